@@ -0,0 +1,134 @@
+'''
+Client for the local job server (diffusion-exp --serve [port]).
+
+    python devtools/job_client.py --port 8765 submit jobs.jsonl [--wait] [--download dir]
+    python devtools/job_client.py --port 8765 status <id>
+    python devtools/job_client.py --port 8765 list
+    python devtools/job_client.py --port 8765 shutdown
+
+With --embed-images the image files are sent as base64,
+so the server does not need to see the client files.
+'''
+import argparse
+import base64
+import json
+import os
+import sys
+import time
+import urllib.error
+import urllib.request
+
+
+class JobClient:
+    def __init__(self, port=8765, host='127.0.0.1'):
+        self.url = f'http://{host}:{port}'
+
+    def request(self, method, path, data=None):
+        body = None
+        headers = {}
+        if data is not None:
+            body = json.dumps(data).encode('utf-8')
+            headers['Content-Type'] = 'application/json'
+        req = urllib.request.Request(self.url + path, data=body, method=method, headers=headers)
+        try:
+            with urllib.request.urlopen(req) as response:
+                content = response.read()
+                if response.headers.get('Content-Type') == 'application/json':
+                    return json.loads(content)
+                return content
+        except urllib.error.HTTPError as e:
+            return json.loads(e.read() or b'{}')
+
+    def health(self):
+        return self.request('GET', '/health')
+
+    def submit(self, jobs):
+        return self.request('POST', '/jobs', jobs).get('ids', [])
+
+    def status(self, job_id):
+        return self.request('GET', f'/jobs/{job_id}')
+
+    def list(self):
+        return self.request('GET', '/jobs').get('jobs', [])
+
+    def image(self, job_id, index):
+        return self.request('GET', f'/jobs/{job_id}/images/{index}')
+
+    def shutdown(self):
+        return self.request('POST', '/shutdown')
+
+    def wait(self, ids, interval=1.0):
+        pending = set(ids)
+        results = {}
+        while pending:
+            for job_id in list(pending):
+                status = self.status(job_id)
+                # unknown jobs have no state
+                if status.get('state') in ('done', 'failed') or 'state' not in status:
+                    results[job_id] = status
+                    pending.discard(job_id)
+            if pending:
+                time.sleep(interval)
+        return results
+
+
+def embed_images(job):
+    for field in ('image', 'mask'):
+        if job.get(field):
+            with open(job.pop(field), 'rb') as fp:
+                job[f'{field}_base64'] = base64.b64encode(fp.read()).decode('ascii')
+    for c in job.get('controlnets', []):
+        if c.get('image'):
+            with open(c.pop('image'), 'rb') as fp:
+                c['image_base64'] = base64.b64encode(fp.read()).decode('ascii')
+    return job
+
+
+def read_jobs(path):
+    with open(path, 'r', encoding='utf-8') as fp:
+        text = fp.read()
+    if text.lstrip().startswith('['):
+        return json.loads(text)
+    return [json.loads(line) for line in text.splitlines() if line.strip() and not line.strip().startswith('#')]
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('--port', type=int, default=8765)
+    parser.add_argument('command', choices=['submit', 'status', 'list', 'health', 'shutdown'])
+    parser.add_argument('argument', nargs='?')
+    parser.add_argument('--wait', action='store_true')
+    parser.add_argument('--embed-images', action='store_true')
+    parser.add_argument('--download')
+    args = parser.parse_args()
+
+    client = JobClient(args.port)
+    if args.command == 'submit':
+        jobs = read_jobs(args.argument)
+        if args.embed_images:
+            jobs = [embed_images(j) for j in jobs]
+        ids = client.submit(jobs)
+        print(json.dumps({'ids': ids}))
+        if args.wait or args.download:
+            results = client.wait(ids)
+            for job_id, status in results.items():
+                print(json.dumps(status))
+                if args.download and status.get('state') == 'done':
+                    os.makedirs(args.download, exist_ok=True)
+                    for index in range(len(status.get('outputs', []))):
+                        with open(os.path.join(args.download, f'{job_id}-{index}.png'), 'wb') as fp:
+                            fp.write(client.image(job_id, index))
+            if any(s.get('state') != 'done' for s in results.values()):
+                sys.exit(1)
+    elif args.command == 'status':
+        print(json.dumps(client.status(args.argument), indent=2))
+    elif args.command == 'list':
+        print(json.dumps(client.list(), indent=2))
+    elif args.command == 'health':
+        print(json.dumps(client.health()))
+    else:
+        print(json.dumps(client.shutdown()))
+
+
+if __name__ == '__main__':
+    main()
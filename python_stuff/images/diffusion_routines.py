@@ -2,13 +2,15 @@ import gc
 import re
 import torch
 import os
-from models.models import create_pipeline, current_model_is_in_painting, models_memory_checker
-from images.latents import create_latents_noise, latents_to_pil
+from models.models import create_pipeline, current_model, current_model_is_in_painting, models_memory_checker
+from models.prompt_cache import encode_prompt
+from images.latents import create_latents_noise, latents_to_pil, cached_vae_encode
 from exceptions.exceptions import CancelException
-from utils.settings import get_setting
+from utils.settings import get_setting, settings_version
 from utils.images import pil_as_dict, pil_from_dict, inpaint_fill_image
 from models.my_gfpgan import gfpgan_dwonload_model, gfpgan_restore_faces
 from models.paths import LORA_DIR
+from utils.telemetry import StepTimer, phase, phase_begin, phase_end, generation_begin, generation_end
 
 from dexpert import progress, progress_canceled, progress_title
 
@@ -84,8 +86,11 @@ def _run_pipeline(pipeline_type, params):
     reload_model = params.get("reload_model", False) 
     input_image = params.get("image")
     input_mask = params.get("mask")
+    image_hash = params.get("image_hash")
+    mask_hash = params.get("mask_hash")
     inpaint_mode = params.get("inpaint_mode", "original")
     controlnets = params.get("controlnets", [])
+    scheduler = params.get("scheduler")
 
     if width % 8 != 0:
         width += 8 - width % 8
@@ -110,7 +115,8 @@ def _run_pipeline(pipeline_type, params):
     report("started")
 
     report("creating the pipeline")
-    pipeline = create_pipeline(pipeline_type, model, controlnets=controlnets, lora_list=lora_list, reload_model=reload_model) 
+    with phase('pipeline creation'):
+        pipeline = create_pipeline(pipeline_type, model, controlnets=controlnets, lora_list=lora_list, reload_model=reload_model, scheduler=scheduler)
     report("pipeline created")
 
     if pipeline_type == 'inpaint2img':
@@ -123,8 +129,13 @@ def _run_pipeline(pipeline_type, params):
             "error": "The current model is a inpainting model"
         }
 
+    step_timer = StepTimer(steps)
+
     def progress_preview(step, timestep, latents):
-        progress(step, steps, latents_to_pil(step, pipeline.vae, latents))
+        step_timer.step(step, timestep)
+        with phase('preview decode'):
+            preview = latents_to_pil(step, pipeline.vae, latents)
+        progress(step, steps, preview)
         if progress_canceled():
             raise CancelException()
     
@@ -156,6 +167,7 @@ def _run_pipeline(pipeline_type, params):
             'image': pil_from_dict(input_image),
             'strength': params['strength'],
         }
+        step_timer.steps = max(1, int(steps * params['strength']))
         if len(controlnets):
             additional_args['width'] = width
             additional_args['height'] = height
@@ -211,21 +223,43 @@ def _run_pipeline(pipeline_type, params):
 
     pipeline.to(device)
     latents_noise.to(device)
+    # variations and the next images use the same prompt, the cache skips the text encoder
+    additional_args.update(encode_prompt(pipeline, current_model(), prompt, negative, cfg))
     report("generating the variation" if variation_enabled else "generating the image")
-    with torch.inference_mode(), torch.autocast(device):
-        result = pipeline(
-            prompt, 
-            negative_prompt=negative, 
-            guidance_scale=cfg, 
-            num_inference_steps=steps,
-            generator=generator,
-            callback=progress_preview,
-            **additional_args,
-        ).images[0]
+
+    # the pipeline decodes the latents at the end, time it apart from the denoise steps
+    decode_latents = getattr(pipeline, 'decode_latents', None)
+    if decode_latents is not None:
+        def timed_decode_latents(*args, **kwargs):
+            with phase('vae decode'):
+                return decode_latents(*args, **kwargs)
+        pipeline.decode_latents = timed_decode_latents
+
+    # the variations of an image encode the same image (and masked image) again, the cache skips the vae encoder
+    encode_key = None
+    if image_hash and pipeline_type != 'txt2img':
+        encode_key = (current_model()['key'], settings_version(), pipeline_type, inpaint_mode, image_hash, mask_hash)
+
+    phase_begin('denoise')
+    try:
+        step_timer.restart()
+        with torch.inference_mode(), torch.autocast(device), cached_vae_encode(pipeline.vae, encode_key):
+            result = pipeline(
+                guidance_scale=cfg, 
+                num_inference_steps=steps,
+                generator=generator,
+                callback=progress_preview,
+                **additional_args,
+            ).images[0]
+    finally:
+        phase_end()
+        if decode_latents is not None:
+            del pipeline.decode_latents
 
     if restore_faces:
         progress(99, 100, pil_as_dict(result)) 
-        result = gfpgan_restore_faces(result)
+        with phase('face restore'):
+            result = gfpgan_restore_faces(result)
 
     report("image generated")
     return pil_as_dict(result)
@@ -233,12 +267,15 @@ def _run_pipeline(pipeline_type, params):
 
 def run_pipeline(mode: str, params: dict):
     progress(0, 100, {})
-
+    generation_begin(mode)
+    data = {"error": "unexpected error"}
     try:
         data = _run_pipeline(mode, params)   
     except CancelException:
         print("Image generation canceled")
         data = {"error": "Operation canceled by the user"}
+    finally:
+        generation_end('error' not in data)
     gc.collect()
 
     progress(100, 100, {})     
@@ -1,9 +1,17 @@
 import gc
+from contextlib import contextmanager
 
 import torch
 from torchvision import transforms
 from PIL import Image
 from utils.images import pil_as_dict
+from utils.telemetry import cache_lookup, phase
+from models.prompt_cache import TensorCache
+
+
+# The vae encoder output (the latent distribution) of the img2img and inpaint input images.
+# The variations of an image send the same image and mask, only the first one runs the encoder.
+LATENTS_CACHE = TensorCache('latents_cache_entries', 16)
 
 
 def pil_to_latents(image, vae):
@@ -16,6 +24,39 @@ def pil_to_latents(image, vae):
     return init_latent_dist
 
 
+@contextmanager
+def cached_vae_encode(vae, key):
+    '''
+    Caches the vae.encode calls made by the pipeline while the context is active.
+    The pipeline encodes the image and the masked image in the same order every time,
+    so the key (the model key first, the image hashes and the mode) plus the call order identify each encode.
+    The distribution is cached, not its sample: the pipeline still samples it with its generator,
+    the results do not change.
+    '''
+    if key is None:
+        yield
+        return
+    encode = vae.encode
+    calls = [0]
+
+    def encode_cached(x, *args, **kwargs):
+        entry_key = (*key, calls[0], tuple(x.shape), str(x.dtype), str(x.device))
+        calls[0] += 1
+        output = LATENTS_CACHE.get(entry_key)
+        cache_lookup('vae encode', output is not None)
+        if output is None:
+            with phase('vae encode'):
+                output = encode(x, *args, **kwargs)
+            LATENTS_CACHE.put(entry_key, output)
+        return output
+
+    vae.encode = encode_cached
+    try:
+        yield
+    finally:
+        del vae.encode
+
+
 def latents_to_pil(step, vae, latents):
     if step % 5 != 0:
         return {}
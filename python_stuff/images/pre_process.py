@@ -7,6 +7,7 @@ from controlnet_aux import HEDdetector, OpenposeDetector
 from transformers import pipeline
 
 from utils.images import pil_as_dict, pil_from_dict
+from utils.settings import get_setting
 from images.line_art import LineartDetector
 from images.manga_line import MangaLineExtration
 from dexpert import progress, progress_title
@@ -16,6 +17,49 @@ def report(message):
 
 
 from models.paths import CACHE_DIR
+from models.model_cache import ModelCache, MB, object_bytes
+
+
+def detector_cache_budget() -> int:
+    return get_setting('detector_cache_mb', 2048) * MB
+
+
+# the detectors stay loaded between the pre-processor calls
+DETECTOR_CACHE = ModelCache(budget=detector_cache_budget)
+
+
+def get_detector(name: str, create):
+    detector = DETECTOR_CACHE.get(name)
+    if detector is None:
+        report(f"loading the {name} model")
+        detector = create()
+        DETECTOR_CACHE.put(name, detector, 'detector', name, object_bytes(detector))
+    return detector
+
+
+def load_lineart():
+    # la = LineartDetector(LineartDetector.model_default)
+    la = LineartDetector(LineartDetector.model_coarse)
+    la.load_model(la.model_name)
+    return la
+
+
+def load_mangaline():
+    ml = MangaLineExtration()
+    ml.load_model()
+    return ml
+
+
+def pre_process_cache_stats():
+    return DETECTOR_CACHE.stats()
+
+
+def pre_process_cache_evict(name: str):
+    if name:
+        DETECTOR_CACHE.evict_by_name(name)
+    else:
+        DETECTOR_CACHE.clear()
+
 
 def HWC3(x):
     assert x.dtype == np.uint8
@@ -81,7 +125,7 @@ def image_to_canny(input_image) -> dict:
 
 def image_to_pose(input_image) -> dict:
     def do_it():
-        openpose = OpenposeDetector.from_pretrained('lllyasviel/ControlNet', cache_dir=CACHE_DIR)
+        openpose = get_detector('openpose', lambda: OpenposeDetector.from_pretrained('lllyasviel/ControlNet', cache_dir=CACHE_DIR))
         progress(2, 3, {})
         image = openpose(input_image)
         return pil_as_dict(image)
@@ -93,7 +137,7 @@ def image_to_pose(input_image) -> dict:
 
 def image_to_scribble(input_image) -> dict:
     def do_it():
-        hed = HEDdetector.from_pretrained('lllyasviel/ControlNet', cache_dir=CACHE_DIR)
+        hed = get_detector('hed', lambda: HEDdetector.from_pretrained('lllyasviel/ControlNet', cache_dir=CACHE_DIR))
         progress(2, 3, {})
         image = PIL.ImageOps.invert(hed(input_image, scribble=True))
         gc.collect()
@@ -105,7 +149,7 @@ def image_to_scribble(input_image) -> dict:
 
 def image_to_deepth(input_image) -> dict:
     def do_it():
-        depth_estimator = pipeline('depth-estimation')
+        depth_estimator = get_detector('depth', lambda: pipeline('depth-estimation'))
         progress(2, 3, {})
         image = depth_estimator(input_image)['depth']
         image = np.array(image)
@@ -121,8 +165,7 @@ def image_to_deepth(input_image) -> dict:
 
 def image_to_lineart(input_image) -> dict:
     def do_it():
-        # la = LineartDetector(LineartDetector.model_default)
-        la = LineartDetector(LineartDetector.model_coarse)
+        la = get_detector('lineart', load_lineart)
         image, remove_pad = resize_image_with_pad(np.array(input_image), 512)
         image = la(image)
         image = image[:, :, None]
@@ -139,7 +182,7 @@ def image_to_lineart(input_image) -> dict:
 
 def image_to_mangaline(input_image) -> dict:
     def do_it():
-        la = MangaLineExtration()
+        la = get_detector('mangaline', load_mangaline)
         image, remove_pad = resize_image_with_pad(np.array(input_image), 512)
         image = la(image)
         image = image[:, :, None]
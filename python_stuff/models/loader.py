@@ -531,6 +531,47 @@ def load_lora_list(lora_list, unet, text_model):
         load_lora_weights(unet, text_model, lm[0], w)
 
 
+SCHEDULERS = {
+    'PNDMScheduler': PNDMScheduler,
+    'DDIMScheduler': DDIMScheduler,
+    'UniPCMultistepScheduler': UniPCMultistepScheduler,
+    'LMSDiscreteScheduler': LMSDiscreteScheduler,
+}
+
+
+def scheduler_class(scheduler_name: str):
+    # unknown names use the LMSDiscreteScheduler (as the model loading always did)
+    return SCHEDULERS.get(scheduler_name, LMSDiscreteScheduler)
+
+
+def create_scheduler(scheduler_name: str, beta_start, beta_end, num_train_timesteps):
+    if scheduler_name == 'PNDMScheduler': 
+        return PNDMScheduler(
+            beta_start=beta_start,
+            beta_end=beta_end,
+            beta_schedule="scaled_linear",
+            num_train_timesteps=num_train_timesteps,
+            skip_prk_steps=True,
+        )
+    elif scheduler_name == 'DDIMScheduler':
+        return DDIMScheduler(
+            beta_start=beta_start,
+            beta_end=beta_end,
+            beta_schedule="scaled_linear",
+            clip_sample=False,
+            set_alpha_to_one=False,
+        )
+    elif  scheduler_name == 'UniPCMultistepScheduler':
+        return UniPCMultistepScheduler(
+            beta_start=beta_start,
+            beta_end=beta_end,
+            beta_schedule="scaled_linear",
+            # clip_sample=False,
+            # set_alpha_to_one=False,
+        )
+    return LMSDiscreteScheduler(beta_start=beta_start, beta_end=beta_end, beta_schedule="scaled_linear")
+
+
 def load_stable_diffusion_model(model_path: str, lora_list: list):
     report(f"loading {model_path}")
 
@@ -559,33 +600,7 @@ def load_stable_diffusion_model(model_path: str, lora_list: list):
     beta_end = config.model.params.linear_end
     report(f"inference config loaded")
 
-    scheduler_name = get_setting('scheduler', 'PNDMScheduler')
-    if scheduler_name == 'PNDMScheduler': 
-        scheduler = PNDMScheduler(
-            beta_start=beta_start,
-            beta_end=beta_end,
-            beta_schedule="scaled_linear",
-            num_train_timesteps=num_train_timesteps,
-            skip_prk_steps=True,
-        )
-    elif scheduler_name == 'DDIMScheduler':
-        scheduler = DDIMScheduler(
-            beta_start=beta_start,
-            beta_end=beta_end,
-            beta_schedule="scaled_linear",
-            clip_sample=False,
-            set_alpha_to_one=False,
-        )
-    elif  scheduler_name == 'UniPCMultistepScheduler':
-        scheduler = UniPCMultistepScheduler(
-            beta_start=beta_start,
-            beta_end=beta_end,
-            beta_schedule="scaled_linear",
-            # clip_sample=False,
-            # set_alpha_to_one=False,
-        )
-    else:
-         scheduler = LMSDiscreteScheduler(beta_start=beta_start, beta_end=beta_end, beta_schedule="scaled_linear")
+    scheduler = create_scheduler(get_setting('scheduler', 'PNDMScheduler'), beta_start, beta_end, num_train_timesteps)
 
     # Convert the UNet2DConditionModel model.
     report("converting UNet2DConditionModel model (unet-config)")
@@ -0,0 +1,158 @@
+import gc
+import itertools
+from collections import OrderedDict
+
+import torch
+
+from utils.settings import get_setting
+
+
+MB = 1024 * 1024
+
+
+def module_bytes(*objects) -> int:
+    total = 0
+    seen = set()
+    for obj in objects:
+        if not isinstance(obj, torch.nn.Module):
+            continue
+        for t in itertools.chain(obj.parameters(), obj.buffers()):
+            if id(t) in seen:
+                continue
+            seen.add(id(t))
+            total += t.numel() * t.element_size()
+    return total
+
+
+def object_bytes(obj, depth: int = 2) -> int:
+    '''
+    module_bytes for objects that keep their modules in attributes (the pre-processor detectors)
+    '''
+    def modules(o, level):
+        if isinstance(o, torch.nn.Module):
+            return [o]
+        if level == 0 or not hasattr(o, '__dict__'):
+            return []
+        return [m for v in vars(o).values() for m in modules(v, level - 1)]
+    return module_bytes(*modules(obj, depth))
+
+
+def cache_budget() -> int:
+    budget_mb = get_setting('model_cache_mb', 0)
+    if budget_mb:
+        return budget_mb * MB
+    device = get_setting('device', 'cuda')
+    if device != 'cpu' and torch.cuda.is_available():
+        return int(torch.cuda.get_device_properties(device).total_memory * 0.6)
+    # no way to know the free ram without extra dependencies: keeps only the models in use
+    return 0
+
+
+class ModelCache:
+    '''
+    Least recently used models, pipelines and controlnets under a byte budget.
+    A pipeline depends on its model and controlnets (it shares their modules and costs no extra bytes),
+    evicting an entry also evicts the entries that depend on it.
+    '''
+    def __init__(self, budget=cache_budget):
+        self.budget = budget
+        self.entries = OrderedDict()
+        self.version = None
+        self.hits = 0
+        self.misses = 0
+        self.evictions = 0
+
+    def get(self, key):
+        entry = self.entries.get(key)
+        if entry is None:
+            self.misses += 1
+            return None
+        self.entries.move_to_end(key)
+        entry['hits'] += 1
+        self.hits += 1
+        return entry['value']
+
+    def put(self, key, value, kind: str, name: str, size: int, parents=(), keep=()):
+        self.entries[key] = {
+            'value': value,
+            'kind': kind,
+            'name': name,
+            'bytes': size,
+            'hits': 0,
+            'parents': tuple(parents),
+        }
+        self.trim(keep=(key, *keep))
+
+    def used(self) -> int:
+        return sum(e['bytes'] for e in self.entries.values())
+
+    def largest(self, kind: str) -> int:
+        return max([e['bytes'] for e in self.entries.values() if e['kind'] == kind] or [0])
+
+    def protected(self, keep) -> set:
+        result = set()
+        for key in keep:
+            if key in self.entries:
+                result.add(key)
+                result.update(self.entries[key]['parents'])
+        return result
+
+    def trim(self, keep=(), reserve: int = 0, budget: int = None):
+        '''
+        Evicts the least recently used entries until the used bytes + reserve fit in the budget.
+        The entries in keep and the entries they depend on stay.
+        '''
+        budget = self.budget() if budget is None else budget
+        protected = self.protected(keep)
+        evicted = False
+        for key in list(self.entries.keys()):
+            if self.used() + reserve <= budget:
+                break
+            if key in protected or key not in self.entries:
+                continue
+            evicted = self.evict(key, collect=False) or evicted
+        if evicted:
+            self.collect()
+
+    def evict(self, key, collect=True) -> bool:
+        entry = self.entries.pop(key, None)
+        if entry is None:
+            return False
+        self.evictions += 1
+        for dependent in [k for k, e in self.entries.items() if key in e['parents']]:
+            self.evict(dependent, collect=False)
+        if collect:
+            self.collect()
+        return True
+
+    def evict_by_name(self, name: str) -> bool:
+        keys = [k for k, e in self.entries.items() if e['name'] == name]
+        for key in keys:
+            self.evict(key, collect=False)
+        self.collect()
+        return len(keys) > 0
+
+    def clear(self):
+        for key in list(self.entries.keys()):
+            self.evict(key, collect=False)
+        self.collect()
+
+    def collect(self):
+        gc.collect()
+        if torch.cuda.is_available():
+            torch.cuda.empty_cache()
+
+    def stats(self) -> dict:
+        return {
+            'budget': self.budget(),
+            'used': self.used(),
+            'hits': self.hits,
+            'misses': self.misses,
+            'evictions': self.evictions,
+            'entries': [{
+                'name': e['name'],
+                'kind': e['kind'],
+                'bytes': e['bytes'],
+                'hits': e['hits'],
+            } for e in self.entries.values()]
+        }
@@ -1,7 +1,5 @@
 import gc
 import os
-from PIL import Image
-from utils.images import pil_as_dict
 
 from contextlib import contextmanager
 from diffusers import (
@@ -18,36 +16,78 @@ import torch
 from models.paths import CACHE_DIR, MODELS_DIR, EMBEDDING_DIR, LORA_DIR
 from utils.settings import get_setting, settings_version
 from utils.downloader import download_file
-from models.loader import load_stable_diffusion_model, get_textual_inversion_paths, get_lora_paths
+from utils.telemetry import phase
+from models.model_cache import ModelCache, module_bytes
+from models.prompt_cache import PROMPT_CACHE
+from images.latents import LATENTS_CACHE
+from images.pre_process import DETECTOR_CACHE
+from models.loader import (
+    load_stable_diffusion_model, get_textual_inversion_paths, get_lora_paths, create_scheduler, scheduler_class
+)
 from external.img2img_controlnet import StableDiffusionControlNetImg2ImgPipeline
 from external.img2img_inpaint_controlnet import StableDiffusionControlNetInpaintImg2ImgPipeline
 
 
 CURRENT_MODEL_PARAMS = {}
 CURRENT_PIPELINE = {}
+MODEL_CACHE = ModelCache()
+
+CONTROLNET_REPOS = {
+    'canny': 'lllyasviel/sd-controlnet-canny',
+    'pose': 'lllyasviel/sd-controlnet-openpose',
+    'scribble': 'lllyasviel/sd-controlnet-scribble',
+    'deepth': 'lllyasviel/sd-controlnet-depth',
+    'segmentation': 'lllyasviel/sd-controlnet-seg',
+    'lineart': 'lllyasviel/control_v11p_sd15s2_lineart_anime',
+    'mangaline': 'lllyasviel/control_v11p_sd15s2_lineart_anime',
+}
 
 # if the model does not load see: https://github.com/d8ahazard/sd_dreambooth_extension/discussions/794
 
+def check_settings_version():
+    # the device and the float type of the cached models depend on the settings
+    global CURRENT_MODEL_PARAMS
+    global CURRENT_PIPELINE
+    if MODEL_CACHE.version != settings_version():
+        CURRENT_MODEL_PARAMS = {}
+        CURRENT_PIPELINE = {}
+        MODEL_CACHE.clear()
+        MODEL_CACHE.version = settings_version()
+
+
 def load_model(model_path: str, lora_list: list, reload_model: bool):
     global CURRENT_MODEL_PARAMS
     global CURRENT_PIPELINE
+    check_settings_version()
     lora_list.sort()
-    if CURRENT_MODEL_PARAMS.get('path', '') != model_path or \
-            lora_list != CURRENT_MODEL_PARAMS.get('lora_list', []) or \
-            reload_model or \
-            settings_version() != CURRENT_MODEL_PARAMS.get('settings_version'):
+    key = ('model', model_path, tuple(tuple(l) for l in lora_list))
+    if reload_model:
         CURRENT_MODEL_PARAMS = {}
         CURRENT_PIPELINE = {}
-        gc.collect()
-        params, in_painting = load_stable_diffusion_model(model_path, lora_list=lora_list)
-        CURRENT_MODEL_PARAMS = {
-            'settings_version': settings_version(),
+        MODEL_CACHE.evict(key)
+        PROMPT_CACHE.evict_model(key)
+        LATENTS_CACHE.evict_model(key)
+    model = MODEL_CACHE.get(key)
+    if model is None:
+        CURRENT_MODEL_PARAMS = {}
+        CURRENT_PIPELINE = {}
+        # makes room for a model as big as the largest one loaded before
+        MODEL_CACHE.trim(reserve=MODEL_CACHE.largest('model'))
+        # the textual inversions are loaded with the model, the prompt cache depends on them
+        embeddings = tuple(sorted(p[1] for p in get_textual_inversion_paths()))
+        with phase('model load'):
+            params, in_painting = load_stable_diffusion_model(model_path, lora_list=lora_list)
+        model = {
+            'key': key,
             'path': model_path,
             'lora_list': lora_list,
+            'embeddings': embeddings,
             'params': params,
             'in_painting': in_painting
         }
-    gc.collect()
+        name = ' '.join([os.path.basename(model_path)] + [f'{os.path.basename(l[0])}:{l[1]}' for l in lora_list])
+        MODEL_CACHE.put(key, model, 'model', name, module_bytes(*params.values()))
+    CURRENT_MODEL_PARAMS = model
 
 usefp16 = {
     True: torch.float16,
@@ -55,45 +95,48 @@ usefp16 = {
 }
 
 
-def create_pipeline(mode: str, model_path: str, controlnets = None, lora_list=[], reload_model=False):
+def load_controlnet(mode: str):
+    # the controlnets are shared by the pipelines of all the models
+    key = ('controlnet', mode)
+    model = MODEL_CACHE.get(key)
+    if model is not None:
+        return key, model
+    if mode == 'segmentation':
+        mode_str = f"models--lllyasviel--sd-controlnet-seg"
+    elif mode == 'lineart':
+        mode_str = f"models--lllyasviel--control_v11p_sd15s2_lineart_anime"
+    else:
+        mode_str = f"models--lllyasviel--sd-controlnet-{mode}"
+    local_files_only = os.path.exists(os.path.join(CACHE_DIR, mode_str, 'snapshots'))
+    model = ControlNetModel.from_pretrained(
+        CONTROLNET_REPOS[mode], torch_dtype=usefp16[get_setting('use_float16', True)], cache_dir=CACHE_DIR, local_files_only=local_files_only
+    )
+    MODEL_CACHE.put(key, model, 'controlnet', f'controlnet {mode}', module_bytes(model), keep=(CURRENT_MODEL_PARAMS['key'],))
+    return key, model
+
+
+def create_pipeline(mode: str, model_path: str, controlnets = None, lora_list=[], reload_model=False, scheduler=None):
     global CURRENT_PIPELINE
     load_model(model_path, lora_list, reload_model)
     controlnet_modes = sorted([f["mode"] for f in (controlnets or [])])
-    if CURRENT_PIPELINE.get("model_path") != model_path or \
-            CURRENT_PIPELINE.get("contronet") != controlnet_modes or \
-            mode != CURRENT_PIPELINE.get("mode") or \
-            reload_model or \
-            settings_version() != CURRENT_PIPELINE.get('settings_version'):
+    model_key = CURRENT_MODEL_PARAMS['key']
+    key = ('pipeline', model_key, mode, tuple(controlnet_modes))
+    pipe = MODEL_CACHE.get(key)
+    if pipe is None:
         CURRENT_PIPELINE = {}
-        gc.collect()
         controlnets = controlnets or [] if mode in ('txt2img', 'img2img', 'inpaint2img') else []
         control_model = []
+        control_keys = []
         have_controlnet = False
-        model_repos = {
-                'canny': 'lllyasviel/sd-controlnet-canny',
-                'pose': 'lllyasviel/sd-controlnet-openpose',
-                'scribble': 'lllyasviel/sd-controlnet-scribble',
-                'deepth': 'lllyasviel/sd-controlnet-depth',
-                'segmentation': 'lllyasviel/sd-controlnet-seg',
-                'lineart': 'lllyasviel/control_v11p_sd15s2_lineart_anime',
-                'mangaline': 'lllyasviel/control_v11p_sd15s2_lineart_anime',
-        }
         for c in controlnets:
             have_controlnet = True
-            if not model_repos.get(c['mode']):
+            if not CONTROLNET_REPOS.get(c['mode']):
                 print("No controlnet for ", c['mode'])
                 continue
             print("Controlnet: ", c['mode'])
-            if c['mode'] == 'segmentation':
-                mode_str = f"models--lllyasviel--sd-controlnet-seg"
-            elif c['mode'] == 'lineart':
-                mode_str = f"models--lllyasviel--control_v11p_sd15s2_lineart_anime"
-            else:
-                mode_str = f"models--lllyasviel--sd-controlnet-{c['mode']}"
-            local_files_only = os.path.exists(os.path.join(CACHE_DIR, mode_str, 'snapshots'))
-            control_model.append(ControlNetModel.from_pretrained(
-                model_repos[c['mode']], torch_dtype=usefp16[get_setting('use_float16', True)], cache_dir=CACHE_DIR, local_files_only=local_files_only
-            ))
+            control_key, model = load_controlnet(c['mode'])
+            control_keys.append(control_key)
+            control_model.append(model)
 
         if len(control_model) == 1:
             control_model = control_model[0]
@@ -120,15 +163,42 @@ def create_pipeline(mode: str, model_path: str, controlnets = None, lora_list=[]
         # pipe.enable_model_cpu_offload()
         pipe.enable_attention_slicing(1)
         pipe.enable_xformers_memory_efficient_attention()
-        CURRENT_PIPELINE = {
-            'settings_version': settings_version(),
-            'mode': mode,
-            'model_path': model_path,
-            'pipeline': pipe,
-            'contronet': controlnet_modes
-        }
-    gc.collect()
-    return CURRENT_PIPELINE['pipeline']
+        name = ' '.join([mode, os.path.basename(model_path)] + controlnet_modes)
+        MODEL_CACHE.put(key, pipe, 'pipeline', name, 0, parents=(model_key, *control_keys))
+    use_scheduler(pipe, scheduler or get_setting('scheduler', 'PNDMScheduler'))
+    CURRENT_PIPELINE = {
+        'key': key,
+        'mode': mode,
+        'model_path': model_path,
+        'pipeline': pipe,
+        'contronet': controlnet_modes
+    }
+    return pipe
+
+
+def use_scheduler(pipe, scheduler_name: str):
+    # the parameter sweeps change the scheduler of a cached pipeline (the model is not reloaded)
+    if type(pipe.scheduler) is scheduler_class(scheduler_name):
+        return
+    config = pipe.scheduler.config
+    pipe.scheduler = create_scheduler(scheduler_name, config.beta_start, config.beta_end, config.num_train_timesteps)
+
+
+def model_cache_stats():
+    return MODEL_CACHE.stats()
+
+
+def model_cache_evict(name: str):
+    global CURRENT_MODEL_PARAMS
+    global CURRENT_PIPELINE
+    CURRENT_MODEL_PARAMS = {}
+    CURRENT_PIPELINE = {}
+    if name:
+        MODEL_CACHE.evict_by_name(name)
+    else:
+        MODEL_CACHE.clear()
+        PROMPT_CACHE.clear()
+        LATENTS_CACHE.clear()
 
 
 @contextmanager
@@ -151,9 +221,15 @@ def models_memory_checker():
 
     try:
         if should_release_memory:
+            # the pre-processor detectors and the cached models that are not in use go first
+            DETECTOR_CACHE.clear()
+            MODEL_CACHE.trim(keep=(CURRENT_MODEL_PARAMS.get('key'), CURRENT_PIPELINE.get('key')), budget=0)
             if device_name == 'cpu':
                 CURRENT_MODEL_PARAMS = {}
                 CURRENT_PIPELINE = {}
+                MODEL_CACHE.clear()
+                PROMPT_CACHE.clear()
+                LATENTS_CACHE.clear()
             else:
                 if vae:
                     vae.to('cpu')
@@ -180,6 +256,10 @@ def models_memory_checker():
             gc.collect()
 
 
+def current_model():
+    return CURRENT_MODEL_PARAMS
+
+
 def current_model_is_in_painting():
     return CURRENT_MODEL_PARAMS.get('in_painting', False) is True
 
@@ -247,10 +327,5 @@ def get_embeddings():
             'filename': os.path.basename(f),
             'path': f
         })
-    for r in result:
-        picture_path = f'{r["path"]}.jpg'
-        if os.path.exists(picture_path):
-            with Image.open(picture_path) as im:
-                r['image'] = pil_as_dict(im)
     result.sort(key=lambda x: x['name'].lower())
     return result
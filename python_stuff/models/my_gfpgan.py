@@ -72,6 +72,39 @@ def param_or_setting(key, default, args):
     return  args.get(key, get_setting(key, default))
 
 
+def _bg_upsampler(args):
+    from basicsr.archs.rrdbnet_arch import RRDBNet
+    from realesrgan import RealESRGANer
+    model = RRDBNet(num_in_ch=3, num_out_ch=3, num_feat=64, num_block=23, num_grow_ch=32, scale=2)
+    return RealESRGANer(
+        scale=2,
+        model_path=os.path.join(BASE_DIR, 'RealESRGAN_x2plus.pth'),
+        model=model,
+        tile=param_or_setting('gfpgan.tile', 400, args),  
+        tile_pad=param_or_setting('gfpgan.tile_pad', 10, args),
+        pre_pad=param_or_setting('gfpgan.pre_pad', 0, args),
+        half=True)  # need to set False in CPU mode
+
+
+def _face_restorer(scale, bg_upsampler, args):
+    arch = param_or_setting('gfpgan.arch', 'clean', args)
+
+    if arch == 'RestoreFormer':
+        model_path = os.path.join(BASE_DIR, 'RestoreFormer.pth')
+        channel_multiplier = 2
+    else:
+        channel_multiplier = 2
+        model_path = MODEL_PATH
+
+    return GFPGANer(
+        model_path=model_path,
+        upscale=scale,
+        arch=arch,
+        channel_multiplier=channel_multiplier,
+        bg_upsampler=bg_upsampler
+    )
+
+
 def _gfpgan_upscale(image, scale, restore_bg, args):
     gfpgan_dwonload_model()
 
@@ -81,34 +114,9 @@ def _gfpgan_upscale(image, scale, restore_bg, args):
     with enter_gfgan_model_dir():
         bg_upsampler = None
         if restore_bg:
-            from basicsr.archs.rrdbnet_arch import RRDBNet
-            from realesrgan import RealESRGANer
-            model = RRDBNet(num_in_ch=3, num_out_ch=3, num_feat=64, num_block=23, num_grow_ch=32, scale=2)
-            bg_upsampler = RealESRGANer(
-                scale=2,
-                model_path=os.path.join(BASE_DIR, 'RealESRGAN_x2plus.pth'),
-                model=model,
-                tile=param_or_setting('gfpgan.tile', 400, args),  
-                tile_pad=param_or_setting('gfpgan.tile_pad', 10, args),
-                pre_pad=param_or_setting('gfpgan.pre_pad', 0, args),
-                half=True)  # need to set False in CPU mode
+            bg_upsampler = _bg_upsampler(args)
             
-        arch = param_or_setting('gfpgan.arch', 'clean', args)
-        
-        if arch == 'RestoreFormer':
-            model_path = os.path.join(BASE_DIR, 'RestoreFormer.pth')
-            channel_multiplier = 2
-        else:
-            channel_multiplier = 2
-            model_path = MODEL_PATH
-
-        restorer = GFPGANer(
-            model_path=model_path,
-            upscale=scale,
-            arch=arch,
-            channel_multiplier=channel_multiplier,
-            bg_upsampler=bg_upsampler
-        )
+        restorer = _face_restorer(scale, bg_upsampler, args)
         cropped_faces, restored_faces, restored_img = restorer.enhance(
                 open_cv_image,
                 has_aligned=param_or_setting('gfpgan.has_aligned', False, args),
@@ -138,4 +146,73 @@ def gfpgan_restore_faces(image):
 
 
 def gfpgan_upscale(image, scale, args):
-    return pil_as_dict(_gfpgan_upscale_check_mem(pil_from_dict(image), scale, True, args))
\ No newline at end of file
+    return pil_as_dict(_gfpgan_upscale_check_mem(pil_from_dict(image), scale, True, args))
+
+
+# The tiles of a large image use the same models, they are loaded by the first tile and kept
+# until gfpgan_release (the c++ side calls it after the last tile).
+TILE_MODELS = {}
+
+
+def _tile_model(name, create):
+    if name not in TILE_MODELS:
+        gfpgan_dwonload_model()
+        with enter_gfgan_model_dir():
+            TILE_MODELS[name] = create()
+    return TILE_MODELS[name]
+
+
+@contextmanager
+def only_faces_centered_at(restorer, box):
+    # restores only the faces whose center is inside the box (x, y, w, h), the others belong to the neighbor windows
+    helper = restorer.face_helper
+    detect = helper.get_face_landmarks_5
+
+    def detect_centered(*args, **kwargs):
+        detect(*args, **kwargs)
+        x, y, w, h = box
+        keep = [
+            i for i, face in enumerate(helper.det_faces)
+            if x <= (face[0] + face[2]) / 2 < x + w and y <= (face[1] + face[3]) / 2 < y + h
+        ]
+        helper.det_faces = [helper.det_faces[i] for i in keep]
+        helper.all_landmarks_5 = [helper.all_landmarks_5[i] for i in keep]
+        return len(helper.all_landmarks_5)
+
+    helper.get_face_landmarks_5 = detect_centered
+    try:
+        yield
+    finally:
+        del helper.get_face_landmarks_5
+
+
+def gfpgan_upscale_background(image, scale, args):
+    # a tile of a large image: only the background upsampler, the faces are restored by gfpgan_restore_window
+    with models_memory_checker():
+        upsampler = _tile_model('upsampler', lambda: _bg_upsampler(args))
+        open_cv_image = cv2.cvtColor(numpy.array(pil_from_dict(image)), cv2.COLOR_RGB2BGR)
+        with enter_gfgan_model_dir():
+            output, _ = upsampler.enhance(open_cv_image, outscale=scale)
+        return pil_as_dict(Image.fromarray(cv2.cvtColor(output, cv2.COLOR_BGR2RGB)))
+
+
+def gfpgan_restore_window(image, box, args):
+    # a window of the upscaled image (see plan_restore_windows): the margin around the box
+    # keeps the faces that cross the box border whole, each face is restored by one window only
+    with models_memory_checker():
+        restorer = _tile_model('restorer', lambda: _face_restorer(1.0, None, args))
+        open_cv_image = cv2.cvtColor(numpy.array(pil_from_dict(image)), cv2.COLOR_RGB2BGR)
+        with enter_gfgan_model_dir(), only_faces_centered_at(restorer, box):
+            _, _, restored_img = restorer.enhance(
+                open_cv_image,
+                has_aligned=False,
+                only_center_face=False,
+                paste_back=True,
+                weight=param_or_setting('gfpgan.weight', 0.5, args)
+            )
+        return pil_as_dict(Image.fromarray(cv2.cvtColor(restored_img, cv2.COLOR_BGR2RGB)))
+
+
+def gfpgan_release():
+    TILE_MODELS.clear()
+    gc.collect()
@@ -0,0 +1,89 @@
+from collections import OrderedDict
+
+import torch
+
+from utils.settings import get_setting, settings_version
+from utils.telemetry import cache_lookup, phase
+
+
+class TensorCache:
+    '''
+    The latest results of a model component (small tensors), the first item of the key is the model key.
+    '''
+    def __init__(self, setting: str, default_entries: int):
+        self.setting = setting
+        self.default_entries = default_entries
+        self.entries = OrderedDict()
+        self.hits = 0
+        self.misses = 0
+
+    def max_entries(self) -> int:
+        return get_setting(self.setting, self.default_entries)
+
+    def get(self, key):
+        value = self.entries.get(key)
+        if value is None:
+            self.misses += 1
+            return None
+        self.entries.move_to_end(key)
+        self.hits += 1
+        return value
+
+    def put(self, key, value):
+        self.entries[key] = value
+        while len(self.entries) > max(self.max_entries(), 0):
+            self.entries.popitem(last=False)
+
+    def evict_model(self, model_key):
+        for key in [k for k in self.entries.keys() if k[0] == model_key]:
+            del self.entries[key]
+
+    def clear(self):
+        self.entries.clear()
+
+    def stats(self) -> dict:
+        return {
+            'entries': len(self.entries),
+            'hits': self.hits,
+            'misses': self.misses,
+        }
+
+
+# The text encoder output of the latest prompts.
+# The key is the model (path + loras), the textual inversions it loaded and the prompt text,
+# the next image and the variations of the same prompt skip the text encoder.
+PROMPT_CACHE = TensorCache('prompt_cache_entries', 64)
+
+
+@torch.no_grad()
+def encode_prompt(pipeline, model: dict, prompt: str, negative: str, cfg: float) -> dict:
+    '''
+    Returns the pipeline arguments (prompt_embeds and negative_prompt_embeds) for the prompt,
+    encoding it only when it is not in the cache.
+    '''
+    device = pipeline._execution_device
+    guidance = cfg > 1.0
+    key = (
+        model['key'],
+        model.get('embeddings', ()),
+        prompt,
+        negative if guidance else None,
+        guidance,
+        str(device),
+        settings_version(),
+    )
+    embeds = PROMPT_CACHE.get(key)
+    cache_lookup('prompt', embeds is not None)
+    if embeds is None:
+        with phase('prompt encode'):
+            encoded = pipeline._encode_prompt(prompt, device, 1, guidance, negative)
+        if guidance:
+            negative_embeds, prompt_embeds = encoded.chunk(2)
+        else:
+            negative_embeds, prompt_embeds = None, encoded
+        embeds = {
+            'prompt_embeds': prompt_embeds,
+            'negative_prompt_embeds': negative_embeds,
+        }
+        PROMPT_CACHE.put(key, embeds)
+    return embeds
@@ -0,0 +1,63 @@
+import time
+from contextlib import contextmanager
+
+import torch
+
+from dexpert import telemetry
+
+
+def vram_usage() -> int:
+    if torch.cuda.is_available():
+        return torch.cuda.memory_allocated()
+    return 0
+
+
+def generation_begin(mode: str):
+    telemetry('begin', mode, vram=vram_usage())
+
+
+def generation_end(success: bool):
+    telemetry('end', success=success, vram=vram_usage())
+
+
+def phase_begin(name: str):
+    telemetry('phase_begin', name, vram=vram_usage())
+
+
+def phase_end():
+    telemetry('phase_end', vram=vram_usage())
+
+
+def cache_lookup(name: str, hit: bool):
+    telemetry('cache', name, success=hit)
+
+
+@contextmanager
+def phase(name: str):
+    phase_begin(name)
+    try:
+        yield
+    finally:
+        phase_end()
+
+
+class StepTimer:
+    '''
+    Measures the time between the pipeline callbacks
+    '''
+    def __init__(self, steps: int):
+        self.steps = steps
+        self.last = time.perf_counter()
+
+    def step(self, step: int, timestep):
+        now = time.perf_counter()
+        elapsed_ms = (now - self.last) * 1000.0
+        self.last = now
+        try:
+            timestep = float(timestep)
+        except (TypeError, ValueError):
+            timestep = 0.0
+        telemetry('step', step=step, steps=self.steps, timestep=timestep, elapsed_ms=elapsed_ms, vram=vram_usage())
+
+    def restart(self):
+        self.last = time.perf_counter()
@@ -0,0 +1,209 @@
+#include <algorithm>
+#include <iostream>
+#include <iterator>
+#include <filesystem>
+
+#include <nlohmann/json.hpp>
+
+#include "src/stable_diffusion/sweep.h"
+#include "src/batch/batch_job.h"
+
+using json = nlohmann::json;
+
+namespace dexpert
+{
+
+namespace {
+    template <typename T>
+    void read_field(const json& data, const char *name, T *value) {
+        if (data.contains(name) && !data[name].is_null()) {
+            *value = data[name].get<T>();
+        }
+    }
+
+    // the sizes are read as signed numbers, a negative one would wrap around in a size_t
+    bool read_size(const json& data, const char *name, size_t *value) {
+        if (data.contains(name) && !data[name].is_null()) {
+            int64_t v = data[name].get<int64_t>();
+            if (v < 1) {
+                return false;
+            }
+            *value = (size_t) v;
+        }
+        return true;
+    }
+
+    bool blank_line(const std::string& text) {
+        for (char c : text) {
+            if (c != ' ' && c != '\t' && c != '\r' && c != '\n') {
+                return c == '#';  // comments are allowed in jsonl files
+            }
+        }
+        return true;
+    }
+}  // unnamed namespace
+
+bool parse_batch_job(const std::string& text, batch_job_t *job, std::string *error) {
+    *job = batch_job_t();
+    try {
+        json data = json::parse(text);
+        if (!data.is_object()) {
+            *error = "the job is not a json object";
+            return false;
+        }
+        read_field(data, "id", &job->id);
+        read_field(data, "mode", &job->mode);
+        read_field(data, "prompt", &job->prompt);
+        read_field(data, "negative", &job->negative);
+        read_field(data, "model", &job->model);
+        read_field(data, "image", &job->image);
+        read_field(data, "mask", &job->mask);
+        read_field(data, "output", &job->output);
+        read_field(data, "inpaint_mode", &job->inpaint_mode);
+        read_field(data, "scheduler", &job->scheduler);
+        read_field(data, "sweep_x", &job->sweep_x);
+        read_field(data, "sweep_y", &job->sweep_y);
+        read_field(data, "seed", &job->seed);
+        if (!read_size(data, "width", &job->width) || !read_size(data, "height", &job->height) ||
+            !read_size(data, "steps", &job->steps) || !read_size(data, "count", &job->count)) {
+            *error = "invalid width, height, steps or count";
+            return false;
+        }
+        read_field(data, "cfg", &job->cfg);
+        read_field(data, "var_stren", &job->var_stren);
+        read_field(data, "strength", &job->strength);
+        read_field(data, "mask_blur", &job->mask_blur);
+        read_field(data, "mask_padding", &job->mask_padding);
+        // the range of the inpaint settings (Config::inpaint_set_mask_padding)
+        job->mask_padding = std::clamp(job->mask_padding, 0, 256);
+        read_field(data, "restore_faces", &job->restore_faces);
+        read_field(data, "enable_codeformer", &job->enable_codeformer);
+        read_field(data, "tiled", &job->tiled);
+        if (data.contains("controlnets")) {
+            for (const auto & c : data["controlnets"]) {
+                batch_controlnet_t control;
+                read_field(c, "mode", &control.mode);
+                read_field(c, "image", &control.image);
+                read_field(c, "strength", &control.strength);
+                job->controlnets.push_back(control);
+            }
+        }
+    } catch (json::exception& e) {
+        *error = e.what();
+        return false;
+    }
+
+    if (job->mode != "txt2img" && job->mode != "img2img" && job->mode != "inpaint") {
+        *error = "invalid mode: " + job->mode;
+        return false;
+    }
+    if (job->prompt.empty()) {
+        *error = "the prompt is empty";
+        return false;
+    }
+    if (job->model.empty()) {
+        *error = "the model is not defined";
+        return false;
+    }
+    if (job->mode != "txt2img" && job->image.empty()) {
+        *error = "the image is not defined";
+        return false;
+    }
+    if (job->mode == "inpaint" && job->mask.empty()) {
+        *error = "the mask is not defined";
+        return false;
+    }
+    if (job->inpaint_mode != "original" && job->inpaint_mode != "fill" &&
+        job->inpaint_mode != "wholepicture" && job->inpaint_mode != "wholefill" &&
+        job->inpaint_mode != "onlymasked" && job->inpaint_mode != "onlymaskedfill") {
+        *error = "invalid inpaint mode: " + job->inpaint_mode;
+        return false;
+    }
+    if (!job->scheduler.empty() && !is_scheduler_name(job->scheduler)) {
+        *error = "invalid scheduler: " + job->scheduler;
+        return false;
+    }
+    if (!job->sweep_x.empty() || !job->sweep_y.empty()) {
+        if (job->mode != "txt2img") {
+            *error = "the parameter sweep is available for txt2img only";
+            return false;
+        }
+        sweep_axis_t axis;
+        if (!parse_sweep_axis(job->sweep_x, &axis, error) || !parse_sweep_axis(job->sweep_y, &axis, error)) {
+            return false;
+        }
+    }
+    for (const auto & c : job->controlnets) {
+        if (c.mode.empty() || c.image.empty()) {
+            *error = "the controlnet requires mode and image";
+            return false;
+        }
+    }
+    if (job->width < 64 || job->height < 64 || job->steps < 1 || job->count < 1) {
+        *error = "invalid width, height, steps or count";
+        return false;
+    }
+    return true;
+}
+
+BatchJobReader::BatchJobReader(const std::string& path) {
+    if (path == "-") {
+        stream_ = &std::cin;
+    } else {
+        file_.reset(new std::ifstream(std::filesystem::u8path(path)));
+        if (file_->good()) {
+            stream_ = file_.get();
+        }
+    }
+}
+
+bool BatchJobReader::good() {
+    return stream_ != NULL;
+}
+
+size_t BatchJobReader::line() {
+    return array_mode_ ? array_index_ : line_;
+}
+
+bool BatchJobReader::next(batch_job_t *job, std::string *error) {
+    error->clear();
+    if (!stream_) {
+        return false;
+    }
+    if (first_) {
+        first_ = false;
+        *stream_ >> std::ws;
+        if (stream_->peek() == '[') {
+            // a json array must be read at once
+            array_mode_ = true;
+            try {
+                json data = json::parse(std::istreambuf_iterator<char>(*stream_), std::istreambuf_iterator<char>());
+                for (const auto & item : data) {
+                    array_items_.push_back(item.dump());
+                }
+            } catch (json::exception& e) {
+                *error = e.what();
+                return false;
+            }
+        }
+    }
+    if (array_mode_) {
+        if (array_index_ >= array_items_.size()) {
+            return false;
+        }
+        parse_batch_job(array_items_[array_index_++], job, error);
+        return true;
+    }
+    std::string text;
+    while (std::getline(*stream_, text)) {
+        ++line_;
+        if (blank_line(text)) {
+            continue;
+        }
+        parse_batch_job(text, job, error);
+        return true;
+    }
+    return false;
+}
+
+}  // namespace dexpert
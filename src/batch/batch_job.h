@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2023 by Rodrigo Antonio de Araujo
+ */
+#ifndef SRC_BATCH_BATCH_JOB_H_
+#define SRC_BATCH_BATCH_JOB_H_
+
+#include <stddef.h>
+#include <fstream>
+#include <istream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace dexpert
+{
+
+typedef struct {
+    std::string mode;       // canny, pose, scribble, deepth, segmentation, lineart, mangaline
+    std::string image;      // path of the control image (already pre-processed)
+    float strength = 1.0;
+} batch_controlnet_t;
+
+typedef struct {
+    std::string id;
+    std::string mode = "txt2img";   // txt2img, img2img or inpaint
+    std::string prompt;
+    std::string negative;
+    std::string model;              // model name (as listed in the gui) or a path
+    std::string image;              // img2img and inpaint
+    std::string mask;               // inpaint
+    std::string output;             // output file, a suffix is added when count > 1
+    std::string inpaint_mode = "original";  // original, fill, wholepicture, wholefill, onlymasked, onlymaskedfill
+    std::string scheduler;          // txt2img: empty uses the scheduler of the settings
+    std::string sweep_x;            // txt2img: parameter sweep axes (see sweep.h), e.g. "cfg=5,7.5,9"
+    std::string sweep_y;
+    std::vector<batch_controlnet_t> controlnets;
+    int seed = -1;
+    size_t width = 512;
+    size_t height = 512;
+    size_t steps = 50;
+    size_t count = 1;               // images to generate (seed, seed + 1 ...)
+    float cfg = 7.5;
+    float var_stren = 0;
+    float strength = 0.8;
+    float mask_blur = 4;
+    int mask_padding = 32;          // onlymasked modes: pixels around the mask that are generated too (0 to 256)
+    bool restore_faces = false;
+    bool enable_codeformer = false;
+    bool tiled = false;             // img2img: images larger than width x height are generated in tiles
+} batch_job_t;
+
+// parses one job (a json object), returns false and fills the error when the job is invalid
+bool parse_batch_job(const std::string& text, batch_job_t *job, std::string *error);
+
+/*
+    Reads the jobs one at time, so a long (or piped) job list starts running immediately.
+    It accepts a json array or jsonl (one object per line, # starts a comment line).
+    The path "-" reads the standard input.
+*/
+class BatchJobReader {
+ public:
+    BatchJobReader(const std::string& path);
+    BatchJobReader (const BatchJobReader &) = delete;
+    BatchJobReader & operator = (const BatchJobReader &) = delete;
+
+    bool good();
+    // returns false at the end, error is filled when the current job could not be parsed
+    bool next(batch_job_t *job, std::string *error);
+    size_t line();
+
+ private:
+    std::unique_ptr<std::ifstream> file_;
+    std::istream *stream_ = NULL;
+    bool array_mode_ = false;
+    bool first_ = true;
+    size_t line_ = 0;
+    std::vector<std::string> array_items_;
+    size_t array_index_ = 0;
+};
+
+}  // namespace dexpert
+
+#endif  // SRC_BATCH_BATCH_JOB_H_
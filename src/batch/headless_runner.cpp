@@ -0,0 +1,371 @@
+#include <stdio.h>
+#include <thread>
+#include <chrono>
+#include <filesystem>
+
+#include "src/python/helpers.h"
+#include "src/python/wrapper.h"
+#include "src/windows/progress_window.h"
+#include "src/stable_diffusion/state.h"
+#include "src/stable_diffusion/generator_txt2img.h"
+#include "src/stable_diffusion/generator_img2img.h"
+#include "src/stable_diffusion/sweep.h"
+#include "src/batch/http_server.h"
+#include "src/batch/job_paths.h"
+#include "src/batch/job_queue.h"
+#include "src/batch/job_server.h"
+#include "src/batch/headless_runner.h"
+
+namespace dexpert
+{
+
+namespace {
+    inpaint_mode_t inpaint_mode_from_name(const std::string& name) {
+        if (name == "fill") {
+            return inpaint_fill;
+        } else if (name == "wholepicture") {
+            return inpaint_wholepicture;
+        } else if (name == "wholefill") {
+            return inpaint_wholefill;
+        } else if (name == "onlymasked") {
+            return inpaint_onlymasked;
+        } else if (name == "onlymaskedfill") {
+            return inpaint_onlymaskedfill;
+        }
+        return inpaint_original;
+    }
+
+    // a model name (as listed in the gui) or a path, empty when the model is not found
+    std::string resolve_model(std::shared_ptr<StableDiffusionState> state, const std::string& model) {
+        std::error_code ec;
+        std::string path = model;
+        if (!std::filesystem::is_regular_file(std::filesystem::u8path(path), ec)) {
+            path = state->getSdModelPath(model);
+            if (path.empty()) {
+                return path;
+            }
+        }
+        // the same file written in another way (relative, ./ or ..) is the same model
+        auto canonical = std::filesystem::weakly_canonical(std::filesystem::u8path(path), ec);
+        return ec ? path : canonical.u8string();
+    }
+
+    bool python_step(const char *what, std::function<py::callback_t(py::status_callback_t)> make_callback) {
+        bool success = false;
+        std::string message;
+        py::get_py()->execute_callback(make_callback([&success, &message] (bool status, const char *error) {
+            success = status;
+            if (error) {
+                message = error;
+            }
+        }));
+        if (!success) {
+            fprintf(stderr, "%s: %s\n", what, message.empty() ? "unexpected error" : message.c_str());
+        }
+        return success;
+    }
+
+    bool init_python() {
+        set_progress_headless(true);
+
+        bool have_deps = false;
+        std::string message;
+        py::get_py()->execute_callback(py::check_have_deps([&have_deps, &message] (bool status, const char *error) {
+            have_deps = status;
+            if (error) {
+                message = error;
+            }
+        }));
+        if (!have_deps) {
+            fprintf(stderr, "[headless] python dependencies are missing, run the application with the gui once to install them. %s\n", message.c_str());
+            return false;
+        }
+
+        py::get_py()->setDepsOk();
+        while (!py::py_ready()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(30));
+        }
+
+        return python_step("configuring stable diffusion", py::configure_stable_diffusion);
+    }
+}  // unnamed namespace
+
+HeadlessRunner::HeadlessRunner(const std::string& output_dir) : output_dir_(output_dir) {
+    if (output_dir_.empty()) {
+        output_dir_ = ".";
+    }
+}
+
+const headless_summary_t& HeadlessRunner::summary() const {
+    return summary_;
+}
+
+std::string HeadlessRunner::outputPath(const batch_job_t& job, const std::string& suffix) {
+    std::filesystem::path path;
+    if (job.output.empty()) {
+        std::string name = job.id.empty() ? std::to_string(job_number_) : job.id;
+        path = std::filesystem::u8path(name + "-" + suffix + ".png");
+    } else {
+        path = std::filesystem::u8path(job.output);
+        if (!suffix.empty()) {
+            auto stem = path.stem().u8string() + "-" + suffix;
+            path.replace_filename(std::filesystem::u8path(stem + path.extension().u8string()));
+        }
+    }
+    std::string resolved;
+    if (!resolve_inside(output_dir_, path.u8string(), &resolved)) {
+        return std::string();
+    }
+    std::error_code ec;
+    std::filesystem::create_directories(std::filesystem::u8path(resolved).parent_path(), ec);
+    return resolved;
+}
+
+bool HeadlessRunner::runJob(const batch_job_t& job, std::vector<std::string> *outputs, std::string *error) {
+    auto state = get_sd_state();
+    ++job_number_;
+
+    std::string model = resolve_model(state, job.model);
+    if (model.empty()) {
+        *error = "model not found: " + job.model;
+        return false;
+    }
+
+    image_ptr_t image;
+    image_ptr_t mask;
+    if (job.mode != "txt2img") {
+        image = state->openImage(job.image.c_str());
+        if (!image) {
+            *error = "could not open the image " + job.image + ": " + state->lastError();
+            return false;
+        }
+    }
+    if (job.mode == "inpaint") {
+        mask = state->openImage(job.mask.c_str());
+        if (!mask) {
+            *error = "could not open the mask " + job.mask + ": " + state->lastError();
+            return false;
+        }
+        mask = mask->removeAlpha();
+    }
+
+    controlnet_list_t controlnets;
+    for (const auto & c : job.controlnets) {
+        auto control_image = state->openImage(c.image.c_str());
+        if (!control_image) {
+            *error = "could not open the controlnet image " + c.image + ": " + state->lastError();
+            return false;
+        }
+        controlnets.push_back(std::make_shared<ControlNet>(c.mode.c_str(), control_image, c.strength));
+    }
+
+    if (!job.sweep_x.empty() || !job.sweep_y.empty()) {
+        return runSweep(job, model, controlnets, outputs, error);
+    }
+
+    int seed = job.seed < 0 ? state->randomSeed() : job.seed;
+    auto seed_gen = std::make_shared<SeedGenerator>();
+    for (size_t i = 0; i < job.count; ++i) {
+        std::shared_ptr<GeneratorBase> g;
+        if (image) {
+            g.reset(new GeneratorImg2Image(
+                seed_gen, false, job.prompt, job.negative, model, controlnets, image, mask, seed + (int) i,
+                job.width, job.height, job.steps, job.cfg, job.var_stren, job.strength,
+                job.restore_faces, job.enable_codeformer, false, mask ? job.mask_blur : 0,
+                inpaint_mode_from_name(job.inpaint_mode), job.mask_padding, job.tiled
+            ));
+        } else {
+            g.reset(new GeneratorTxt2Image(
+                seed_gen, false, job.prompt, job.negative, model, controlnets, seed + (int) i,
+                job.width, job.height, job.steps, job.cfg, job.var_stren,
+                job.restore_faces, job.enable_codeformer, false, job.scheduler
+            ));
+        }
+
+        // keeps only the current generator (its image is released after saving it)
+        state->clearGenerators();
+        if (!state->generatorAdd(g) || !g->getImage()) {
+            *error = state->lastError();
+            return false;
+        }
+        std::string path = outputPath(job, job.output.empty() || job.count > 1 ? std::to_string(i) : std::string());
+        if (path.empty()) {
+            *error = "the output must be inside the output directory " + output_dir_;
+            return false;
+        }
+        if (!state->saveImage(path.c_str(), g->getImage())) {
+            *error = "could not save " + path + ": " + state->lastError();
+            return false;
+        }
+        g->clearImage();
+        outputs->push_back(path);
+        summary_.images += 1;
+        printf("[headless] saved %s (seed %d)\n", path.c_str(), seed + (int) i);
+        fflush(stdout);
+    }
+    state->clearGenerators();
+    return true;
+}
+
+bool HeadlessRunner::runSweep(const batch_job_t& job, const std::string& model, const controlnet_list_t& controlnets, std::vector<std::string> *outputs, std::string *error) {
+    auto state = get_sd_state();
+    sweep_axis_t x_axis;
+    sweep_axis_t y_axis;
+    // the job parser validated the axes
+    parse_sweep_axis(job.sweep_x, &x_axis, error);
+    parse_sweep_axis(job.sweep_y, &y_axis, error);
+
+    sweep_base_t base;
+    base.prompt = job.prompt;
+    base.negative = job.negative;
+    base.model = model;
+    base.scheduler = job.scheduler;
+    base.controlnets = controlnets;
+    base.seed = job.seed;
+    base.width = job.width;
+    base.height = job.height;
+    base.steps = job.steps;
+    base.cfg = job.cfg;
+    base.restore_faces = job.restore_faces;
+    base.enable_codeformer = job.enable_codeformer;
+
+    ParameterSweep sweep(base, x_axis, y_axis);
+    const std::string sheet_path = outputPath(job, "sheet");
+    if (sheet_path.empty()) {
+        *error = "the output must be inside the output directory " + output_dir_;
+        return false;
+    }
+    bool saved = true;
+    bool success = sweep.run([&] (const sweep_cell_t& cell, image_ptr_t image, RawImage *sheet) {
+        // the grid keeps the images, the generators are not needed
+        state->clearGenerators();
+        if (!image) {
+            return false;
+        }
+        std::string path = outputPath(job, "x" + std::to_string(cell.x) + "y" + std::to_string(cell.y));
+        if (path.empty()) {
+            *error = "the output must be inside the output directory " + output_dir_;
+            saved = false;
+            return false;
+        }
+        for (const auto & item : {std::make_pair(path, image.get()), std::make_pair(sheet_path, sheet)}) {
+            if (!state->saveImage(item.first.c_str(), item.second)) {
+                *error = "could not save " + item.first + ": " + state->lastError();
+                saved = false;
+                return false;
+            }
+        }
+        outputs->push_back(path);
+        summary_.images += 1;
+        printf("[headless] saved %s (cell %zu x %zu)\n", path.c_str(), cell.x, cell.y);
+        fflush(stdout);
+        return true;
+    });
+    if (!success) {
+        if (saved) {
+            *error = sweep.lastError();
+        }
+        return false;
+    }
+    outputs->push_back(sheet_path);
+    printf("[headless] saved %s (%zu x %zu sweep)\n", sheet_path.c_str(), sweep.columns(), sweep.rows());
+    fflush(stdout);
+    return true;
+}
+
+headless_summary_t HeadlessRunner::runJobs(BatchJobReader *reader) {
+    batch_job_t job;
+    std::string error;
+    while (reader->next(&job, &error)) {
+        summary_.jobs += 1;
+        if (error.empty()) {
+            std::vector<std::string> outputs;
+            runJob(job, &outputs, &error);
+        }
+        if (!error.empty()) {
+            summary_.failed_jobs += 1;
+            fprintf(stderr, "[headless] job %zu (%s) failed: %s\n", reader->line(), job.id.c_str(), error.c_str());
+            fflush(stderr);
+        }
+    }
+    if (!error.empty()) {
+        // the reader could not parse the job file
+        summary_.failed_jobs += 1;
+        fprintf(stderr, "[headless] invalid job file: %s\n", error.c_str());
+    }
+    return summary_;
+}
+
+int run_headless(const std::string& jobs_path, const std::string& output_dir) {
+    BatchJobReader reader(jobs_path);
+    if (!reader.good()) {
+        fprintf(stderr, "[headless] could not open the job file %s\n", jobs_path.c_str());
+        py::py_end();
+        return 1;
+    }
+
+    if (!init_python()) {
+        py::py_end();
+        return 2;
+    }
+
+    HeadlessRunner runner(output_dir);
+    auto summary = runner.runJobs(&reader);
+    printf("[headless] %zu jobs, %zu failed, %zu images generated\n", summary.jobs, summary.failed_jobs, summary.images);
+    fflush(stdout);
+
+    py::py_end();
+    return summary.failed_jobs > 0 ? 3 : 0;
+}
+
+int run_job_server(int port, const std::string& output_dir) {
+    if (!init_python()) {
+        py::py_end();
+        return 2;
+    }
+
+    // the http thread resolves the models of the submitted jobs
+    auto state = get_sd_state();
+    JobQueue queue(scheduler_config_t(), [state] (const std::string& model) {
+        return resolve_model(state, model);
+    });
+    JobServer job_server(&queue, output_dir);
+    HttpServer http(port, [&job_server] (const http_request_t& request) {
+        return job_server.handle(request);
+    });
+    if (!http.start()) {
+        fprintf(stderr, "[server] %s\n", http.lastError());
+        py::py_end();
+        return 1;
+    }
+    printf("[server] listening at http://127.0.0.1:%d\n", port);
+    fflush(stdout);
+
+    HeadlessRunner runner(output_dir);
+    queued_job_t item;
+    while (!job_server.shutdownRequested()) {
+        if (!queue.next(&item, 500)) {
+            continue;
+        }
+        std::vector<std::string> outputs;
+        std::string error;
+        bool success = runner.runJob(item.job, &outputs, &error);
+        if (!success) {
+            fprintf(stderr, "[server] job %zu failed: %s\n", item.id, error.c_str());
+            fflush(stderr);
+        }
+        job_server.releaseInputs(item.job);
+        queue.finish(item.id, success, error, outputs);
+    }
+
+    queue.stop();
+    http.stop();
+    auto stats = queue.schedulerStats();
+    printf("[server] %zu jobs, %zu model loads, %zu pipeline rebuilds\n", stats.picked, stats.weight_reloads, stats.pipeline_rebuilds);
+    fflush(stdout);
+    get_sd_state()->printModelCache();
+    py::py_end();
+    return 0;
+}
+
+}  // namespace dexpert
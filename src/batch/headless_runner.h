@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2023 by Rodrigo Antonio de Araujo
+ */
+#ifndef SRC_BATCH_HEADLESS_RUNNER_H_
+#define SRC_BATCH_HEADLESS_RUNNER_H_
+
+#include <string>
+#include <vector>
+
+#include "src/batch/batch_job.h"
+#include "src/stable_diffusion/generator_txt2img.h"
+
+namespace dexpert
+{
+
+typedef struct {
+    size_t jobs = 0;
+    size_t failed_jobs = 0;
+    size_t images = 0;
+} headless_summary_t;
+
+/*
+    Runs the generation jobs without the gui (diffusion-exp --headless jobs.jsonl [--output dir]).
+    It uses the same generators and save path as the gui. The model stays loaded between the jobs,
+    python only reloads it when a job asks for a different model.
+*/
+class HeadlessRunner {
+ public:
+    HeadlessRunner(const std::string& output_dir);
+    HeadlessRunner (const HeadlessRunner &) = delete;
+    HeadlessRunner & operator = (const HeadlessRunner &) = delete;
+
+    // python must be configured before (see run_headless)
+    bool runJob(const batch_job_t& job, std::vector<std::string> *outputs, std::string *error);
+    headless_summary_t runJobs(BatchJobReader *reader);
+    const headless_summary_t& summary() const;
+
+ private:
+    // the suffix is added to the file name (name-suffix.png), it's required when the job has no output.
+    // returns an empty string when the path is not inside the output directory
+    std::string outputPath(const batch_job_t& job, const std::string& suffix);
+    // saves the cells of the sweep and rewrites the contact sheet after each one
+    bool runSweep(const batch_job_t& job, const std::string& model, const controlnet_list_t& controlnets, std::vector<std::string> *outputs, std::string *error);
+
+ private:
+    std::string output_dir_;
+    size_t job_number_ = 0;
+    headless_summary_t summary_;
+};
+
+// initializes python and runs the job file, the result is the process exit code
+int run_headless(const std::string& jobs_path, const std::string& output_dir);
+// initializes python and runs the jobs received by the local http server (see job_server.h) until /shutdown
+int run_job_server(int port, const std::string& output_dir);
+
+}  // namespace dexpert
+
+#endif  // SRC_BATCH_HEADLESS_RUNNER_H_
@@ -0,0 +1,296 @@
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#define CLOSE_SOCKET closesocket
+#define SEND_FLAGS 0
+typedef int socklen_t;
+#else
+#include <unistd.h>
+#include <poll.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#define CLOSE_SOCKET close
+#define SEND_FLAGS MSG_NOSIGNAL  // a client that disconnects must not kill the process with SIGPIPE
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+#include "src/batch/http_server.h"
+
+namespace dexpert
+{
+
+namespace {
+    const size_t kMAX_HEADER_SIZE = 64 * 1024;
+    const size_t kMAX_BODY_SIZE = 256 * 1024 * 1024;  // base64 images can be big
+    const int kACCEPT_TIMEOUT_MS = 250;
+    const int kCLIENT_TIMEOUT_MS = 5000;  // an idle client can't hold the accept thread longer than it
+
+    bool send_all(intptr_t client, const char *data, size_t size) {
+        while (size > 0) {
+            int sent = send((int) client, data, (int) std::min<size_t>(size, 1024 * 1024), SEND_FLAGS);
+            if (sent <= 0) {
+                return false;
+            }
+            data += sent;
+            size -= sent;
+        }
+        return true;
+    }
+
+    void set_client_timeouts(int client) {
+#ifdef _WIN32
+        DWORD timeout = kCLIENT_TIMEOUT_MS;
+#else
+        timeval timeout = {kCLIENT_TIMEOUT_MS / 1000, (kCLIENT_TIMEOUT_MS % 1000) * 1000};
+#endif
+        setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, (const char *) &timeout, sizeof(timeout));
+        setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, (const char *) &timeout, sizeof(timeout));
+    }
+
+    std::string lower(std::string text) {
+        std::transform(text.begin(), text.end(), text.begin(), [] (unsigned char c) { return (char) tolower(c); });
+        return text;
+    }
+
+    std::string trim(const std::string& text) {
+        size_t b = text.find_first_not_of(" \t\r");
+        if (b == std::string::npos) {
+            return std::string();
+        }
+        size_t e = text.find_last_not_of(" \t\r");
+        return text.substr(b, e - b + 1);
+    }
+
+    // localhost, 127.0.0.1 or [::1] with an optional port
+    bool is_local_host(std::string host) {
+        host = lower(host);
+        if (host.compare(0, 5, "[::1]") == 0) {
+            host = host.substr(5);
+        } else {
+            size_t colon = host.find(':');
+            std::string name = host.substr(0, colon);
+            if (name != "localhost" && name != "127.0.0.1") {
+                return false;
+            }
+            host = colon == std::string::npos ? std::string() : host.substr(colon);
+        }
+        if (host.empty()) {
+            return true;
+        }
+        return host.size() > 1 && host[0] == ':' && host.find_first_not_of("0123456789", 1) == std::string::npos;
+    }
+}  // unnamed namespace
+
+const char *http_status_text(int status) {
+    switch (status) {
+        case 200: return "OK";
+        case 201: return "Created";
+        case 202: return "Accepted";
+        case 400: return "Bad Request";
+        case 403: return "Forbidden";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 413: return "Payload Too Large";
+        case 415: return "Unsupported Media Type";
+        default: return "Internal Server Error";
+    }
+}
+
+bool parse_http_head(const std::string& head, http_request_t *request) {
+    size_t line_end = head.find("\r\n");
+    std::string line = head.substr(0, line_end);
+    size_t s1 = line.find(' ');
+    size_t s2 = line.find(' ', s1 + 1);
+    if (s1 == std::string::npos || s2 == std::string::npos) {
+        return false;
+    }
+    request->method = line.substr(0, s1);
+    std::string target = line.substr(s1 + 1, s2 - s1 - 1);
+    size_t q = target.find('?');
+    request->path = target.substr(0, q);
+    if (q != std::string::npos) {
+        request->query = target.substr(q + 1);
+    }
+    size_t pos = line_end == std::string::npos ? head.size() : line_end + 2;
+    while (pos < head.size()) {
+        size_t end = head.find("\r\n", pos);
+        if (end == std::string::npos) {
+            end = head.size();
+        }
+        std::string header = head.substr(pos, end - pos);
+        size_t colon = header.find(':');
+        if (colon != std::string::npos) {
+            request->headers[lower(trim(header.substr(0, colon)))] = trim(header.substr(colon + 1));
+        }
+        pos = end + 2;
+    }
+    return true;
+}
+
+bool is_local_request(const http_request_t& request) {
+    auto host = request.headers.find("host");
+    if (host == request.headers.end() || !is_local_host(host->second)) {
+        return false;  // a dns name that points to 127.0.0.1 is not enough (dns rebinding)
+    }
+    auto origin = request.headers.find("origin");
+    if (origin == request.headers.end()) {
+        return true;  // curl and the scripts do not send it
+    }
+    const std::string scheme = "http://";
+    return lower(origin->second).compare(0, scheme.size(), scheme) == 0 &&
+        is_local_host(origin->second.substr(scheme.size()));
+}
+
+HttpServer::HttpServer(int port, http_handler_t handler) : port_(port), handler_(handler), terminated_(false) {
+#ifdef _WIN32
+    WSADATA wsa_data;
+    WSAStartup(MAKEWORD(2, 2), &wsa_data);
+#endif
+}
+
+HttpServer::~HttpServer() {
+    stop();
+#ifdef _WIN32
+    WSACleanup();
+#endif
+}
+
+const char *HttpServer::lastError() {
+    return last_error_.c_str();
+}
+
+bool HttpServer::start() {
+    int s = (int) socket(AF_INET, SOCK_STREAM, 0);
+    if (s < 0) {
+        last_error_ = "could not create the socket";
+        return false;
+    }
+    int reuse = 1;
+    setsockopt(s, SOL_SOCKET, SO_REUSEADDR, (const char *) &reuse, sizeof(reuse));
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons((unsigned short) port_);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);  // never exposed to the network
+    if (bind(s, (sockaddr *) &address, sizeof(address)) != 0 || listen(s, 16) != 0) {
+        last_error_ = "could not listen at 127.0.0.1:" + std::to_string(port_);
+        CLOSE_SOCKET(s);
+        return false;
+    }
+    socket_ = s;
+    terminated_ = false;
+    thread_.reset(new std::thread([this] {
+        run();
+    }));
+    return true;
+}
+
+void HttpServer::stop() {
+    terminated_ = true;
+    if (thread_) {
+        thread_->join();
+        thread_.reset();
+    }
+    if (socket_ >= 0) {
+        CLOSE_SOCKET((int) socket_);
+        socket_ = -1;
+    }
+}
+
+void HttpServer::run() {
+    while (!terminated_) {
+        // wait with a timeout so stop() does not depend on a new connection
+#ifdef _WIN32
+        fd_set read_set;
+        FD_ZERO(&read_set);
+        FD_SET((SOCKET) socket_, &read_set);
+        timeval timeout = {0, kACCEPT_TIMEOUT_MS * 1000};
+        if (select(0, &read_set, NULL, NULL, &timeout) <= 0) {
+            continue;
+        }
+#else
+        pollfd pfd = {(int) socket_, POLLIN, 0};
+        if (poll(&pfd, 1, kACCEPT_TIMEOUT_MS) <= 0) {
+            continue;
+        }
+#endif
+        sockaddr_in client_address;
+        socklen_t address_size = sizeof(client_address);
+        int client = (int) accept((int) socket_, (sockaddr *) &client_address, &address_size);
+        if (client < 0) {
+            continue;
+        }
+        set_client_timeouts(client);
+        handleConnection(client);
+        CLOSE_SOCKET(client);
+    }
+}
+
+void HttpServer::handleConnection(intptr_t client) {
+    std::string data;
+    char buffer[64 * 1024];
+    size_t head_end = std::string::npos;
+    http_response_t response;
+    http_request_t request;
+
+    while (head_end == std::string::npos) {
+        int received = recv((int) client, buffer, sizeof(buffer), 0);
+        if (received <= 0) {
+            return;
+        }
+        data.append(buffer, received);
+        head_end = data.find("\r\n\r\n");
+        if (head_end == std::string::npos && data.size() > kMAX_HEADER_SIZE) {
+            return;
+        }
+    }
+
+    if (!parse_http_head(data.substr(0, head_end), &request)) {
+        response.status = 400;
+        response.body = "{\"error\": \"invalid request\"}";
+    } else if (!is_local_request(request)) {
+        response.status = 403;
+        response.body = "{\"error\": \"only local requests are accepted\"}";
+    } else {
+        size_t content_length = 0;
+        auto it = request.headers.find("content-length");
+        if (it != request.headers.end()) {
+            content_length = strtoull(it->second.c_str(), NULL, 10);
+        }
+        if (content_length > kMAX_BODY_SIZE) {
+            response.status = 413;
+            response.body = "{\"error\": \"the request is too big\"}";
+        } else {
+            request.body = data.substr(head_end + 4);
+            while (request.body.size() < content_length) {
+                int received = recv((int) client, buffer, sizeof(buffer), 0);
+                if (received <= 0) {
+                    return;
+                }
+                request.body.append(buffer, received);
+            }
+            request.body.resize(content_length);
+            try {
+                response = handler_(request);
+            } catch (std::exception& e) {
+                response.status = 500;
+                response.body = std::string("{\"error\": \"unexpected error\"}");
+                fprintf(stderr, "[http] %s %s: %s\n", request.method.c_str(), request.path.c_str(), e.what());
+            }
+        }
+    }
+
+    std::string head = "HTTP/1.1 " + std::to_string(response.status) + " " + http_status_text(response.status) + "\r\n";
+    head += "Content-Type: " + response.content_type + "\r\n";
+    head += "Content-Length: " + std::to_string(response.body.size()) + "\r\n";
+    head += "Connection: close\r\n\r\n";
+    if (send_all(client, head.c_str(), head.size())) {
+        send_all(client, response.body.c_str(), response.body.size());
+    }
+}
+
+}  // namespace dexpert
@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2023 by Rodrigo Antonio de Araujo
+ */
+#ifndef SRC_BATCH_HTTP_SERVER_H_
+#define SRC_BATCH_HTTP_SERVER_H_
+
+#include <stdint.h>
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+
+namespace dexpert
+{
+
+typedef struct {
+    std::string method;
+    std::string path;       // without the query string
+    std::string query;
+    std::map<std::string, std::string> headers;    // lower case names
+    std::string body;
+} http_request_t;
+
+typedef struct {
+    int status = 200;
+    std::string content_type = "application/json";
+    std::string body;
+} http_response_t;
+
+typedef std::function<http_response_t(const http_request_t& request)> http_handler_t;
+
+/*
+    Minimal HTTP/1.1 server bound to the loopback interface.
+    One request per connection (Connection: close), the requests are handled by the accept thread
+    so the handler should not block (the jobs run in other thread). The client sockets have
+    send and receive timeouts, a slow client delays the others and stop() for a few seconds at most.
+    Requests whose Host or Origin is not the local machine are rejected (403): a web page the
+    user visits can send requests to the loopback interface, but the browser sets those headers.
+*/
+class HttpServer {
+ public:
+    HttpServer(int port, http_handler_t handler);
+    HttpServer (const HttpServer &) = delete;
+    HttpServer & operator = (const HttpServer &) = delete;
+    virtual ~HttpServer();
+
+    bool start();
+    void stop();
+    const char *lastError();
+
+ private:
+    void run();
+    void handleConnection(intptr_t client);
+
+ private:
+    int port_;
+    intptr_t socket_ = -1;
+    http_handler_t handler_;
+    std::atomic<bool> terminated_;
+    std::unique_ptr<std::thread> thread_;
+    std::string last_error_;
+};
+
+const char *http_status_text(int status);
+// parses the request line and the headers (the head without the blank line that ends it)
+bool parse_http_head(const std::string& head, http_request_t *request);
+// true when the Host header (required) and the Origin header (when present) name the local machine
+bool is_local_request(const http_request_t& request);
+
+}  // namespace dexpert
+
+#endif  // SRC_BATCH_HTTP_SERVER_H_
@@ -0,0 +1,72 @@
+#include <ctype.h>
+#include <algorithm>
+#include <filesystem>
+
+#include "src/batch/job_paths.h"
+
+namespace dexpert
+{
+
+namespace {
+    std::filesystem::path resolve(const std::filesystem::path& path, std::error_code& ec) {
+        auto result = std::filesystem::weakly_canonical(std::filesystem::absolute(path, ec), ec);
+        if (!result.has_filename()) {
+            result = result.parent_path();  // a trailing separator adds an empty element
+        }
+        return result;
+    }
+}  // unnamed namespace
+
+bool resolve_inside(const std::string& dir, const std::string& path, std::string *resolved) {
+    if (path.empty()) {
+        return false;
+    }
+    std::error_code ec;
+    auto base = resolve(std::filesystem::u8path(dir.empty() ? "." : dir), ec);
+    if (ec) {
+        return false;
+    }
+    auto target = std::filesystem::u8path(path);
+    if (target.is_relative()) {
+        target = base / target;
+    }
+    target = resolve(target, ec);
+    if (ec) {
+        return false;
+    }
+    // compares the elements, a string prefix would accept /output-other for /output
+    auto t = target.begin();
+    for (auto b = base.begin(); b != base.end(); ++b, ++t) {
+        if (t == target.end() || *t != *b) {
+            return false;
+        }
+    }
+    if (t == target.end()) {
+        return false;  // the directory itself is not a file
+    }
+    *resolved = target.u8string();
+    return true;
+}
+
+const char *image_content_type(const std::string& path) {
+    std::string extension = std::filesystem::u8path(path).extension().u8string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), [] (unsigned char c) { return (char) tolower(c); });
+    if (extension == ".png") {
+        return "image/png";
+    }
+    if (extension == ".jpg" || extension == ".jpeg") {
+        return "image/jpeg";
+    }
+    if (extension == ".bmp") {
+        return "image/bmp";
+    }
+    if (extension == ".gif") {
+        return "image/gif";
+    }
+    if (extension == ".webp") {
+        return "image/webp";
+    }
+    return "application/octet-stream";
+}
+
+}  // namespace dexpert
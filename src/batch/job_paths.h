@@ -0,0 +1,24 @@
+/*
+ * Copyright (C) 2023 by Rodrigo Antonio de Araujo
+ */
+#ifndef SRC_BATCH_JOB_PATHS_H_
+#define SRC_BATCH_JOB_PATHS_H_
+
+#include <string>
+
+namespace dexpert
+{
+
+/*
+    Resolves a path of a job against a directory (relative paths are relative to the directory),
+    following .. and the symbolic links that exist. Returns false when the result is not inside
+    the directory, so a job can not write (or the server read) a file anywhere on the disk.
+*/
+bool resolve_inside(const std::string& dir, const std::string& path, std::string *resolved);
+
+// the content type of an image file by its extension (application/octet-stream when unknown)
+const char *image_content_type(const std::string& path);
+
+}  // namespace dexpert
+
+#endif  // SRC_BATCH_JOB_PATHS_H_
@@ -0,0 +1,120 @@
+#include <chrono>
+
+#include "src/batch/job_queue.h"
+
+namespace dexpert
+{
+
+namespace {
+    const size_t kMAX_FINISHED_JOBS = 1000;
+}  // unnamed namespace
+
+const char *job_state_name(job_state_t state) {
+    switch (state) {
+        case job_queued:
+            return "queued";
+        case job_running:
+            return "running";
+        case job_done:
+            return "done";
+        default:
+            return "failed";
+    }
+}
+
+JobQueue::JobQueue(const scheduler_config_t& config, model_resolver_t resolve_model) :
+    scheduler_(config), resolve_model_(resolve_model) {
+}
+
+size_t JobQueue::submit(const batch_job_t& job) {
+    // resolving the model may touch the disk, it's done out of the lock
+    auto affinity = job_affinity(job, resolve_model_);
+    std::unique_lock<std::mutex> lk(mtx_);
+    queued_job_t item;
+    item.id = ++last_id_;
+    item.job = job;
+    item.affinity = affinity;
+    item.submitted = std::chrono::steady_clock::now();
+    pending_.push_back(item);
+    cond_.notify_one();
+    return item.id;
+}
+
+bool JobQueue::next(queued_job_t *job, int timeout_ms) {
+    std::unique_lock<std::mutex> lk(mtx_);
+    if (!cond_.wait_for(lk, std::chrono::milliseconds(timeout_ms), [this] { return stopped_ || !pending_.empty(); })) {
+        return false;
+    }
+    if (stopped_) {
+        return false;
+    }
+    std::vector<scheduled_job_t> candidates;
+    candidates.reserve(pending_.size());
+    for (const auto & j : pending_) {
+        candidates.push_back({j.affinity, j.submitted});
+    }
+    size_t index = scheduler_.pick(candidates, std::chrono::steady_clock::now());
+    queued_job_t item = pending_[index];
+    pending_.erase(pending_.begin() + index);
+    item.state = job_running;
+    jobs_.push_back(item);
+    *job = item;
+    return true;
+}
+
+void JobQueue::finish(size_t id, bool success, const std::string& error, const std::vector<std::string>& outputs) {
+    std::unique_lock<std::mutex> lk(mtx_);
+    for (auto & j : jobs_) {
+        if (j.id == id) {
+            j.state = success ? job_done : job_failed;
+            j.error = error;
+            j.outputs = outputs;
+            break;
+        }
+    }
+    while (jobs_.size() > kMAX_FINISHED_JOBS && jobs_.front().state != job_running) {
+        jobs_.pop_front();
+    }
+}
+
+bool JobQueue::status(size_t id, queued_job_t *job) {
+    std::unique_lock<std::mutex> lk(mtx_);
+    for (const auto & j : jobs_) {
+        if (j.id == id) {
+            *job = j;
+            return true;
+        }
+    }
+    for (const auto & j : pending_) {
+        if (j.id == id) {
+            *job = j;
+            return true;
+        }
+    }
+    return false;
+}
+
+std::vector<queued_job_t> JobQueue::list() {
+    std::unique_lock<std::mutex> lk(mtx_);
+    std::vector<queued_job_t> result(jobs_.begin(), jobs_.end());
+    result.insert(result.end(), pending_.begin(), pending_.end());
+    return result;
+}
+
+size_t JobQueue::pending() {
+    std::unique_lock<std::mutex> lk(mtx_);
+    return pending_.size();
+}
+
+scheduler_stats_t JobQueue::schedulerStats() {
+    std::unique_lock<std::mutex> lk(mtx_);
+    return scheduler_.stats();
+}
+
+void JobQueue::stop() {
+    std::unique_lock<std::mutex> lk(mtx_);
+    stopped_ = true;
+    cond_.notify_all();
+}
+
+}  // namespace dexpert
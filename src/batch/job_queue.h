@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2023 by Rodrigo Antonio de Araujo
+ */
+#ifndef SRC_BATCH_JOB_QUEUE_H_
+#define SRC_BATCH_JOB_QUEUE_H_
+
+#include <stddef.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "src/batch/batch_job.h"
+#include "src/batch/job_scheduler.h"
+
+namespace dexpert
+{
+
+typedef enum {
+    job_queued,
+    job_running,
+    job_done,
+    job_failed
+} job_state_t;
+
+typedef struct {
+    size_t id = 0;
+    batch_job_t job;
+    job_state_t state = job_queued;
+    std::string error;
+    std::vector<std::string> outputs;
+    job_affinity_t affinity;
+    job_time_t submitted;
+} queued_job_t;
+
+const char *job_state_name(job_state_t state);
+
+/*
+    Jobs submitted by the http server and executed by the headless worker.
+    The scheduler chooses the next job, grouping the jobs that use the same pipeline (see job_scheduler.h).
+*/
+class JobQueue {
+ public:
+    explicit JobQueue(const scheduler_config_t& config = scheduler_config_t(),
+        model_resolver_t resolve_model = model_resolver_t());
+    JobQueue (const JobQueue &) = delete;
+    JobQueue & operator = (const JobQueue &) = delete;
+
+    size_t submit(const batch_job_t& job);
+    // blocks until there is a job (returns false on timeout or after stop), the job is marked as running
+    bool next(queued_job_t *job, int timeout_ms);
+    void finish(size_t id, bool success, const std::string& error, const std::vector<std::string>& outputs);
+    bool status(size_t id, queued_job_t *job);
+    std::vector<queued_job_t> list();
+    size_t pending();
+    scheduler_stats_t schedulerStats();
+    void stop();
+
+ private:
+    std::mutex mtx_;
+    std::condition_variable cond_;
+    bool stopped_ = false;
+    size_t last_id_ = 0;
+    JobScheduler scheduler_;
+    model_resolver_t resolve_model_;
+    std::deque<queued_job_t> pending_;
+    std::deque<queued_job_t> jobs_;     // running and finished jobs (the latest ones)
+};
+
+}  // namespace dexpert
+
+#endif  // SRC_BATCH_JOB_QUEUE_H_
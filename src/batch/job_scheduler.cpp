@@ -0,0 +1,133 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <map>
+#include <regex>
+
+#include "src/batch/job_scheduler.h"
+
+namespace dexpert
+{
+
+namespace {
+    // <lora:name:1.0> and <lora:name:1> load the same weights (python parses the weight as float)
+    std::string lora_key(const std::string& name, const std::string& weight) {
+        char buffer[32] = "";
+        snprintf(buffer, sizeof(buffer), "%g", strtof(weight.c_str(), NULL));
+        return name + ":" + buffer;
+    }
+
+    std::string pipeline_mode(const batch_job_t& job) {
+        // the names create_pipeline receives
+        if (job.mode == "inpaint") {
+            return "inpaint2img";
+        }
+        return job.mode;
+    }
+}  // unnamed namespace
+
+job_affinity_t job_affinity(const batch_job_t& job, const model_resolver_t& resolve_model) {
+    // same expression parse_prompt_loras uses at python side
+    static const std::regex lora_re("<lora:([^:]+):([^>]+)>");
+    std::vector<std::string> loras;
+    for (auto it = std::sregex_iterator(job.prompt.begin(), job.prompt.end(), lora_re); it != std::sregex_iterator(); ++it) {
+        loras.push_back(lora_key((*it)[1].str(), (*it)[2].str()));
+    }
+    std::sort(loras.begin(), loras.end());
+
+    std::vector<std::string> controlnets;
+    for (const auto & c : job.controlnets) {
+        controlnets.push_back(c.mode);
+    }
+    std::sort(controlnets.begin(), controlnets.end());
+
+    job_affinity_t affinity;
+    if (resolve_model) {
+        affinity.weights = resolve_model(job.model);
+    }
+    if (affinity.weights.empty()) {
+        affinity.weights = job.model;  // the job is going to fail, any key works
+    }
+    for (const auto & l : loras) {
+        affinity.weights += "|" + l;
+    }
+    affinity.pipeline = affinity.weights + "|" + pipeline_mode(job);
+    for (const auto & c : controlnets) {
+        affinity.pipeline += "|" + c;
+    }
+    return affinity;
+}
+
+JobScheduler::JobScheduler(const scheduler_config_t& config) : config_(config) {
+}
+
+const scheduler_stats_t& JobScheduler::stats() const {
+    return stats_;
+}
+
+void JobScheduler::picked(const job_affinity_t& affinity) {
+    stats_.picked += 1;
+    if (affinity.pipeline == loaded_.pipeline) {
+        run_length_ += 1;
+        return;
+    }
+    if (affinity.weights == loaded_.weights) {
+        stats_.pipeline_rebuilds += 1;
+    } else {
+        stats_.weight_reloads += 1;
+    }
+    loaded_ = affinity;
+    run_length_ = 1;
+}
+
+size_t JobScheduler::pick(const std::vector<scheduled_job_t>& pending, job_time_t now) {
+    size_t result = 0;
+    if (now - pending[0].submitted > std::chrono::seconds(config_.max_wait_seconds)) {
+        if (pending[0].affinity.pipeline != loaded_.pipeline) {
+            stats_.starved += 1;
+        }
+        picked(pending[0].affinity);
+        return 0;
+    }
+
+    size_t same_pipeline = pending.size();
+    size_t same_weights = pending.size();
+    size_t other_pipeline = pending.size();
+    std::map<std::string, size_t> group_size;
+    for (size_t i = 0; i < pending.size(); ++i) {
+        const auto & a = pending[i].affinity;
+        group_size[a.pipeline] += 1;
+        if (a.pipeline == loaded_.pipeline) {
+            same_pipeline = std::min(same_pipeline, i);
+        } else {
+            other_pipeline = std::min(other_pipeline, i);
+            if (a.weights == loaded_.weights) {
+                same_weights = std::min(same_weights, i);
+            }
+        }
+    }
+
+    if (same_pipeline < pending.size() && (run_length_ < config_.max_batch || other_pipeline == pending.size())) {
+        result = same_pipeline;
+    } else if (same_pipeline < pending.size()) {
+        // the batch is over, gives the turn to the job waiting for longer
+        result = other_pipeline;
+    } else if (same_weights < pending.size()) {
+        result = same_weights;
+    } else {
+        // the first job of each pipeline decides the tie, so the older ones win
+        size_t largest = 0;
+        for (size_t i = 0; i < pending.size(); ++i) {
+            size_t count = group_size[pending[i].affinity.pipeline];
+            if (count > largest) {
+                largest = count;
+                result = i;
+            }
+        }
+    }
+
+    picked(pending[result].affinity);
+    return result;
+}
+
+}  // namespace dexpert
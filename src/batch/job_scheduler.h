@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2023 by Rodrigo Antonio de Araujo
+ */
+#ifndef SRC_BATCH_JOB_SCHEDULER_H_
+#define SRC_BATCH_JOB_SCHEDULER_H_
+
+#include <stddef.h>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "src/batch/batch_job.h"
+
+namespace dexpert
+{
+
+typedef std::chrono::steady_clock::time_point job_time_t;
+
+typedef struct {
+    std::string weights;    // model + loras: python reloads the weights when it changes (load_model)
+    std::string pipeline;   // weights + pipeline mode + controlnet modes: python rebuilds the pipeline (create_pipeline)
+} job_affinity_t;
+
+// returns the path of the model (a name or a path), empty when it is unknown
+typedef std::function<std::string(const std::string& model)> model_resolver_t;
+
+// the model is resolved to its path, a model given by name and by path has the same affinity
+job_affinity_t job_affinity(const batch_job_t& job, const model_resolver_t& resolve_model = model_resolver_t());
+
+typedef struct {
+    job_affinity_t affinity;
+    job_time_t submitted;
+} scheduled_job_t;
+
+typedef struct {
+    size_t max_batch = 16;          // jobs of the same pipeline in a row while other jobs are waiting
+    int max_wait_seconds = 600;     // a job waiting longer than that runs next
+} scheduler_config_t;
+
+typedef struct {
+    size_t picked = 0;
+    size_t weight_reloads = 0;
+    size_t pipeline_rebuilds = 0;   // same weights, different pipeline
+    size_t starved = 0;             // jobs picked because they waited too much
+} scheduler_stats_t;
+
+/*
+    Chooses the next job so python reuses the loaded pipeline as much as possible:
+        1. the oldest job when it waited more than max_wait_seconds
+        2. the oldest job using the loaded pipeline (at most max_batch in a row when other jobs wait)
+        3. the oldest job using the loaded weights (only the pipeline is rebuilt)
+        4. the oldest job of the pipeline with more jobs waiting
+*/
+class JobScheduler {
+ public:
+    explicit JobScheduler(const scheduler_config_t& config = scheduler_config_t());
+
+    // pending is in submission order and is not empty, returns the index of the job to run
+    size_t pick(const std::vector<scheduled_job_t>& pending, job_time_t now);
+    const scheduler_stats_t& stats() const;
+
+ private:
+    void picked(const job_affinity_t& affinity);
+
+ private:
+    scheduler_config_t config_;
+    scheduler_stats_t stats_;
+    job_affinity_t loaded_;
+    size_t run_length_ = 0;
+};
+
+}  // namespace dexpert
+
+#endif  // SRC_BATCH_JOB_SCHEDULER_H_
@@ -0,0 +1,335 @@
+#include <ctype.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <fstream>
+#include <filesystem>
+#include <iterator>
+
+#include <nlohmann/json.hpp>
+
+#include "src/data/base64.h"
+#include "src/batch/job_paths.h"
+#include "src/batch/job_server.h"
+
+using json = nlohmann::json;
+
+namespace dexpert
+{
+
+namespace {
+    http_response_t json_response(int status, const json& data) {
+        http_response_t response;
+        response.status = status;
+        response.body = data.dump();
+        return response;
+    }
+
+    http_response_t error_response(int status, const std::string& message) {
+        return json_response(status, {{"error", message}});
+    }
+
+    json job_to_json(const queued_job_t& job) {
+        json data;
+        data["id"] = job.id;
+        data["state"] = job_state_name(job.state);
+        data["mode"] = job.job.mode;
+        data["model"] = job.job.model;
+        data["outputs"] = job.outputs;
+        if (!job.error.empty()) {
+            data["error"] = job.error;
+        }
+        if (!job.job.id.empty()) {
+            data["job_id"] = job.job.id;
+        }
+        return data;
+    }
+
+    // splits /jobs/12/images/0 into ["jobs", "12", "images", "0"]
+    std::vector<std::string> path_parts(const std::string& path) {
+        std::vector<std::string> parts;
+        size_t pos = 0;
+        while (pos < path.size()) {
+            size_t end = path.find('/', pos);
+            if (end == std::string::npos) {
+                end = path.size();
+            }
+            if (end > pos) {
+                parts.push_back(path.substr(pos, end - pos));
+            }
+            pos = end + 1;
+        }
+        return parts;
+    }
+
+    // the decoded image is stored with the extension of its content (the python loader uses it)
+    const char *image_extension(const std::string& data) {
+        if (data.compare(0, 8, "\x89PNG\r\n\x1a\n") == 0) {
+            return ".png";
+        }
+        if (data.compare(0, 3, "\xff\xd8\xff") == 0) {
+            return ".jpg";
+        }
+        if (data.compare(0, 2, "BM") == 0) {
+            return ".bmp";
+        }
+        if (data.compare(0, 4, "GIF8") == 0) {
+            return ".gif";
+        }
+        if (data.size() > 12 && data.compare(0, 4, "RIFF") == 0 && data.compare(8, 4, "WEBP") == 0) {
+            return ".webp";
+        }
+        return NULL;
+    }
+
+    // the server reads and writes files only inside the output directory (the base64 images are stored there too)
+    bool check_job_paths(const std::string& output_dir, const batch_job_t& job, std::string *error) {
+        std::string resolved;
+        std::vector<std::string> inputs;
+        if (!job.image.empty()) {
+            inputs.push_back(job.image);
+        }
+        if (!job.mask.empty()) {
+            inputs.push_back(job.mask);
+        }
+        for (const auto & c : job.controlnets) {
+            inputs.push_back(c.image);
+        }
+        for (const auto & path : inputs) {
+            if (!resolve_inside(output_dir, path, &resolved)) {
+                *error = "the image " + path + " is not inside the output directory, send it as base64";
+                return false;
+            }
+        }
+        // without an output the id names the files (see HeadlessRunner::outputPath)
+        std::string output = job.output.empty() ? job.id + "-0.png" : job.output;
+        if (!resolve_inside(output_dir, output, &resolved)) {
+            *error = "the output " + output + " is not inside the output directory";
+            return false;
+        }
+        return true;
+    }
+
+    bool is_json_request(const http_request_t& request) {
+        auto it = request.headers.find("content-type");
+        if (it == request.headers.end()) {
+            return false;
+        }
+        std::string type = it->second.substr(0, it->second.find(';'));
+        std::transform(type.begin(), type.end(), type.begin(), [] (unsigned char c) { return (char) tolower(c); });
+        return type == "application/json";
+    }
+
+    bool parse_index(const std::string& text, size_t *value) {
+        char *end = NULL;
+        unsigned long long v = strtoull(text.c_str(), &end, 10);
+        if (text.empty() || *end != '\0') {
+            return false;
+        }
+        *value = (size_t) v;
+        return true;
+    }
+}  // unnamed namespace
+
+JobServer::JobServer(JobQueue *queue, const std::string& output_dir) : queue_(queue), output_dir_(output_dir.empty() ? "." : output_dir), shutdown_(false) {
+    auto dir = std::filesystem::u8path(output_dir_) / "inputs";
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+    input_dir_ = dir.u8string();
+}
+
+bool JobServer::shutdownRequested() {
+    return shutdown_;
+}
+
+http_response_t JobServer::handle(const http_request_t& request) {
+    auto parts = path_parts(request.path);
+    size_t id = 0;
+    size_t index = 0;
+
+    if (parts.size() == 1 && parts[0] == "health" && request.method == "GET") {
+        auto stats = queue_->schedulerStats();
+        return json_response(200, {
+            {"status", "ok"},
+            {"pending", queue_->pending()},
+            {"scheduler", {
+                {"picked", stats.picked},
+                {"weight_reloads", stats.weight_reloads},
+                {"pipeline_rebuilds", stats.pipeline_rebuilds},
+                {"starved", stats.starved}
+            }}
+        });
+    }
+    if (parts.size() == 1 && parts[0] == "shutdown" && request.method == "POST") {
+        shutdown_ = true;
+        queue_->stop();
+        return json_response(200, {{"status", "stopping"}});
+    }
+    if (parts.empty() || parts[0] != "jobs") {
+        return error_response(404, "not found");
+    }
+    if (parts.size() == 1) {
+        if (request.method == "POST") {
+            return submit(request);
+        }
+        if (request.method == "GET") {
+            return listJobs();
+        }
+        return error_response(405, "method not allowed");
+    }
+    if (!parse_index(parts[1], &id)) {
+        return error_response(404, "not found");
+    }
+    if (request.method != "GET") {
+        return error_response(405, "method not allowed");
+    }
+    if (parts.size() == 2) {
+        return jobStatus(id);
+    }
+    if (parts.size() == 4 && parts[2] == "images" && parse_index(parts[3], &index)) {
+        return jobImage(id, index);
+    }
+    return error_response(404, "not found");
+}
+
+bool JobServer::storeImage(const std::string& base64, const std::string& name, std::string *path, std::string *error) {
+    std::string data;
+    if (!base64_decode(base64, data) || data.empty()) {
+        *error = "invalid base64 at " + name;
+        return false;
+    }
+    const char *extension = image_extension(data);
+    if (!extension) {
+        *error = "unsupported image format at " + name + " (png, jpeg, bmp, gif or webp)";
+        return false;
+    }
+    auto file_path = std::filesystem::u8path(input_dir_) / (std::to_string(++input_count_) + "-" + name + extension);
+    std::ofstream f(file_path, std::ios::binary);
+    f.write(data.c_str(), data.size());
+    if (!f.good()) {
+        *error = "could not store " + name;
+        return false;
+    }
+    *path = file_path.u8string();
+    return true;
+}
+
+void JobServer::releaseInputs(const batch_job_t& job) {
+    std::vector<std::string> paths = {job.image, job.mask};
+    for (const auto & c : job.controlnets) {
+        paths.push_back(c.image);
+    }
+    const auto input_dir = std::filesystem::u8path(input_dir_);
+    std::error_code ec;
+    for (const auto & path : paths) {
+        // only the files the server stored, the paths given by the client are not touched
+        auto file_path = std::filesystem::u8path(path);
+        if (!path.empty() && file_path.parent_path() == input_dir) {
+            std::filesystem::remove(file_path, ec);
+        }
+    }
+}
+
+http_response_t JobServer::submit(const http_request_t& request) {
+    // a web page can not send application/json to another origin without a cors preflight
+    if (!is_json_request(request)) {
+        return error_response(415, "the content type must be application/json");
+    }
+    json data;
+    try {
+        data = json::parse(request.body);
+    } catch (json::exception& e) {
+        return error_response(400, e.what());
+    }
+    if (!data.is_array()) {
+        data = json::array({data});
+    }
+
+    // validates all the jobs first: a request is accepted or rejected as a whole
+    std::vector<batch_job_t> jobs;
+    std::vector<std::string> stored;
+    std::string error;
+    std::string path;
+    auto reject = [&stored] (const std::string& message) {
+        std::error_code ec;
+        for (const auto & p : stored) {
+            std::filesystem::remove(std::filesystem::u8path(p), ec);
+        }
+        return error_response(400, message);
+    };
+    for (auto & item : data) {
+        if (!item.is_object()) {
+            return reject("the job is not a json object");
+        }
+        try {
+            const char *image_fields[][2] = {{"image_base64", "image"}, {"mask_base64", "mask"}};
+            for (const auto & field : image_fields) {
+                if (item.contains(field[0])) {
+                    if (!storeImage(item[field[0]].get<std::string>(), field[1], &path, &error)) {
+                        return reject(error);
+                    }
+                    stored.push_back(path);
+                    item[field[1]] = path;
+                    item.erase(field[0]);
+                }
+            }
+            if (item.contains("controlnets")) {
+                for (auto & c : item["controlnets"]) {
+                    if (c.is_object() && c.contains("image_base64")) {
+                        if (!storeImage(c["image_base64"].get<std::string>(), "control", &path, &error)) {
+                            return reject(error);
+                        }
+                        stored.push_back(path);
+                        c["image"] = path;
+                        c.erase("image_base64");
+                    }
+                }
+            }
+        } catch (json::exception& e) {
+            return reject(e.what());
+        }
+        batch_job_t job;
+        if (!parse_batch_job(item.dump(), &job, &error) || !check_job_paths(output_dir_, job, &error)) {
+            return reject(error);
+        }
+        jobs.push_back(job);
+    }
+
+    json ids = json::array();
+    for (const auto & job : jobs) {
+        ids.push_back(queue_->submit(job));
+    }
+    return json_response(202, {{"ids", ids}});
+}
+
+http_response_t JobServer::jobStatus(size_t id) {
+    queued_job_t job;
+    if (!queue_->status(id, &job)) {
+        return error_response(404, "job not found");
+    }
+    return json_response(200, job_to_json(job));
+}
+
+http_response_t JobServer::jobImage(size_t id, size_t index) {
+    queued_job_t job;
+    if (!queue_->status(id, &job) || index >= job.outputs.size()) {
+        return error_response(404, "image not found");
+    }
+    std::ifstream f(std::filesystem::u8path(job.outputs[index]), std::ios::binary);
+    if (!f) {
+        return error_response(404, "image file not found");
+    }
+    http_response_t response;
+    response.content_type = image_content_type(job.outputs[index]);
+    response.body.assign(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+    return response;
+}
+
+http_response_t JobServer::listJobs() {
+    json jobs = json::array();
+    for (const auto & job : queue_->list()) {
+        jobs.push_back(job_to_json(job));
+    }
+    return json_response(200, {{"jobs", jobs}});
+}
+
+}  // namespace dexpert
@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2023 by Rodrigo Antonio de Araujo
+ */
+#ifndef SRC_BATCH_JOB_SERVER_H_
+#define SRC_BATCH_JOB_SERVER_H_
+
+#include <atomic>
+#include <string>
+
+#include "src/batch/http_server.h"
+#include "src/batch/job_queue.h"
+
+namespace dexpert
+{
+
+/*
+    Routes of the local job server (diffusion-exp --serve [port] [--output <dir>]):
+        GET  /health                    server status, pending jobs and scheduler counters
+        POST /jobs                      a job (or an array of jobs), returns the ids
+        GET  /jobs                      all the jobs
+        GET  /jobs/<id>                 job state, error and output files
+        GET  /jobs/<id>/images/<n>      the n-th output image
+        POST /shutdown                  stops the server after the current job
+    The jobs use the headless job format (batch_job.h), posted as application/json. Images are
+    base64 at image_base64, mask_base64 and controlnets[].image_base64, or paths inside the output
+    directory. The outputs must be inside the output directory too.
+*/
+class JobServer {
+ public:
+    JobServer(JobQueue *queue, const std::string& output_dir);
+    JobServer (const JobServer &) = delete;
+    JobServer & operator = (const JobServer &) = delete;
+
+    http_response_t handle(const http_request_t& request);
+    bool shutdownRequested();
+    // removes the images the server stored for the job (call it when the job finishes)
+    void releaseInputs(const batch_job_t& job);
+
+ private:
+    http_response_t submit(const http_request_t& request);
+    http_response_t jobStatus(size_t id);
+    http_response_t jobImage(size_t id, size_t index);
+    http_response_t listJobs();
+    bool storeImage(const std::string& base64, const std::string& name, std::string *path, std::string *error);
+
+ private:
+    JobQueue *queue_;
+    std::string output_dir_;
+    std::string input_dir_;
+    size_t input_count_ = 0;
+    std::atomic<bool> shutdown_;
+};
+
+}  // namespace dexpert
+
+#endif  // SRC_BATCH_JOB_SERVER_H_
@@ -246,6 +246,19 @@ void Config::inpaint_set_mask_blur(float value) {
     inpaint_mask_blur_ = value;
 }
 
+int Config::inpaint_get_mask_padding() {
+    return inpaint_mask_padding_;
+}
+
+void Config::inpaint_set_mask_padding(int value) {
+    if (value < 0)
+        value = 0;
+    if (value > 256)
+        value = 256;
+
+    inpaint_mask_padding_ = value;
+}
+
 bool Config::getPrivacyMode() {
     return privacy_mode_;
 }
@@ -254,6 +267,68 @@ void Config::setPrivacyMode(bool value) {
     privacy_mode_ = value;
 }
 
+uint32_t Config::getConsoleScrollbackMB() {
+    return console_scrollback_mb_;
+}
+
+void Config::setConsoleScrollbackMB(uint32_t value) {
+    if (value < 1) {
+        value = 1;
+    }
+    console_scrollback_mb_ = value;
+}
+
+bool Config::getTraceEnabled() {
+    return trace_enabled_;
+}
+
+void Config::setTraceEnabled(bool value) {
+    trace_enabled_ = value;
+}
+
+uint32_t Config::getUndoHistoryMB() {
+    return undo_history_mb_;
+}
+
+void Config::setUndoHistoryMB(uint32_t value) {
+    if (value < 1) {
+        value = 1;
+    }
+    undo_history_mb_ = value;
+}
+
+uint32_t Config::getPreProcessCacheMB() {
+    return pre_process_cache_mb_;
+}
+
+void Config::setPreProcessCacheMB(uint32_t value) {
+    pre_process_cache_mb_ = value;
+}
+
+uint32_t Config::getPreProcessDiskCacheMB() {
+    return pre_process_disk_cache_mb_;
+}
+
+void Config::setPreProcessDiskCacheMB(uint32_t value) {
+    pre_process_disk_cache_mb_ = value;
+}
+
+uint32_t Config::getModelCacheMB() {
+    return model_cache_mb_;
+}
+
+void Config::setModelCacheMB(uint32_t value) {
+    model_cache_mb_ = value;
+}
+
+uint32_t Config::getDetectorCacheMB() {
+    return detector_cache_mb_;
+}
+
+void Config::setDetectorCacheMB(uint32_t value) {
+    detector_cache_mb_ = value;
+}
+
 void Config::setAdditionalModelDir(const std::string& value) {
     additionalModelDir_ = value;
 }
@@ -292,6 +367,8 @@ bool Config::save() {
         sd["add_model_dir"] = additionalModelDir_;
         sd["add_emb_dir"] = additionalEmbDir_;
         sd["add_lora_dir"] = additionalLoraDir_;
+        sd["model_cache_mb"] = model_cache_mb_;
+        sd["detector_cache_mb"] = detector_cache_mb_;
         data["stable_diffusion"] = sd;
         json files;
         files["last_image_save_dir"] = last_image_save_dir_;
@@ -307,6 +384,11 @@ bool Config::save() {
         data["gfpgan"] = gfpgan;
         json general;
         general["privacy_mode"] = privacy_mode_;
+        general["console_scrollback_mb"] = console_scrollback_mb_;
+        general["trace_enabled"] = trace_enabled_;
+        general["undo_history_mb"] = undo_history_mb_;
+        general["pre_process_cache_mb"] = pre_process_cache_mb_;
+        general["pre_process_disk_cache_mb"] = pre_process_disk_cache_mb_;
         data["general"] = general;
         const std::wstring path = getConfigDir() + kCONFIG_FILE;
         std::ofstream f(path.c_str());
@@ -371,6 +453,12 @@ bool Config::load() {
             if (sd.contains("add_lora_dir")) {
                 additionalLoraDir_ = sd["add_lora_dir"].get<std::string>();
             }
+            if (sd.contains("model_cache_mb")) {
+                model_cache_mb_ = sd["model_cache_mb"].get<uint32_t>();
+            }
+            if (sd.contains("detector_cache_mb")) {
+                detector_cache_mb_ = sd["detector_cache_mb"].get<uint32_t>();
+            }
         }
         if (data.contains("files")) {
             auto files = data["files"];
@@ -411,6 +499,21 @@ bool Config::load() {
             if (general.contains("privacy_mode")) {
                 privacy_mode_ = general["privacy_mode"].get<bool>();
             }
+            if (general.contains("console_scrollback_mb")) {
+                setConsoleScrollbackMB(general["console_scrollback_mb"].get<uint32_t>());
+            }
+            if (general.contains("trace_enabled")) {
+                trace_enabled_ = general["trace_enabled"].get<bool>();
+            }
+            if (general.contains("undo_history_mb")) {
+                setUndoHistoryMB(general["undo_history_mb"].get<uint32_t>());
+            }
+            if (general.contains("pre_process_cache_mb")) {
+                pre_process_cache_mb_ = general["pre_process_cache_mb"].get<uint32_t>();
+            }
+            if (general.contains("pre_process_disk_cache_mb")) {
+                pre_process_disk_cache_mb_ = general["pre_process_disk_cache_mb"].get<uint32_t>();
+            }
         }
         return true;
     } catch(json::exception& e) {
@@ -48,6 +48,20 @@ namespace dexpert
     void setUseGPU(bool value);
     bool getPrivacyMode();
     void setPrivacyMode(bool value);
+    uint32_t getConsoleScrollbackMB();
+    void setConsoleScrollbackMB(uint32_t value);
+    bool getTraceEnabled();
+    void setTraceEnabled(bool value);
+    uint32_t getUndoHistoryMB();    // memory budget of each image undo history (the disk can take 4x more)
+    void setUndoHistoryMB(uint32_t value);
+    uint32_t getPreProcessCacheMB();        // pre-processed control images kept in memory
+    void setPreProcessCacheMB(uint32_t value);
+    uint32_t getPreProcessDiskCacheMB();    // 0 = no disk cache
+    void setPreProcessDiskCacheMB(uint32_t value);
+    uint32_t getModelCacheMB();     // 0 = automatic (a share of the vram or of the ram)
+    void setModelCacheMB(uint32_t value);
+    uint32_t getDetectorCacheMB();  // pre-processor models (pose, depth, lineart...)
+    void setDetectorCacheMB(uint32_t value);
     float gfpgan_get_weight();
     void gfpgan_set_weight(float value);
     const char* gfpgan_get_arch();
@@ -63,6 +77,8 @@ namespace dexpert
 
     float inpaint_get_mask_blur();
     void inpaint_set_mask_blur(float value);
+    int inpaint_get_mask_padding();
+    void inpaint_set_mask_padding(int value);
 
     std::string& lastImageSaveDir();
     std::string& lastImageOpenDir();
@@ -98,6 +114,13 @@ namespace dexpert
   private:
     // configs
     bool privacy_mode_ = false;
+    uint32_t console_scrollback_mb_ = 16;
+    bool trace_enabled_ = false;
+    uint32_t undo_history_mb_ = 256;
+    uint32_t pre_process_cache_mb_ = 256;
+    uint32_t pre_process_disk_cache_mb_ = 1024;
+    uint32_t model_cache_mb_ = 0;
+    uint32_t detector_cache_mb_ = 2048;
     bool use_gpu_ = true;
     bool use_float16_ = true;
     float gfpgan_weight_ = 0.5;
@@ -107,6 +130,7 @@ namespace dexpert
     bool gfpgan_has_aligned_ = false;
     bool gfpgan_paste_back_ = true;
     float inpaint_mask_blur_ = 4.0;
+    int inpaint_mask_padding_ = 32;
     int controlnetCount_ = 0;
     bool safeFilterEnabled_ = true;
     std::string scheduler_ = "PNDMScheduler";
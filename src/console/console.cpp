@@ -1,3 +1,4 @@
+#include "src/opengl_utils/frame_scheduler.h"
 #include "src/console/console.h"
 
 #ifdef _WIN32
@@ -20,6 +21,7 @@ namespace dexpert
     Console::~Console()
     {
         Fl::remove_timeout(Console::validate, this);
+        cancel_frame(this);
     }
 
     void Console::validate(void *ud) {
@@ -38,14 +40,17 @@ namespace dexpert
         Fl::repeat_timeout(0.33, Console::validate, ud); // retrigger timeout
         Console *c = (Console *)ud;
         if (c->version_ != c->terminal_->version()) {
-            c->redraw();
+            damage_widget(c, FL_DAMAGE_USER1); // only the lines that changed
         }
     }
 
     void Console::draw()
     {
         version_ = terminal_->version();
-        terminal_->draw(this, getFontFace(), getFontSize(), getFontHeight());
+        auto snapshot = terminal_->snapshot();
+        bool partial = drawn_ && (damage() & ~FL_DAMAGE_USER1) == 0;
+        terminal_->draw(this, getFontFace(), getFontSize(), getFontHeight(), snapshot.get(), partial ? drawn_.get() : NULL);
+        drawn_ = snapshot;
     };
 
     void Console::textfont(Fl_Font fontface)
@@ -34,6 +34,7 @@ class Console: public Fl_Widget {
  private:
     int version_;
     std::shared_ptr<EmulatedTerminal> terminal_;
+    std::shared_ptr<terminal_snapshot_t> drawn_;    // the snapshot on the screen
     int font_width = 10;
     int font_height = 16;
     int font_size;		//current font size, should equal to height
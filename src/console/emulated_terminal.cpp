@@ -1,4 +1,6 @@
 #include <stdio.h>
+#include <string.h>
+#include <algorithm>
 #include <iostream>
 #include <mutex>
 #include <memory>
@@ -12,6 +14,7 @@
 #include <unistd.h>
 #endif
 
+#include "src/data/tracing.h"
 #include "src/console/emulated_terminal.h"
 #include "src/python/wrapper.h"
 
@@ -20,6 +23,11 @@
 #define LINE_COUNT 512
 #define HALF_LINES 256
 #define BUFFER_SIZE (LINE_SIZE * LINE_COUNT)
+#define RING_SIZE (1024 * 1024)
+#define DEFAULT_SCROLLBACK_LIMIT (16 * 1024 * 1024)
+#define PARSER_IDLE_WAIT_MS 50
+#define PARSER_BATCH_SIZE (64 * 1024)
+#define PUBLISH_INTERVAL_MS 16
 
 #ifdef _WIN32
 #define DUP _dup
@@ -68,13 +76,85 @@ namespace dexpert
             {
                 default_fn[log_source_stdout] = 1;
                 default_fn[log_source_stderr] = 2;
-                get_terminal(log_source_stdout); // just to start the stdout capture
-                get_terminal(log_source_stderr); // just to start the stderr capture
                 dexpert::py::get_py(); // initialize python
             }
         };
 
-        Startup initializer; // start the captures
+        Startup initializer;
+    }
+
+    void start_console_capture()
+    {
+        // the headless modes don't call it, their output stays in the real stdout and stderr
+        get_terminal(log_source_stdout);
+        get_terminal(log_source_stderr);
+    }
+
+    namespace
+    {
+        typedef std::chrono::steady_clock clock_type_t;
+
+        // copies a line to dst (dst <= src), dropping the carriage return rewrites covered by the last rewrite
+        size_t coalesce_line(const char *src, size_t len, char *dst, size_t max_width)
+        {
+            size_t first_cr = len;
+            size_t last_cr = len;
+            for (size_t i = 0; i < len; i++)
+            {
+                unsigned char c = src[i];
+                if (c == 0x0d)
+                {
+                    if (first_cr == len)
+                        first_cr = i;
+                    last_cr = i;
+                }
+                else if (c < 0x20 || c == 0x7f || c == 0xff)
+                {
+                    first_cr = len; // escape sequences and other controls are kept as they are
+                    break;
+                }
+            }
+            if (first_cr != len && first_cr != last_cr)
+            {
+                size_t widest = 0;
+                size_t start = first_cr + 1;
+                for (size_t i = start; i <= last_cr; i++)
+                {
+                    if (src[i] == 0x0d)
+                    {
+                        widest = std::max(widest, i - start);
+                        start = i + 1;
+                    }
+                }
+                size_t last_len = len - last_cr - 1;
+                // a wider line would wrap, and a shorter rewrite would leave part of the previous one visible
+                if (widest <= last_len && last_len <= max_width && first_cr <= max_width)
+                {
+                    memmove(dst, src, first_cr + 1);
+                    memmove(dst + first_cr + 1, src + last_cr + 1, last_len);
+                    return first_cr + 1 + last_len;
+                }
+            }
+            memmove(dst, src, len);
+            return len;
+        }
+
+        size_t coalesce_carriage_returns(char *data, size_t len, size_t max_width)
+        {
+            size_t out = 0;
+            size_t i = 0;
+            while (i < len)
+            {
+                size_t eol = i;
+                while (eol < len && data[eol] != 0x0a)
+                    eol++;
+                out += coalesce_line(data + i, eol - i, data + out, max_width);
+                if (eol < len)
+                    data[out++] = 0x0a;
+                i = eol + 1;
+            }
+            return out;
+        }
     }
 
     std::shared_ptr<EmulatedTerminal> get_terminal(log_source_t src_type)
@@ -86,13 +166,18 @@ namespace dexpert
         return terminals[src_type];
     }
 
-    EmulatedTerminal::EmulatedTerminal(log_source_t src_type_)
+    EmulatedTerminal::EmulatedTerminal(log_source_t src_type_) : ring_(RING_SIZE), scrollback_(DEFAULT_SCROLLBACK_LIMIT)
     {
         src_type = src_type_;
+        terminated_ = false;
+        parser_sleeping_ = false;
+        version_ = 0;
         if (init_console())
         {
             LOG("EmulatedTerminal 1.");
             initialize();
+            parser_.reset(new std::thread([this]
+                                          { parse(); }));
             thread_.reset(new std::thread([this]
                                           { run(); }));
         }
@@ -107,6 +192,11 @@ namespace dexpert
             fflush(STREAM(src_type));
             thread_->join();
         }
+        if (parser_)
+        {
+            wake_parser_.notify_one();
+            parser_->join();
+        }
         free(buff);
         free(line);
         free(attr);
@@ -117,6 +207,16 @@ namespace dexpert
         return version_;
     }
 
+    void EmulatedTerminal::setScrollbackLimit(size_t bytes)
+    {
+        scrollback_.setMemoryLimit(bytes);
+    }
+
+    ScrollbackStore *EmulatedTerminal::scrollback()
+    {
+        return &scrollback_;
+    }
+
     void EmulatedTerminal::initialize()
     {
         buff = (char *)malloc(BUFFER_SIZE);
@@ -178,6 +278,7 @@ namespace dexpert
     void EmulatedTerminal::run()
     {
         LOG("EmulatedTerminal::run() 1.");
+        set_trace_thread_name(src_type == log_source_stdout ? "terminal reader (stdout)" : "terminal reader (stderr)");
 
         char temp[LINE_SIZE] = {
             0,
@@ -194,7 +295,20 @@ namespace dexpert
             }
             if (readed > 0)
             {
-                append(temp, readed);
+                TRACE_SCOPE("terminal read");
+                // the parser drains the ring, when it is full wake it and wait 1 ms for room
+                // (the other end of the pipe is the python worker, it blocks while we wait)
+                size_t sent = ring_.push(temp, (size_t)readed);
+                while (sent < (size_t)readed && !terminated_)
+                {
+                    wake_parser_.notify_one();
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                    sent += ring_.push(temp + sent, readed - sent);
+                }
+                if (parser_sleeping_)
+                {
+                    wake_parser_.notify_one();
+                }
             }
         }
 
@@ -204,6 +318,84 @@ namespace dexpert
         CLOSE(pipefd[1]);
     }
 
+    void EmulatedTerminal::parse()
+    {
+        std::vector<char> temp(PARSER_BATCH_SIZE);
+        const auto publish_interval = std::chrono::milliseconds(PUBLISH_INTERVAL_MS);
+        auto last_publish = clock_type_t::now() - publish_interval;
+        bool pending = false;
+        set_trace_thread_name(src_type == log_source_stdout ? "terminal parser (stdout)" : "terminal parser (stderr)");
+        while (!terminated_)
+        {
+            size_t count = ring_.pop(&temp[0], temp.size());
+            if (count == 0)
+            {
+                auto wait = std::chrono::milliseconds(PARSER_IDLE_WAIT_MS);
+                if (pending)
+                {
+                    auto elapsed = clock_type_t::now() - last_publish;
+                    if (elapsed >= publish_interval)
+                    {
+                        std::unique_lock<std::mutex> lk(mtx_);
+                        publish_snapshot();
+                        last_publish = clock_type_t::now();
+                        pending = false;
+                        continue;
+                    }
+                    wait = std::chrono::duration_cast<std::chrono::milliseconds>(publish_interval - elapsed) + std::chrono::milliseconds(1);
+                }
+                std::unique_lock<std::mutex> lk(wake_mtx_);
+                parser_sleeping_ = true;
+                if (ring_.empty() && !terminated_)
+                {
+                    // the timeout covers a notification sent before we started to wait
+                    wake_parser_.wait_for(lk, wait);
+                }
+                parser_sleeping_ = false;
+                continue;
+            }
+            TRACE_SCOPE("terminal parse");
+            std::unique_lock<std::mutex> lk(mtx_);
+            while (count > 0)
+            {
+                count = coalesce_carriage_returns(&temp[0], count, size_x);
+                append(&temp[0], count);
+                count = ring_.pop(&temp[0], temp.size());
+            }
+            // the gui draws at most one update per frame
+            if (clock_type_t::now() - last_publish >= publish_interval)
+            {
+                publish_snapshot();
+                last_publish = clock_type_t::now();
+                pending = false;
+            }
+            else
+            {
+                pending = true;
+            }
+        }
+    }
+
+    void EmulatedTerminal::publish_snapshot()
+    {
+        std::shared_ptr<terminal_snapshot_t> snapshot(new terminal_snapshot_t());
+        snapshot->text.resize(size_y);
+        snapshot->attrs.resize(size_y);
+        int ly = screen_y;
+        for (int i = 0; i < size_y; i++)
+        {
+            int begin = line[ly + i];
+            int end = line[ly + i + 1];
+            if (begin < end)
+            {
+                snapshot->text[i].assign(buff + begin, end - begin);
+                snapshot->attrs[i].assign(attr + begin, end - begin);
+            }
+        }
+        std::atomic_store(&snapshot_, snapshot);
+        ++version_;
+    }
+
 #define TNO_IAC 0xff
 #define TNO_DONT 0xfe
 #define TNO_DO 0xfd
@@ -256,9 +448,6 @@ namespace dexpert
         const unsigned char *p = (const unsigned char *)data;
         const unsigned char *zz = p + len;
 
-        std::unique_lock<std::mutex> lk(mtx_);
-        ++version_;
-
         if (bEscape)
             p = vt100_Escape(p, zz - p);
 
@@ -898,6 +1087,13 @@ namespace dexpert
         if (cursor_x > BUFFER_SIZE - LINE_SIZE || cursor_y > LINE_COUNT - 3)
         {
             int middle = line[HALF_LINES];
+            for (int i = 0; i < HALF_LINES; i++)
+            {
+                int len = line[i + 1] - line[i];
+                if (len > 0 && buff[line[i + 1] - 1] == 0x0a)
+                    len--;
+                scrollback_.append(buff + line[i], len > 0 ? len : 0);
+            }
             for (int i = HALF_LINES; i < cursor_y + 2; i++)
                 line[i] -= middle;
             memmove(line, line + HALF_LINES, HALF_LINES * sizeof(int));
@@ -938,51 +1134,78 @@ namespace dexpert
         FL_BLACK, FL_RED, FL_GREEN, FL_YELLOW,
         FL_BLUE, FL_MAGENTA, FL_CYAN, FL_WHITE};
 
-    void EmulatedTerminal::draw(Fl_Widget *target, int font_face, int font_size, int font_height)
+    std::shared_ptr<terminal_snapshot_t> EmulatedTerminal::snapshot()
     {
-        std::unique_lock<std::mutex> lk(mtx_);
-        
-        fl_push_clip(target->x(), target->y(), target->w(), target->h());
+        return std::atomic_load(&snapshot_);
+    }
 
-        fl_color(target->color());
-        fl_rectf(target->x(), target->y(), target->w(), target->h());
+    void EmulatedTerminal::draw(Fl_Widget *target, int font_face, int font_size, int font_height, terminal_snapshot_t *snapshot, terminal_snapshot_t *previous)
+    {
+        fl_push_clip(target->x(), target->y(), target->w(), target->h());
         fl_font(font_face, font_size);
 
-        int sel_l = 0, sel_r = 0;
-        int ly = screen_y;
-        int dx, dy = target->y();
+        int cap = (target->h() - font_height / 2) / font_height;
+        auto first_visible_line = [cap] (terminal_snapshot_t *s) {
+            int last_line = 0;
+            for (size_t i = 0; i < s->text.size(); i++) {
+                if (!s->text[i].empty()) {
+                    ++last_line;
+                };
+            }
+            int scroll_y = last_line - cap;
+            return scroll_y < 0 ? 0 : scroll_y;
+        };
+
+        int scroll_y = snapshot ? first_visible_line(snapshot) : 0;
+
+        if (previous && (!snapshot || previous->text.size() != snapshot->text.size() || first_visible_line(previous) != scroll_y))
+        {
+            previous = NULL; // the lines moved, draw everything
+        }
 
-        int last_line = 0;
-        for (int i = 0; i < size_y; i++) {
-            if (line[ly + i] < line[ly + i + 1]) {
-                ++last_line;
-            };
+        if (!previous)
+        {
+            fl_color(target->color());
+            fl_rectf(target->x(), target->y(), target->w(), target->h());
         }
-        
-        int cap = (target->h() - font_height / 2) / font_height;
-        int scroll_y = last_line - cap;
-        if (scroll_y < 0) {
-            scroll_y = 0;
+
+        if (!snapshot)
+        {
+            fl_pop_clip();
+            return;
         }
 
-        for (int i = scroll_y; i < size_y; i++)
+        int line_count = (int)snapshot->text.size();
+        int dx, dy = target->y();
+
+        for (int i = scroll_y; i < line_count; i++)
         {
             dx = target->x() + 1;
             dy += font_height;
-            int j = line[ly + i];
-            while (j < line[ly + i + 1])
+            if (previous && previous->text[i] == snapshot->text[i] && previous->attrs[i] == snapshot->attrs[i])
+            {
+                continue;
+            }
+            if (previous)
+            {
+                fl_color(target->color());
+                fl_rectf(target->x(), dy - font_height + 4, target->w(), font_height);
+            }
+            const char *text = snapshot->text[i].c_str();
+            const char *attrs = snapshot->attrs[i].c_str();
+            int size = (int)snapshot->text[i].size();
+            int j = 0;
+            while (j < size)
             {
                 int n = j;
-                while (attr[n] == attr[j])
+                while (attrs[n] == attrs[j])
                 {
-                    if (++n == line[ly + i + 1])
-                        break;
-                    if (n == sel_r || n == sel_l)
+                    if (++n == size)
                         break;
                 }
-                unsigned int font_color = VT_attr[(int)attr[j] & 0x0f];
-                unsigned int bg_color = VT_attr[(int)((attr[j] >> 4) & 0x0f)];
-                int wi = fl_width(buff + j, n - j);
+                unsigned int font_color = VT_attr[(int)attrs[j] & 0x0f];
+                unsigned int bg_color = VT_attr[(int)((attrs[j] >> 4) & 0x0f)];
+                int wi = fl_width(text + j, n - j);
 
                 if (bg_color != target->color())
                 {
@@ -990,9 +1213,9 @@ namespace dexpert
                     fl_rectf(dx, dy - font_height + 4, wi, font_height);
                 }
                 fl_color(font_color);
-                int m = (buff[n - 1] == 0x0a) ? n - 1 : n; // don't draw LF,
+                int m = (text[n - 1] == 0x0a) ? n - 1 : n; // don't draw LF,
                 // which will result in little squares on some platforms
-                fl_draw(buff + j, m - j, dx, dy);
+                fl_draw(text + j, m - j, dx, dy);
                 dx += wi;
                 j = n;
             }
@@ -1002,31 +1225,70 @@ namespace dexpert
     }
 
     void EmulatedTerminal::copy_to_clipboard() {
+#ifdef _WIN32
         std::unique_lock<std::mutex> lk(mtx_);
-        std::string contents;
-        int sz = 0;
-        int j = 0;
+        size_t screen_size = 0;
         for (int i = 0; i < LINE_COUNT; i++)
         {
-            j = line[i];
-            sz = line[i + 1] - j;
+            if (line[i + 1] > line[i]) {
+                screen_size += line[i + 1] - line[i] + 1;
+            }
+        }
+        size_t total_size = scrollback_.size() + screen_size;
+        if (total_size == 0) {
+            return;
+        }
+        // the scrollback can be large, so it is copied straight to the clipboard memory
+        HGLOBAL hMem =  GlobalAlloc(GMEM_MOVEABLE, total_size + 1);
+        if (hMem == NULL) {
+            return;
+        }
+        char *dst = (char *)GlobalLock(hMem);
+        size_t pos = 0;
+        scrollback_.read([dst, &pos, total_size] (const char *data, size_t size) {
+            if (pos + size > total_size) {
+                size = total_size - pos;
+            }
+            memcpy(dst + pos, data, size);
+            pos += size;
+        });
+        for (int i = 0; i < LINE_COUNT && pos < total_size; i++)
+        {
+            int j = line[i];
+            int sz = line[i + 1] - j;
+            if (sz > 0 && pos + sz + 1 <= total_size) {
+                memcpy(dst + pos, &buff[j], sz);
+                pos += sz;
+                dst[pos++] = '\n';
+            }
+        }
+        dst[pos] = '\0';
+        GlobalUnlock(hMem);
+        OpenClipboard(0);
+        EmptyClipboard();
+        SetClipboardData(CF_TEXT, hMem);
+        CloseClipboard();
+#else
+        // fltk keeps its own copy of the clipboard text
+        std::unique_lock<std::mutex> lk(mtx_);
+        std::string text;
+        text.reserve(scrollback_.size());
+        scrollback_.read([&text] (const char *data, size_t size) {
+            text.append(data, size);
+        });
+        for (int i = 0; i < LINE_COUNT; i++)
+        {
+            int j = line[i];
+            int sz = line[i + 1] - j;
             if (sz > 0) {
-                contents += std::string(&buff[j], sz) + "\n";
+                text.append(&buff[j], sz);
+                text += '\n';
             }
         }
-        if (!contents.empty()) {
-#ifdef _WIN32
-        HGLOBAL hMem =  GlobalAlloc(GMEM_MOVEABLE, contents.size());
-        if (hMem != NULL) {
-            memcpy(GlobalLock(hMem), &contents[0], contents.size());
-            GlobalUnlock(hMem);
-            OpenClipboard(0);
-            EmptyClipboard();
-            SetClipboardData(CF_TEXT, hMem);
-            CloseClipboard();
+        if (!text.empty()) {
+            Fl::copy(text.c_str(), (int) text.size(), 1);
         }
 #endif
-        }
     }
 
 } // namespace dexpert
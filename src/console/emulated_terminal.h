@@ -7,10 +7,17 @@
 #include <mutex>
 #include <thread>
 #include <memory>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <condition_variable>
 
 #include <FL/Fl.H>
 #include <FL/fl_draw.H>
 
+#include "src/data/spsc_queue.h"
+#include "src/console/scrollback.h"
+
 namespace dexpert {
 
 typedef enum {
@@ -20,7 +27,14 @@ typedef enum {
 
 class EmulatedTerminal;
 
+typedef struct {
+    std::vector<std::string> text;    // the visible lines
+    std::vector<std::string> attrs;   // one attribute per byte of text
+} terminal_snapshot_t;
+
 std::shared_ptr<EmulatedTerminal> get_terminal(log_source_t src_type);
+// redirects stdout and stderr to the terminals (the gui shows them in the console windows)
+void start_console_capture();
 
 class EmulatedTerminal {
     friend std::shared_ptr<EmulatedTerminal> get_terminal(log_source_t);
@@ -30,13 +44,19 @@ class EmulatedTerminal {
     ~EmulatedTerminal();
     EmulatedTerminal (const EmulatedTerminal &) = delete;
     EmulatedTerminal & operator = (const EmulatedTerminal &) = delete;
-    void draw(Fl_Widget *target, int font_face, int font_size, int font_height);
+    std::shared_ptr<terminal_snapshot_t> snapshot();
+    // when previous is not NULL only the lines that changed since previous are drawn
+    void draw(Fl_Widget *target, int font_face, int font_size, int font_height, terminal_snapshot_t *snapshot, terminal_snapshot_t *previous);
     int version();
     void copy_to_clipboard();
+    void setScrollbackLimit(size_t bytes);
+    ScrollbackStore *scrollback();
 
  private:
     bool init_console();
     void run();
+    void parse();
+    void publish_snapshot();
     void initialize();
     void append(const char *data, size_t len);
     const unsigned char *vt100_Escape(const unsigned char *sz, int cnt);
@@ -47,7 +67,14 @@ class EmulatedTerminal {
 
  private:
     std::unique_ptr<std::thread> thread_;
-    std::mutex mtx_;
+    std::unique_ptr<std::thread> parser_;
+    std::mutex mtx_;    // the parser state (used by the parser thread and the clipboard)
+    SpscQueue<char> ring_;    // pipe reader -> parser
+    std::mutex wake_mtx_;
+    std::condition_variable wake_parser_;
+    std::atomic_bool parser_sleeping_;
+    std::shared_ptr<terminal_snapshot_t> snapshot_; // what the gui draws (std::atomic_load/atomic_store)
+    ScrollbackStore scrollback_;    // the lines discarded from buff
     log_source_t src_type = log_source_stdout;
     int pipefd[2] = { 0, };
     
@@ -58,7 +85,7 @@ class EmulatedTerminal {
     char *buff = NULL;
     char *attr = NULL;
     int *line = NULL;
-    bool terminated_ = false;
+    std::atomic_bool terminated_;
     int cursor_x = 0;
     int cursor_y = 0;
     int save_x = 0;
@@ -71,7 +98,7 @@ class EmulatedTerminal {
     int roll_bot = 24-1;
     int recv0 = 0;
 
-    int version_ = 0;
+    std::atomic_int version_;
 
     bool bEscape = false; // escape sequence processing mode
     int ESC_idx = 0;      // current index for ESC_code
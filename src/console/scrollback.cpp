@@ -0,0 +1,175 @@
+#include <algorithm>
+#include <functional>
+
+#include "src/data/lz_codec.h"
+#include "src/console/scrollback.h"
+
+namespace dexpert {
+
+namespace {
+    const size_t kCHUNK_SIZE = 64 * 1024;
+}  // unnamed namespace
+
+ScrollbackStore::ScrollbackStore(size_t memory_limit) : memory_limit_(memory_limit) {
+    open_.first_line = 0;
+    open_.original_size = 0;
+}
+
+void ScrollbackStore::setMemoryLimit(size_t memory_limit) {
+    std::unique_lock<std::mutex> lk(mtx_);
+    memory_limit_ = memory_limit;
+    enforceLimit();
+}
+
+void ScrollbackStore::append(const char *text, size_t size) {
+    std::unique_lock<std::mutex> lk(mtx_);
+    open_text_.append(text, size);
+    open_text_ += '\n';
+    open_.line_ends.push_back(open_text_.size() - 1);
+    total_size_ += size + 1;
+    if (open_text_.size() >= kCHUNK_SIZE) {
+        seal();
+        enforceLimit();
+    }
+}
+
+void ScrollbackStore::seal() {
+    if (open_.line_ends.empty()) {
+        return;
+    }
+    size_t next_line = open_.first_line + open_.line_ends.size();
+    open_.original_size = open_text_.size();
+    open_.compressed = lz_compress(open_text_.c_str(), open_text_.size());
+    memory_usage_ += open_.compressed.size() + open_.line_ends.size() * sizeof(uint32_t);
+    chunks_.push_back(chunk_t());
+    std::swap(chunks_.back(), open_);
+    open_.first_line = next_line;
+    open_.original_size = 0;
+    open_text_.clear();
+}
+
+void ScrollbackStore::enforceLimit() {
+    while (!chunks_.empty() && memory_usage_ + open_text_.size() > memory_limit_) {
+        const chunk_t & c = chunks_.front();
+        memory_usage_ -= c.compressed.size() + c.line_ends.size() * sizeof(uint32_t);
+        total_size_ -= c.original_size;
+        if (cached_first_line_ == c.first_line) {
+            cached_first_line_ = (size_t) -1;
+            cached_text_.clear();
+        }
+        chunks_.pop_front();
+    }
+}
+
+size_t ScrollbackStore::firstLine() {
+    std::unique_lock<std::mutex> lk(mtx_);
+    return chunks_.empty() ? open_.first_line : chunks_.front().first_line;
+}
+
+size_t ScrollbackStore::endLine() {
+    std::unique_lock<std::mutex> lk(mtx_);
+    return open_.first_line + open_.line_ends.size();
+}
+
+size_t ScrollbackStore::size() {
+    std::unique_lock<std::mutex> lk(mtx_);
+    return total_size_;
+}
+
+size_t ScrollbackStore::memoryUsage() {
+    std::unique_lock<std::mutex> lk(mtx_);
+    return memory_usage_ + open_text_.size();
+}
+
+bool ScrollbackStore::contents(size_t chunk_index, const std::string **text) {
+    if (chunk_index >= chunks_.size()) {
+        *text = &open_text_;
+        return true;
+    }
+    const chunk_t & c = chunks_[chunk_index];
+    if (cached_first_line_ != c.first_line) {
+        if (!lz_decompress(c.compressed, cached_text_, c.original_size)) {
+            cached_first_line_ = (size_t) -1;
+            return false;
+        }
+        cached_first_line_ = c.first_line;
+    }
+    *text = &cached_text_;
+    return true;
+}
+
+bool ScrollbackStore::line(size_t index, std::string &text) {
+    std::unique_lock<std::mutex> lk(mtx_);
+    text.clear();
+    size_t chunk_index = chunks_.size();
+    const chunk_t *c = &open_;
+    if (index < open_.first_line) {
+        // binary search for the chunk containing the line
+        auto it = std::upper_bound(chunks_.begin(), chunks_.end(), index, [] (size_t value, const chunk_t & chunk) {
+            return value < chunk.first_line;
+        });
+        if (it == chunks_.begin()) {
+            return false;  // discarded
+        }
+        --it;
+        chunk_index = it - chunks_.begin();
+        c = &(*it);
+    }
+    size_t k = index - c->first_line;
+    if (k >= c->line_ends.size()) {
+        return false;
+    }
+    const std::string *data = NULL;
+    if (!contents(chunk_index, &data)) {
+        return false;
+    }
+    size_t begin = k == 0 ? 0 : c->line_ends[k - 1] + 1;
+    text.assign(data->c_str() + begin, c->line_ends[k] - begin);
+    return true;
+}
+
+int64_t ScrollbackStore::find(const std::string& text, size_t from_line) {
+    std::unique_lock<std::mutex> lk(mtx_);
+    if (text.empty()) {
+        return -1;
+    }
+    std::boyer_moore_horspool_searcher<std::string::const_iterator> searcher(text.begin(), text.end());
+    for (size_t i = 0; i <= chunks_.size(); ++i) {
+        const chunk_t & c = i < chunks_.size() ? chunks_[i] : open_;
+        size_t chunk_end = c.first_line + c.line_ends.size();
+        if (chunk_end <= from_line) {
+            continue;
+        }
+        const std::string *data = NULL;
+        if (!contents(i, &data)) {
+            continue;
+        }
+        size_t start = 0;
+        if (from_line > c.first_line) {
+            start = c.line_ends[from_line - c.first_line - 1] + 1;
+        }
+        auto found = std::search(data->cbegin() + start, data->cend(), searcher);
+        if (found == data->cend()) {
+            continue;
+        }
+        size_t pos = found - data->cbegin();
+        auto line_end = std::lower_bound(c.line_ends.begin(), c.line_ends.end(), (uint32_t) pos);
+        return c.first_line + (line_end - c.line_ends.begin());
+    }
+    return -1;
+}
+
+void ScrollbackStore::read(scrollback_reader_t reader) {
+    std::unique_lock<std::mutex> lk(mtx_);
+    std::string text;
+    for (const auto & c : chunks_) {
+        if (lz_decompress(c.compressed, text, c.original_size)) {
+            reader(text.c_str(), text.size());
+        }
+    }
+    if (!open_text_.empty()) {
+        reader(open_text_.c_str(), open_text_.size());
+    }
+}
+
+}  // namespace dexpert
@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2023 by Rodrigo Antonio de Araujo
+ */
+#ifndef SRC_CONSOLE_SCROLLBACK_H_
+#define SRC_CONSOLE_SCROLLBACK_H_
+
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <functional>
+
+namespace dexpert {
+
+typedef std::function<void(const char *data, size_t size)> scrollback_reader_t;
+
+/*
+    Keeps the lines that scrolled out of the terminal screen.
+    The lines are appended to an open chunk, when the chunk is full it's compressed.
+    The oldest chunks are discarded when the memory limit is reached.
+    Line numbers are absolute (they keep growing when old chunks are discarded).
+*/
+class ScrollbackStore {
+ public:
+    ScrollbackStore(size_t memory_limit);
+    ScrollbackStore (const ScrollbackStore &) = delete;
+    ScrollbackStore & operator = (const ScrollbackStore &) = delete;
+
+    void setMemoryLimit(size_t memory_limit);
+    void append(const char *text, size_t size);
+    size_t firstLine();   // the oldest line we still have
+    size_t endLine();     // one past the latest line
+    // the line without the '\n' (a binary search finds its chunk), false when it was discarded
+    bool line(size_t index, std::string &text);
+    // returns the first line at or after from_line containing the text, -1 if there is none
+    int64_t find(const std::string& text, size_t from_line);
+    // calls reader with the whole contents, one chunk at time ('\n' separated lines)
+    void read(scrollback_reader_t reader);
+    size_t size();        // uncompressed size
+    size_t memoryUsage();
+
+ private:
+    typedef struct {
+        size_t first_line;
+        size_t original_size;
+        std::string compressed;
+        std::vector<uint32_t> line_ends;    // offset of the '\n' of each line
+    } chunk_t;
+
+    void seal();
+    void enforceLimit();
+    bool contents(size_t chunk_index, const std::string **text);
+
+ private:
+    std::mutex mtx_;
+    size_t memory_limit_;
+    size_t memory_usage_ = 0;
+    size_t total_size_ = 0;
+    std::deque<chunk_t> chunks_;
+    chunk_t open_;
+    std::string open_text_;
+    // the latest decompressed chunk, the gui usually reads neighbor lines
+    size_t cached_first_line_ = (size_t) -1;
+    std::string cached_text_;
+};
+
+}  // namespace dexpert
+
+#endif  // SRC_CONSOLE_SCROLLBACK_H_
@@ -1,10 +1,13 @@
 #include <stdio.h>
+#include <algorithm>
 
 #include <GL/gl.h>
 #include <FL/Fl.H>
 #include <FL/gl.h>
 
 #include "src/opengl_utils/routines.h"
+#include "src/opengl_utils/frame_scheduler.h"
+#include "src/data/tracing.h"
 #include "src/config/config.h"
 #include "src/dialogs/utils.h"
 #include "src/dialogs/common_dialogs.h"
@@ -18,6 +21,13 @@ namespace dexpert
     namespace 
     {
         float color_step = 1.0 / 255;
+        // the upscaler receives tiles of this size (source pixels), the memory does not grow with the image
+        const int kUPSCALE_TILE_SIZE = 512;
+        const int kUPSCALE_TILE_OVERLAP = 32;
+        // face restoration windows of the upscaled image: at most 2048 x 2048 (a tile upscaled 4x),
+        // faces up to about 512 pixels wide are restored whole
+        const int kRESTORE_WINDOW_CORE = 1024;
+        const int kRESTORE_WINDOW_MARGIN = 512;
     } // namespace 
     
     namespace {
@@ -48,7 +58,6 @@ namespace dexpert
         vp_[2] = this->w();
         vp_[3] = this->h();
         valid(0);
-        Fl::add_timeout(0.01, ImagePanel::imageRefresh, this);
         for (int i = 0; i < image_type_count; ++i) {
             image_visible_[i] = true;
         }  
@@ -56,16 +65,20 @@ namespace dexpert
 
     ImagePanel::~ImagePanel()
     {
-        Fl::remove_timeout(ImagePanel::imageRefresh, this);
+        cancel_frame(this);
     }
 
     void ImagePanel::imageRefresh(void *cbdata) {
         ((ImagePanel *) cbdata)->imageRefresh();
-        Fl::repeat_timeout(0.018, ImagePanel::imageRefresh, cbdata); // retrigger timeout
+    }
+
+    void ImagePanel::scheduleFrame() {
+        schedule_frame(ImagePanel::imageRefresh, this);
     }
 
     void ImagePanel::imageRefresh() {
         if (!visible_r()) {
+            // the flags stay set, FL_SHOW schedules the frame again
             return;
         }
 
@@ -108,6 +121,15 @@ namespace dexpert
     }
 
     void ImagePanel::setLayerImage(image_type_t layer, image_ptr_t image)
+    {
+        replaceLayer(layer, image);
+        invalidate_caches();
+        adjustSizes();
+        commitHistory();
+        scrollAgain();
+    }
+
+    void ImagePanel::previewLayerImage(image_type_t layer, image_ptr_t image)
     {
         images_[layer] = image;
         invalidate_caches();
@@ -151,7 +173,8 @@ namespace dexpert
             int w = s2.x - s1.x;
             int h = s2.y - s1.y;
             if (w > 0 && h > 0) {
-                images_[image_type_paste] = img->resizeCanvas(w, h);
+                replaceLayer(image_type_paste, img->resizeCanvas(w, h));
+                commitHistory();
                 paste_coords_.x = s1.x;
                 paste_coords_.y = s1.y;
                 setScroll(scroll_x_, scroll_y_);
@@ -215,6 +238,7 @@ namespace dexpert
     void ImagePanel::applyBrush(int mousex, int mousey, bool clear) {
         getMouseXY(&mousex, &mousey);
         RawImage *img = NULL;
+        int layer = image_type_image;
 
         uint8_t color[4] = { 0, 0, 0, 0};
         uint8_t bgcolor[4] = {255, 255, 255, 255};
@@ -228,12 +252,15 @@ namespace dexpert
             color[2] = brush_color_[2];
             valid_caches_[image_type_paste] = false;
             valid_caches_[image_type_image] = false;
-            img = images_[edit_type_paste ? image_type_paste : image_type_image].get();
+            layer = edit_type_paste ? image_type_paste : image_type_image;
+            img = images_[layer].get();
         } else if (edit_type_ == edit_type_mask) { 
-            img = images_[image_type_mask].get();
+            layer = image_type_mask;
+            img = images_[layer].get();
             valid_caches_[image_type_mask] = false;
         } else if (edit_type_ == edit_type_controlnet) { 
-            img = images_[image_type_controlnet].get();
+            layer = image_type_controlnet;
+            img = images_[layer].get();
             valid_caches_[image_type_controlnet] = false;
             if (controlnet_image_type_ == controlnet_segmentation) {
                 color[0] = brush_color_[0];
@@ -248,8 +275,17 @@ namespace dexpert
         }
 
         if (Fl::event_shift() != 0 && images_[image_type_image].get() != NULL && edit_type_ == edit_type_mask) {
+            if (history_) {
+                history_->touchAll(layer, images_[layer]);
+            }
             img->fillWithMask(mousex, mousey, images_[image_type_image].get());
         } else {
+            if (history_) {
+                // drawCircleColor keeps the center inside the image
+                int cx = std::max(0, std::min<int>(mousex, img->w() - 1));
+                int cy = std::max(0, std::min<int>(mousey, img->h() - 1));
+                history_->touch(layer, images_[layer], cx - brush_size_, cy - brush_size_, brush_size_ * 2 + 1, brush_size_ * 2 + 1);
+            }
             img->drawCircleColor(mousex, mousey, brush_size_, color, bgcolor, clear);
         }
 
@@ -260,6 +296,7 @@ namespace dexpert
         current_x_ = move_x;
         current_y_ = move_y;
         mouse_changed_ = true;
+        scheduleFrame();
 
         auto ref = getReferenceImage();
         if (!ref) {
@@ -318,6 +355,14 @@ namespace dexpert
         current_x_ = up_x;
         current_y_ = up_y;
         mouse_changed_ = true;
+        scheduleFrame();
+
+        if (drawing_changed_) {
+            drawing_changed_ = false;
+            applyBrush(draw_x_, draw_y_, drawing_clear_);
+        }
+        // a brush stroke is one undo step
+        commitHistory();
 
         if (isDragging()) {
             return;
@@ -347,6 +392,7 @@ namespace dexpert
             scheduleRedraw();
         } else {
             clicked_ = true;
+            scheduleFrame();
         }
     };
 
@@ -360,13 +406,15 @@ namespace dexpert
 
     void ImagePanel::scheduleRedraw() {
         should_redraw_ = true;
+        scheduleFrame();
     }
 
     void ImagePanel::open(image_type_t layer) {
         auto img = open_image_from_dialog();
         if (img) {
-            images_[layer] = img;
+            replaceLayer(layer, img);
             adjustSizes();
+            commitHistory();
             scrollAgain();
         }
     }
@@ -381,7 +429,8 @@ namespace dexpert
     }
 
     void ImagePanel::clearPasteImage() {
-        images_[image_type_paste].reset();
+        replaceLayer(image_type_paste, image_ptr_t());
+        commitHistory();
         paste_coords_.x = 0;
         paste_coords_.y = 0;
         scrollAgain();
@@ -391,8 +440,13 @@ namespace dexpert
         if (!images_[image_type_paste] || !images_[image_type_image]) {
             return;
         }
+        if (history_) {
+            auto paste = images_[image_type_paste];
+            history_->touch(image_type_image, images_[image_type_image], paste_coords_.x, paste_coords_.y, paste->w(), paste->h());
+        }
         images_[image_type_image]->pasteAt(paste_coords_.x, paste_coords_.y, images_[image_type_paste].get());
-        images_[image_type_paste].reset();
+        replaceLayer(image_type_paste, image_ptr_t());
+        commitHistory();
         paste_coords_.x = 0;
         paste_coords_.y = 0;
         noSelection();
@@ -403,9 +457,29 @@ namespace dexpert
     {
         switch (event)
         {
+        case FL_SHOW: {
+            // the changes made while the panel was hidden
+            if (should_redraw_ || mouse_changed_ || drawing_changed_) {
+                scheduleFrame();
+            }
+            return Fl_Gl_Window::handle(event);
+        }
+        break;
+
         case FL_KEYUP:
         case FL_KEYDOWN:
         {
+            if (event == FL_KEYDOWN && history_ && Fl::event_command() != 0) {
+                int key = Fl::event_key();
+                if (key == 'z' && Fl::event_shift() == 0) {
+                    undo();
+                    return 1;
+                }
+                if (key == 'y' || (key == 'z' && Fl::event_shift() != 0)) {
+                    redo();
+                    return 1;
+                }
+            }
             return Fl_Gl_Window::handle(event);
         }
         break;
@@ -495,10 +569,64 @@ namespace dexpert
         mask_panel_ = mask_panel;
     }
 
+    void ImagePanel::enableHistory() {
+        if (!history_) {
+            size_t budget = (size_t) getConfig().getUndoHistoryMB() * 1024 * 1024;
+            history_.reset(new UndoHistory(budget, budget * 4));
+        }
+    }
+
+    void ImagePanel::replaceLayer(int layer, image_ptr_t image) {
+        if (history_ && images_[layer] != image) {
+            history_->replace(layer, images_[layer]);
+        }
+        images_[layer] = image;
+    }
+
+    void ImagePanel::commitHistory() {
+        if (history_) {
+            history_->commit();
+        }
+    }
+
+    void ImagePanel::undo() {
+        if (history_ && history_->undo(images_)) {
+            historyChanged();
+        }
+    }
+
+    void ImagePanel::redo() {
+        if (history_ && history_->redo(images_)) {
+            historyChanged();
+        }
+    }
+
+    bool ImagePanel::canUndo() {
+        return history_ && history_->canUndo();
+    }
+
+    bool ImagePanel::canRedo() {
+        return history_ && history_->canRedo();
+    }
+
+    void ImagePanel::historyChanged() {
+        invalidate_caches();
+        if (images_[image_type_paste] == NULL) {
+            paste_coords_.x = 0;
+            paste_coords_.y = 0;
+        }
+        if (on_change_) {
+            on_change_();
+        }
+        scrollAgain();
+        scheduleRedraw();
+    }
+
     RawImage* ImagePanel::get_cached_image(int layer) {
         /*
             Dim the image to fit the window. Don't draw a huge image in a smaller area...
         */
+        TRACE_SCOPE("ImagePanel::get_cached_image");
         RawImage *original = images_[layer].get();
         if (mask_panel_ != NULL && layer == image_type_mask && mask_panel_->image_visible_[layer]) {
             original = mask_panel_->images_[layer].get();
@@ -559,6 +687,7 @@ namespace dexpert
 
     void ImagePanel::draw()
     {
+        TRACE_SCOPE("ImagePanel::draw");
         if (!valid())
         {
             valid(1);
@@ -690,9 +819,10 @@ namespace dexpert
         }
         for (int i = 0; i < image_type_count; i++) {
             if (images_[i]) {
-                images_[i] = images_[i]->resizeCanvas(w, h);
+                replaceLayer(i, images_[i]->resizeCanvas(w, h));
             }
         }
+        commitHistory();
         scrollAgain();
     }
 
@@ -703,9 +833,10 @@ namespace dexpert
         }
         for (int i = 0; i < image_type_count; i++) {
             if (images_[i]) {
-                images_[i] = images_[i]->resizeImage(w, h);
+                replaceLayer(i, images_[i]->resizeImage(w, h));
             }
         }
+        commitHistory();
         scrollAgain();
     }
 
@@ -716,9 +847,10 @@ namespace dexpert
         }
         for (int i = 0; i < image_type_count; i++) {
             if (images_[i]) {
-                images_[i] = images_[i]->resizeLeft(value);
+                replaceLayer(i, images_[i]->resizeLeft(value));
             }
         }
+        commitHistory();
         auto img = getReferenceImage();
         if (img) {
             selection_start_.x = 0;
@@ -737,9 +869,10 @@ namespace dexpert
         }
         for (int i = 0; i < image_type_count; i++) {
             if (images_[i]) {
-                images_[i] = images_[i]->resizeRight(value);
+                replaceLayer(i, images_[i]->resizeRight(value));
             }
         }
+        commitHistory();
         auto img = getReferenceImage();
         if (img) {
             selection_start_.x = img->w() - value* 2;
@@ -758,9 +891,10 @@ namespace dexpert
         }
         for (int i = 0; i < image_type_count; i++) {
             if (images_[i]) {
-                images_[i] = images_[i]->resizeBottom(value);
+                replaceLayer(i, images_[i]->resizeBottom(value));
             }
         }
+        commitHistory();
         auto img = getReferenceImage();
         if (img) {
             selection_start_.x = 0;
@@ -779,9 +913,10 @@ namespace dexpert
         }
         for (int i = 0; i < image_type_count; i++) {
             if (images_[i]) {
-                images_[i] = images_[i]->resizeTop(value);
+                replaceLayer(i, images_[i]->resizeTop(value));
             }
         }
+        commitHistory();
         auto img = getReferenceImage();
         if (img) {
             selection_start_.x = 0;
@@ -836,6 +971,7 @@ namespace dexpert
     }
 
     void ImagePanel::draw_buffer(RawImage *img) {
+        TRACE_SCOPE("ImagePanel::draw_buffer");
         auto ref = getReferenceImage();
 
         if (!img || !ref) {
@@ -1078,6 +1214,9 @@ namespace dexpert
         for (int i = 0; i < image_type_count; i++) {
             images_[i].reset();
         }
+        if (history_) {
+            history_->clear();
+        }
         noSelection();
         setZoomLevel(1.0);
         images_[image_type_image].reset(new RawImage(NULL, w, h, dexpert::py::img_rgba, false));
@@ -1090,22 +1229,51 @@ namespace dexpert
             return;
         }
 
-        dexpert::py::get_py()->execute_callback(dexpert::py::upscale_image(img, scale, weight,
-            [this] (bool success, const char *message, std::shared_ptr<RawImage> image) {
+        image_ptr_t result;
+        std::string error;
+        auto tiles = plan_tiles(img->w(), img->h(), kUPSCALE_TILE_SIZE, kUPSCALE_TILE_SIZE, kUPSCALE_TILE_OVERLAP);
+        // the tiles are stitched in a worker thread while python upscales the next ones
+        TileStitcher stitcher(img->w(), img->h(), scale, kUPSCALE_TILE_OVERLAP, seam_cosine);
+        dexpert::py::get_py()->execute_callback(dexpert::py::upscale_tiles(img, scale, tiles,
+            [&stitcher, &error] (const tile_rect_t& tile, bool success, const char *message, std::shared_ptr<RawImage> image) {
                 if (!success) {
-                    show_error(message);
+                    error = message;
                 } else if (image) {
-                    images_[image_type_image] = image;
+                    stitcher.add(tile, image);
                 } else {
-                    show_error("Unknown error, upscaler fail. No image was returned");
+                    error = "Unknown error, upscaler fail. No image was returned";
                 }
+                return error.empty();
         }));
+        result = stitcher.finish();
+        if (error.empty() && !result) {
+            error = stitcher.lastError();
+        }
+        if (error.empty() && result) {
+            // the faces are restored after the stitching, a face over a seam would be restored twice
+            auto windows = plan_restore_windows(result->w(), result->h(), kRESTORE_WINDOW_CORE, kRESTORE_WINDOW_MARGIN);
+            dexpert::py::get_py()->execute_callback(dexpert::py::restore_faces(result.get(), weight, windows,
+                [&error] (bool success, const char *message) {
+                    if (!success) {
+                        error = message ? message : "Unknown error, face restoration fail";
+                    }
+            }));
+        }
+        if (!error.empty()) {
+            show_error(error.c_str());
+            result.reset();
+        }
 
+        // the history is updated at the gui thread
+        if (result) {
+            replaceLayer(image_type_image, result);
+        }
         for (int i = 0; i < image_type_count; i++) {
             if (i != image_type_image) {
-                images_[i].reset();
+                replaceLayer(i, image_ptr_t());
             }
         }
+        commitHistory();
 
         scrollAgain();
     }
@@ -1136,10 +1304,11 @@ namespace dexpert
         }
         for (int i = 0; i < image_type_count; i++) {
             if (i != image_type_image) {
-                images_[i].reset();
+                replaceLayer(i, image_ptr_t());
             }
         }
-        images_[image_type_image] = img;
+        replaceLayer(image_type_image, img);
+        commitHistory();
         noSelection();
         scrollAgain();
     }
@@ -1207,6 +1376,9 @@ namespace dexpert
         for (int i = 0; i < image_type_count; i++) {
             images_[i].reset();
         }
+        if (history_) {
+            history_->clear();
+        }
         scheduleRedraw();
     }
 
@@ -1229,7 +1401,7 @@ namespace dexpert
             if (!target || (target->w() == img->w() && target->h() == img->h())) {
                 continue;
             }
-            images_[i] = target->resizeInTheCenter(img->w(), img->h());
+            replaceLayer(i, target->resizeInTheCenter(img->w(), img->h()));
             valid_caches_[i] = false;
         }
     }
@@ -1241,7 +1413,8 @@ namespace dexpert
         }
         RawImage *target = images_[image_type_paste].get();
         if (target) {
-            images_[image_type_paste] = target->resizeInTheCenter(img->w(), img->h());
+            replaceLayer(image_type_paste, target->resizeInTheCenter(img->w(), img->h()));
+            commitHistory();
             valid_caches_[image_type_paste] = false;
             valid_caches_[image_type_image] = false;
         }
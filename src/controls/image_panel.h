@@ -2,11 +2,13 @@
 #define SRC_CONTROLS_IMAGE_PANEL_H
 
 #include <functional>
+#include <memory>
 
 #include <FL/Fl_Gl_Window.H>
 
 #include "src/opengl_utils/view_port.h"
 #include "src/python/raw_image.h"
+#include "src/controls/undo_history.h"
 
 typedef enum {
   image_type_image,         // the final image
@@ -75,6 +77,8 @@ namespace dexpert
         bool getLayerVisible(image_type_t layer);
         void setLayerEditable(image_type_t layer, bool visible);
         void setLayerImage(image_type_t layer, image_ptr_t image);
+        // replaces the layer without an undo step (a preview), the step that set the previous image undoes it
+        void previewLayerImage(image_type_t layer, image_ptr_t image);
         RawImage* getLayerImage(image_type_t layer);
         image_ptr_t getSelectedImage(image_type_t layer);
         void setPasteImageAtSelection(image_type_t layer, RawImage *img);
@@ -127,6 +131,12 @@ namespace dexpert
         void scheduleRedraw();
         void zoomFit();
         void setMaskPanel(ImagePanel *mask_panel);
+        // the panels the user edits keep an undo history (ctrl+z, ctrl+y)
+        void enableHistory();
+        void undo();
+        void redo();
+        bool canUndo();
+        bool canRedo();
 
     protected:
         int handle(int event) override;
@@ -148,6 +158,7 @@ namespace dexpert
     private:
         static void imageRefresh(void *cbdata);
         void imageRefresh();
+        void scheduleFrame();
         void draw_tool();
         void adjustSizes();
 
@@ -162,9 +173,13 @@ namespace dexpert
         void convertToImageCoords(int *x, int *y);
         void convertToScreenCoords(int *x, int *y);
         void applyBrush(int mousex, int mousey, bool clear);
+        void replaceLayer(int layer, image_ptr_t image);
+        void commitHistory();
+        void historyChanged();
         
     private:
         ImagePanel *mask_panel_ = NULL;
+        std::unique_ptr<UndoHistory> history_;
         callback_t on_change_;
         image_tool_t tool_ = image_tool_none;
         bool mouse_changed_ = false;
@@ -0,0 +1,457 @@
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <filesystem>
+#include <iterator>
+
+#include "src/data/lz_codec.h"
+#include "src/controls/undo_history.h"
+
+namespace dexpert
+{
+
+namespace {
+    const int kTILE_SIZE = 64;
+    size_t spill_file_count = 0;
+
+    std::string xor_buffers(const std::string& a, const std::string& b) {
+        std::string result(a.size(), '\0');
+        for (size_t i = 0; i < a.size(); ++i) {
+            result[i] = a[i] ^ b[i];
+        }
+        return result;
+    }
+
+    size_t format_channels(py::image_format_t format) {
+        switch (format) {
+            case py::img_gray_8bit:
+                return 1;
+            case py::img_rgb:
+                return 3;
+            default:
+                return 4;
+        }
+    }
+
+    bool all_zero(const std::string& data) {
+        for (char c : data) {
+            if (c) {
+                return false;
+            }
+        }
+        return true;
+    }
+}  // unnamed namespace
+
+UndoHistory::UndoHistory(size_t memory_budget, size_t disk_budget) : memory_budget_(memory_budget), disk_budget_(disk_budget) {
+}
+
+UndoHistory::~UndoHistory() {
+    if (spill_.is_open()) {
+        spill_.close();
+        std::error_code ec;
+        std::filesystem::remove(std::filesystem::u8path(spill_path_), ec);
+    }
+}
+
+void UndoHistory::touch(int layer, image_ptr_t image, int x, int y, int w, int h) {
+    if (!image) {
+        return;
+    }
+    int x2 = std::min<int>(x + w, image->w());
+    int y2 = std::min<int>(y + h, image->h());
+    x = std::max(x, 0);
+    y = std::max(y, 0);
+    if (x2 <= x || y2 <= y) {
+        return;
+    }
+    const size_t tiles_x = (image->w() + kTILE_SIZE - 1) / kTILE_SIZE;
+    for (int ty = y / kTILE_SIZE; ty <= (y2 - 1) / kTILE_SIZE; ++ty) {
+        for (int tx = x / kTILE_SIZE; tx <= (x2 - 1) / kTILE_SIZE; ++tx) {
+            auto key = std::make_pair(layer, ty * tiles_x + tx);
+            if (pending_tiles_.find(key) != pending_tiles_.end()) {
+                continue;   // keeps the pixels from the operation start
+            }
+            pending_tile_t tile;
+            tile.image = image;
+            tile.x = tx * kTILE_SIZE;
+            tile.y = ty * kTILE_SIZE;
+            tile.w = std::min<int>(kTILE_SIZE, image->w() - tile.x);
+            tile.h = std::min<int>(kTILE_SIZE, image->h() - tile.y);
+            tile.before.resize((size_t) tile.w * tile.h * image->channels());
+            image->getPixels(tile.x, tile.y, tile.w, tile.h, (unsigned char *) &tile.before[0]);
+            pending_tiles_[key] = std::move(tile);
+        }
+    }
+}
+
+void UndoHistory::touchAll(int layer, image_ptr_t image) {
+    if (image) {
+        touch(layer, image, 0, 0, image->w(), image->h());
+    }
+}
+
+void UndoHistory::flushTiles(int layer) {
+    for (auto it = pending_tiles_.begin(); it != pending_tiles_.end();) {
+        if (layer >= 0 && it->first.first != layer) {
+            ++it;
+            continue;
+        }
+        auto & tile = it->second;
+        std::string after(tile.before.size(), '\0');
+        tile.image->getPixels(tile.x, tile.y, tile.w, tile.h, (unsigned char *) &after[0]);
+        auto delta = xor_buffers(tile.before, after);
+        if (!all_zero(delta)) {
+            undo_record_t record;
+            record.layer = it->first.first;
+            record.x = tile.x;
+            record.y = tile.y;
+            record.w = tile.w;
+            record.h = tile.h;
+            store(record.blob, lz_compress(delta.c_str(), delta.size()));
+            pending_.push_back(std::move(record));
+        }
+        it = pending_tiles_.erase(it);
+    }
+}
+
+void UndoHistory::replace(int layer, image_ptr_t image) {
+    // the tiles changed before the replacement belong to the old image
+    flushTiles(layer);
+    undo_record_t record;
+    record.layer = layer;
+    record.replace = true;
+    record.empty = !image;
+    if (image) {
+        record.image_w = image->w();
+        record.image_h = image->h();
+        record.format = image->format();
+        size_t size = (size_t) image->w() * image->h() * image->channels();
+        store(record.blob, lz_compress((const char *) image->buffer(), size));
+    }
+    pending_.push_back(std::move(record));
+}
+
+void UndoHistory::commit() {
+    flushTiles(-1);
+    if (pending_.empty()) {
+        return;
+    }
+    undo_.push_back(std::move(pending_));
+    pending_.clear();
+    for (auto & step : redo_) {
+        release(step);
+    }
+    redo_.clear();
+    enforceBudget();
+}
+
+bool UndoHistory::undo(image_ptr_t *layers) {
+    commit();
+    if (undo_.empty()) {
+        return false;
+    }
+    auto step = std::move(undo_.back());
+    undo_.pop_back();
+    if (!unspill(step)) {
+        // the older steps start from the pixels this step should restore
+        fprintf(stderr, "Could not read the undo history, the older steps were dropped\n");
+        release(step);
+        for (auto & older : undo_) {
+            release(older);
+        }
+        undo_.clear();
+        enforceBudget();
+        return false;
+    }
+    apply(step, true, layers);
+    redo_.push_back(std::move(step));
+    enforceBudget();
+    return true;
+}
+
+bool UndoHistory::redo(image_ptr_t *layers) {
+    commit();
+    if (redo_.empty()) {
+        return false;
+    }
+    auto step = std::move(redo_.back());
+    redo_.pop_back();
+    if (!unspill(step)) {
+        // the newer steps start from the pixels this step should restore
+        fprintf(stderr, "Could not read the redo history, the newer steps were dropped\n");
+        release(step);
+        for (auto & newer : redo_) {
+            release(newer);
+        }
+        redo_.clear();
+        enforceBudget();
+        return false;
+    }
+    apply(step, false, layers);
+    undo_.push_back(std::move(step));
+    enforceBudget();
+    return true;
+}
+
+bool UndoHistory::canUndo() {
+    return !undo_.empty() || !pending_.empty() || !pending_tiles_.empty();
+}
+
+bool UndoHistory::canRedo() {
+    return !redo_.empty();
+}
+
+void UndoHistory::clear() {
+    pending_tiles_.clear();
+    release(pending_);
+    pending_.clear();
+    for (auto & step : undo_) {
+        release(step);
+    }
+    for (auto & step : redo_) {
+        release(step);
+    }
+    undo_.clear();
+    redo_.clear();
+    resetSpillFile();
+}
+
+undo_stats_t UndoHistory::stats() {
+    undo_stats_t result;
+    result.undo_steps = undo_.size();
+    result.redo_steps = redo_.size();
+    result.memory_bytes = memory_bytes_;
+    result.disk_bytes = disk_bytes_;
+    return result;
+}
+
+void UndoHistory::apply(undo_step_t& step, bool reverse, image_ptr_t *layers) {
+    for (size_t i = 0; i < step.size(); ++i) {
+        auto & record = step[reverse ? step.size() - i - 1 : i];
+        if (record.replace) {
+            applyReplace(record, layers);
+        } else {
+            applyTile(record, layers);
+        }
+    }
+}
+
+void UndoHistory::applyTile(undo_record_t& record, image_ptr_t *layers) {
+    auto image = layers[record.layer];
+    if (!image || record.x + record.w > (int) image->w() || record.y + record.h > (int) image->h()) {
+        return;
+    }
+    std::string compressed;
+    std::string delta;
+    if (!load(record.blob, &compressed) || !lz_decompress(compressed, delta, (size_t) record.w * record.h * image->channels())) {
+        return;
+    }
+    std::string pixels(delta.size(), '\0');
+    image->getPixels(record.x, record.y, record.w, record.h, (unsigned char *) &pixels[0]);
+    pixels = xor_buffers(pixels, delta);
+    image->setPixels(record.x, record.y, record.w, record.h, (const unsigned char *) pixels.c_str());
+}
+
+void UndoHistory::applyReplace(undo_record_t& record, image_ptr_t *layers) {
+    image_ptr_t other;
+    if (!record.empty) {
+        std::string compressed;
+        std::string buffer;
+        size_t size = (size_t) record.image_w * record.image_h * format_channels(record.format);
+        if (!load(record.blob, &compressed) || !lz_decompress(compressed, buffer, size)) {
+            return;
+        }
+        other.reset(new RawImage((const unsigned char *) buffer.c_str(), record.image_w, record.image_h, record.format));
+    }
+
+    // the record keeps the current image, so applying it again goes back
+    auto current = layers[record.layer];
+    release(record.blob);
+    record.empty = !current;
+    if (current) {
+        record.image_w = current->w();
+        record.image_h = current->h();
+        record.format = current->format();
+        size_t size = (size_t) current->w() * current->h() * current->channels();
+        store(record.blob, lz_compress((const char *) current->buffer(), size));
+    }
+    layers[record.layer] = other;
+}
+
+void UndoHistory::store(undo_blob_t& blob, std::string&& data) {
+    blob.size = data.size();
+    blob.data = std::move(data);
+    blob.spilled = false;
+    memory_bytes_ += blob.size;
+}
+
+bool UndoHistory::load(undo_blob_t& blob, std::string *data) {
+    if (!blob.spilled) {
+        *data = blob.data;
+        return true;
+    }
+    data->assign(blob.size, '\0');
+    spill_.clear();
+    spill_.seekg(blob.offset);
+    spill_.read(&(*data)[0], blob.size);
+    return (size_t) spill_.gcount() == blob.size;
+}
+
+bool UndoHistory::unspill(undo_step_t& step) {
+    // the whole step is read before it changes a pixel, it is never applied halfway
+    for (auto & record : step) {
+        auto & blob = record.blob;
+        if (!blob.spilled) {
+            continue;
+        }
+        std::string data;
+        if (!load(blob, &data)) {
+            return false;
+        }
+        disk_bytes_ -= blob.size;
+        freeSpill(blob.offset, blob.size);
+        blob.spilled = false;
+        blob.data = std::move(data);
+        memory_bytes_ += blob.size;
+    }
+    return true;
+}
+
+void UndoHistory::release(undo_blob_t& blob) {
+    if (blob.spilled) {
+        disk_bytes_ -= blob.size;
+        freeSpill(blob.offset, blob.size);
+    } else {
+        memory_bytes_ -= blob.size;
+    }
+    blob = undo_blob_t();
+}
+
+void UndoHistory::release(undo_step_t& step) {
+    for (auto & record : step) {
+        release(record.blob);
+    }
+}
+
+bool UndoHistory::spill(undo_step_t& step) {
+    if (!spill_.is_open()) {
+        char name[64] = "";
+        snprintf(name, sizeof(name), "dexpert-undo-%p-%zu.bin", (void *) this, ++spill_file_count);
+        std::error_code ec;
+        auto path = std::filesystem::temp_directory_path(ec) / name;
+        spill_path_ = path.u8string();
+        spill_.open(path, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+        spill_end_ = 0;
+        spill_free_.clear();
+        if (!spill_.is_open()) {
+            return false;
+        }
+    }
+    for (auto & record : step) {
+        auto & blob = record.blob;
+        if (blob.spilled || blob.size == 0) {
+            continue;
+        }
+        size_t offset = allocateSpill(blob.size);
+        spill_.clear();
+        spill_.seekp(offset);
+        spill_.write(blob.data.c_str(), blob.size);
+        if (!spill_.good()) {
+            freeSpill(offset, blob.size);
+            return false;
+        }
+        blob.offset = offset;
+        blob.spilled = true;
+        std::string().swap(blob.data);
+        memory_bytes_ -= blob.size;
+        disk_bytes_ += blob.size;
+    }
+    return true;
+}
+
+void UndoHistory::enforceBudget() {
+    // the oldest steps go to the disk first, the next step to undo (or redo) stays in memory
+    bool disk_ok = true;
+    for (size_t i = 0; memory_bytes_ > memory_budget_ && disk_ok && i + 1 < undo_.size(); ++i) {
+        disk_ok = spill(undo_[i]);
+    }
+    for (size_t i = 0; memory_bytes_ > memory_budget_ && disk_ok && i + 1 < redo_.size(); ++i) {
+        disk_ok = spill(redo_[i]);
+    }
+    // without disk space the steps farthest from the current image are forgotten, the redo steps first
+    // (the next commit drops them anyway)
+    auto over_budget = [this, disk_ok] {
+        return disk_bytes_ > disk_budget_ || (!disk_ok && memory_bytes_ > memory_budget_);
+    };
+    while (redo_.size() > 1 && over_budget()) {
+        release(redo_.front());
+        redo_.pop_front();
+    }
+    while (undo_.size() > 1 && over_budget()) {
+        release(undo_.front());
+        undo_.pop_front();
+    }
+    if (disk_bytes_ == 0 && spill_end_ > 0) {
+        resetSpillFile();
+    }
+}
+
+size_t UndoHistory::allocateSpill(size_t size) {
+    // the smallest unused range that fits, the end of the file when there is none
+    auto best = spill_free_.end();
+    for (auto it = spill_free_.begin(); it != spill_free_.end(); ++it) {
+        if (it->second >= size && (best == spill_free_.end() || it->second < best->second)) {
+            best = it;
+        }
+    }
+    if (best == spill_free_.end()) {
+        size_t offset = spill_end_;
+        spill_end_ += size;
+        return offset;
+    }
+    size_t offset = best->first;
+    size_t left = best->second - size;
+    spill_free_.erase(best);
+    if (left > 0) {
+        spill_free_[offset + size] = left;
+    }
+    return offset;
+}
+
+void UndoHistory::freeSpill(size_t offset, size_t size) {
+    if (size == 0) {
+        return;
+    }
+    // merges with the unused neighbors
+    auto next = spill_free_.lower_bound(offset);
+    if (next != spill_free_.end() && offset + size == next->first) {
+        size += next->second;
+        next = spill_free_.erase(next);
+    }
+    if (next != spill_free_.begin()) {
+        auto previous = std::prev(next);
+        if (previous->first + previous->second == offset) {
+            offset = previous->first;
+            size += previous->second;
+            spill_free_.erase(previous);
+        }
+    }
+    if (offset + size == spill_end_) {
+        spill_end_ = offset;    // the tail is written again by the next spill
+    } else {
+        spill_free_[offset] = size;
+    }
+}
+
+void UndoHistory::resetSpillFile() {
+    if (!spill_.is_open()) {
+        return;
+    }
+    spill_.close();
+    spill_.open(std::filesystem::u8path(spill_path_), std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+    spill_end_ = 0;
+    spill_free_.clear();
+}
+
+}  // namespace dexpert
@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2023 by Rodrigo Antonio de Araujo
+ */
+#ifndef SRC_CONTROLS_UNDO_HISTORY_H_
+#define SRC_CONTROLS_UNDO_HISTORY_H_
+
+#include <stddef.h>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "src/python/raw_image.h"
+
+namespace dexpert
+{
+
+typedef struct {
+    std::string data;       // lz compressed, empty when it is at the spill file
+    size_t size = 0;        // compressed size
+    size_t offset = 0;      // position at the spill file
+    bool spilled = false;
+} undo_blob_t;
+
+typedef struct {
+    int layer = 0;
+    bool replace = false;   // the whole layer was replaced (resize, crop...), blob has the other image
+    bool empty = false;     // replace: the other image is no image at all
+    int x = 0;              // tile: position and size
+    int y = 0;
+    int w = 0;
+    int h = 0;
+    uint32_t image_w = 0;   // replace: the other image size and format
+    uint32_t image_h = 0;
+    py::image_format_t format = py::img_rgba;
+    undo_blob_t blob;
+} undo_record_t;
+
+typedef std::vector<undo_record_t> undo_step_t;
+
+typedef struct {
+    size_t undo_steps = 0;
+    size_t redo_steps = 0;
+    size_t memory_bytes = 0;
+    size_t disk_bytes = 0;
+} undo_stats_t;
+
+/*
+    Undo history of the image panel layers.
+    A step keeps only the 64x64 tiles an operation changed, as the xor between the pixels before and
+    after it, so the same record undoes and redoes the change. The operations that replace a layer
+    keep the other image instead. Everything is compressed with lz_codec, the oldest steps go to a
+    spill file when the memory budget is over and are dropped when the disk budget is over (the
+    farthest redo steps first). The ranges of the blobs read back or dropped are reused, so the
+    spill file does not grow past the disk budget in a long session.
+    A step that can not be read back from the spill file is dropped with the steps that depend on it.
+*/
+class UndoHistory {
+ public:
+    UndoHistory(size_t memory_budget, size_t disk_budget);
+    ~UndoHistory();
+    UndoHistory (const UndoHistory &) = delete;
+    UndoHistory & operator = (const UndoHistory &) = delete;
+
+    // call before the pixels of the rectangle change (the image keeps its size)
+    void touch(int layer, image_ptr_t image, int x, int y, int w, int h);
+    void touchAll(int layer, image_ptr_t image);
+    // call before the layer points to another image
+    void replace(int layer, image_ptr_t image);
+    // ends the current operation (one undo step)
+    void commit();
+
+    // layers is the image panel layers, the undo/redo replaces and changes them
+    bool undo(image_ptr_t *layers);
+    bool redo(image_ptr_t *layers);
+    bool canUndo();
+    bool canRedo();
+    void clear();
+    undo_stats_t stats();
+
+ private:
+    typedef struct {
+        image_ptr_t image;
+        int x;
+        int y;
+        int w;
+        int h;
+        std::string before;
+    } pending_tile_t;
+
+    void flushTiles(int layer);
+    void release(undo_blob_t& blob);
+    void release(undo_step_t& step);
+    void apply(undo_step_t& step, bool reverse, image_ptr_t *layers);
+    void applyTile(undo_record_t& record, image_ptr_t *layers);
+    void applyReplace(undo_record_t& record, image_ptr_t *layers);
+    bool load(undo_blob_t& blob, std::string *data);
+    bool unspill(undo_step_t& step);
+    void store(undo_blob_t& blob, std::string&& data);
+    void enforceBudget();
+    bool spill(undo_step_t& step);
+    size_t allocateSpill(size_t size);
+    void freeSpill(size_t offset, size_t size);
+    void resetSpillFile();
+
+ private:
+    size_t memory_budget_;
+    size_t disk_budget_;
+    size_t memory_bytes_ = 0;
+    size_t disk_bytes_ = 0;         // live bytes at the spill file
+    size_t spill_end_ = 0;          // end of the last range in use
+    std::map<size_t, size_t> spill_free_;  // offset -> size of the unused ranges before spill_end_
+    std::string spill_path_;
+    std::fstream spill_;
+    std::map<std::pair<int, size_t>, pending_tile_t> pending_tiles_;  // (layer, tile index)
+    undo_step_t pending_;
+    std::deque<undo_step_t> undo_;
+    std::deque<undo_step_t> redo_;
+};
+
+}  // namespace dexpert
+
+#endif  // SRC_CONTROLS_UNDO_HISTORY_H_
@@ -0,0 +1,80 @@
+#include <stdint.h>
+
+#include "src/data/base64.h"
+
+namespace dexpert {
+
+namespace {
+    const char kBASE64_CHARS[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+    int decode_char(char c) {
+        if (c >= 'A' && c <= 'Z') return c - 'A';
+        if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+        if (c >= '0' && c <= '9') return c - '0' + 52;
+        if (c == '+' || c == '-') return 62;
+        if (c == '/' || c == '_') return 63;
+        return -1;
+    }
+}  // unnamed namespace
+
+std::string base64_encode(const char *data, size_t size) {
+    std::string result;
+    result.reserve(((size + 2) / 3) * 4);
+    const uint8_t *p = (const uint8_t *) data;
+    size_t i = 0;
+    for (; i + 2 < size; i += 3) {
+        uint32_t v = (p[i] << 16) | (p[i + 1] << 8) | p[i + 2];
+        result += kBASE64_CHARS[(v >> 18) & 63];
+        result += kBASE64_CHARS[(v >> 12) & 63];
+        result += kBASE64_CHARS[(v >> 6) & 63];
+        result += kBASE64_CHARS[v & 63];
+    }
+    if (i < size) {
+        uint32_t v = p[i] << 16;
+        if (i + 1 < size) {
+            v |= p[i + 1] << 8;
+        }
+        result += kBASE64_CHARS[(v >> 18) & 63];
+        result += kBASE64_CHARS[(v >> 12) & 63];
+        result += i + 1 < size ? kBASE64_CHARS[(v >> 6) & 63] : '=';
+        result += '=';
+    }
+    return result;
+}
+
+bool base64_decode(const std::string& text, std::string& output) {
+    output.clear();
+    size_t start = 0;
+    if (text.compare(0, 5, "data:") == 0) {
+        start = text.find(',');
+        if (start == std::string::npos) {
+            return false;
+        }
+        ++start;
+    }
+    output.reserve((text.size() - start) / 4 * 3);
+    uint32_t buffer = 0;
+    int bits = 0;
+    for (size_t i = start; i < text.size(); ++i) {
+        char c = text[i];
+        if (c == '=') {
+            break;
+        }
+        if (c == ' ' || c == '\n' || c == '\r' || c == '\t') {
+            continue;
+        }
+        int v = decode_char(c);
+        if (v < 0) {
+            return false;
+        }
+        buffer = (buffer << 6) | v;
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            output += (char) ((buffer >> bits) & 0xff);
+        }
+    }
+    return true;
+}
+
+}  // namespace dexpert
@@ -0,0 +1,18 @@
+/*
+ * Copyright (C) 2023 by Rodrigo Antonio de Araujo
+ */
+#ifndef SRC_DATA_BASE64_H_
+#define SRC_DATA_BASE64_H_
+
+#include <stddef.h>
+#include <string>
+
+namespace dexpert {
+
+std::string base64_encode(const char *data, size_t size);
+// accepts data urls (data:image/png;base64,...) and ignores white spaces, returns false on invalid input
+bool base64_decode(const std::string& text, std::string& output);
+
+}  // namespace dexpert
+
+#endif  // SRC_DATA_BASE64_H_
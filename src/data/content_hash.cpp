@@ -0,0 +1,268 @@
+#include <string.h>
+
+// CONTENT_HASH_SCALAR builds the portable path (the tests check both paths give the same digests)
+#if (defined(__SSE2__) || defined(_M_X64)) && !defined(CONTENT_HASH_SCALAR)
+#include <emmintrin.h>
+#define CONTENT_HASH_SSE2
+#endif
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#endif
+
+#include "src/data/content_hash.h"
+
+namespace dexpert {
+
+namespace {
+    const uint64_t kPRIME1 = 11400714785074694791ULL;
+    const uint64_t kPRIME2 = 14029467366897019727ULL;
+    const uint64_t kPRIME3 = 1609587929392839161ULL;
+    const uint64_t kPRIME4 = 9650029242287828579ULL;
+    const uint64_t kPRIME5 = 2870177450012600261ULL;
+
+    inline uint64_t rotl(uint64_t value, int bits) {
+        return (value << bits) | (value >> (64 - bits));
+    }
+
+    inline uint64_t read64(const uint8_t *p) {
+        uint64_t value;
+        memcpy(&value, p, sizeof(value));  // little endian hosts only (windows/x86)
+        return value;
+    }
+
+    inline uint32_t read32(const uint8_t *p) {
+        uint32_t value;
+        memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    inline uint64_t round(uint64_t acc, uint64_t input) {
+        acc += input * kPRIME2;
+        acc = rotl(acc, 31);
+        return acc * kPRIME1;
+    }
+
+    inline uint64_t merge_round(uint64_t acc, uint64_t value) {
+        acc ^= round(0, value);
+        return acc * kPRIME1 + kPRIME4;
+    }
+
+    const int kLANES = 8;
+    const size_t kSTRIPE = 64;                  // bytes consumed by the lanes at once
+    const size_t kSECRET_SIZE = 192;
+    const size_t kSTRIPES_PER_BLOCK = (kSECRET_SIZE - kSTRIPE) / 8;
+    const uint64_t kPRIME32_1 = 0x9E3779B1U;
+    const uint64_t kPRIME32_2 = 0x85EBCA77U;
+    const uint64_t kPRIME32_3 = 0xC2B2AE3DU;
+
+    uint64_t splitmix64(uint64_t *state) {
+        uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+    struct secret_t {
+        uint8_t bytes[kSECRET_SIZE];
+        secret_t() {
+            uint64_t state = 0x6469666675736578ULL;  // "diffusex"
+            for (size_t i = 0; i < kSECRET_SIZE; i += 8) {
+                uint64_t value = splitmix64(&state);
+                memcpy(bytes + i, &value, 8);
+            }
+        }
+    };
+
+    const secret_t kSECRET;
+
+#ifdef CONTENT_HASH_SSE2
+    // x86_64 always has sse2: two lanes per register
+    inline void accumulate_stripe(uint64_t *acc, const uint8_t *input, const uint8_t *secret) {
+        __m128i *a = (__m128i *) acc;
+        for (int i = 0; i < kLANES / 2; ++i) {
+            const __m128i value = _mm_loadu_si128((const __m128i *) input + i);
+            const __m128i key = _mm_xor_si128(value, _mm_loadu_si128((const __m128i *) secret + i));
+            const __m128i product = _mm_mul_epu32(key, _mm_shuffle_epi32(key, _MM_SHUFFLE(0, 3, 0, 1)));
+            const __m128i swapped = _mm_shuffle_epi32(value, _MM_SHUFFLE(1, 0, 3, 2));
+            a[i] = _mm_add_epi64(product, _mm_add_epi64(a[i], swapped));
+        }
+    }
+
+    inline void scramble(uint64_t *acc, const uint8_t *secret) {
+        __m128i *a = (__m128i *) acc;
+        const __m128i prime = _mm_set1_epi32((int) kPRIME32_1);
+        for (int i = 0; i < kLANES / 2; ++i) {
+            __m128i value = _mm_xor_si128(a[i], _mm_srli_epi64(a[i], 47));
+            value = _mm_xor_si128(value, _mm_loadu_si128((const __m128i *) secret + i));
+            const __m128i low = _mm_mul_epu32(value, prime);
+            const __m128i high = _mm_mul_epu32(_mm_shuffle_epi32(value, _MM_SHUFFLE(0, 3, 0, 1)), prime);
+            a[i] = _mm_add_epi64(low, _mm_slli_epi64(high, 32));
+        }
+    }
+#else
+    inline void accumulate_stripe(uint64_t *acc, const uint8_t *input, const uint8_t *secret) {
+        for (int i = 0; i < kLANES; ++i) {
+            const uint64_t value = read64(input + i * 8);
+            const uint64_t key = value ^ read64(secret + i * 8);
+            acc[i ^ 1] += value;
+            acc[i] += (key & 0xFFFFFFFFULL) * (key >> 32);
+        }
+    }
+
+    inline void scramble(uint64_t *acc, const uint8_t *secret) {
+        for (int i = 0; i < kLANES; ++i) {
+            uint64_t a = acc[i];
+            a ^= a >> 47;
+            a ^= read64(secret + i * 8);
+            acc[i] = a * kPRIME32_1;
+        }
+    }
+#endif
+
+    inline uint64_t mul128_fold64(uint64_t a, uint64_t b) {
+#if defined(_MSC_VER) && defined(_M_X64)
+        uint64_t high;
+        const uint64_t low = _umul128(a, b, &high);
+        return low ^ high;
+#elif defined(__SIZEOF_INT128__)
+        const unsigned __int128 product = (unsigned __int128) a * b;
+        return (uint64_t) product ^ (uint64_t) (product >> 64);
+#else
+        // the four 32 bits products
+        const uint64_t lo_lo = (a & 0xFFFFFFFFULL) * (b & 0xFFFFFFFFULL);
+        const uint64_t hi_lo = (a >> 32) * (b & 0xFFFFFFFFULL);
+        const uint64_t lo_hi = (a & 0xFFFFFFFFULL) * (b >> 32);
+        const uint64_t hi_hi = (a >> 32) * (b >> 32);
+        const uint64_t cross = (lo_lo >> 32) + (hi_lo & 0xFFFFFFFFULL) + lo_hi;
+        const uint64_t high = (hi_lo >> 32) + (cross >> 32) + hi_hi;
+        const uint64_t low = (cross << 32) | (lo_lo & 0xFFFFFFFFULL);
+        return low ^ high;
+#endif
+    }
+
+    inline uint64_t avalanche3(uint64_t h) {
+        h ^= h >> 37;
+        h *= 0x165667919E3779F9ULL;
+        return h ^ (h >> 32);
+    }
+
+    uint64_t merge_accumulators(const uint64_t *acc, const uint8_t *secret, uint64_t start) {
+        uint64_t result = start;
+        for (int i = 0; i < 4; ++i) {
+            result += mul128_fold64(acc[2 * i] ^ read64(secret + 16 * i), acc[2 * i + 1] ^ read64(secret + 16 * i + 8));
+        }
+        return avalanche3(result);
+    }
+}  // unnamed namespace
+
+uint64_t content_hash64(const void *data, size_t size, uint64_t seed) {
+    const uint8_t *p = (const uint8_t *) data;
+    const uint8_t *end = p + size;
+    uint64_t h;
+
+    if (size >= 32) {
+        uint64_t v1 = seed + kPRIME1 + kPRIME2;
+        uint64_t v2 = seed + kPRIME2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - kPRIME1;
+        const uint8_t *limit = end - 32;
+        do {
+            v1 = round(v1, read64(p));
+            v2 = round(v2, read64(p + 8));
+            v3 = round(v3, read64(p + 16));
+            v4 = round(v4, read64(p + 24));
+            p += 32;
+        } while (p <= limit);
+        h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+        h = merge_round(h, v1);
+        h = merge_round(h, v2);
+        h = merge_round(h, v3);
+        h = merge_round(h, v4);
+    } else {
+        h = seed + kPRIME5;
+    }
+
+    h += size;
+    for (; p + 8 <= end; p += 8) {
+        h ^= round(0, read64(p));
+        h = rotl(h, 27) * kPRIME1 + kPRIME4;
+    }
+    if (p + 4 <= end) {
+        h ^= (uint64_t) read32(p) * kPRIME1;
+        h = rotl(h, 23) * kPRIME2 + kPRIME3;
+        p += 4;
+    }
+    for (; p < end; ++p) {
+        h ^= (*p) * kPRIME5;
+        h = rotl(h, 11) * kPRIME1;
+    }
+
+    h ^= h >> 33;
+    h *= kPRIME2;
+    h ^= h >> 29;
+    h *= kPRIME3;
+    h ^= h >> 32;
+    return h;
+}
+
+digest128_t content_hash128(const void *data, size_t size, uint64_t seed) {
+    uint8_t secret[kSECRET_SIZE];
+    for (size_t i = 0; i < kSECRET_SIZE; i += 16) {
+        // the seed changes the secret the same way XXH3 does
+        uint64_t low = read64(kSECRET.bytes + i) + seed;
+        uint64_t high = read64(kSECRET.bytes + i + 8) - seed;
+        memcpy(secret + i, &low, 8);
+        memcpy(secret + i + 8, &high, 8);
+    }
+
+    uint8_t padded[kSTRIPE] = {0,};
+    const uint8_t *input = (const uint8_t *) data;
+    size_t len = size;
+    if (len < kSTRIPE) {
+        // short inputs become one stripe, the size goes into the final merge
+        memcpy(padded, input, len);
+        input = padded;
+        len = kSTRIPE;
+    }
+
+    alignas(16) uint64_t acc[kLANES] = {
+        kPRIME32_3, kPRIME1, kPRIME2, kPRIME3,
+        kPRIME4, kPRIME32_2, kPRIME5, kPRIME32_1
+    };
+    const size_t block_size = kSTRIPE * kSTRIPES_PER_BLOCK;
+    const size_t blocks = (len - 1) / block_size;
+    for (size_t b = 0; b < blocks; ++b) {
+        for (size_t s = 0; s < kSTRIPES_PER_BLOCK; ++s) {
+            accumulate_stripe(acc, input + b * block_size + s * kSTRIPE, secret + s * 8);
+        }
+        scramble(acc, secret + kSECRET_SIZE - kSTRIPE);
+    }
+    // the last partial block and the last stripe (it may overlap the previous one)
+    const size_t stripes = ((len - 1) - block_size * blocks) / kSTRIPE;
+    for (size_t s = 0; s < stripes; ++s) {
+        accumulate_stripe(acc, input + blocks * block_size + s * kSTRIPE, secret + s * 8);
+    }
+    accumulate_stripe(acc, input + len - kSTRIPE, secret + kSECRET_SIZE - kSTRIPE - 7);
+
+    digest128_t result;
+    result.low = merge_accumulators(acc, secret + 11, size * kPRIME1);
+    result.high = merge_accumulators(acc, secret + kSECRET_SIZE - kSTRIPE - 11, ~(size * kPRIME2));
+    return result;
+}
+
+std::string digest_to_hex(const digest128_t& digest) {
+    return hash_to_hex(digest.high) + hash_to_hex(digest.low);
+}
+
+std::string hash_to_hex(uint64_t hash) {
+    static const char digits[] = "0123456789abcdef";
+    std::string result(16, '0');
+    for (int i = 15; i >= 0; --i) {
+        result[i] = digits[hash & 0xf];
+        hash >>= 4;
+    }
+    return result;
+}
+
+}  // namespace dexpert
@@ -0,0 +1,41 @@
+/*
+ * Copyright (C) 2023 by Rodrigo Antonio de Araujo
+ */
+#ifndef SRC_DATA_CONTENT_HASH_H_
+#define SRC_DATA_CONTENT_HASH_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+namespace dexpert {
+
+typedef struct digest128 {
+    uint64_t low = 0;
+    uint64_t high = 0;
+    bool operator == (const digest128& other) const {
+        return low == other.low && high == other.high;
+    }
+    bool operator != (const digest128& other) const {
+        return !(*this == other);
+    }
+} digest128_t;
+
+/*
+    XXH64: a fast non cryptographic hash to identify buffers (images, cache keys).
+    Four independent lanes consume 32 bytes per round, so the cpu runs them in parallel.
+*/
+uint64_t content_hash64(const void *data, size_t size, uint64_t seed = 0);
+std::string hash_to_hex(uint64_t hash);
+
+/*
+    128 bits digest built like XXH3-128 (the accumulation loop and the final merges), with its own
+    secret, so the values differ from the xxhash library. The eight 64-bit accumulators run two by
+    two in sse2 registers, fast enough to hash a 4K image near the memory bandwidth.
+*/
+digest128_t content_hash128(const void *data, size_t size, uint64_t seed = 0);
+std::string digest_to_hex(const digest128_t& digest);
+
+}  // namespace dexpert
+
+#endif  // SRC_DATA_CONTENT_HASH_H_
@@ -0,0 +1,162 @@
+#include <string.h>
+#include <inttypes.h>
+#include <vector>
+
+#include "src/data/lz_codec.h"
+
+namespace dexpert {
+
+namespace {
+    const int kHASH_BITS = 14;
+    const size_t kMIN_MATCH = 4;
+    const size_t kMAX_OFFSET = 65535;
+    const size_t kLAST_LITERALS = 5;  // the tail is always stored as literals (simplifies the decoder)
+
+    inline uint32_t read32(const uint8_t *p) {
+        uint32_t v;
+        memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    inline uint32_t hash32(uint32_t v) {
+        return (v * 2654435761U) >> (32 - kHASH_BITS);
+    }
+
+    void write_length(std::string &out, size_t len) {
+        while (len >= 255) {
+            out += (char) 255;
+            len -= 255;
+        }
+        out += (char) len;
+    }
+
+    bool read_length(const uint8_t *&p, const uint8_t *end, size_t &len) {
+        uint8_t b;
+        do {
+            if (p >= end) {
+                return false;
+            }
+            b = *p++;
+            len += b;
+        } while (b == 255);
+        return true;
+    }
+
+    void write_sequence(std::string &out, const uint8_t *literals, size_t literal_len, size_t match_len, size_t offset) {
+        // token: 4 bits literal length, 4 bits match length (minus kMIN_MATCH), 15 means "more bytes follow"
+        uint8_t token = (uint8_t) ((literal_len < 15 ? literal_len : 15) << 4);
+        if (match_len) {
+            size_t m = match_len - kMIN_MATCH;
+            token |= (uint8_t) (m < 15 ? m : 15);
+        }
+        out += (char) token;
+        if (literal_len >= 15) {
+            write_length(out, literal_len - 15);
+        }
+        out.append((const char *) literals, literal_len);
+        if (!match_len) {
+            return;
+        }
+        out += (char) (offset & 0xff);
+        out += (char) (offset >> 8);
+        if (match_len - kMIN_MATCH >= 15) {
+            write_length(out, match_len - kMIN_MATCH - 15);
+        }
+    }
+}  // unnamed namespace
+
+std::string lz_compress(const char *data, size_t size) {
+    std::string out;
+    out.reserve(size / 2 + 16);
+    uint64_t original = size;
+    out.append((const char *) &original, sizeof(original));
+
+    const uint8_t *src = (const uint8_t *) data;
+    const uint8_t *anchor = src;
+    const uint8_t *end = src + size;
+
+    if (size > kMIN_MATCH + kLAST_LITERALS) {
+        std::vector<uint32_t> table(1 << kHASH_BITS, 0xffffffff);
+        const uint8_t *limit = end - kLAST_LITERALS - kMIN_MATCH;
+        const uint8_t *p = src;
+        while (p <= limit) {
+            uint32_t seq = read32(p);
+            uint32_t h = hash32(seq);
+            uint32_t candidate = table[h];
+            table[h] = (uint32_t) (p - src);
+            if (candidate != 0xffffffff && (size_t) (p - src) - candidate <= kMAX_OFFSET && read32(src + candidate) == seq) {
+                const uint8_t *match = src + candidate;
+                size_t len = kMIN_MATCH;
+                while (p + len < end - kLAST_LITERALS && match[len] == p[len]) {
+                    ++len;
+                }
+                write_sequence(out, anchor, p - anchor, len, p - match);
+                p += len;
+                anchor = p;
+            } else {
+                ++p;
+            }
+        }
+    }
+
+    write_sequence(out, anchor, end - anchor, 0, 0);
+    return out;
+}
+
+bool lz_decompress(const std::string& compressed, std::string& output, size_t expected_size) {
+    output.clear();
+    if (compressed.size() < sizeof(uint64_t)) {
+        return false;
+    }
+    uint64_t original = 0;
+    memcpy(&original, compressed.c_str(), sizeof(original));
+    if (original != expected_size) {
+        return false;
+    }
+    output.resize(original);
+
+    const uint8_t *p = (const uint8_t *) compressed.c_str() + sizeof(original);
+    const uint8_t *end = (const uint8_t *) compressed.c_str() + compressed.size();
+    uint8_t *dst = (uint8_t *) &output[0];
+    size_t pos = 0;
+
+    while (p < end) {
+        uint8_t token = *p++;
+        size_t literal_len = token >> 4;
+        if (literal_len == 15 && !read_length(p, end, literal_len)) {
+            return false;
+        }
+        if (literal_len > (size_t) (end - p) || pos + literal_len > original) {
+            return false;
+        }
+        memcpy(dst + pos, p, literal_len);
+        p += literal_len;
+        pos += literal_len;
+        if (p >= end) {
+            break;  // the last sequence has no match
+        }
+        if (end - p < 2) {
+            return false;
+        }
+        size_t offset = p[0] | (p[1] << 8);
+        p += 2;
+        size_t match_len = token & 0x0f;
+        if (match_len == 15 && !read_length(p, end, match_len)) {
+            return false;
+        }
+        match_len += kMIN_MATCH;
+        if (offset == 0 || offset > pos || pos + match_len > original) {
+            return false;
+        }
+        // the regions can overlap (offset < match_len), so copy byte by byte
+        const uint8_t *match = dst + pos - offset;
+        for (size_t i = 0; i < match_len; ++i) {
+            dst[pos + i] = match[i];
+        }
+        pos += match_len;
+    }
+
+    return pos == original;
+}
+
+}  // namespace dexpert
@@ -0,0 +1,23 @@
+/*
+ * Copyright (C) 2023 by Rodrigo Antonio de Araujo
+ */
+#ifndef SRC_DATA_LZ_CODEC_H_
+#define SRC_DATA_LZ_CODEC_H_
+
+#include <stddef.h>
+#include <string>
+
+namespace dexpert {
+
+/*
+    Small LZ77 codec in the spirit of LZ4: greedy matches found through a hash table,
+    no entropy coding. It's fast enough to run in the console parser and on image tiles.
+    The output carries the uncompressed size. lz_decompress only accepts the size the caller expects,
+    a corrupt size (the data may come from a file) can't make it allocate more than that.
+*/
+std::string lz_compress(const char *data, size_t size);
+bool lz_decompress(const std::string& compressed, std::string& output, size_t expected_size);
+
+}  // namespace dexpert
+
+#endif  // SRC_DATA_LZ_CODEC_H_
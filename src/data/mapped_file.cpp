@@ -0,0 +1,88 @@
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "src/data/mapped_file.h"
+
+namespace dexpert {
+
+MappedFile::MappedFile(const std::filesystem::path& path) {
+#ifdef _WIN32
+    HANDLE file = CreateFileW(path.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return;
+    }
+    file_ = file;
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+        return;
+    }
+    HANDLE mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping == NULL) {
+        return;
+    }
+    mapping_ = mapping;
+    void *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (data == NULL) {
+        return;
+    }
+    data_ = (const uint8_t *) data;
+    size_ = file_size.QuadPart;
+#else
+    fd_ = open(path.c_str(), O_RDONLY);
+    if (fd_ < 0) {
+        return;
+    }
+    struct stat st;
+    if (fstat(fd_, &st) != 0 || st.st_size == 0) {
+        return;
+    }
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd_, 0);
+    if (data == MAP_FAILED) {
+        return;
+    }
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+    data_ = (const uint8_t *) data;
+    size_ = st.st_size;
+#endif
+}
+
+MappedFile::~MappedFile() {
+#ifdef _WIN32
+    if (data_) {
+        UnmapViewOfFile(data_);
+    }
+    if (mapping_) {
+        CloseHandle((HANDLE) mapping_);
+    }
+    if (file_) {
+        CloseHandle((HANDLE) file_);
+    }
+#else
+    if (data_) {
+        munmap((void *) data_, size_);
+    }
+    if (fd_ >= 0) {
+        close(fd_);
+    }
+#endif
+}
+
+bool MappedFile::good() {
+    return data_ != NULL;
+}
+
+const uint8_t *MappedFile::data() {
+    return data_;
+}
+
+size_t MappedFile::size() {
+    return size_;
+}
+
+}  // namespace dexpert
@@ -0,0 +1,42 @@
+/*
+ * Copyright (C) 2023 by Rodrigo Antonio de Araujo
+ */
+#ifndef SRC_DATA_MAPPED_FILE_H_
+#define SRC_DATA_MAPPED_FILE_H_
+
+#include <stddef.h>
+#include <inttypes.h>
+#include <filesystem>
+
+namespace dexpert {
+
+/*
+    Read only view of a whole file (mmap / CreateFileMapping).
+    The pages are loaded by the system on demand, so we avoid copying
+    multi-gigabyte models through a read buffer.
+*/
+class MappedFile {
+ public:
+    MappedFile(const std::filesystem::path& path);
+    ~MappedFile();
+    MappedFile (const MappedFile &) = delete;
+    MappedFile & operator = (const MappedFile &) = delete;
+
+    bool good();
+    const uint8_t *data();
+    size_t size();
+
+ private:
+    const uint8_t *data_ = NULL;
+    size_t size_ = 0;
+#ifdef _WIN32
+    void *file_ = NULL;
+    void *mapping_ = NULL;
+#else
+    int fd_ = -1;
+#endif
+};
+
+}  // namespace dexpert
+
+#endif  // SRC_DATA_MAPPED_FILE_H_
@@ -0,0 +1,31 @@
+/*
+ * Copyright (C) 2023 by Rodrigo Antonio de Araujo
+ */
+#ifndef SRC_DATA_SHA256_H_
+#define SRC_DATA_SHA256_H_
+
+#include <stddef.h>
+#include <inttypes.h>
+#include <string>
+
+namespace dexpert {
+
+class Sha256 {
+ public:
+    Sha256();
+    void update(const void *data, size_t len);
+    std::string hexdigest();  // finishes the hash, call it once
+
+ private:
+    void transform(const uint8_t *block);
+
+ private:
+    uint32_t state_[8];
+    uint8_t block_[64];
+    size_t block_len_ = 0;
+    uint64_t total_len_ = 0;
+};
+
+}  // namespace dexpert
+
+#endif  // SRC_DATA_SHA256_H_
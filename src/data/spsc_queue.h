@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2023 by Rodrigo Antonio de Araujo
+ */
+#ifndef SRC_DATA_SPSC_QUEUE_H_
+#define SRC_DATA_SPSC_QUEUE_H_
+
+#include <stddef.h>
+#include <atomic>
+#include <vector>
+
+namespace dexpert {
+
+/*
+    Lock-free ring with a single producer thread and a single consumer thread.
+    The capacity is rounded up to a power of two, push() and pop() never block:
+    they return how many items were transferred.
+*/
+template <typename T>
+class SpscQueue {
+ public:
+    SpscQueue(size_t capacity) {
+        size_t size = 2;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        items_.resize(size);
+        mask_ = size - 1;
+        head_ = 0;
+        tail_ = 0;
+    }
+
+    SpscQueue (const SpscQueue &) = delete;
+    SpscQueue & operator = (const SpscQueue &) = delete;
+
+    // producer side
+    size_t push(const T *items, size_t count) {
+        size_t head = head_.load(std::memory_order_relaxed);
+        size_t tail = tail_.load(std::memory_order_acquire);
+        size_t free_items = items_.size() - (head - tail);
+        if (count > free_items) {
+            count = free_items;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            items_[(head + i) & mask_] = items[i];
+        }
+        head_.store(head + count, std::memory_order_release);
+        return count;
+    }
+
+    bool push(const T& item) {
+        return push(&item, 1) == 1;
+    }
+
+    // consumer side
+    size_t pop(T *items, size_t max_count) {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        size_t head = head_.load(std::memory_order_acquire);
+        size_t count = head - tail;
+        if (count > max_count) {
+            count = max_count;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            items[i] = items_[(tail + i) & mask_];
+        }
+        tail_.store(tail + count, std::memory_order_release);
+        return count;
+    }
+
+    bool pop(T& item) {
+        return pop(&item, 1) == 1;
+    }
+
+    bool empty() const {
+        return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+    }
+
+    size_t capacity() const {
+        return items_.size();
+    }
+
+ private:
+    std::vector<T> items_;
+    size_t mask_;
+    alignas(64) std::atomic<size_t> head_;  // written by the producer
+    alignas(64) std::atomic<size_t> tail_;  // written by the consumer
+};
+
+}  // namespace dexpert
+
+#endif  // SRC_DATA_SPSC_QUEUE_H_
@@ -0,0 +1,275 @@
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <fstream>
+#include <filesystem>
+#include <vector>
+
+#include <FL/Fl_JPEG_Image.H>
+
+#include "src/config/config.h"
+#include "src/data/thumbnail_cache.h"
+
+namespace dexpert {
+
+namespace {
+    const uint32_t kTHUMBNAIL_SIZE = 100;
+    const size_t kDISK_BUDGET = 64 * 1024 * 1024;  // about two thousand thumbnails
+    const char kTHUMBNAIL_MAGIC[4] = {'D', 'X', 'T', 'H'};
+    const int format_channels[py::img_format_count] = {
+        1,  // img_gray_8bit
+        3,  // img_rgb
+        4  // img_rgba
+    };
+
+    std::shared_ptr<ThumbnailCache> thumbnail_cache;
+
+    uint64_t hash_key(const std::string& key) {
+        // FNV-1a, we only need a stable file name
+        uint64_t hash = 14695981039346656037ULL;
+        for (auto c : key) {
+            hash ^= (uint8_t) c;
+            hash *= 1099511628211ULL;
+        }
+        return hash;
+    }
+
+    image_ptr_t read_thumbnail(const std::filesystem::path& path) {
+        std::ifstream f(path, std::ios::binary);
+        if (!f.good()) {
+            return image_ptr_t();
+        }
+        char magic[4] = {0,};
+        uint32_t header[3] = {0,}; // w, h, format
+        f.read(magic, sizeof(magic));
+        f.read((char *)header, sizeof(header));
+        if (!f.good() || memcmp(magic, kTHUMBNAIL_MAGIC, sizeof(magic)) != 0 || header[2] >= py::img_format_count) {
+            return image_ptr_t();
+        }
+        if (header[0] == 0 || header[1] == 0 || header[0] > 4096 || header[1] > 4096) {
+            return image_ptr_t();
+        }
+        std::string buffer;
+        buffer.resize(header[0] * header[1] * format_channels[header[2]]);
+        f.read(&buffer[0], buffer.size());
+        if (!f.good()) {
+            return image_ptr_t();
+        }
+        return std::make_shared<RawImage>((const unsigned char *)buffer.c_str(), header[0], header[1], (py::image_format_t) header[2]);
+    }
+
+    void write_thumbnail(const std::filesystem::path& path, RawImage *image) {
+        std::ofstream f(path, std::ios::binary | std::ios::trunc);
+        if (!f.good()) {
+            fprintf(stderr, "Could not write the thumbnail %s\n", path.u8string().c_str());
+            return;
+        }
+        uint32_t header[3] = {image->w(), image->h(), (uint32_t) image->format()};
+        f.write(kTHUMBNAIL_MAGIC, sizeof(kTHUMBNAIL_MAGIC));
+        f.write((const char *)header, sizeof(header));
+        f.write((const char *)image->buffer(), image->w() * image->h() * format_channels[image->format()]);
+    }
+
+    image_ptr_t decode_jpeg(const std::string& path) {
+        Fl_JPEG_Image jpeg(path.c_str());
+        if (jpeg.w() < 1 || jpeg.h() < 1 || jpeg.count() < 1 || jpeg.data()[0] == NULL) {
+            return image_ptr_t();
+        }
+        py::image_format_t format;
+        switch (jpeg.d()) {
+            case 1:
+                format = py::img_gray_8bit;
+            break;
+            case 3:
+                format = py::img_rgb;
+            break;
+            case 4:
+                format = py::img_rgba;
+            break;
+            default:
+                return image_ptr_t();
+        }
+        const unsigned char *src = (const unsigned char *) jpeg.data()[0];
+        size_t line_size = jpeg.w() * jpeg.d();
+        size_t src_stride = jpeg.ld() ? jpeg.ld() : line_size;
+        std::string buffer;
+        buffer.resize(line_size * jpeg.h());
+        for (int y = 0; y < jpeg.h(); ++y) {
+            memcpy(&buffer[y * line_size], src + y * src_stride, line_size);
+        }
+        return std::make_shared<RawImage>((const unsigned char *)buffer.c_str(), jpeg.w(), jpeg.h(), format);
+    }
+}  // unnamed namespace
+
+std::shared_ptr<ThumbnailCache> get_thumbnail_cache() {
+    if (!thumbnail_cache) {
+        thumbnail_cache.reset(new ThumbnailCache(kTHUMBNAIL_SIZE));
+    }
+    return thumbnail_cache;
+}
+
+ThumbnailCache::ThumbnailCache(uint32_t size) : size_(size) {
+    directory_ = getConfig().getConfigDir() + L"/thumbnails";
+    std::error_code ec;
+    std::filesystem::create_directories(std::filesystem::path(directory_), ec);
+    thread_.reset(new std::thread([this] {
+        run();
+    }));
+}
+
+ThumbnailCache::~ThumbnailCache() {
+    {
+        std::unique_lock<std::mutex> lk(mtx_);
+        terminated_ = true;
+    }
+    cond_.notify_all();
+    thread_->join();
+}
+
+uint32_t ThumbnailCache::size() {
+    return size_;
+}
+
+image_ptr_t ThumbnailCache::get(const std::string& path) {
+    auto it = thumbnails_.find(path);
+    if (it != thumbnails_.end()) {
+        return it->second.image;
+    }
+    thumbnails_[path] = thumbnail_t{false, image_ptr_t()};
+    {
+        std::unique_lock<std::mutex> lk(mtx_);
+        queue_.push_back(path);
+    }
+    cond_.notify_one();
+    return image_ptr_t();
+}
+
+void ThumbnailCache::put(const std::string& path, image_ptr_t image) {
+    image_ptr_t thumbnail;
+    if (image) {
+        thumbnail = image->resizeInTheCenter(size_, size_);
+    }
+    thumbnails_[path] = thumbnail_t{true, thumbnail};
+}
+
+bool ThumbnailCache::poll() {
+    std::list<std::pair<std::string, image_ptr_t> > done;
+    {
+        std::unique_lock<std::mutex> lk(mtx_);
+        done.swap(done_);
+    }
+    bool changed = false;
+    for (auto & d : done) {
+        auto it = thumbnails_.find(d.first);
+        if (it == thumbnails_.end() || it->second.loaded) {
+            continue;  // cleared or replaced by put() while it was loading
+        }
+        it->second.loaded = true;
+        it->second.image = d.second;
+        changed = true;
+    }
+    return changed;
+}
+
+bool ThumbnailCache::pending() {
+    for (auto & t : thumbnails_) {
+        if (!t.second.loaded) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThumbnailCache::clear() {
+    std::unique_lock<std::mutex> lk(mtx_);
+    queue_.clear();
+    done_.clear();
+    thumbnails_.clear();
+}
+
+void ThumbnailCache::run() {
+    while (true) {
+        std::string path;
+        {
+            std::unique_lock<std::mutex> lk(mtx_);
+            cond_.wait(lk, [this] { return terminated_ || !queue_.empty(); });
+            if (terminated_) {
+                break;
+            }
+            path = queue_.front();
+            queue_.pop_front();
+        }
+        image_ptr_t image = load(path);
+        std::unique_lock<std::mutex> lk(mtx_);
+        done_.push_back(std::make_pair(path, image));
+    }
+}
+
+image_ptr_t ThumbnailCache::load(const std::string& path) {
+    std::string preview = path + ".jpg";
+    std::error_code ec;
+    auto preview_path = std::filesystem::u8path(preview);
+    auto size = std::filesystem::file_size(preview_path, ec);
+    if (ec) {
+        return image_ptr_t(); // there is no preview for this embedding
+    }
+    auto mtime = std::filesystem::last_write_time(preview_path, ec);
+    if (ec) {
+        return image_ptr_t();
+    }
+    char key_hash[32] = {0,};
+    std::string key = preview + "|" + std::to_string(mtime.time_since_epoch().count()) + "|" + std::to_string(size);
+    snprintf(key_hash, sizeof(key_hash), "%016llx.thumb", (unsigned long long) hash_key(key));
+    auto thumbnail_path = std::filesystem::path(directory_) / key_hash;
+
+    image_ptr_t result = read_thumbnail(thumbnail_path);
+    if (result) {
+        // the file modification time is the disk lru
+        std::filesystem::last_write_time(thumbnail_path, std::filesystem::file_time_type::clock::now(), ec);
+        return result;
+    }
+
+    result = decode_jpeg(preview);
+    if (!result) {
+        fprintf(stderr, "Could not decode the preview %s\n", preview.c_str());
+        return result;
+    }
+    result = result->resizeInTheCenter(size_, size_);
+    write_thumbnail(thumbnail_path, result.get());
+    enforceDiskBudget();
+    return result;
+}
+
+void ThumbnailCache::enforceDiskBudget() {
+    typedef std::pair<std::filesystem::file_time_type, std::filesystem::path> entry_t;
+    std::vector<entry_t> files;
+    size_t total = 0;
+    std::error_code ec;
+    std::filesystem::directory_iterator it(std::filesystem::path(directory_), ec);
+    for (; !ec && it != std::filesystem::directory_iterator(); it.increment(ec)) {
+        std::error_code fec;
+        auto size = it->file_size(fec);
+        auto mtime = it->last_write_time(fec);
+        if (fec) {
+            continue;
+        }
+        total += size;
+        files.push_back(std::make_pair(mtime, it->path()));
+    }
+    if (total <= kDISK_BUDGET) {
+        return;
+    }
+    std::sort(files.begin(), files.end());
+    for (const auto & f : files) {
+        if (total <= kDISK_BUDGET) {
+            break;
+        }
+        std::error_code rec;
+        auto size = std::filesystem::file_size(f.second, rec);
+        if (!rec && std::filesystem::remove(f.second, rec)) {
+            total -= size;
+        }
+    }
+}
+
+}  // namespace dexpert
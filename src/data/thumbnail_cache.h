@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2023 by Rodrigo Antonio de Araujo
+ */
+#ifndef SRC_DATA_THUMBNAIL_CACHE_H_
+#define SRC_DATA_THUMBNAIL_CACHE_H_
+
+#include <map>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <string>
+#include <memory>
+#include <condition_variable>
+
+#include "src/python/raw_image.h"
+
+namespace dexpert {
+
+class ThumbnailCache;
+
+std::shared_ptr<ThumbnailCache> get_thumbnail_cache();
+
+/*
+    Keeps the previews of the embeddings (<model path>.jpg) scaled to the miniature size.
+    The thumbnails are stored at <config dir>/thumbnails and the file name is a hash of
+    the preview path + modification time + size, so an edited preview produces a new entry.
+    The oldest thumbnails (by the file modification time, touched on each read) go away when the
+    directory is over the disk budget.
+    The images are decoded by a worker thread, the gui thread calls poll() to receive them.
+*/
+class ThumbnailCache {
+    friend std::shared_ptr<ThumbnailCache> get_thumbnail_cache();
+    ThumbnailCache(uint32_t size);
+
+ public:
+    ~ThumbnailCache();
+    ThumbnailCache (const ThumbnailCache &) = delete;
+    ThumbnailCache & operator = (const ThumbnailCache &) = delete;
+    // returns the thumbnail if it's loaded, otherwise it schedule the loading and returns an empty pointer
+    image_ptr_t get(const std::string& path);
+    // replaces the thumbnail after the user defines a new picture
+    void put(const std::string& path, image_ptr_t image);
+    // returns true when some thumbnail finished to load
+    bool poll();
+    bool pending();
+    // forget the thumbnails in memory (the disk cache is validated again)
+    void clear();
+    uint32_t size();
+
+ private:
+    void run();
+    image_ptr_t load(const std::string& path);
+    void enforceDiskBudget();
+
+ private:
+    typedef struct {
+        bool loaded;
+        image_ptr_t image;
+    } thumbnail_t;
+
+    uint32_t size_;
+    bool terminated_ = false;
+    std::wstring directory_;
+    std::map<std::string, thumbnail_t> thumbnails_;
+    std::list<std::string> queue_;
+    std::list<std::pair<std::string, image_ptr_t> > done_;
+    std::mutex mtx_;
+    std::condition_variable cond_;
+    std::unique_ptr<std::thread> thread_;
+};
+
+}  // namespace dexpert
+
+#endif  // SRC_DATA_THUMBNAIL_CACHE_H_
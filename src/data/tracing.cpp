@@ -0,0 +1,158 @@
+#include <stdio.h>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "src/data/tracing.h"
+
+namespace dexpert {
+
+namespace {
+    const size_t kMAX_EVENTS_PER_THREAD = 1024 * 1024;
+
+    typedef struct {
+        const char *name;
+        int64_t started_us;
+        int64_t duration_us;
+    } trace_event_t;
+
+    typedef struct {
+        std::mutex mtx;     // only contended when the trace is written
+        uint32_t tid;
+        std::string name;
+        size_t dropped = 0;
+        std::vector<trace_event_t> events;
+    } thread_buffer_t;
+
+    std::atomic<bool> enabled(false);
+    std::atomic<scope_time_hook_t> scope_time_hook(nullptr);
+    std::mutex buffers_mtx;
+    std::vector<std::shared_ptr<thread_buffer_t> > buffers;
+    std::wstring trace_path;
+    uint32_t thread_count = 0;
+
+    int64_t now_us() {
+        using namespace std::chrono;
+        static const steady_clock::time_point epoch = steady_clock::now();
+        return duration_cast<microseconds>(steady_clock::now() - epoch).count();
+    }
+
+    thread_buffer_t *thread_buffer() {
+        thread_local std::shared_ptr<thread_buffer_t> buffer;
+        if (!buffer) {
+            buffer = std::make_shared<thread_buffer_t>();
+            std::unique_lock<std::mutex> lk(buffers_mtx);
+            buffer->tid = ++thread_count;
+            buffers.push_back(buffer);
+        }
+        return buffer.get();
+    }
+
+    std::string escape(const std::string& text) {
+        std::string result;
+        for (char c : text) {
+            if (c == '"' || c == '\\') {
+                result += '\\';
+            }
+            if ((unsigned char) c >= 0x20) {
+                result += c;
+            }
+        }
+        return result;
+    }
+}  // unnamed namespace
+
+void start_tracing(const std::wstring& path) {
+    std::unique_lock<std::mutex> lk(buffers_mtx);
+    trace_path = path;
+    now_us();  // sets the epoch
+    enabled = true;
+}
+
+bool tracing_enabled() {
+    return enabled.load(std::memory_order_relaxed);
+}
+
+void set_trace_thread_name(const char *name) {
+    thread_buffer_t *buffer = thread_buffer();
+    std::unique_lock<std::mutex> lk(buffer->mtx);
+    buffer->name = name;
+}
+
+bool stop_tracing() {
+    if (!enabled.exchange(false)) {
+        return false;
+    }
+    std::unique_lock<std::mutex> lk(buffers_mtx);
+    std::filesystem::path path(trace_path);
+    std::error_code ec;
+    std::filesystem::create_directories(path.parent_path(), ec);
+    std::ofstream f(path);
+    if (!f) {
+        return false;
+    }
+    char line[512];
+    bool first = true;
+    f << "{\"traceEvents\":[\n";
+    for (auto & b : buffers) {
+        std::unique_lock<std::mutex> blk(b->mtx);
+        if (!b->name.empty()) {
+            snprintf(line, sizeof(line), "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                first ? "" : ",\n", b->tid, escape(b->name).c_str());
+            f << line;
+            first = false;
+        }
+        for (const auto & e : b->events) {
+            snprintf(line, sizeof(line), "%s{\"name\":\"%s\",\"cat\":\"dexpert\",\"ph\":\"X\",\"ts\":%lld,\"dur\":%lld,\"pid\":1,\"tid\":%u}",
+                first ? "" : ",\n", escape(e.name).c_str(), (long long) e.started_us, (long long) e.duration_us, b->tid);
+            f << line;
+            first = false;
+        }
+        if (b->dropped) {
+            printf("Tracing: %zu events dropped at thread %u (buffer full)\n", b->dropped, b->tid);
+        }
+        b->events.clear();
+        b->events.shrink_to_fit();
+        b->dropped = 0;
+    }
+    f << "\n]}\n";
+    return f.good();
+}
+
+TraceSpan::TraceSpan(const char *name) : name_(name) {
+    started_us_ = tracing_enabled() ? now_us() : -1;
+}
+
+TraceSpan::~TraceSpan() {
+    if (started_us_ < 0 || !tracing_enabled()) {
+        return;
+    }
+    int64_t finished = now_us();
+    thread_buffer_t *buffer = thread_buffer();
+    std::unique_lock<std::mutex> lk(buffer->mtx);
+    if (buffer->events.size() >= kMAX_EVENTS_PER_THREAD) {
+        buffer->dropped += 1;
+        return;
+    }
+    buffer->events.push_back({name_, started_us_, finished - started_us_});
+}
+
+void set_scope_time_hook(scope_time_hook_t hook) {
+    scope_time_hook = hook;
+}
+
+ScopedTimer::ScopedTimer(const char *name) : span_(name), name_(name), started_us_(now_us()) {
+}
+
+ScopedTimer::~ScopedTimer() {
+    scope_time_hook_t hook = scope_time_hook;
+    if (hook) {
+        hook(name_, (now_us() - started_us_) / 1000.0);
+    }
+}
+
+}  // namespace dexpert
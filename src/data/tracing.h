@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2023 by Rodrigo Antonio de Araujo
+ */
+#ifndef SRC_DATA_TRACING_H_
+#define SRC_DATA_TRACING_H_
+
+#include <stdint.h>
+#include <string>
+
+namespace dexpert {
+
+/*
+    Lightweight tracing in the chrome trace format (open the file at about://tracing or ui.perfetto.dev).
+    Each thread records its spans into its own buffer, so recording does not contend with other threads.
+    When tracing is disabled a span costs one atomic load.
+*/
+void start_tracing(const std::wstring& path);
+// writes the trace file and stops recording, returns false if the file could not be written
+bool stop_tracing();
+bool tracing_enabled();
+// shows a name instead of the thread id in the trace viewer
+void set_trace_thread_name(const char *name);
+
+class TraceSpan {
+ public:
+    // name must be a string literal (it's not copied)
+    explicit TraceSpan(const char *name);
+    ~TraceSpan();
+    TraceSpan (const TraceSpan &) = delete;
+    TraceSpan & operator = (const TraceSpan &) = delete;
+
+ private:
+    const char *name_;
+    int64_t started_us_;
+};
+
+// receives the time of each ScopedTimer, the generation profiler installs it
+typedef void (*scope_time_hook_t)(const char *name, double ms);
+void set_scope_time_hook(scope_time_hook_t hook);
+
+// measures the enclosing scope and reports it to the scope time hook
+// (it's also a trace span, name must be a string literal)
+class ScopedTimer {
+ public:
+    explicit ScopedTimer(const char *name);
+    ~ScopedTimer();
+    ScopedTimer (const ScopedTimer &) = delete;
+    ScopedTimer & operator = (const ScopedTimer &) = delete;
+
+ private:
+    TraceSpan span_;
+    const char *name_;
+    int64_t started_us_;
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(name) dexpert::TraceSpan TRACE_CONCAT(trace_span_, __LINE__)(name)
+
+}  // namespace dexpert
+
+#endif  // SRC_DATA_TRACING_H_
@@ -33,12 +33,18 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
     */
     AllocConsole();
     ShowWindow(GetConsoleWindow(), SW_HIDE);
-    std::wstring where = executableDir() + L"/diffusion-exp.exe";
+    std::wstring where = L"\"" + executableDir() + L"/diffusion-exp.exe\"";
+    // forward the arguments (ex. --trace)
+    wchar_t args[1024] = { 0, };
+    if (lpCmdLine && *lpCmdLine && MultiByteToWideChar(CP_ACP, 0, lpCmdLine, -1, args, (sizeof(args) / sizeof(wchar_t)) - 1) > 0) {
+        where += L" ";
+        where += args;
+    }
     PROCESS_INFORMATION info;
     STARTUPINFOW si;
     ZeroMemory( &si, sizeof(si) );
     si.cb = sizeof(si);
     ZeroMemory( &info, sizeof(info) );
-    CreateProcessW(NULL, (LPWSTR) where.c_str(), NULL, NULL, TRUE, 0, NULL, NULL, &si , &info);
+    CreateProcessW(NULL, &where[0], NULL, NULL, TRUE, 0, NULL, NULL, &si , &info);
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,368 @@
+#include <math.h>
+#include <algorithm>
+#include <functional>
+#include <thread>
+
+#include "src/images/edge_detection.h"
+
+namespace dexpert
+{
+
+namespace {
+    const unsigned int kMAX_WORKERS = 8;
+    const int kMIN_ROWS_PER_WORKER = 32;
+    // the sigmas of the xdog scribble are meant for images resized to 512 pixels (resize_image_with_pad)
+    const float kSCRIBBLE_RESOLUTION = 512.0;
+    const float kSCRIBBLE_SIGMA_FINE = 0.5;
+    const float kSCRIBBLE_SIGMA_COARSE = 5.0;
+    // tan(22.5) and tan(67.5) split the gradient direction in horizontal, vertical and the diagonals
+    const float kTAN_22_5 = 0.41421356f;
+    const float kTAN_67_5 = 2.41421356f;
+    // bigger sigmas use three box blurs, their cost does not depend on the sigma
+    const float kMAX_KERNEL_SIGMA = 2.0;
+    const int kBOX_PASSES = 3;
+
+    // runs fn(first row, end row) in bands of rows at the same time
+    void parallel_rows(int h, const std::function<void(int, int)>& fn) {
+        unsigned int workers = std::max(1u, std::min(std::thread::hardware_concurrency(), kMAX_WORKERS));
+        workers = std::min<unsigned int>(workers, std::max(1, h / kMIN_ROWS_PER_WORKER));
+        if (workers < 2) {
+            fn(0, h);
+            return;
+        }
+        const int band = (h + workers - 1) / workers;
+        std::vector<std::thread> threads;
+        for (int y = 0; y < h; y += band) {
+            int end = std::min(h, y + band);
+            threads.push_back(std::thread([&fn, y, end] {
+                fn(y, end);
+            }));
+        }
+        for (auto & t : threads) {
+            t.join();
+        }
+    }
+
+    // opencv's default border (BORDER_REFLECT_101)
+    int reflect(int i, int n) {
+        if (n < 2) {
+            return 0;
+        }
+        while (i < 0 || i >= n) {
+            i = i < 0 ? -i : 2 * n - i - 2;
+        }
+        return i;
+    }
+
+    std::vector<float> gaussian_kernel(float sigma) {
+        int radius = std::max(1, (int) ceilf(sigma * 4));
+        std::vector<float> kernel(radius * 2 + 1);
+        float sum = 0;
+        for (int i = -radius; i <= radius; ++i) {
+            kernel[i + radius] = expf(-(i * i) / (2 * sigma * sigma));
+            sum += kernel[i + radius];
+        }
+        for (auto & k : kernel) {
+            k /= sum;
+        }
+        return kernel;
+    }
+
+    // box blur of rgb pixels (3 floats per pixel) using running sums, the border is replicated
+    std::vector<float> box_blur(const std::vector<float>& src, int w, int h, int radius) {
+        const int line = w * 3;
+        const float scale = 1.0f / (radius * 2 + 1);
+        std::vector<float> tmp(src.size());
+        std::vector<float> dst(src.size());
+
+        parallel_rows(h, [&] (int y1, int y2) {
+            for (int y = y1; y < y2; ++y) {
+                const float *in = &src[(size_t) y * line];
+                float *out = &tmp[(size_t) y * line];
+                for (int c = 0; c < 3; ++c) {
+                    float sum = 0;
+                    for (int x = -radius; x <= radius; ++x) {
+                        sum += in[std::min(std::max(x, 0), w - 1) * 3 + c];
+                    }
+                    for (int x = 0; x < w; ++x) {
+                        out[x * 3 + c] = sum * scale;
+                        sum += in[std::min(x + radius + 1, w - 1) * 3 + c] - in[std::max(x - radius, 0) * 3 + c];
+                    }
+                }
+            }
+        });
+
+        parallel_rows(h, [&] (int y1, int y2) {
+            auto row = [&] (int y) {
+                return &tmp[(size_t) std::min(std::max(y, 0), h - 1) * line];
+            };
+            std::vector<float> sum(line, 0.0f);
+            for (int y = y1 - radius; y <= y1 + radius; ++y) {
+                const float *in = row(y);
+                for (int i = 0; i < line; ++i) {
+                    sum[i] += in[i];
+                }
+            }
+            for (int y = y1; y < y2; ++y) {
+                float *out = &dst[(size_t) y * line];
+                const float *add = row(y + radius + 1);
+                const float *sub = row(y - radius);
+                for (int i = 0; i < line; ++i) {   // contiguous: the compiler vectorizes it
+                    out[i] = sum[i] * scale;
+                    sum[i] += add[i] - sub[i];
+                }
+            }
+        });
+        return dst;
+    }
+
+    // separable gaussian blur of rgb pixels (3 floats per pixel)
+    std::vector<float> gaussian_blur(const std::vector<float>& src, int w, int h, float sigma) {
+        if (sigma > kMAX_KERNEL_SIGMA) {
+            // box sizes whose variances add up to sigma^2 (the ideal width rounded to odd sizes)
+            const float ideal = sqrtf(12 * sigma * sigma / kBOX_PASSES + 1);
+            int lower = (int) ideal;
+            if (lower % 2 == 0) {
+                --lower;
+            }
+            const int upper = lower + 2;
+            const int lower_passes = (int) roundf((12 * sigma * sigma - kBOX_PASSES * lower * lower - 4 * kBOX_PASSES * lower - 3 * kBOX_PASSES) / (-4 * lower - 4));
+            std::vector<float> result = src;
+            for (int i = 0; i < kBOX_PASSES; ++i) {
+                result = box_blur(result, w, h, ((i < lower_passes ? lower : upper) - 1) / 2);
+            }
+            return result;
+        }
+
+        const auto kernel = gaussian_kernel(sigma);
+        const int radius = kernel.size() / 2;
+        const int line = w * 3;
+        std::vector<float> tmp(src.size());
+        std::vector<float> dst(src.size());
+
+        parallel_rows(h, [&] (int y1, int y2) {
+            std::vector<float> padded((w + radius * 2) * 3);
+            for (int y = y1; y < y2; ++y) {
+                const float *row = &src[(size_t) y * line];
+                for (int x = -radius; x < w + radius; ++x) {
+                    const float *p = row + reflect(x, w) * 3;
+                    float *d = &padded[(x + radius) * 3];
+                    d[0] = p[0];
+                    d[1] = p[1];
+                    d[2] = p[2];
+                }
+                float *out = &tmp[(size_t) y * line];
+                std::fill(out, out + line, 0.0f);
+                for (size_t k = 0; k < kernel.size(); ++k) {
+                    const float weight = kernel[k];
+                    const float *in = &padded[k * 3];
+                    for (int i = 0; i < line; ++i) {   // contiguous: the compiler vectorizes it
+                        out[i] += weight * in[i];
+                    }
+                }
+            }
+        });
+
+        parallel_rows(h, [&] (int y1, int y2) {
+            for (int y = y1; y < y2; ++y) {
+                float *out = &dst[(size_t) y * line];
+                std::fill(out, out + line, 0.0f);
+                for (size_t k = 0; k < kernel.size(); ++k) {
+                    const float weight = kernel[k];
+                    const float *in = &tmp[(size_t) reflect(y + (int) k - radius, h) * line];
+                    for (int i = 0; i < line; ++i) {
+                        out[i] += weight * in[i];
+                    }
+                }
+            }
+        });
+        return dst;
+    }
+
+    image_ptr_t control_image(const std::vector<uint8_t>& lines, uint32_t w, uint32_t h) {
+        std::vector<unsigned char> buffer((size_t) w * h * 4, 0);
+        for (size_t i = 0; i < lines.size(); ++i) {
+            if (lines[i]) {
+                buffer[i * 4 + 3] = 255;
+            }
+        }
+        return std::make_shared<RawImage>(buffer.data(), w, h, py::img_rgba);
+    }
+}  // unnamed namespace
+
+image_ptr_t hwc3(RawImage *image) {
+    const size_t count = (size_t) image->w() * image->h();
+    const unsigned char *src = image->buffer();
+    std::vector<unsigned char> rgb(count * 3);
+    switch (image->format()) {
+        case py::img_rgb:
+            return image->duplicate();
+        case py::img_gray_8bit:
+            for (size_t i = 0; i < count; ++i) {
+                rgb[i * 3] = rgb[i * 3 + 1] = rgb[i * 3 + 2] = src[i];
+            }
+            break;
+        default:
+            for (size_t i = 0; i < count; ++i) {
+                const unsigned char *p = src + i * 4;
+                const int alpha = p[3];
+                for (int c = 0; c < 3; ++c) {
+                    rgb[i * 3 + c] = (p[c] * alpha + 255 * (255 - alpha) + 127) / 255;
+                }
+            }
+            break;
+    }
+    return std::make_shared<RawImage>(rgb.data(), image->w(), image->h(), py::img_rgb);
+}
+
+edge_map_t canny_map(RawImage *image) {
+    auto rgb = hwc3(image);
+    const int w = rgb->w();
+    const int h = rgb->h();
+    const unsigned char *src = rgb->buffer();
+    const size_t line = (size_t) w * 3;
+
+    std::vector<float> magnitude((size_t) w * h);
+    std::vector<float> gx((size_t) w * h);
+    std::vector<float> gy((size_t) w * h);
+    parallel_rows(h, [&] (int y1, int y2) {
+        for (int y = y1; y < y2; ++y) {
+            // cv2.Canny replicates the border
+            const unsigned char *up = src + std::max(y - 1, 0) * line;
+            const unsigned char *mid = src + y * line;
+            const unsigned char *down = src + std::min(y + 1, h - 1) * line;
+            for (int x = 0; x < w; ++x) {
+                const int l = std::max(x - 1, 0) * 3;
+                const int r = std::min(x + 1, w - 1) * 3;
+                const int m = x * 3;
+                int best = -1, best_x = 0, best_y = 0;
+                for (int c = 0; c < 3; ++c) {
+                    int dx = (up[r + c] + 2 * mid[r + c] + down[r + c]) - (up[l + c] + 2 * mid[l + c] + down[l + c]);
+                    int dy = (down[l + c] + 2 * down[m + c] + down[r + c]) - (up[l + c] + 2 * up[m + c] + up[r + c]);
+                    int value = abs(dx) + abs(dy);
+                    if (value > best) {
+                        best = value;
+                        best_x = dx;
+                        best_y = dy;
+                    }
+                }
+                const size_t i = (size_t) y * w + x;
+                magnitude[i] = best;
+                gx[i] = best_x;
+                gy[i] = best_y;
+            }
+        }
+    });
+
+    edge_map_t result;
+    result.w = w;
+    result.h = h;
+    result.strength.resize((size_t) w * h, 0);
+    auto at = [&] (int x, int y) -> float {
+        if (x < 0 || y < 0 || x >= w || y >= h) {
+            return 0;
+        }
+        return magnitude[(size_t) y * w + x];
+    };
+    parallel_rows(h, [&] (int y1, int y2) {
+        for (int y = y1; y < y2; ++y) {
+            for (int x = 0; x < w; ++x) {
+                const size_t i = (size_t) y * w + x;
+                const float m = magnitude[i];
+                if (m == 0) {
+                    continue;
+                }
+                const float ax = fabsf(gx[i]);
+                const float ay = fabsf(gy[i]);
+                bool peak;
+                if (ay < ax * kTAN_22_5) {
+                    peak = m > at(x - 1, y) && m >= at(x + 1, y);
+                } else if (ay > ax * kTAN_67_5) {
+                    peak = m > at(x, y - 1) && m >= at(x, y + 1);
+                } else {
+                    const int s = (gx[i] < 0) != (gy[i] < 0) ? -1 : 1;
+                    peak = m > at(x - s, y - 1) && m > at(x + s, y + 1);
+                }
+                if (peak) {
+                    result.strength[i] = m;
+                }
+            }
+        }
+    });
+    return result;
+}
+
+image_ptr_t canny_threshold(const edge_map_t& map, int low, int high) {
+    if (low > high) {
+        std::swap(low, high);
+    }
+    const int w = map.w;
+    const int h = map.h;
+    // 0 = no line, 1 = line if connected to a strong one, 2 = line
+    std::vector<uint8_t> lines(map.strength.size(), 0);
+    std::vector<size_t> stack;
+    for (size_t i = 0; i < lines.size(); ++i) {
+        if (map.strength[i] > high) {
+            lines[i] = 2;
+            stack.push_back(i);
+        } else if (map.strength[i] > low) {
+            lines[i] = 1;
+        }
+    }
+    while (!stack.empty()) {
+        const size_t i = stack.back();
+        stack.pop_back();
+        const int x = i % w;
+        const int y = i / w;
+        for (int ny = std::max(y - 1, 0); ny <= std::min(y + 1, h - 1); ++ny) {
+            for (int nx = std::max(x - 1, 0); nx <= std::min(x + 1, w - 1); ++nx) {
+                const size_t n = (size_t) ny * w + nx;
+                if (lines[n] == 1) {
+                    lines[n] = 2;
+                    stack.push_back(n);
+                }
+            }
+        }
+    }
+    for (auto & l : lines) {
+        l = l == 2;
+    }
+    return control_image(lines, map.w, map.h);
+}
+
+edge_map_t scribble_map(RawImage *image) {
+    auto rgb = hwc3(image);
+    const int w = rgb->w();
+    const int h = rgb->h();
+    const unsigned char *src = rgb->buffer();
+    std::vector<float> pixels((size_t) w * h * 3);
+    for (size_t i = 0; i < pixels.size(); ++i) {
+        pixels[i] = src[i];
+    }
+    // the same as resizing to 512 pixels, without resizing the result back
+    const float scale = std::min(w, h) / kSCRIBBLE_RESOLUTION;
+    auto fine = gaussian_blur(pixels, w, h, kSCRIBBLE_SIGMA_FINE * scale);
+    auto coarse = gaussian_blur(pixels, w, h, kSCRIBBLE_SIGMA_COARSE * scale);
+
+    edge_map_t result;
+    result.w = w;
+    result.h = h;
+    result.strength.resize((size_t) w * h);
+    parallel_rows(h, [&] (int y1, int y2) {
+        for (size_t i = (size_t) y1 * w; i < (size_t) y2 * w; ++i) {
+            float d = std::min(coarse[i * 3] - fine[i * 3], std::min(coarse[i * 3 + 1] - fine[i * 3 + 1], coarse[i * 3 + 2] - fine[i * 3 + 2]));
+            result.strength[i] = 2 * std::min(std::max(d, 0.0f), 255.0f);
+        }
+    });
+    return result;
+}
+
+image_ptr_t scribble_threshold(const edge_map_t& map, int threshold) {
+    std::vector<uint8_t> lines(map.strength.size());
+    for (size_t i = 0; i < lines.size(); ++i) {
+        lines[i] = map.strength[i] > threshold;
+    }
+    return control_image(lines, map.w, map.h);
+}
+
+}  // namespace dexpert
@@ -0,0 +1,43 @@
+/*
+ * Copyright (C) 2023 by Rodrigo Antonio de Araujo
+ */
+#ifndef SRC_IMAGES_EDGE_DETECTION_H_
+#define SRC_IMAGES_EDGE_DETECTION_H_
+
+#include <stdint.h>
+#include <vector>
+
+#include "src/python/raw_image.h"
+
+namespace dexpert
+{
+
+/*
+    Native versions of the cheap controlnet pre-processors (python_stuff/images/pre_process.py).
+    The work is split in two: the edge map does not depend on the thresholds and it is the expensive
+    part, thresholding it again is cheap, so moving the threshold slider does not compute it again.
+    The control images are rgba: black opaque lines over a transparent background, the same result
+    of the python pre-processor followed by RawImage::removeBackground(true).
+*/
+
+typedef struct {
+    uint32_t w = 0;
+    uint32_t h = 0;
+    std::vector<float> strength;    // w * h
+} edge_map_t;
+
+// HWC3: gray and rgba images become rgb (the alpha is composed over white)
+image_ptr_t hwc3(RawImage *image);
+
+// gradient magnitude (3x3 sobel, L1 norm, the strongest channel) after the non maximum suppression
+edge_map_t canny_map(RawImage *image);
+// the canny hysteresis: lines start at strength > high and continue while strength > low
+image_ptr_t canny_threshold(const edge_map_t& map, int low, int high);
+
+// difference of gaussians (xdog), the scribble pre-processor that does not need the HED model
+edge_map_t scribble_map(RawImage *image);
+image_ptr_t scribble_threshold(const edge_map_t& map, int threshold);
+
+}  // namespace dexpert
+
+#endif  // SRC_IMAGES_EDGE_DETECTION_H_
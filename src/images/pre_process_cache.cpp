@@ -0,0 +1,205 @@
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+#include "src/config/config.h"
+#include "src/data/content_hash.h"
+#include "src/data/lz_codec.h"
+#include "src/images/pre_process_cache.h"
+
+namespace dexpert
+{
+
+namespace {
+    const char kCACHE_MAGIC[4] = {'D', 'X', 'P', 'P'};
+    const wchar_t *kCACHE_DIR = L"/pre_process";
+    const size_t kMEGABYTE = 1024 * 1024;
+    const uint32_t kMAX_IMAGE_SIZE = 16384;     // larger sizes at the header mean a corrupt file
+
+    std::shared_ptr<PreProcessCache> pre_process_cache;
+
+    size_t image_bytes(RawImage *image) {
+        return (size_t) image->w() * image->h() * image->channels();
+    }
+
+    size_t format_channels(uint32_t format) {
+        switch (format) {
+            case py::img_gray_8bit:
+                return 1;
+            case py::img_rgb:
+                return 3;
+            default:
+                return 4;
+        }
+    }
+}  // unnamed namespace
+
+std::shared_ptr<PreProcessCache> get_pre_process_cache() {
+    if (!pre_process_cache) {
+        auto & c = getConfig();
+        pre_process_cache.reset(new PreProcessCache(
+            c.getConfigDir() + kCACHE_DIR,
+            c.getPreProcessCacheMB() * kMEGABYTE,
+            c.getPreProcessDiskCacheMB() * kMEGABYTE));
+    }
+    return pre_process_cache;
+}
+
+PreProcessCache::PreProcessCache(const std::wstring& directory, size_t memory_budget, size_t disk_budget) :
+    directory_(directory), memory_budget_(memory_budget), disk_budget_(disk_budget) {
+    if (disk_budget_) {
+        std::error_code ec;
+        std::filesystem::create_directories(std::filesystem::path(directory_), ec);
+    }
+}
+
+std::string PreProcessCache::makeKey(const std::string& mode, RawImage *source, const std::string& params) {
+    return mode + "|" + params + "|" + digest_to_hex(source->contentHash());
+}
+
+std::wstring PreProcessCache::filePath(const std::string& key) {
+    auto name = hash_to_hex(content_hash64(key.c_str(), key.size())) + ".bin";
+    return (std::filesystem::path(directory_) / name).wstring();
+}
+
+image_ptr_t PreProcessCache::get(const std::string& mode, RawImage *source, const std::string& params) {
+    if (!source) {
+        return image_ptr_t();
+    }
+    auto key = makeKey(mode, source, params);
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+        lru_.splice(lru_.begin(), lru_, it->second);
+        return it->second->second->duplicate();
+    }
+    auto image = readFile(key);
+    if (!image) {
+        return image;
+    }
+    keep(key, image);
+    return image->duplicate();
+}
+
+void PreProcessCache::put(const std::string& mode, RawImage *source, const std::string& params, image_ptr_t result) {
+    if (!source || !result) {
+        return;
+    }
+    auto key = makeKey(mode, source, params);
+    auto image = result->duplicate();
+    keep(key, image);
+    writeFile(key, image.get());
+}
+
+void PreProcessCache::keep(const std::string& key, image_ptr_t image) {
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+        memory_bytes_ -= image_bytes(it->second->second.get());
+        lru_.erase(it->second);
+    }
+    lru_.push_front(std::make_pair(key, image));
+    index_[key] = lru_.begin();
+    memory_bytes_ += image_bytes(image.get());
+    // the newest image stays even when it's bigger than the budget
+    while (memory_bytes_ > memory_budget_ && lru_.size() > 1) {
+        auto & last = lru_.back();
+        memory_bytes_ -= image_bytes(last.second.get());
+        index_.erase(last.first);
+        lru_.pop_back();
+    }
+}
+
+image_ptr_t PreProcessCache::readFile(const std::string& key) {
+    if (!disk_budget_) {
+        return image_ptr_t();
+    }
+    auto path = std::filesystem::path(filePath(key));
+    std::ifstream f(path, std::ios::binary);
+    if (!f.good()) {
+        return image_ptr_t();
+    }
+    char magic[4] = {0,};
+    uint32_t header[4] = {0,}; // w, h, format, key size
+    f.read(magic, sizeof(magic));
+    f.read((char *)header, sizeof(header));
+    if (!f.good() || memcmp(magic, kCACHE_MAGIC, sizeof(magic)) != 0 || header[2] >= py::img_format_count || header[3] != key.size()) {
+        return image_ptr_t();
+    }
+    if (header[0] < 1 || header[1] < 1 || header[0] > kMAX_IMAGE_SIZE || header[1] > kMAX_IMAGE_SIZE) {
+        return image_ptr_t();
+    }
+    std::string stored_key(header[3], '\0');
+    f.read(&stored_key[0], stored_key.size());
+    if (!f.good() || stored_key != key) {
+        return image_ptr_t();  // another key with the same file name
+    }
+    std::string compressed((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+    std::string pixels;
+    // the image copies w * h * channels bytes from pixels, a truncated file must not get there
+    if (!lz_decompress(compressed, pixels, (size_t) header[0] * header[1] * format_channels(header[2]))) {
+        return image_ptr_t();
+    }
+    auto image = std::make_shared<RawImage>((const unsigned char *) pixels.c_str(), header[0], header[1], (py::image_format_t) header[2]);
+    f.close();
+    // the file modification time is the disk lru
+    std::error_code ec;
+    std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), ec);
+    return image;
+}
+
+void PreProcessCache::writeFile(const std::string& key, RawImage *image) {
+    if (!disk_budget_) {
+        return;
+    }
+    auto path = std::filesystem::path(filePath(key));
+    {
+        std::ofstream f(path, std::ios::binary | std::ios::trunc);
+        if (!f.good()) {
+            fprintf(stderr, "Could not write the pre-processor cache %s\n", path.u8string().c_str());
+            return;
+        }
+        auto compressed = lz_compress((const char *) image->buffer(), image_bytes(image));
+        uint32_t header[4] = {image->w(), image->h(), (uint32_t) image->format(), (uint32_t) key.size()};
+        f.write(kCACHE_MAGIC, sizeof(kCACHE_MAGIC));
+        f.write((const char *)header, sizeof(header));
+        f.write(key.c_str(), key.size());
+        f.write(compressed.c_str(), compressed.size());
+    }
+    enforceDiskBudget();
+}
+
+void PreProcessCache::enforceDiskBudget() {
+    typedef std::pair<std::filesystem::file_time_type, std::filesystem::path> entry_t;
+    std::vector<entry_t> files;
+    size_t total = 0;
+    std::error_code ec;
+    std::filesystem::directory_iterator it(std::filesystem::path(directory_), ec);
+    for (; !ec && it != std::filesystem::directory_iterator(); it.increment(ec)) {
+        std::error_code fec;
+        auto size = it->file_size(fec);
+        auto mtime = it->last_write_time(fec);
+        if (fec) {
+            continue;
+        }
+        total += size;
+        files.push_back(std::make_pair(mtime, it->path()));
+    }
+    if (total <= disk_budget_) {
+        return;
+    }
+    std::sort(files.begin(), files.end());
+    for (const auto & f : files) {
+        if (total <= disk_budget_) {
+            break;
+        }
+        std::error_code rec;
+        auto size = std::filesystem::file_size(f.second, rec);
+        if (!rec && std::filesystem::remove(f.second, rec)) {
+            total -= size;
+        }
+    }
+}
+
+}  // namespace dexpert
@@ -0,0 +1,57 @@
+/*
+ * Copyright (C) 2023 by Rodrigo Antonio de Araujo
+ */
+#ifndef SRC_IMAGES_PRE_PROCESS_CACHE_H_
+#define SRC_IMAGES_PRE_PROCESS_CACHE_H_
+
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+
+#include "src/python/raw_image.h"
+
+namespace dexpert
+{
+
+class PreProcessCache;
+
+std::shared_ptr<PreProcessCache> get_pre_process_cache();
+
+/*
+    Control images produced by the pre-processors, keyed by (mode, params, content hash of the input).
+    The least recently used images leave the memory when the memory budget is over, and they are also
+    written (lz compressed) to <config dir>/pre_process, whose oldest files go away when the disk
+    budget is over. The images are copied in and out, so painting over a result does not change it.
+*/
+class PreProcessCache {
+ public:
+    PreProcessCache(const std::wstring& directory, size_t memory_budget, size_t disk_budget);
+    PreProcessCache (const PreProcessCache &) = delete;
+    PreProcessCache & operator = (const PreProcessCache &) = delete;
+
+    image_ptr_t get(const std::string& mode, RawImage *source, const std::string& params = std::string());
+    void put(const std::string& mode, RawImage *source, const std::string& params, image_ptr_t result);
+
+ private:
+    std::string makeKey(const std::string& mode, RawImage *source, const std::string& params);
+    std::wstring filePath(const std::string& key);
+    void keep(const std::string& key, image_ptr_t image);
+    image_ptr_t readFile(const std::string& key);
+    void writeFile(const std::string& key, RawImage *image);
+    void enforceDiskBudget();
+
+ private:
+    typedef std::list<std::pair<std::string, image_ptr_t> > lru_t;
+
+    std::wstring directory_;
+    size_t memory_budget_;
+    size_t disk_budget_;
+    size_t memory_bytes_ = 0;
+    lru_t lru_;     // the most recently used first
+    std::map<std::string, lru_t::iterator> index_;
+};
+
+}  // namespace dexpert
+
+#endif  // SRC_IMAGES_PRE_PROCESS_CACHE_H_
@@ -0,0 +1,119 @@
+#include "src/data/tracing.h"
+#include "src/images/pre_process_worker.h"
+
+namespace dexpert
+{
+
+PreProcessWorker::PreProcessWorker() {
+}
+
+PreProcessWorker::~PreProcessWorker() {
+    if (!thread_) {
+        return;
+    }
+    {
+        std::unique_lock<std::mutex> lk(mtx_);
+        terminated_ = true;
+    }
+    cond_.notify_all();
+    thread_->join();
+}
+
+bool PreProcessWorker::supports(const std::string& method) {
+    return method == "canny" || method == "scribble";
+}
+
+void PreProcessWorker::submit(const std::string& method, RawImage *image, int threshold) {
+    request_t request;
+    request.method = method;
+    request.threshold = threshold;
+    if (image) {
+        request.image = image->duplicate();  // the gui keeps painting over the original
+    }
+    {
+        std::unique_lock<std::mutex> lk(mtx_);
+        if (has_request_ && !request.image) {
+            request.image = request_.image;  // the replaced request had a new image
+        }
+        request_ = request;
+        has_request_ = true;
+        has_result_ = false;
+        ++submitted_;
+    }
+    if (!thread_) {
+        thread_.reset(new std::thread([this] {
+            run();
+        }));
+    }
+    cond_.notify_one();
+}
+
+bool PreProcessWorker::poll(image_ptr_t *result, std::string *method) {
+    std::unique_lock<std::mutex> lk(mtx_);
+    if (!has_result_) {
+        return false;
+    }
+    has_result_ = false;
+    *result = result_;
+    *method = result_method_;
+    result_.reset();
+    return true;
+}
+
+bool PreProcessWorker::busy() {
+    std::unique_lock<std::mutex> lk(mtx_);
+    return finished_ != submitted_ || has_result_;
+}
+
+void PreProcessWorker::run() {
+    while (true) {
+        request_t request;
+        size_t serial = 0;
+        {
+            std::unique_lock<std::mutex> lk(mtx_);
+            cond_.wait(lk, [this] { return terminated_ || has_request_; });
+            if (terminated_) {
+                break;
+            }
+            request = request_;
+            request_ = request_t();
+            has_request_ = false;
+            serial = submitted_;
+        }
+
+        image_ptr_t result;
+        {
+            TRACE_SCOPE("native::pre_process");
+            if (request.image) {
+                map_image_ = request.image;
+                map_method_.clear();
+            }
+            if (map_image_ && map_method_ != request.method) {
+                if (request.method == "canny") {
+                    map_ = canny_map(map_image_.get());
+                } else {
+                    map_ = scribble_map(map_image_.get());
+                }
+                map_method_ = request.method;
+            }
+            if (map_image_) {
+                if (request.method == "canny") {
+                    // the python pre-processor uses 100 and 200
+                    result = canny_threshold(map_, request.threshold, request.threshold * 2);
+                } else {
+                    result = scribble_threshold(map_, request.threshold);
+                }
+            }
+        }
+
+        std::unique_lock<std::mutex> lk(mtx_);
+        if (serial == submitted_) {
+            result_ = result;
+            result_method_ = request.method;
+            has_result_ = true;
+        }
+        finished_ = serial;
+    }
+}
+
+}  // namespace dexpert
@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2023 by Rodrigo Antonio de Araujo
+ */
+#ifndef SRC_IMAGES_PRE_PROCESS_WORKER_H_
+#define SRC_IMAGES_PRE_PROCESS_WORKER_H_
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <condition_variable>
+
+#include "src/images/edge_detection.h"
+
+namespace dexpert
+{
+
+/*
+    Runs the native pre-processors (canny and scribble) in a worker thread, so they never wait for
+    python and never freeze the gui. Only the latest request matters: a request replaces the one
+    waiting to run. The edge map of the last image is kept, a request without image only changes
+    the threshold. The gui thread calls poll() to receive the result.
+*/
+class PreProcessWorker {
+ public:
+    PreProcessWorker();
+    ~PreProcessWorker();
+    PreProcessWorker (const PreProcessWorker &) = delete;
+    PreProcessWorker & operator = (const PreProcessWorker &) = delete;
+
+    static bool supports(const std::string& method);
+    // copies the image, pass NULL to reuse the image of the previous request
+    void submit(const std::string& method, RawImage *image, int threshold);
+    // returns true when the result of the latest request is ready
+    bool poll(image_ptr_t *result, std::string *method);
+    // true while there is a request to run or a result to poll
+    bool busy();
+
+ private:
+    typedef struct {
+        std::string method;
+        image_ptr_t image;
+        int threshold = 0;
+    } request_t;
+
+    void run();
+
+ private:
+    bool terminated_ = false;
+    bool has_request_ = false;
+    bool has_result_ = false;
+    request_t request_;
+    size_t submitted_ = 0;
+    size_t finished_ = 0;
+    image_ptr_t result_;
+    std::string result_method_;
+    std::mutex mtx_;
+    std::condition_variable cond_;
+    std::unique_ptr<std::thread> thread_;
+    // used only by the worker thread
+    edge_map_t map_;
+    std::string map_method_;
+    image_ptr_t map_image_;
+};
+
+}  // namespace dexpert
+
+#endif  // SRC_IMAGES_PRE_PROCESS_WORKER_H_
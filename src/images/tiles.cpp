@@ -0,0 +1,237 @@
+#include <math.h>
+#include <algorithm>
+
+#include "src/data/tracing.h"
+#include "src/images/tiles.h"
+
+namespace dexpert
+{
+
+namespace {
+
+    // tile positions along one axis, the first starts at 0 and the last ends at size
+    std::vector<int> plan_axis(int size, int tile, int overlap) {
+        std::vector<int> result;
+        if (size <= tile) {
+            result.push_back(0);
+            return result;
+        }
+        overlap = std::min(std::max(overlap, 0), tile / 2);
+        int stride = tile - overlap;
+        int count = (size - overlap + stride - 1) / stride;
+        if (count < 2) {
+            count = 2;
+        }
+        for (int i = 0; i < count; ++i) {
+            result.push_back((int) ((int64_t) (size - tile) * i / (count - 1)));
+        }
+        return result;
+    }
+
+    float seam_weight(float t, seam_blend_t blend) {
+        if (t >= 1.0f) {
+            return 1.0f;
+        }
+        if (blend == seam_cosine) {
+            return 0.5f - 0.5f * cosf(t * (float) M_PI);
+        }
+        return t;
+    }
+
+    int scaled(int value, float scale) {
+        return (int) lroundf(value * scale);
+    }
+
+}  // unnamed namespace
+
+std::vector<tile_rect_t> plan_tiles(int image_w, int image_h, int tile_w, int tile_h, int overlap) {
+    std::vector<tile_rect_t> result;
+    if (image_w < 1 || image_h < 1 || tile_w < 1 || tile_h < 1) {
+        return result;
+    }
+    auto xs = plan_axis(image_w, tile_w, overlap);
+    auto ys = plan_axis(image_h, tile_h, overlap);
+    for (int y : ys) {
+        for (int x : xs) {
+            tile_rect_t r;
+            r.x = x;
+            r.y = y;
+            r.w = std::min(tile_w, image_w);
+            r.h = std::min(tile_h, image_h);
+            result.push_back(r);
+        }
+    }
+    return result;
+}
+
+std::vector<restore_window_t> plan_restore_windows(int image_w, int image_h, int core, int margin) {
+    std::vector<restore_window_t> result;
+    if (image_w < 1 || image_h < 1 || core < 1) {
+        return result;
+    }
+    margin = std::max(margin, 0);
+    const int columns = (image_w + core - 1) / core;
+    const int rows = (image_h + core - 1) / core;
+    for (int row = 0; row < rows; ++row) {
+        const int y0 = (int) ((int64_t) image_h * row / rows);
+        const int y1 = (int) ((int64_t) image_h * (row + 1) / rows);
+        for (int column = 0; column < columns; ++column) {
+            const int x0 = (int) ((int64_t) image_w * column / columns);
+            const int x1 = (int) ((int64_t) image_w * (column + 1) / columns);
+            restore_window_t r;
+            r.window.x = std::max(x0 - margin, 0);
+            r.window.y = std::max(y0 - margin, 0);
+            r.window.w = std::min(x1 + margin, image_w) - r.window.x;
+            r.window.h = std::min(y1 + margin, image_h) - r.window.y;
+            r.core.x = x0 - r.window.x;
+            r.core.y = y0 - r.window.y;
+            r.core.w = x1 - x0;
+            r.core.h = y1 - y0;
+            result.push_back(r);
+        }
+    }
+    return result;
+}
+
+TileStitcher::TileStitcher(int image_w, int image_h, float scale, int overlap, seam_blend_t blend, size_t max_in_flight) :
+    out_w_(scaled(image_w, scale)),
+    out_h_(scaled(image_h, scale)),
+    scale_(scale),
+    overlap_(overlap),
+    blend_(blend),
+    max_in_flight_(std::max<size_t>(max_in_flight, 1)) {
+}
+
+TileStitcher::~TileStitcher() {
+    if (!thread_) {
+        return;
+    }
+    {
+        std::unique_lock<std::mutex> lk(mtx_);
+        terminated_ = true;
+    }
+    cond_.notify_all();
+    thread_->join();
+}
+
+void TileStitcher::add(const tile_rect_t& source, image_ptr_t result) {
+    if (!result) {
+        return;
+    }
+    {
+        std::unique_lock<std::mutex> lk(mtx_);
+        cond_.wait(lk, [this] { return pending_.size() < max_in_flight_; });
+        pending_.push_back({source, result});
+    }
+    if (!thread_) {
+        thread_.reset(new std::thread([this] {
+            run();
+        }));
+    }
+    cond_.notify_all();
+}
+
+image_ptr_t TileStitcher::finish() {
+    std::unique_lock<std::mutex> lk(mtx_);
+    cond_.wait(lk, [this] { return pending_.empty() && !pasting_; });
+    if (!error_.empty()) {
+        return image_ptr_t();
+    }
+    return output_;
+}
+
+const char *TileStitcher::lastError() const {
+    return error_.c_str();
+}
+
+void TileStitcher::run() {
+    while (true) {
+        pending_tile_t tile;
+        {
+            std::unique_lock<std::mutex> lk(mtx_);
+            cond_.wait(lk, [this] { return terminated_ || !pending_.empty(); });
+            if (terminated_) {
+                break;
+            }
+            tile = pending_.front();
+            pending_.pop_front();
+            pasting_ = error_.empty();
+        }
+        cond_.notify_all();  // add() may be waiting for room
+        if (!pasting_) {
+            continue;  // a previous tile failed, the result is discarded
+        }
+
+        paste(tile.source, tile.result.get());
+
+        {
+            std::unique_lock<std::mutex> lk(mtx_);
+            pasting_ = false;
+        }
+        cond_.notify_all();
+    }
+}
+
+void TileStitcher::paste(const tile_rect_t& source, RawImage *result) {
+    TRACE_SCOPE("TileStitcher::paste");
+    if (!output_) {
+        output_.reset(new RawImage(NULL, out_w_, out_h_, result->format(), false));
+    }
+    const int x0 = scaled(source.x, scale_);
+    const int y0 = scaled(source.y, scale_);
+    const int w = std::min(scaled(source.x + source.w, scale_), out_w_) - x0;
+    const int h = std::min(scaled(source.y + source.h, scale_), out_h_) - y0;
+    if (w < 1 || h < 1) {
+        return;
+    }
+    image_ptr_t resized;
+    if ((int) result->w() != w || (int) result->h() != h) {
+        resized = result->resizeImage(w, h);
+        result = resized.get();
+    }
+    if (result->format() != output_->format()) {
+        // the tiles of a job come from the same python function, they should have the same format
+        std::unique_lock<std::mutex> lk(mtx_);
+        error_ = "The format of a tile does not match the previous tiles";
+        return;
+    }
+
+    // the overlap fades in only over the tiles that were pasted before (at the left and at the top),
+    // plan_tiles does not overlap more than half of the tile
+    const int overlap_x = std::min(overlap_, source.w / 2);
+    const int overlap_y = std::min(overlap_, source.h / 2);
+    const int fade_w = std::max(scaled(overlap_x, scale_), 1);
+    const int fade_h = std::max(scaled(overlap_y, scale_), 1);
+    const bool fade_x = source.x > 0 && overlap_x > 0;
+    const bool fade_y = source.y > 0 && overlap_y > 0;
+    const int channels = output_->channels();
+    std::vector<float> column_weight(w, 1.0f);
+    if (fade_x) {
+        for (int x = 0; x < w && x < fade_w; ++x) {
+            column_weight[x] = seam_weight((x + 0.5f) / fade_w, blend_);
+        }
+    }
+
+    std::vector<unsigned char> tile_row((size_t) w * channels);
+    std::vector<unsigned char> out_row((size_t) w * channels);
+    for (int y = 0; y < h; ++y) {
+        result->getPixels(0, y, w, 1, tile_row.data());
+        const float row_weight = fade_y ? seam_weight((y + 0.5f) / fade_h, blend_) : 1.0f;
+        if (row_weight >= 1.0f && !fade_x) {
+            output_->setPixels(x0, y0 + y, w, 1, tile_row.data());
+            continue;
+        }
+        output_->getPixels(x0, y0 + y, w, 1, out_row.data());
+        unsigned char *o = out_row.data();
+        const unsigned char *t = tile_row.data();
+        for (int x = 0; x < w; ++x) {
+            const float a = column_weight[x] * row_weight;
+            for (int c = 0; c < channels; ++c, ++o, ++t) {
+                *o = (unsigned char) (*o + (*t - *o) * a + 0.5f);
+            }
+        }
+        output_->setPixels(x0, y0 + y, w, 1, out_row.data());
+    }
+}
+
+}  // namespace dexpert
@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2023 by Rodrigo Antonio de Araujo
+ */
+#ifndef SRC_IMAGES_TILES_H_
+#define SRC_IMAGES_TILES_H_
+
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <condition_variable>
+
+#include "src/python/raw_image.h"
+
+namespace dexpert
+{
+
+typedef struct {
+    int x = 0;
+    int y = 0;
+    int w = 0;
+    int h = 0;
+} tile_rect_t;
+
+typedef enum {
+    seam_linear,
+    seam_cosine
+} seam_blend_t;
+
+// splits the image in tiles of tile_w x tile_h (smaller only when the image is smaller) in rows (left to right,
+// top to bottom). The tiles are spread evenly, the neighbors overlap at least `overlap` pixels.
+std::vector<tile_rect_t> plan_tiles(int image_w, int image_h, int tile_w, int tile_h, int overlap);
+
+typedef struct {
+    tile_rect_t window;     // the crop of the image that is processed
+    tile_rect_t core;       // inside the window (relative to it), the cores of all the windows cover the image once
+} restore_window_t;
+
+// splits the image in cores of at most core x core pixels that do not overlap (spread evenly, in rows),
+// each window adds up to `margin` pixels around its core. The face restoration uses them: a face is restored
+// by the window whose core has its center, the margin keeps faces up to about `margin` pixels wide whole.
+std::vector<restore_window_t> plan_restore_windows(int image_w, int image_h, int core, int margin);
+
+/*
+    Builds the result of a tiled job: the tiles are pasted over the previous ones in the order of plan_tiles,
+    the `overlap` pixels at the left and at the top of each tile fade in over its neighbors (at most half
+    of the tile, as plan_tiles does).
+    The results can be scaled (the upscaler), the tile is resized to its place when the size does not match.
+    A worker thread pastes the tiles while python processes the next ones. add() waits when max_in_flight
+    results are waiting, so the memory depends on the tile size, not on the number of tiles.
+*/
+class TileStitcher {
+ public:
+    TileStitcher(int image_w, int image_h, float scale, int overlap, seam_blend_t blend, size_t max_in_flight = 2);
+    ~TileStitcher();
+    TileStitcher (const TileStitcher &) = delete;
+    TileStitcher & operator = (const TileStitcher &) = delete;
+
+    // source is the tile rectangle in the input image
+    void add(const tile_rect_t& source, image_ptr_t result);
+    // waits for the pending tiles, returns NULL if no tile was added or a tile failed (see lastError)
+    image_ptr_t finish();
+    // call it after finish()
+    const char *lastError() const;
+
+ private:
+    typedef struct {
+        tile_rect_t source;
+        image_ptr_t result;
+    } pending_tile_t;
+
+    void run();
+    void paste(const tile_rect_t& source, RawImage *result);
+
+ private:
+    int out_w_;
+    int out_h_;
+    float scale_;
+    int overlap_;
+    seam_blend_t blend_;
+    size_t max_in_flight_;
+    bool terminated_ = false;
+    bool pasting_ = false;
+    std::deque<pending_tile_t> pending_;
+    image_ptr_t output_;
+    std::string error_;
+    std::mutex mtx_;
+    std::condition_variable cond_;
+    std::unique_ptr<std::thread> thread_;
+};
+
+}  // namespace dexpert
+
+#endif  // SRC_IMAGES_TILES_H_
@@ -1,5 +1,10 @@
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
 #include <iostream>
+#include <string>
 #include <thread>
+#include <filesystem>
 
 #ifdef _WIN32
 #include <Windows.h>
@@ -11,6 +16,10 @@
 #include "src/windows/console_viewer.h"
 #include "src/windows/main_window.h"
 #include "src/windows/splash_screen.h"
+#include "src/console/emulated_terminal.h"
+#include "src/config/config.h"
+#include "src/data/tracing.h"
+#include "src/batch/headless_runner.h"
 
 #include "src/stable_diffusion/state.h"
 #include "src/stable_diffusion/generator_txt2img.h"
@@ -66,15 +75,90 @@ bool install_deps() {
 }
 
 
+std::wstring trace_file(int argc, char **argv) {
+    // --trace [path] or general.trace_enabled at the configuration file
+    bool enabled = dexpert::getConfig().getTraceEnabled();
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--trace") != 0) {
+            continue;
+        }
+        if (i + 1 < argc && strncmp(argv[i + 1], "--", 2) != 0) {
+            return std::filesystem::u8path(argv[i + 1]).wstring();
+        }
+        enabled = true;
+    }
+    if (!enabled) {
+        return std::wstring();
+    }
+    return dexpert::getConfig().getConfigDir() + L"/traces/trace-" + std::to_wstring(time(NULL)) + L".json";
+}
+
+const int kDEFAULT_SERVER_PORT = 8765;
+
+bool has_argument(int argc, char **argv, const char *name) {
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+const char *argument_value(int argc, char **argv, const char *name) {
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (strcmp(argv[i], name) == 0) {
+            return argv[i + 1];
+        }
+    }
+    return NULL;
+}
+
 int main(int argc, char **argv)
 {
     int result = 0;
+    std::wstring trace_path = trace_file(argc, argv);
+    if (!trace_path.empty()) {
+        dexpert::start_tracing(trace_path);
+    }
+
+    const char *headless_jobs = argument_value(argc, argv, "--headless");
+    bool serve = has_argument(argc, argv, "--serve");
+    if (headless_jobs || serve) {
+        // no windows at all:
+        //   diffusion-exp --headless <jobs.jsonl | -> [--output <directory>]
+        //   diffusion-exp --serve [port] [--output <directory>]
+        const char *output_dir = argument_value(argc, argv, "--output");
+        const char *port = argument_value(argc, argv, "--serve");
+        std::thread worker_thread([&result, headless_jobs, output_dir, port] {
+            dexpert::set_trace_thread_name("headless");
+            if (headless_jobs) {
+                result = dexpert::run_headless(headless_jobs, output_dir ? output_dir : ".");
+            } else {
+                int port_number = port && port[0] != '-' ? atoi(port) : kDEFAULT_SERVER_PORT;
+                result = dexpert::run_job_server(port_number, output_dir ? output_dir : ".");
+            }
+        });
+        dexpert::py::py_main();
+        worker_thread.join();
+        if (!trace_path.empty()) {
+            dexpert::stop_tracing();
+        }
+        return result;
+    }
+
+    // before python prints anything, so the console windows show all the output
+    dexpert::start_console_capture();
+
     /*
         It runs the gui in a secodary thread to let python to use the main thread.
         Python should use the main thread to avoid the app to hang unloading some libraries (ex. PyTorch).
     */
     std::thread gui_thread([&result] {
+        dexpert::set_trace_thread_name("gui");
         Fl::scheme("gtk+");
+        size_t scrollback_limit = (size_t) dexpert::getConfig().getConsoleScrollbackMB() * 1024 * 1024;
+        dexpert::get_terminal(dexpert::log_source_stdout)->setScrollbackLimit(scrollback_limit);
+        dexpert::get_terminal(dexpert::log_source_stderr)->setScrollbackLimit(scrollback_limit);
         /*
         for (int i = 0; i < 100; i++) {
             dexpert::test_generators();
@@ -128,5 +212,8 @@ int main(int argc, char **argv)
 
     dexpert::py::py_main();
     gui_thread.join();
+    if (!trace_path.empty() && !dexpert::stop_tracing()) {
+        fprintf(stderr, "Could not write the trace file\n");
+    }
     return result;
 }
@@ -0,0 +1,131 @@
+#include <chrono>
+#include <vector>
+#include <algorithm>
+
+#include <FL/Fl.H>
+
+#include "src/opengl_utils/frame_scheduler.h"
+
+namespace dexpert
+{
+
+namespace {
+    const double kFRAME_INTERVAL = 1.0 / 60.0;
+
+    typedef std::chrono::steady_clock clock_type_t;
+
+    typedef struct {
+        frame_callback_t cb;
+        void *cbdata;
+    } pending_frame_t;
+
+    typedef struct {
+        Fl_Widget *widget;
+        uchar damage;
+    } damaged_widget_t;
+
+    bool timer_armed = false;
+    std::vector<pending_frame_t> pending_callbacks;
+    std::vector<damaged_widget_t> damaged_widgets;
+
+    frame_stats_t stats;
+    size_t window_wakeups = 0;
+    clock_type_t::time_point window_start = clock_type_t::now();
+
+    void update_wakeup_rate(clock_type_t::time_point now) {
+        double elapsed = std::chrono::duration<double>(now - window_start).count();
+        if (elapsed < 1.0) {
+            return;
+        }
+        stats.wakeups_per_second = window_wakeups / elapsed;
+        window_wakeups = 0;
+        window_start = now;
+    }
+
+    void run_frame(void *);
+
+    void arm_timer() {
+        if (timer_armed) {
+            return;
+        }
+        timer_armed = true;
+        Fl::add_timeout(kFRAME_INTERVAL, run_frame, NULL);
+    }
+
+    void run_frame(void *) {
+        timer_armed = false;
+        auto start = clock_type_t::now();
+
+        // callbacks scheduled while we run are executed in the next frame
+        std::vector<pending_frame_t> callbacks;
+        callbacks.swap(pending_callbacks);
+        for (auto it = callbacks.begin(); it != callbacks.end(); it++) {
+            it->cb(it->cbdata);
+        }
+
+        std::vector<damaged_widget_t> widgets;
+        widgets.swap(damaged_widgets);
+        for (auto it = widgets.begin(); it != widgets.end(); it++) {
+            if (it->widget->visible_r()) {
+                if (it->damage & FL_DAMAGE_ALL) {
+                    it->widget->redraw();
+                } else {
+                    it->widget->damage(it->damage);
+                }
+                ++stats.redraws;
+            }
+        }
+        if (!widgets.empty()) {
+            Fl::flush();
+        }
+
+        auto end = clock_type_t::now();
+        float frame_ms = std::chrono::duration<float, std::milli>(end - start).count();
+        if (stats.frames == 0) {
+            stats.frame_time_ms = frame_ms;
+        } else {
+            stats.frame_time_ms = stats.frame_time_ms * 0.9 + frame_ms * 0.1;
+        }
+        ++stats.frames;
+        ++window_wakeups;
+        update_wakeup_rate(end);
+    }
+
+}  // unnamed namespace
+
+void schedule_frame(frame_callback_t cb, void *cbdata) {
+    for (auto it = pending_callbacks.begin(); it != pending_callbacks.end(); it++) {
+        if (it->cb == cb && it->cbdata == cbdata) {
+            return;
+        }
+    }
+    pending_callbacks.push_back({cb, cbdata});
+    arm_timer();
+}
+
+void damage_widget(Fl_Widget *widget, uchar damage) {
+    for (auto it = damaged_widgets.begin(); it != damaged_widgets.end(); it++) {
+        if (it->widget == widget) {
+            it->damage |= damage;
+            return;
+        }
+    }
+    damaged_widgets.push_back({widget, damage});
+    arm_timer();
+}
+
+void cancel_frame(void *cbdata) {
+    pending_callbacks.erase(std::remove_if(pending_callbacks.begin(), pending_callbacks.end(), [cbdata] (const pending_frame_t &p) {
+        return p.cbdata == cbdata;
+    }), pending_callbacks.end());
+    damaged_widgets.erase(std::remove_if(damaged_widgets.begin(), damaged_widgets.end(), [cbdata] (const damaged_widget_t &d) {
+        return (void *) d.widget == cbdata;
+    }), damaged_widgets.end());
+}
+
+frame_stats_t get_frame_stats() {
+    update_wakeup_rate(clock_type_t::now());
+    return stats;
+}
+
+} // namespace dexpert
@@ -0,0 +1,38 @@
+/*
+ * Copyright (C) 2023 by Rodrigo Antonio de Araujo
+ */
+#ifndef SRC_OPENGL_UTILS_FRAME_SCHEDULER_H_
+#define SRC_OPENGL_UTILS_FRAME_SCHEDULER_H_
+
+#include <stddef.h>
+
+#include <FL/Fl.H>
+#include <FL/Fl_Widget.H>
+
+namespace dexpert
+{
+
+typedef void (*frame_callback_t)(void *cbdata);
+
+typedef struct {
+    float wakeups_per_second = 0;  // frames executed during the latest second
+    float frame_time_ms = 0;       // average time spent in callbacks + drawing
+    size_t frames = 0;             // total frames since the application started
+    size_t redraws = 0;            // total widgets redrawn since the application started
+} frame_stats_t;
+
+/*
+    All the widgets share a single frame timer.
+    The timer is armed only when there is something to do, so an idle application does not wake up.
+    Callbacks run once in the next frame (reschedule to run again) and damaged widgets are redrawn after them.
+*/
+void schedule_frame(frame_callback_t cb, void *cbdata);
+// damage is FL_DAMAGE_ALL or a mask the widget handles in its draw (e.g. FL_DAMAGE_USER1 for a partial redraw)
+void damage_widget(Fl_Widget *widget, uchar damage = FL_DAMAGE_ALL);
+// call it at the widget destructor
+void cancel_frame(void *cbdata);
+frame_stats_t get_frame_stats();
+
+} // namespace dexpert
+
+#endif  // SRC_OPENGL_UTILS_FRAME_SCHEDULER_H_
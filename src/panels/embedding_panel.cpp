@@ -3,6 +3,7 @@
 #include "src/dialogs/common_dialogs.h"
 #include "src/data/event_manager.h"
 #include "src/data/xpm.h"
+#include "src/data/thumbnail_cache.h"
 #include "src/python/helpers.h"
 #include "src/python/wrapper.h"
 
@@ -61,7 +62,21 @@ EmbeddingPanel::EmbeddingPanel(embedding_type_t embedding_type, int x, int y, in
 }
 
 EmbeddingPanel::~EmbeddingPanel() {
+    Fl::remove_timeout(EmbeddingPanel::thumbnailsLoaded, this);
+}
+
+void EmbeddingPanel::thumbnailsLoaded(void *cbdata) {
+    ((EmbeddingPanel *) cbdata)->thumbnailsLoaded();
+}
 
+void EmbeddingPanel::thumbnailsLoaded() {
+    auto thumbnails = get_thumbnail_cache();
+    if (thumbnails->poll()) {
+        updateData();
+    }
+    if (thumbnails->pending()) {
+        Fl::repeat_timeout(0.05, EmbeddingPanel::thumbnailsLoaded, this);
+    }
 }
 
 void EmbeddingPanel::resize(int x, int y, int w, int h) {
@@ -174,10 +189,14 @@ void EmbeddingPanel::updateData() {
         }
     }
 
+    auto thumbnails = get_thumbnail_cache();
     for (int i = 0; i < images_.size(); ++i) {
         int pos = index_ + i;
         images_[i]->setTag(pos);
         if (pos < embedded_.size()) {
+            if (!embedded_[pos].img) {
+                embedded_[pos].img = thumbnails->get(embedded_[pos].path);
+            }
             labels_[i]->copy_label(embedded_[pos].name_short.c_str());
             images_[i]->setPicture(embedded_[pos].img);
             images_[i]->copy_tooltip(embedded_[pos].name.c_str());
@@ -186,6 +205,10 @@ void EmbeddingPanel::updateData() {
             images_[i]->clearPicture();
         }
     }
+
+    if (thumbnails->pending() && !Fl::has_timeout(EmbeddingPanel::thumbnailsLoaded, this)) {
+        Fl::add_timeout(0.05, EmbeddingPanel::thumbnailsLoaded, this);
+    }
 }
 
 void EmbeddingPanel::update(bool force) {
@@ -205,6 +228,9 @@ void EmbeddingPanel::update(bool force) {
             })
         );
         embedded_cache = temp;
+        if (force) {
+            get_thumbnail_cache()->clear();
+        }
     }
 
     if (errorMessage) {
@@ -241,17 +267,10 @@ void EmbeddingPanel::setSelectedImage(image_ptr_t image) {
             if (images_[i]->getPicture() && !ask("Replace the image ?")) {
                 return;
             }
-            images_[i]->setPicture(image);
-            if (images_[i]->visible_r()) {
-                images_[i]->redraw();
-            }
             std::string path = embedded_[selected_].path;
-            embedded_[selected_].img = image;
-            if (embedded_cache.size() > selected_) {
-                auto it = embedded_cache.begin();
-                std::advance(it, selected_);
-                it->img = image;
-            }
+            get_thumbnail_cache()->put(path, image);
+            embedded_[selected_].img = get_thumbnail_cache()->get(path);
+            images_[i]->setPicture(embedded_[selected_].img);
             path += ".jpg";
             bool success = false;
             const char *msg = NULL;
@@ -263,8 +282,6 @@ void EmbeddingPanel::setSelectedImage(image_ptr_t image) {
             );
             if (msg) {
                 show_error(msg);
-            } else {
-                embedded_cache.clear();
             }
             return;
         }
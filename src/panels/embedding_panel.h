@@ -50,6 +50,8 @@ class EmbeddingPanel: public EventListener, public Fl_Group {
   private:
     void alignComponents();
     void updateData();
+    static void thumbnailsLoaded(void *cbdata);
+    void thumbnailsLoaded();
 
   private:
     embedding_type_t embedding_type_ = embedding_textual_inv;
@@ -5,6 +5,7 @@
 
 #include "src/config/config.h"
 #include "src/opengl_utils/routines.h"
+#include "src/opengl_utils/frame_scheduler.h"
 #include "src/data/event_manager.h"
 #include "src/panels/miniature.h"
 
@@ -20,24 +21,10 @@ Miniature::Miniature(uint32_t x, uint32_t y, uint32_t w, uint32_t h): Fl_Gl_Wind
     vp_[2] = this->w();
     vp_[3] = this->h();
     valid(0);
-    Fl::add_timeout(0.01, Miniature::imageRefresh, this);
 }
 
 Miniature::~Miniature() {
-     Fl::remove_timeout(Miniature::imageRefresh, this);
-}
-
-void Miniature::imageRefresh(void *cbdata) {
-    ((Miniature *) cbdata)->imageRefresh();
-    Fl::repeat_timeout(0.018, Miniature::imageRefresh, cbdata); // retrigger timeout
-}
-
-void Miniature::imageRefresh() {
-    if (!should_refresh_) return;
-    should_refresh_ = true;
-    if (!visible_r()) return;
-    if (!getConfig().getPrivacyMode()) return;
-    redraw();
+    cancel_frame(this);
 }
 
 
@@ -47,16 +34,12 @@ void Miniature::setPicture(image_ptr_t image) {
         return;
     }
     image_ = image;
-    if (visible_r()) {
-        redraw();
-    }
+    damage_widget(this);
 }
 
 void Miniature::clearPicture() {
     image_.reset();
-    if (visible_r()) {
-        redraw();
-    }
+    damage_widget(this);
 }
 
 RawImage *Miniature::getPicture() {
@@ -96,7 +79,9 @@ int Miniature::handle(int event) {
                 mouse_down_y_ = Fl::event_y();
             }
             mouse_move(mouse_down_left_, mouse_down_right_, mouse_down_x_, mouse_down_y_, Fl::event_x(), Fl::event_y());
-            should_refresh_ = true;
+            if (getConfig().getPrivacyMode()) {
+                damage_widget(this); // the blur follows the mouse
+            }
         } break;
 
         case FL_PUSH: {
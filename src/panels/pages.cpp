@@ -1,7 +1,9 @@
 #include "src/dialogs/common_dialogs.h"
+#include "src/dialogs/utils.h"
 #include "src/stable_diffusion/state.h"
 #include "src/stable_diffusion/generator_txt2img.h"
 #include "src/stable_diffusion/generator_img2img.h"
+#include "src/stable_diffusion/sweep.h"
 #include "src/config/config.h"
 
 #include "src/panels/pages.h"
@@ -180,6 +182,24 @@ void Pages::refreshModels() {
     promptPanel_->refreshModels();
 }
 
+controlnet_list_t Pages::getControlnets() {
+    controlnet_list_t controlnets;
+
+    std::shared_ptr c = inputImage_->getControlnet();
+
+    if (c) {
+        controlnets.push_back(c);
+    }
+
+    for (int i = 0; i < COUNTOF(controlNets_); ++i) {
+        c = controlNets_[i]->getControlnet();
+        if (c) {
+            controlnets.push_back(c);
+        }
+    }
+    return controlnets;
+}
+
 void Pages::textToImage() {
     if (!promptPanel_->ready(false)) {
         return;
@@ -200,20 +220,7 @@ void Pages::textToImage() {
         return;
     }
 
-    controlnet_list_t controlnets;
-
-    std::shared_ptr c = inputImage_->getControlnet();
-
-    if (c) {
-        controlnets.push_back(c);
-    }
-
-    for (int i = 0; i < COUNTOF(controlNets_); ++i) {
-        c = controlNets_[i]->getControlnet();
-        if (c) {
-            controlnets.push_back(c);
-        }
-    }
+    controlnet_list_t controlnets = getControlnets();
     
     bool reload = promptPanel_->shouldReload(true);
 
@@ -260,7 +267,9 @@ void Pages::textToImage() {
             false,
             reload,
             inputImage_->maskBlurEnabled() ? getConfig().inpaint_get_mask_blur() : 0,
-            inputImage_->getInpaintMode()
+            inputImage_->getInpaintMode(),
+            getConfig().inpaint_get_mask_padding(),
+            inputImage_->tiledEnabled()
         ));
     } else {
         g.reset(new GeneratorTxt2Image(
@@ -278,7 +287,8 @@ void Pages::textToImage() {
             promptPanel_->getVariationStrength(),
             promptPanel_->shouldRestoreFaces(),
             false,
-            reload
+            reload,
+            ""
         ));
     }
 
@@ -290,4 +300,73 @@ void Pages::textToImage() {
     }
 }
 
+void Pages::parameterSweep() {
+    if (!promptPanel_->ready(false)) {
+        return;
+    }
+    if (inputImage_->getImg2ImgImage()) {
+        show_error("The parameter sweep generates text to image only, remove the input image first!");
+        return;
+    }
+    const char* model = promptPanel_->getSdModel(false);
+    if (model == NULL) {
+        show_error("Add a model file (.safetensors or .ckpt) into 'models/stable diffusion' directory before you start!");
+        return;
+    }
+
+    sweep_axis_t axes[2];
+    const char *questions[2] = {
+        "Sweep columns (cfg=5,7.5,9 steps=20,30 seed=1,2 scheduler=PNDMScheduler,DDIMScheduler or lora:name=0.2,0.6)",
+        "Sweep rows (the same fields, empty for a single row)"
+    };
+    for (int i = 0; i < 2; ++i) {
+        const char *value = ask_value(questions[i]);
+        if (value == NULL) {
+            return;
+        }
+        std::string error;
+        if (!parse_sweep_axis(value, &axes[i], &error)) {
+            show_error(error.c_str());
+            return;
+        }
+    }
+    if (axes[0].values.empty() && axes[1].values.empty()) {
+        show_error("The parameter sweep requires at least one axis!");
+        return;
+    }
+
+    sweep_base_t base;
+    base.prompt = promptPanel_->getPrompt();
+    base.negative = promptPanel_->getNegativePrompt();
+    base.model = get_sd_state()->getSdModelPath(model);
+    base.controlnets = getControlnets();
+    base.seed = promptPanel_->getSeed();
+    base.width = promptPanel_->getWidth();
+    base.height = promptPanel_->getHeight();
+    base.steps = promptPanel_->getSteps();
+    base.cfg = promptPanel_->getCFG();
+    base.restore_faces = promptPanel_->shouldRestoreFaces();
+    base.reload_model = promptPanel_->shouldReload(true);
+
+    get_sd_state()->clearGenerators();
+    ParameterSweep sweep(base, axes[0], axes[1]);
+    size_t generated = 0;
+    const size_t cells = sweep.columns() * sweep.rows();
+    bool success = sweep.run([this, &generated, cells] (const sweep_cell_t&, image_ptr_t image, RawImage *sheet) {
+        if (image) {
+            ++generated;
+        }
+        char title[100] = "";
+        sprintf(title, "sweep %d of %d", (int)generated, (int)cells);
+        resultsPanel_->showImage(sheet, title);
+        return true;
+    });
+    if (!success) {
+        show_error(sweep.lastError());
+    }
+    if (generated > 0) {
+        save_image_with_dialog(sweep.contactSheet());
+    }
+}
+
 }   // namespace dexpert
@@ -12,6 +12,7 @@
 #include "src/panels/prompt_panel.h"
 #include "src/panels/preview_panel.h"
 #include "src/python/raw_image.h"
+#include "src/stable_diffusion/generator_txt2img.h"
 
 namespace dexpert
 {
@@ -42,6 +43,8 @@ class Pages: public Fl_Group {
 
     const char *pageTitle(page_t page);
     void textToImage();
+    // asks the axes, generates the grid and offers to save the contact sheet
+    void parameterSweep();
     void loadConfig();
     void setInputImage(RawImage *img, painting_mode_t mode);
     RawImage *getInputImage();
@@ -52,6 +55,7 @@ class Pages: public Fl_Group {
 
  private:
     void alignComponents();
+    controlnet_list_t getControlnets();
 
  private:
     page_t active_page_ = page_prompts;
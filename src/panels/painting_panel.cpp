@@ -5,6 +5,7 @@
 #include "src/dialogs/utils.h"
 #include "src/python/helpers.h"
 #include "src/python/wrapper.h"
+#include "src/images/pre_process_cache.h"
 
 #include "src/data/xpm.h"
 
@@ -14,6 +15,9 @@ namespace dexpert
 {
 
 namespace {
+    const int kCANNY_THRESHOLD = 100;     // the high threshold is the double
+    const int kSCRIBBLE_THRESHOLD = 32;
+
     const char *modes_text[painting_mode_max] = {
         "Disabled",
         "Img2Img",
@@ -62,7 +66,9 @@ namespace {
         "Original image",
         "Fill image",
         "Whole image (original)",
-        "Whole image (fill)"
+        "Whole image (fill)",
+        "Only masked (original)",
+        "Only masked (fill)"
         // "Latent Noise",
         //"Latent Nothing"
     };
@@ -94,11 +100,14 @@ PaintingPanel::PaintingPanel(int x, int y, int w, int h,  PromptPanel *prompt, P
         Fl_Group(x, y, w, h), 
         prompt_(prompt), 
         inputPanel_(inputPanel),
-        only_control_net_(only_control_net) {
+        only_control_net_(only_control_net),
+        canny_threshold_(kCANNY_THRESHOLD),
+        scribble_threshold_(kSCRIBBLE_THRESHOLD) {
     this->begin();
     image_panel_ = new ImagePanel(0, 0, 1, 1, [this] {
         updateInfo();
     });
+    image_panel_->enableHistory();
     label_info_ = new Fl_Box(0, 0, 1, 1, "");
     left_bar_ = new Fl_Group(0, 0, 1, 1);
     left_bar_->begin();
@@ -108,7 +117,9 @@ PaintingPanel::PaintingPanel(int x, int y, int w, int h,  PromptPanel *prompt, P
     mode_ = new Fl_Choice(0, 0, 1, 1, "Mode");
     brushes_ = new Fl_Choice(0, 0, 1, 1, "Brush size");
     blur_mask_ = new Fl_Check_Button(0, 0, 1, 1, "Blur mask");
+    tiled_ = new Fl_Check_Button(0, 0, 1, 1, "Tiled");
     inpaintMode_ = new Fl_Choice(0, 0, 1, 1, "Inpaint mode");
+    threshold_ = new Fl_Value_Slider(0, 0, 1, 1, "Threshold");
 
     denoise_ = new Fl_Float_Input(0, 0, 1, 1, "Similarity");
     btnOpen_.reset(new Button(xpm::image(xpm::directory_16x16), [this] {
@@ -220,6 +231,13 @@ PaintingPanel::PaintingPanel(int x, int y, int w, int h,  PromptPanel *prompt, P
     brushes_->value(5);
     brushes_->callback(brushSelected, this);
 
+    threshold_->type(FL_HOR_SLIDER);
+    threshold_->align(FL_ALIGN_TOP_LEFT);
+    threshold_->tooltip("Pre-processor threshold, the lower the more lines");
+    threshold_->bounds(1, 255);
+    threshold_->step(1);
+    threshold_->callback(thresholdChanged, this);
+
     if (!inputPanel_) {
         btnInput_->hide();
     } else {
@@ -227,12 +245,16 @@ PaintingPanel::PaintingPanel(int x, int y, int w, int h,  PromptPanel *prompt, P
     }
     
     blur_mask_->hide();
+    tiled_->hide();
     inpaintMode_->hide();
+    threshold_->hide();
 
     image_panel_->setTool(image_tool_brush);
     image_panel_->setBackgroundColor(255, 255, 255, 255);
 
     blur_mask_->value(1);
+    tiled_->tooltip("Generate the images larger than the output size in overlapping tiles");
+    tiled_->value(0);
 
     alignComponents();
     enableControls();
@@ -240,7 +262,7 @@ PaintingPanel::PaintingPanel(int x, int y, int w, int h,  PromptPanel *prompt, P
 }
 
 PaintingPanel::~PaintingPanel() {
-
+    Fl::remove_timeout(PaintingPanel::nativePreProcessDone, this);
 }
 
 
@@ -298,7 +320,9 @@ void PaintingPanel::alignComponents() {
 
     draw_image_check_->resize(left_bar_->x(), btnPreprocess_->y() + btnPreprocess_->h() + 3, left_bar_->w() - 2, 20);
     blur_mask_->resize(left_bar_->x(), draw_image_check_->y() + draw_image_check_->h() + 3, left_bar_->w() - 2, 20);
+    tiled_->resize(blur_mask_->x(), blur_mask_->y(), blur_mask_->w(), blur_mask_->h());
     inpaintMode_->resize(left_bar_->x(), blur_mask_->y() + blur_mask_->h() + 23, left_bar_->w() - 2, 20);
+    threshold_->resize(left_bar_->x(), draw_image_check_->y() + draw_image_check_->h() + 23, left_bar_->w() - 2, 20);
 }
 
 void PaintingPanel::enableControls() {
@@ -471,10 +495,13 @@ void PaintingPanel::modeSelected() {
     image_panel_->setLayerVisible(image_type_controlnet, false);
     image_panel_->setLayerVisible(image_type_paste, false);
     blur_mask_->hide();
+    tiled_->hide();
     inpaintMode_->hide();
+    threshold_->hide();
     switch (getSelectedMode()) {
         case painting_img2img: {
             image_panel_->setEditType(edit_type_paste);
+            tiled_->show();
             uint8_t r, g, b;
             btnFgColor_->getColor(&r, &g, &b);
             image_panel_->setBrushColor(r, g, b);
@@ -525,9 +552,33 @@ void PaintingPanel::modeSelected() {
             image_panel_->setEditType(edit_type_none);
         break;
     }
+    if (getSelectedMode() == painting_canny || getSelectedMode() == painting_scribble) {
+        threshold_->value(getSelectedMode() == painting_canny ? canny_threshold_ : scribble_threshold_);
+        threshold_->show();
+    }
     enableControls();
 }
 
+void PaintingPanel::thresholdChanged(Fl_Widget *widget, void *cbdata) {
+    ((PaintingPanel *) cbdata)->thresholdChanged();
+}
+
+void PaintingPanel::thresholdChanged() {
+    const char *method = controlnet_modes[getSelectedMode()];
+    if (getSelectedMode() == painting_canny) {
+        canny_threshold_ = (int) threshold_->value();
+    } else if (getSelectedMode() == painting_scribble) {
+        scribble_threshold_ = (int) threshold_->value();
+    } else {
+        return;
+    }
+    // updates the control image while it's the pre-processor result (not painted over)
+    if (native_result_ && native_result_.get() == image_panel_->getLayerImage(image_type_controlnet) &&
+        native_result_->getVersion() == native_result_version_) {
+        native_pre_process(method, false);
+    }
+}
+
 void PaintingPanel::newMask() {
     if (getSelectedMode() == painting_inpaint_masked ||
         getSelectedMode() == painting_inpaint_not_masked ||
@@ -636,13 +687,24 @@ void PaintingPanel::pre_process(const char* method) {
     if (!ask("The operation will replace the input image. Do you want to proceed ?"))  {
         return;
     }
+    if (PreProcessWorker::supports(method)) {
+        native_pre_process(method, true);
+        return;
+    }
+    auto source = image_panel_->getLayerImage(image_type_image);
+    auto cached = get_pre_process_cache()->get(method, source);
+    if (cached) {
+        image_panel_->setLayerImage(image_type_controlnet, cached);
+        image_panel_->setEditType(edit_type_controlnet);
+        return;
+    }
     const char *msg = NULL;
     bool success = false;
     dexpert::py::image_ptr_t img;
     dexpert::py::get_py()->execute_callback(
         dexpert::py::pre_process_image(
             method,
-            image_panel_->getLayerImage(image_type_image),
+            source,
             [&msg, &success, &img] (bool suc, const char *message, dexpert::py::image_ptr_t image) {
                 msg = message;
                 success = suc;
@@ -659,11 +721,50 @@ void PaintingPanel::pre_process(const char* method) {
                 getSelectedMode() != painting_mangaline);
         }
 
+        get_pre_process_cache()->put(method, source, std::string(), img);
         image_panel_->setLayerImage(image_type_controlnet, img);
         image_panel_->setEditType(edit_type_controlnet);
     }
 }
 
+void PaintingPanel::native_pre_process(const char* method, bool new_image) {
+    native_preview_ = !new_image;
+    native_worker_.submit(
+        method, 
+        new_image ? image_panel_->getLayerImage(image_type_image) : NULL, 
+        getSelectedMode() == painting_canny ? canny_threshold_ : scribble_threshold_);
+    if (!Fl::has_timeout(PaintingPanel::nativePreProcessDone, this)) {
+        Fl::add_timeout(0.01, PaintingPanel::nativePreProcessDone, this);
+    }
+}
+
+void PaintingPanel::nativePreProcessDone(void *cbdata) {
+    ((PaintingPanel *) cbdata)->nativePreProcessDone();
+}
+
+void PaintingPanel::nativePreProcessDone() {
+    image_ptr_t img;
+    std::string method;
+    const char *mode = controlnet_modes[getSelectedMode()];
+    if (native_worker_.poll(&img, &method) && img && mode && method == mode) {
+        // the slider replaces its own preview, one undo step for the whole drag
+        bool preview = native_preview_ && native_result_ &&
+            native_result_.get() == image_panel_->getLayerImage(image_type_controlnet) &&
+            native_result_->getVersion() == native_result_version_;
+        if (preview) {
+            image_panel_->previewLayerImage(image_type_controlnet, img);
+        } else {
+            image_panel_->setLayerImage(image_type_controlnet, img);
+        }
+        image_panel_->setEditType(edit_type_controlnet);
+        native_result_ = img;
+        native_result_version_ = img->getVersion();
+    }
+    if (native_worker_.busy()) {
+        Fl::repeat_timeout(0.01, PaintingPanel::nativePreProcessDone, this);
+    }
+}
+
 void PaintingPanel::preprocessImage() {
     switch (getSelectedMode())
     {
@@ -783,6 +884,10 @@ bool PaintingPanel::maskBlurEnabled() {
     return blur_mask_->value() == 1;
 }
 
+bool PaintingPanel::tiledEnabled() {
+    return getSelectedMode() == painting_img2img && tiled_->value() == 1;
+}
+
 inpaint_mode_t PaintingPanel::getInpaintMode() {
     return (inpaint_mode_t)inpaintMode_->value();
 }
@@ -11,9 +11,11 @@
 #include <FL/Fl_Choice.H>
 #include <FL/Fl_Check_Button.H>
 #include <FL/Fl_Float_Input.H>
+#include <FL/Fl_Value_Slider.H>
 
 #include "src/controls/button.h"
 #include "src/controls/image_panel.h"
+#include "src/images/pre_process_worker.h"
 #include "src/panels/prompt_panel.h"
 #include "src/python/raw_image.h"
 #include "src/stable_diffusion/generator.h"
@@ -73,6 +75,7 @@ class PaintingPanel: public Fl_Group {
     void setSelectedMode(painting_mode_t mode);
     painting_mode_t getSelectedMode();
     bool maskBlurEnabled();
+    bool tiledEnabled();
     inpaint_mode_t getInpaintMode();
     
  private:
@@ -80,6 +83,10 @@ class PaintingPanel: public Fl_Group {
    void modeSelected();
    static void brushSelected(Fl_Widget *widget, void *cbdata);
    void brushSelected();
+   static void thresholdChanged(Fl_Widget *widget, void *cbdata);
+   void thresholdChanged();
+   static void nativePreProcessDone(void *cbdata);
+   void nativePreProcessDone();
 
  private:
     void alignComponents();
@@ -94,6 +101,7 @@ class PaintingPanel: public Fl_Group {
     bool ensureImagePresent();
     bool ensureMaskPresent();
     void pre_process(const char* method);
+    void native_pre_process(const char* method, bool new_image);
     void enableControls();
     void updateInfo();
 
@@ -111,7 +119,9 @@ class PaintingPanel: public Fl_Group {
     Fl_Box* label_info_;
     Fl_Check_Button *draw_image_check_;
     Fl_Check_Button *blur_mask_;
+    Fl_Check_Button *tiled_;
     Fl_Choice *inpaintMode_;
+    Fl_Value_Slider *threshold_;
     ImagePanel *image_panel_;
     std::unique_ptr<Button> btnOpen_;
     std::unique_ptr<Button> btnSave_;
@@ -121,6 +131,12 @@ class PaintingPanel: public Fl_Group {
     std::unique_ptr<Button> btnOpenMask_;
     std::unique_ptr<Button> btnSaveMask_;
     std::unique_ptr<Button> btnPreprocess_;
+    PreProcessWorker native_worker_;
+    int canny_threshold_;
+    int scribble_threshold_;
+    image_ptr_t native_result_;     // the control image the threshold slider may replace
+    size_t native_result_version_ = 0;
+    bool native_preview_ = false;   // the last submit is a threshold change of native_result_
 };
     
 }   // namespace dexpert
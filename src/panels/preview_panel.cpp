@@ -157,6 +157,16 @@ void PreviewPanel::goLastImage() {
     updateImage();
 }
 
+void PreviewPanel::showImage(RawImage *image, const char *title) {
+    if (!image) {
+        return;
+    }
+    miniature_->setLayerImage(image_type_image, image->duplicate());
+    miniature_->zoomFit();
+    enableControls(true);
+    lblCounter_->copy_label(title);
+}
+
 void PreviewPanel::updateImage() {
     auto img = get_sd_state()->getResultsImage(getRow());
     if (!img) {
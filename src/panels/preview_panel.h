@@ -25,6 +25,8 @@ namespace dexpert
         void resize(int x, int y, int w, int h) override;
         void updateImage();
         void goLastImage();
+        // shows an image that is not one of the results (the sweep contact sheet) until the row changes
+        void showImage(RawImage *image, const char *title);
 
     private:
         void alignComponents();
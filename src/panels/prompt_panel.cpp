@@ -1,5 +1,8 @@
+#include <stdio.h>
 #include <algorithm>
 
+#include <FL/Fl.H>
+
 #include "src/stable_diffusion/state.h"
 #include "src/dialogs/common_dialogs.h"
 #include "src/config/config.h"
@@ -74,6 +77,7 @@ PromptPanel::PromptPanel(int x, int y, int w, int h) : EventListener(), Fl_Group
 }
 
 PromptPanel::~PromptPanel() {
+    Fl::remove_timeout(PromptPanel::checkModelHashing, this);
 
 }
 
@@ -288,12 +292,8 @@ void PromptPanel::refreshModels() {
     
     auto mdls = get_sd_state()->getSdModels();
 
-    std::string name_lower;
-
     for (auto it = mdls.cbegin(); it != mdls.cend(); it++) {
-        name_lower = it->name;
-        std::transform(name_lower.begin(), name_lower.end(), name_lower.begin(), ::tolower);
-        if (name_lower.find("inpaint") != std::string::npos) {
+        if (it->inpainting) {
             modelsInpaint_->add(it->name.c_str());
         } else {
             models_->add(it->name.c_str());
@@ -311,6 +311,37 @@ void PromptPanel::refreshModels() {
 
     models_->value(value); 
     modelsInpaint_->value(valueInpaint);
+
+    checkModelHashing();
+}
+
+void PromptPanel::checkModelHashing(void *cbdata) {
+    ((PromptPanel *) cbdata)->checkModelHashing();
+}
+
+void PromptPanel::checkModelHashing() {
+    // the hashes of the new models are computed in background, the model label shows the progress
+    size_t done = 0;
+    size_t total = 0;
+    if (get_sd_state()->hashingSdModels(&done, &total)) {
+        char label[64] = "";
+        snprintf(label, sizeof(label), "Model (hashing %d%%)", total > 0 ? (int) (done * 100 / total) : 0);
+        models_->copy_label(label);
+        hashing_models_ = true;
+        if (!Fl::has_timeout(PromptPanel::checkModelHashing, this)) {
+            Fl::add_timeout(0.5, PromptPanel::checkModelHashing, this);
+        }
+        return;
+    }
+    Fl::remove_timeout(PromptPanel::checkModelHashing, this);
+    models_->copy_label("Model");
+    if (hashing_models_) {
+        hashing_models_ = false;
+        // the model list receives the new hashes (the refresh hashes the files that changed meanwhile)
+        if (get_sd_state()->reloadSdModelList()) {
+            checkModelHashing();
+        }
+    }
 }
 
 const char *PromptPanel::getSdModel(bool for_inpainting) {
@@ -47,6 +47,8 @@ class PromptPanel: public EventListener, public Fl_Group {
  private:
     void alignComponents();
     void interrogate(const char* model);
+    void checkModelHashing();
+    static void checkModelHashing(void *cbdata);
     
  protected:
     void resize(int x, int y, int w, int h) override;
@@ -54,6 +56,7 @@ class PromptPanel: public EventListener, public Fl_Group {
 
  private:
    bool should_reload_model_;
+   bool hashing_models_ = false;
    PaintingPanel* image_panel_ = NULL;
    callback_t on_generate_;
    Fl_Multiline_Input *positivePrompt_;
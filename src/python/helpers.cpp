@@ -1,3 +1,4 @@
+#include <stdio.h>
 #include <list>
 #include <Python.h>
 
@@ -5,6 +6,7 @@
 #include "src/python/helpers.h"
 #include "src/windows/progress_window.h"
 #include "src/python/wrapper.h"
+#include "src/data/tracing.h"
 
 namespace dexpert
 {
@@ -28,10 +30,31 @@ namespace dexpert
             return buffer.c_str();
         }
 
+        model_cache_stats_t cacheStatsFromPyDict(py11::dict r) {
+            model_cache_stats_t stats;
+            stats.budget = r["budget"].cast<size_t>();
+            stats.used = r["used"].cast<size_t>();
+            stats.hits = r["hits"].cast<size_t>();
+            stats.misses = r["misses"].cast<size_t>();
+            stats.evictions = r["evictions"].cast<size_t>();
+            auto seq = r["entries"].cast<py11::sequence>();
+            for (size_t i = 0; i < seq.size(); ++i) {
+                auto it = seq[i].cast<py11::dict>();
+                model_cache_entry_t entry;
+                entry.name = it["name"].cast<std::string>();
+                entry.kind = it["kind"].cast<std::string>();
+                entry.bytes = it["bytes"].cast<size_t>();
+                entry.hits = it["hits"].cast<size_t>();
+                stats.entries.push_back(entry);
+            }
+            return stats;
+        }
+
         callback_t install_deps(status_callback_t status_cb)
         {
             return [status_cb]
             {
+                TRACE_SCOPE("py::install_deps");
                 try {
                     auto m =  dexpert::py::depsModule();
                     if (m) {
@@ -51,6 +74,7 @@ namespace dexpert
         {
             return [status_cb]
             {
+                TRACE_SCOPE("py::check_have_deps");
                 try {
                     auto m =  dexpert::py::depsModule();
                     if (m) {
@@ -70,6 +94,7 @@ namespace dexpert
             enable_progress_window(false);
             return [status_cb, model, image] ()
             {
+                TRACE_SCOPE("py::interrogate_image");
                 try {
                     py11::dict d;
                     image->toPyDict(d);
@@ -90,6 +115,7 @@ namespace dexpert
         {
             return [status_cb, path]
             {
+                TRACE_SCOPE("py::open_image");
                 try {
                     auto r = dexpert::py::getModule().attr("open_image")(path);
                     py11::dict d = r.cast<py11::dict>();
@@ -105,6 +131,7 @@ namespace dexpert
         {
             return [status_cb, path, image]()
             {
+                TRACE_SCOPE("py::save_image");
                 try {
                     py11::dict d;
                     image->toPyDict(d);
@@ -122,6 +149,7 @@ namespace dexpert
             enable_progress_window(false);
             return [status_cb, mode, image]()
             {
+                TRACE_SCOPE("py::pre_process_image");
                 try {
                     py11::dict d;
                     image->toPyDict(d);
@@ -136,19 +164,51 @@ namespace dexpert
             };
         }
 
+        callback_t pre_process_cache_stats(model_cache_callback_t status_cb) {
+            return [status_cb]
+            {
+                TRACE_SCOPE("py::pre_process_cache_stats");
+                try {
+                    auto r = dexpert::py::getModule().attr("pre_process_cache_stats")().cast<py11::dict>();
+                    status_cb(true, NULL, cacheStatsFromPyDict(r));
+                } catch(std::runtime_error e) {
+                    status_cb(false, getError(e), model_cache_stats_t());
+                }
+            };
+        }
+
+        callback_t pre_process_cache_evict(const std::string& name, status_callback_t status_cb) {
+            return [status_cb, name]
+            {
+                TRACE_SCOPE("py::pre_process_cache_evict");
+                try {
+                    dexpert::py::getModule().attr("pre_process_cache_evict")(name);
+                    status_cb(true, NULL);
+                } catch(std::runtime_error e) {
+                    status_cb(false, getError(e));
+                }
+            };
+        }
+
+        image_ptr_t gfpgan_upscale(RawImage *image, float scale, float weight)
+        {
+            py11::dict d;
+            py11::dict params;
+            params["gfpgan.weight"] = weight;
+            image->toPyDict(d);
+            auto r = dexpert::py::getModule().attr("gfpgan_upscale")(d, py11::float_(scale), params);
+            py11::dict d2 = r.cast<py11::dict>();
+            return dexpert::py::rawImageFromPyDict(d2);
+        }
+
         callback_t upscale_image(RawImage *image, float scale, float weight, image_callback_t status_cb)
         {
             enable_progress_window(false);
             return [status_cb, image, scale, weight]
             {
+                TRACE_SCOPE("py::upscale_image");
                 try {
-                    py11::dict d;
-                    py11::dict params;
-                    params["gfpgan.weight"] = weight;
-                    image->toPyDict(d);
-                    auto r = dexpert::py::getModule().attr("gfpgan_upscale")(d, py11::float_(scale), params);
-                    py11::dict d2 = r.cast<py11::dict>();
-                    auto img = dexpert::py::rawImageFromPyDict(d2);
+                    auto img = gfpgan_upscale(image, scale, weight);
                     status_cb(true, NULL, img); // TODO: check error!
                 } catch(std::runtime_error e) {
                     status_cb(false, getError(e), image_ptr_t()); // TODO: check error!
@@ -156,6 +216,99 @@ namespace dexpert
             };
         }
 
+        image_ptr_t gfpgan_upscale_background(RawImage *image, float scale)
+        {
+            py11::dict d;
+            py11::dict params;
+            image->toPyDict(d);
+            auto r = dexpert::py::getModule().attr("gfpgan_upscale_background")(d, py11::float_(scale), params);
+            py11::dict d2 = r.cast<py11::dict>();
+            return dexpert::py::rawImageFromPyDict(d2);
+        }
+
+        // the tiles of an upscale share the models, python keeps them until the last tile
+        void gfpgan_release()
+        {
+            try {
+                dexpert::py::getModule().attr("gfpgan_release")();
+            } catch(std::runtime_error e) {
+                fprintf(stderr, "could not release the upscaler models: %s\n", getError(e));
+            }
+        }
+
+        callback_t upscale_tiles(RawImage *image, float scale, const std::vector<tile_rect_t>& tiles, tile_callback_t tile_cb)
+        {
+            enable_progress_window(false);
+            return [tile_cb, image, scale, tiles]
+            {
+                TRACE_SCOPE("py::upscale_tiles");
+                for (size_t i = 0; i < tiles.size(); ++i) {
+                    const auto & r = tiles[i];
+                    set_progress(i, tiles.size(), image_ptr_t());
+                    if (should_cancel_progress()) {
+                        tile_cb(r, false, "Operation canceled by the user", image_ptr_t());
+                        break;
+                    }
+                    try {
+                        auto tile = image->getCrop(r.x, r.y, r.w, r.h);
+                        auto img = gfpgan_upscale_background(tile.get(), scale);
+                        if (!tile_cb(r, true, NULL, img)) {
+                            break;
+                        }
+                    } catch(std::runtime_error e) {
+                        tile_cb(r, false, getError(e), image_ptr_t());
+                        break;
+                    }
+                }
+                gfpgan_release();
+                set_progress(tiles.size(), tiles.size(), image_ptr_t());
+            };
+        }
+
+        callback_t restore_faces(RawImage *image, float weight, const std::vector<restore_window_t>& windows, status_callback_t status_cb)
+        {
+            enable_progress_window(false);
+            return [status_cb, image, weight, windows]
+            {
+                TRACE_SCOPE("py::restore_faces");
+                bool success = true;
+                std::string message;
+                for (size_t i = 0; i < windows.size() && success; ++i) {
+                    const auto & r = windows[i];
+                    set_progress(i, windows.size(), image_ptr_t());
+                    if (should_cancel_progress()) {
+                        success = false;
+                        message = "Operation canceled by the user";
+                        break;
+                    }
+                    try {
+                        // the window is cropped after the previous ones were pasted back, so their faces are kept
+                        auto window = image->getCrop(r.window.x, r.window.y, r.window.w, r.window.h);
+                        py11::dict d;
+                        py11::dict params;
+                        params["gfpgan.weight"] = weight;
+                        window->toPyDict(d);
+                        auto box = py11::make_tuple(r.core.x, r.core.y, r.core.w, r.core.h);
+                        auto result = dexpert::py::getModule().attr("gfpgan_restore_window")(d, box, params);
+                        py11::dict d2 = result.cast<py11::dict>();
+                        auto restored = dexpert::py::rawImageFromPyDict(d2);
+                        if (!restored || restored->w() != window->w() || restored->h() != window->h() || restored->format() != image->format()) {
+                            success = false;
+                            message = "Unknown error, face restoration fail. The window does not match the image";
+                            break;
+                        }
+                        image->pasteAt(r.window.x, r.window.y, restored.get());
+                    } catch(std::runtime_error e) {
+                        success = false;
+                        message = getError(e);
+                    }
+                }
+                gfpgan_release();
+                set_progress(windows.size(), windows.size(), image_ptr_t());
+                status_cb(success, success ? NULL : message.c_str());
+            };
+        }
+
         const void txt2img_config_t::fill_prompt_dict(py11::dict &params) const
         {
             params["prompt"] = this->prompt;
@@ -171,6 +324,10 @@ namespace dexpert
             params["reload_model"] = this->reload_model;
             params["restore_faces"] = this->restore_faces;
             params["enable_codeformer"] = this->enable_codeformer;
+            if (*this->scheduler)
+            {
+                params["scheduler"] = this->scheduler;
+            }
 
             if (!this->controlnets.empty())
             {
@@ -198,11 +355,19 @@ namespace dexpert
             params["image"] = data;
             params["strength"] = this->strength;
             params["inpaint_mode"] = this->inpaint_mode;
+            if (!this->image_hash.empty())
+            {
+                params["image_hash"] = this->image_hash;
+            }
             if (this->mask)
             {
                 py11::dict data;
                 this->mask->toPyDict(data);
                 params["mask"] = data;
+                if (!this->mask_hash.empty())
+                {
+                    params["mask_hash"] = this->mask_hash;
+                }
             }
         }
 
@@ -210,9 +375,13 @@ namespace dexpert
         {
             return [fn_name, &config, status_cb]
             {
+                TRACE_SCOPE(fn_name);
                 try {
                     py11::dict params;
-                    config.fill_prompt_dict(params);
+                    {
+                        ScopedTimer timer("fill_prompt_dict");
+                        config.fill_prompt_dict(params);
+                    }
                     auto r = dexpert::py::getModule().attr(fn_name)(params);
                     py11::dict asimg = r.cast<py11::dict>();
                     auto img = dexpert::py::rawImageFromPyDict(asimg);
@@ -236,38 +405,12 @@ namespace dexpert
             enable_progress_window();
             return get_diffusion_callback("img2img", config, status_cb);
         }
-
-        callback_t list_models(const std::wstring &path, model_callback_t status_cb)
-        {
-            return [&path, status_cb]
-            {
-                try {
-                    model_list_t models;
-
-                    auto r = dexpert::py::getModule().attr("list_models")(path);
-                    auto seq = r.cast<py11::sequence>();
-                    for (size_t i = 0; i < seq.size(); ++i)
-                    {
-                        auto it = seq[i].cast<py11::dict>();
-                        model_t model;
-                        model.name = it["name"].cast<std::string>();
-                        model.size = it["size"].cast<py11::int_>();
-                        model.hash = it["hash"].cast<std::string>();
-                        model.path = it["path"].cast<std::string>();
-                        models.push_back(model);
-                    }
-                    status_cb(true, NULL, models); // TODO: check error!
-                } catch(std::runtime_error e) {
-                    status_cb(false, getError(e), model_list_t()); // TODO: check error!
-                }
-
-            };
-        }
         
         callback_t list_embeddings(embedding_callback_t status_cb)
         {
             return [status_cb]
             {
+                TRACE_SCOPE("py::list_embeddings");
                 try {
                     embedding_list_t values;
 
@@ -298,6 +441,7 @@ namespace dexpert
         callback_t model_urls(model_url_callback_t status_cb) {
             return [status_cb]
             {
+                TRACE_SCOPE("py::model_urls");
                 try {
                     model_url_list_t models;
                     auto r = dexpert::py::getModule().attr("get_sd_model_urls")();
@@ -324,6 +468,7 @@ namespace dexpert
             enable_progress_window(false);
             return [status_cb, url, filename]()
             {
+                TRACE_SCOPE("py::download_model");
                 try {
                     dexpert::py::getModule().attr("download_sd_model")(url, filename);
                     status_cb(true, NULL); // TODO: check error!
@@ -334,10 +479,37 @@ namespace dexpert
             };
         }
 
+        callback_t model_cache_stats(model_cache_callback_t status_cb) {
+            return [status_cb]
+            {
+                TRACE_SCOPE("py::model_cache_stats");
+                try {
+                    auto r = dexpert::py::getModule().attr("model_cache_stats")().cast<py11::dict>();
+                    status_cb(true, NULL, cacheStatsFromPyDict(r));
+                } catch(std::runtime_error e) {
+                    status_cb(false, getError(e), model_cache_stats_t());
+                }
+            };
+        }
+
+        callback_t model_cache_evict(const std::string& name, status_callback_t status_cb) {
+            return [status_cb, name]
+            {
+                TRACE_SCOPE("py::model_cache_evict");
+                try {
+                    dexpert::py::getModule().attr("model_cache_evict")(name);
+                    status_cb(true, NULL);
+                } catch(std::runtime_error e) {
+                    status_cb(false, getError(e));
+                }
+            };
+        }
+
         callback_t configure_stable_diffusion(status_callback_t status_cb)
         {
             return [status_cb]
             {
+                TRACE_SCOPE("py::configure_stable_diffusion");
                 try {
                     py11::dict settings;
                     auto &c = getConfig();
@@ -354,6 +526,8 @@ namespace dexpert
                     settings["add_model_dir"] = c.getAdditionalModelDir();
                     settings["add_emb_dir"] = c.getAdditionalEmbsDir();
                     settings["add_lora_dir"] = c.getAdditionalLoraDir();
+                    settings["model_cache_mb"] = c.getModelCacheMB();
+                    settings["detector_cache_mb"] = c.getDetectorCacheMB();
                     auto r = dexpert::py::getModule().attr("set_user_settings")(settings);
                     status_cb(true, NULL);
                 } catch(std::runtime_error e) {
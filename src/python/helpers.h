@@ -13,21 +13,13 @@
 #include <pybind11/embed.h>
 
 #include "src/python/raw_image.h"
+#include "src/images/tiles.h"
 
 namespace py11 = pybind11;
 
 namespace dexpert {
 namespace py {
 
-typedef struct  {
-    std::string name;
-    std::string hash;
-    std::string path;
-    size_t size;
-} model_t;
-
-typedef std::list<model_t> model_list_t;
-
 typedef struct {
     const char *mode = "";
     RawImage *image = NULL;
@@ -49,6 +41,7 @@ class txt2img_config_t {
     bool restore_faces = false;
     bool enable_codeformer = false;
     bool reload_model = false;
+    const char *scheduler = "";  // empty uses the scheduler of the settings
     std::list<control_net_t> controlnets;
     virtual ~txt2img_config_t() {};
     virtual const void fill_prompt_dict(py11::dict &params) const;
@@ -58,6 +51,9 @@ class img2img_config_t: public txt2img_config_t {
  public:
     RawImage *image = NULL;
     RawImage *mask = NULL;
+    // content hashes of the image and the mask, the backend caches the vae encoded latents by them
+    std::string image_hash;
+    std::string mask_hash;
     const char *inpaint_mode = "";
     float strength = 0.8;
     const void fill_prompt_dict(py11::dict &params) const override;
@@ -84,13 +80,31 @@ class embedding_t {
 
 typedef std::list<embedding_t> embedding_list_t;
 
+typedef struct {
+    std::string name;
+    std::string kind;   // model, pipeline or controlnet
+    size_t bytes = 0;
+    size_t hits = 0;
+} model_cache_entry_t;
+
+typedef struct {
+    size_t budget = 0;
+    size_t used = 0;
+    size_t hits = 0;
+    size_t misses = 0;
+    size_t evictions = 0;
+    std::list<model_cache_entry_t> entries;  // least recently used first
+} model_cache_stats_t;
+
 typedef std::function<void()> callback_t;
 typedef std::function<void(bool success, const char *message)> status_callback_t;
 typedef std::function<void(bool success, const char *message, std::shared_ptr<RawImage> image)> image_callback_t;
-typedef std::function<void(bool success, const char *message, const model_list_t &models)> model_callback_t;
 typedef std::function<void(bool success, const char *message, const model_url_list_t &models)> model_url_callback_t;
 typedef std::function<void(bool success, const char *message, const embedding_list_t &values)> embedding_callback_t;
 typedef std::function<void(bool success, const char *message, const std::string& prompt)> interrogate_callback_t;
+typedef std::function<void(bool success, const char *message, const model_cache_stats_t& stats)> model_cache_callback_t;
+// called for each tile (in order), return false to stop
+typedef std::function<bool(const tile_rect_t& tile, bool success, const char *message, std::shared_ptr<RawImage> image)> tile_callback_t;
 
 callback_t check_have_deps(status_callback_t status_cb);
 callback_t install_deps(status_callback_t status_cb);
@@ -99,15 +113,25 @@ callback_t configure_stable_diffusion(status_callback_t status_cb);
 callback_t open_image(const char* path, image_callback_t status_cb);
 callback_t save_image(const char* path, RawImage *image, status_callback_t status_cb);
 callback_t upscale_image(RawImage *image, float scale, float weight, image_callback_t status_cb);
+// upscales the tiles one at time (python receives only the tile), the progress shows the tile count.
+// The faces are not restored: a face over a seam would be restored twice, use restore_faces on the stitched image.
+callback_t upscale_tiles(RawImage *image, float scale, const std::vector<tile_rect_t>& tiles, tile_callback_t tile_cb);
+// restores the faces of the image in place, python receives one window at time (see plan_restore_windows)
+callback_t restore_faces(RawImage *image, float weight, const std::vector<restore_window_t>& windows, status_callback_t status_cb);
 callback_t pre_process_image(const char *mode, RawImage *image, image_callback_t status_cb);
+// the detectors the pre-processors keep loaded (an empty name unloads all of them)
+callback_t pre_process_cache_stats(model_cache_callback_t status_cb);
+callback_t pre_process_cache_evict(const std::string& name, status_callback_t status_cb);
 callback_t txt2_image(const txt2img_config_t& config, image_callback_t status_cb); 
 callback_t img2_image(const img2img_config_t& config, image_callback_t status_cb); 
 
-callback_t list_models(const std::wstring& path, model_callback_t status_cb);
 callback_t list_embeddings(embedding_callback_t status_cb);
 callback_t model_urls(model_url_callback_t status_cb);
 callback_t download_model(const char *url, const char *filename, status_callback_t status_cb);
 callback_t interrogate_image(const char* model, RawImage *image, interrogate_callback_t status_cb);
+callback_t model_cache_stats(model_cache_callback_t status_cb);
+// an empty name evicts all the cached models and pipelines
+callback_t model_cache_evict(const std::string& name, status_callback_t status_cb);
 
 }  // namespace py
 }  // namespace
@@ -1,9 +1,13 @@
 #include <string>
 #include <exception>
+#include <algorithm>
+#include <atomic>
+#include <thread>
 
 #include <CImg.h>
 
 #include "src/python/raw_image.h"
+#include "src/data/tracing.h"
 
 using namespace cimg_library;
 
@@ -17,6 +21,11 @@ namespace {
         4  // img_rgba
     };
 
+    // the digest keeps the hash of each band of rows, a change rehashes only its bands
+    const size_t kHASH_BAND_ROWS = 64;
+    const size_t kHASH_PARALLEL_BYTES = 8 * 1024 * 1024;
+    const unsigned int kHASH_MAX_WORKERS = 4;
+
     uint8_t white_color_rgba[4] {
         255, 255, 255, 255
     };
@@ -104,9 +113,67 @@ size_t RawImage::getVersion() {
 }
 
 void RawImage::incVersion() {
+    incVersion(0, h_);
+}
+
+void RawImage::incVersion(int y, int h) {
+    int end = std::min<int>(y + h, h_);
+    y = std::max(y, 0);
+    if (y < end) {
+        if (dirty_first_row_ >= dirty_end_row_) {
+            dirty_first_row_ = y;
+            dirty_end_row_ = end;
+        } else {
+            dirty_first_row_ = std::min(dirty_first_row_, y);
+            dirty_end_row_ = std::max(dirty_end_row_, end);
+        }
+    }
     ++version_;
 }
 
+digest128_t RawImage::contentHash() {
+    if (hash_valid_ && hash_version_ == version_) {
+        return hash_;
+    }
+    const size_t line = (size_t) w_ * format_channels[format_];
+    const size_t bands = (h_ + kHASH_BAND_ROWS - 1) / kHASH_BAND_ROWS;
+    size_t first = 0;
+    size_t end = bands;
+    if (band_hashes_.size() == bands && hash_valid_) {
+        first = dirty_first_row_ / kHASH_BAND_ROWS;
+        end = (dirty_end_row_ + kHASH_BAND_ROWS - 1) / kHASH_BAND_ROWS;
+    }
+    band_hashes_.resize(bands);
+
+    std::atomic<size_t> next(first);
+    auto hash_bands = [&] {
+        for (size_t b = next++; b < end; b = next++) {
+            size_t rows = std::min<size_t>(kHASH_BAND_ROWS, h_ - b * kHASH_BAND_ROWS);
+            band_hashes_[b] = content_hash128(buffer_ + b * kHASH_BAND_ROWS * line, rows * line, b);
+        }
+    };
+    // big changes (a new image) are hashed by several threads, the memory bandwidth is the limit
+    unsigned int workers = 1;
+    if ((end - first) * kHASH_BAND_ROWS * line >= kHASH_PARALLEL_BYTES) {
+        workers = std::max(1u, std::min(std::thread::hardware_concurrency(), kHASH_MAX_WORKERS));
+    }
+    std::vector<std::thread> threads;
+    for (unsigned int i = 1; i < workers; ++i) {
+        threads.push_back(std::thread(hash_bands));
+    }
+    hash_bands();
+    for (auto & t : threads) {
+        t.join();
+    }
+
+    uint64_t seed = ((uint64_t) w_ << 32) ^ ((uint64_t) h_ << 2) ^ format_;
+    hash_ = content_hash128(band_hashes_.data(), bands * sizeof(digest128_t), seed);
+    hash_version_ = version_;
+    hash_valid_ = true;
+    dirty_first_row_ = dirty_end_row_ = 0;
+    return hash_;
+}
+
 image_ptr_t RawImage::duplicate() {
     return std::make_shared<RawImage>(
         buffer_, w_, h_, format_
@@ -176,7 +243,7 @@ void RawImage::drawCircleColor(int x, int y, int radius, uint8_t color[4], uint8
         img.draw_circle(x, y, radius, color);
     }
     img.permute_axes("cxyz");
-    incVersion();
+    incVersion(y - radius, radius * 2 + 1);
 }
 
 void RawImage::drawCircle(int x, int y, int radius, bool clear) {
@@ -190,6 +257,15 @@ void RawImage::drawCircle(int x, int y, int radius, bool clear) {
     }
 }
 
+void RawImage::drawText(int x, int y, const char *text, uint8_t color[4], int font_height) {
+    int src_channels = format_channels[format_];
+    CImg<unsigned char> img(buffer_, src_channels, w_, h_, 1, true);
+    img.permute_axes("yzcx");
+    img.draw_text(x, y, "%s", color, 0, 1, font_height, text);
+    img.permute_axes("cxyz");
+    incVersion(y, font_height);
+}
+
 void RawImage::fillWithMask(int x, int y, RawImage *mask) {
     auto image = this->duplicate();
     auto same_mask = mask->resizeCanvas(image->w(), image->h());
@@ -212,6 +288,7 @@ void RawImage::fillWithMask(int x, int y, RawImage *mask) {
     img.draw_image(0, 0, src.get_resize(image->w(), image->h()));
     img.permute_axes("cxyz");
     src.permute_axes("cxyz");
+    incVersion();
 }
 
 void RawImage::pasteAt(int x, int y, RawImage *image) {
@@ -226,6 +303,7 @@ void RawImage::pasteAt(int x, int y, RawImage *image) {
     }
     img.permute_axes("cxyz");
     src.permute_axes("cxyz");
+    incVersion(y, image->h());
 }
 
 void RawImage::pasteAt(int x, int y, RawImage *mask, RawImage *image) {
@@ -239,6 +317,7 @@ void RawImage::pasteAt(int x, int y, RawImage *mask, RawImage *image) {
     msk.permute_axes("cxyz");
     img.permute_axes("cxyz");
     src.permute_axes("cxyz");
+    incVersion(y, image->h());
 }
 
 void RawImage::pasteAt(int x, int y, int w, int h, RawImage *image) {
@@ -254,6 +333,7 @@ void RawImage::pasteAt(int x, int y, int w, int h, RawImage *image) {
     }
     img.permute_axes("cxyz");
     src.permute_axes("cxyz");
+    incVersion(y, h);
 }
 
 void RawImage::pasteInvertMask(RawImage *image) {
@@ -277,6 +357,7 @@ void RawImage::pasteInvertMask(RawImage *image) {
             ++p;
         }
     }
+    incVersion();
 }
 
 void RawImage::pasteFrom(int x, int y, float zoom, RawImage *image) {
@@ -300,6 +381,7 @@ void RawImage::pasteFrom(int x, int y, float zoom, RawImage *image) {
         h = image->h() - y;
     }
     memset(this->buffer_, 255, this->buffer_len_); // turn this image white
+    incVersion();
     if (h < 0 || w < 0) {
         return;
     }
@@ -491,10 +573,30 @@ image_ptr_t RawImage::resizeBottom(int value) {
     return resizeCanvas(this->w(), this->h() + value);
 }
 
+int RawImage::channels() {
+    return format_channels[format_];
+}
+
+void RawImage::getPixels(int x, int y, int w, int h, unsigned char *pixels) {
+    const size_t line = w * format_channels[format_];
+    for (int i = 0; i < h; ++i) {
+        memcpy(pixels + i * line, buffer_ + ((size_t) (y + i) * w_ + x) * format_channels[format_], line);
+    }
+}
+
+void RawImage::setPixels(int x, int y, int w, int h, const unsigned char *pixels) {
+    const size_t line = w * format_channels[format_];
+    for (int i = 0; i < h; ++i) {
+        memcpy(buffer_ + ((size_t) (y + i) * w_ + x) * format_channels[format_], pixels + i * line, line);
+    }
+    incVersion(y, h);
+}
+
 image_ptr_t rawImageFromPyDict(py11::dict &image) {
     if (!image.contains("data")) {
         return image_ptr_t();
     }
+    ScopedTimer timer("rawImageFromPyDict");
     auto img_mode = image["mode"].cast<std::string>();
     auto format = img_gray_8bit;
     if (img_mode == "RGB")
@@ -5,9 +5,12 @@
 #define SRC_PYTHON_RAW_IMAGE_H_
 
 #include <memory>
+#include <vector>
 #include <Python.h>
 #include <pybind11/embed.h> 
 
+#include "src/data/content_hash.h"
+
 namespace py11 = pybind11;
 
 namespace dexpert {
@@ -36,6 +39,11 @@ class RawImage {
     uint32_t w();
     size_t getVersion();
     void incVersion();
+    // only the rows from y to y + h changed
+    void incVersion(int y, int h);
+    // digest of the pixels, size and format. It's computed again only after the version changes,
+    // and only the bands of rows that changed are hashed again.
+    digest128_t contentHash();
     void pasteFill(RawImage *image);
     void pasteFrom(int x, int y, float zoom, RawImage *image);
     void pasteAt(int x, int y, RawImage *image);
@@ -58,10 +66,16 @@ class RawImage {
     image_ptr_t erode(int size);
 
     bool getColor(int x, int y, uint8_t *r, uint8_t *g, uint8_t *b, uint8_t *a);
+    // raw access to a rectangle inside the image (w * h * channels() bytes)
+    int channels();
+    void getPixels(int x, int y, int w, int h, unsigned char *pixels);
+    void setPixels(int x, int y, int w, int h, const unsigned char *pixels);
 
     void drawCircleColor(int x, int y, int radius, uint8_t color[4], uint8_t bgcolor[4], bool clear);
     void drawCircle(int x, int y, int radius, bool clear);
     void fillWithMask(int x, int y, RawImage *mask);
+    // draws the text with the CImg built-in font (the background is not painted)
+    void drawText(int x, int y, const char *text, uint8_t color[4], int font_height);
 
  private:
     unsigned char *buffer_;
@@ -70,6 +84,12 @@ class RawImage {
     uint32_t h_;
     image_format_t format_;
     size_t version_;
+    bool hash_valid_ = false;
+    size_t hash_version_ = 0;
+    digest128_t hash_;
+    std::vector<digest128_t> band_hashes_;
+    int dirty_first_row_ = 0;
+    int dirty_end_row_ = 0;
 };
 
 image_ptr_t rawImageFromPyDict(py11::dict &image);
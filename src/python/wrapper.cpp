@@ -3,6 +3,7 @@
 #include <fstream>
 #include <sstream>
 #include <chrono>
+#include <string.h>
 #include <Python.h>
 
 #include <Fl/Fl.H>
@@ -13,6 +14,8 @@
 #include "src/python/wrapper.h"
 #include "src/python/raw_image.h"
 #include "src/windows/progress_window.h"
+#include "src/stable_diffusion/telemetry.h"
+#include "src/data/tracing.h"
 
 namespace py11 = pybind11;
 
@@ -44,6 +47,34 @@ PYBIND11_EMBEDDED_MODULE(dexpert, m) {
             return true;
         return false;
     });
+
+    m.def("telemetry", [](const std::string& kind, const std::string& name, size_t step, size_t steps, double timestep, double elapsed_ms, size_t vram, bool success) {
+        dexpert::telemetry_event_t event = {};
+        if (kind == "begin") {
+            event.kind = dexpert::telemetry_generation_begin;
+        } else if (kind == "end") {
+            event.kind = dexpert::telemetry_generation_end;
+        } else if (kind == "phase_begin") {
+            event.kind = dexpert::telemetry_phase_begin;
+        } else if (kind == "phase_end") {
+            event.kind = dexpert::telemetry_phase_end;
+        } else if (kind == "step") {
+            event.kind = dexpert::telemetry_step;
+        } else if (kind == "cache") {
+            event.kind = dexpert::telemetry_cache;
+        } else {
+            return false;
+        }
+        strncpy(event.name, name.c_str(), sizeof(event.name) - 1);
+        event.step = step;
+        event.steps = steps;
+        event.timestep = timestep;
+        event.elapsed_ms = elapsed_ms;
+        event.vram = vram;
+        event.success = success;
+        return dexpert::push_telemetry(event);
+    }, py11::arg("kind"), py11::arg("name") = "", py11::arg("step") = 0, py11::arg("steps") = 0,
+       py11::arg("timestep") = 0.0, py11::arg("elapsed_ms") = 0.0, py11::arg("vram") = 0, py11::arg("success") = true);
 }
 
 } // unnamed namespace 
@@ -66,6 +97,7 @@ py11::module_ *depsModule() {
 
 void PythonMachine::run_machine() {
     puts("Initializing Python");
+    set_trace_thread_name("python");
 
     py11::scoped_interpreter guard{};
     py11::module_ sys = py11::module_::import("sys");
@@ -115,6 +147,7 @@ void PythonMachine::execute_callback_internal() {
     }
 
     if (cb) {
+        TRACE_SCOPE("PythonMachine::execute_callback");
         try {
             cb();
         } catch(pybind11::cast_error err) {
@@ -138,7 +171,7 @@ void PythonMachine::execute_callback(async_callback_t callback) {
 
 void PythonMachine::replace_callback(async_callback_t callback) {
     while (!callback_mutex_.try_lock()) {
-        Fl::wait(0.033);
+        progress_wait(0.033);
     }
     callback_ = callback;
     callback_mutex_.unlock();
@@ -154,7 +187,7 @@ void PythonMachine::wait_callback() {
         }
         callback_mutex_.unlock();
         if (should_continue) {
-            Fl::wait(0.033);
+            progress_wait(0.033);
         }
     }
 }
@@ -8,6 +8,7 @@
 #include <vector>
 #include <memory>
 #include "src/python/raw_image.h"
+#include "src/stable_diffusion/profiler.h"
 
 
 namespace dexpert
@@ -19,6 +20,8 @@ typedef enum {
     inpaint_fill,
     inpaint_wholepicture,
     inpaint_wholefill,
+    inpaint_onlymasked,     // only the masked area (and padding) is generated
+    inpaint_onlymaskedfill,
     // inpaint_none,
     // keep inpaint_mode_count at the end
     inpaint_mode_count
@@ -44,6 +47,8 @@ class GeneratorBase {
     virtual void generate(generator_cb_t cb) = 0;
 
     virtual std::shared_ptr<GeneratorBase> duplicate(bool variation) = 0;
+    // fills the generation parameters of the profile record
+    virtual void describe(profile_record_t *record) const = 0;
 
     RawImage* getImage();
     void clearImage();
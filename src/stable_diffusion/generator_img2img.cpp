@@ -1,3 +1,7 @@
+#include <algorithm>
+#include <vector>
+
+#include "src/images/tiles.h"
 #include "src/stable_diffusion/generator_img2img.h"
 #include "src/python/helpers.h"
 #include "src/python/wrapper.h"
@@ -12,10 +16,106 @@ namespace
         "original",
         "fill",
         "original", // wholepicture + original
-        "fill" // wholepicture + fill
+        "fill", // wholepicture + fill
+        "original", // onlymasked + original
+        "fill" // onlymasked + fill
         // "latent",
         // "nothing"
     };
+
+    // the only masked modes paste the result back with a feathered mask even when the mask blur is disabled
+    const int kMIN_FEATHER = 4;
+    // tiled img2img: the tiles overlap, the seams are blended
+    const int kTILE_OVERLAP = 64;
+
+    bool is_only_masked(inpaint_mode_t mode) {
+        return mode == inpaint_onlymasked || mode == inpaint_onlymaskedfill;
+    }
+
+    // the pixels that stay are the black ones (opaque when there is alpha), the same rule of RawImage::removeAlpha
+    bool repaint_bounds(RawImage *mask, tile_rect_t *bounds) {
+        const int channels = mask->channels();
+        const int colors = std::min(channels, 3);
+        int x0 = mask->w(), y0 = mask->h(), x1 = -1, y1 = -1;
+        std::vector<unsigned char> row((size_t) mask->w() * channels);
+        for (int y = 0; y < (int) mask->h(); ++y) {
+            mask->getPixels(0, y, mask->w(), 1, row.data());
+            const unsigned char *p = row.data();
+            for (int x = 0; x < (int) mask->w(); ++x, p += channels) {
+                bool keep = channels < 4 || p[3] > 0;
+                for (int c = 0; keep && c < colors; ++c) {
+                    keep = p[c] == 0;
+                }
+                if (!keep) {
+                    x0 = std::min(x0, x);
+                    x1 = std::max(x1, x);
+                    y0 = std::min(y0, y);
+                    y1 = y;
+                }
+            }
+        }
+        if (x1 < 0) {
+            return false;
+        }
+        bounds->x = x0;
+        bounds->y = y0;
+        bounds->w = x1 - x0 + 1;
+        bounds->h = y1 - y0 + 1;
+        return true;
+    }
+
+    // grows the bounds by the padding and then to the aspect ratio of the target size, without leaving the image
+    tile_rect_t padded_crop(const tile_rect_t& bounds, int padding, int image_w, int image_h, int target_w, int target_h) {
+        tile_rect_t r;
+        padding = std::clamp(padding, 0, 256);  // the range of Config::inpaint_set_mask_padding
+        r.w = std::max(bounds.w + padding * 2, 1);
+        r.h = std::max(bounds.h + padding * 2, 1);
+        if ((int64_t) r.w * target_h < (int64_t) r.h * target_w) {
+            r.w = (int) (((int64_t) r.h * target_w + target_h - 1) / target_h);
+        } else {
+            r.h = (int) (((int64_t) r.w * target_h + target_w - 1) / target_w);
+        }
+        r.w = std::clamp(r.w, 1, std::max(image_w, 1));
+        r.h = std::clamp(r.h, 1, std::max(image_h, 1));
+        r.x = std::clamp(bounds.x + bounds.w / 2 - r.w / 2, 0, image_w - r.w);
+        r.y = std::clamp(bounds.y + bounds.h / 2 - r.h / 2, 0, image_h - r.h);
+        return r;
+    }
+
+    image_ptr_t crop_resized(RawImage *image, const tile_rect_t& r, int w, int h) {
+        return image->getCrop(r.x, r.y, r.w, r.h)->resizeImage(w, h);
+    }
+
+    // the same area of each control image (it may have other size than the image), resized to w x h
+    std::list<py::control_net_t> crop_controlnets(
+        const std::list<py::control_net_t>& controls, RawImage *image, const tile_rect_t& area, int w, int h,
+        std::vector<image_ptr_t> *crops
+    ) {
+        std::list<py::control_net_t> result;
+        for (auto control : controls) {
+            if (control.image) {
+                tile_rect_t r;
+                r.x = area.x * (int) control.image->w() / (int) image->w();
+                r.y = area.y * (int) control.image->h() / (int) image->h();
+                r.w = std::max(area.w * (int) control.image->w() / (int) image->w(), 1);
+                r.h = std::max(area.h * (int) control.image->h() / (int) image->h(), 1);
+                crops->push_back(crop_resized(control.image, r, w, h));
+                control.image = crops->back().get();
+            }
+            result.push_back(control);
+        }
+        return result;
+    }
+
+    void run_img2img(const py::img2img_config_t& params, bool *success, const char **message, image_ptr_t *result) {
+        auto gen_cb = dexpert::py::img2_image(params, [success, message, result] (bool status, const char* msg, std::shared_ptr<dexpert::py::RawImage> img) {
+            *success = status;
+            *message = msg;
+            *result = img;
+        });
+        dexpert::py::get_py()->execute_callback(gen_cb);
+    }
+
 } // unamed namespace 
 
 
@@ -39,7 +139,9 @@ namespace
         bool enable_codeformer,
         bool reload_model,
         float mask_blur_size,
-        inpaint_mode_t inpaint_mode
+        inpaint_mode_t inpaint_mode,
+        int mask_padding,
+        bool tiled
     ) : 
         GeneratorBase(seed_gen, variation),
         prompt_(prompt), 
@@ -59,7 +161,9 @@ namespace
         enable_codeformer_(enable_codeformer),
         reload_model_(reload_model),
         mask_blur_size_(mask_blur_size),
-        inpaint_mode_(inpaint_mode)
+        inpaint_mode_(inpaint_mode),
+        mask_padding_(mask_padding),
+        tiled_(tiled)
         {
     image_orig_w_ = image_->w();
     image_orig_h_ = image_->h();
@@ -95,11 +199,24 @@ std::shared_ptr<GeneratorBase> GeneratorImg2Image::duplicate(bool variation) {
         this->enable_codeformer_,
         false, // only the first one should reload the model
         this->mask_blur_size_,
-        this->inpaint_mode_
+        this->inpaint_mode_,
+        this->mask_padding_,
+        this->tiled_
     ));
     return d;
 }
 
+void GeneratorImg2Image::describe(profile_record_t *record) const {
+    record->mode = mask_ ? "inpaint" : "img2img";
+    if (!controlnets_.empty()) {
+        record->mode += "+controlnet";
+    }
+    record->model = model_;
+    record->width = width_;
+    record->height = height_;
+    record->steps = steps_;
+}
+
 void GeneratorImg2Image::generate(generator_cb_t cb) {
     bool success = false;
 
@@ -125,6 +242,7 @@ void GeneratorImg2Image::generate(generator_cb_t cb) {
     reload_model_ = false;
 
     if (mask_) {
+        ScopedTimer timer("mask blur");
         if (mask_blur_size_) {
             blur_mask = mask_->blur(mask_blur_size_);
         }
@@ -135,8 +253,40 @@ void GeneratorImg2Image::generate(generator_cb_t cb) {
         full_mask = dexpert::py::newImage(full_mask->w(), full_mask->h(), false);
         full_mask = full_mask->removeAlpha();
     }
-    
+
+    // only masked: the area around the mask is generated at the target size and pasted back,
+    // the cost depends on the size of the masked area, not on the size of the image
+    tile_rect_t crop;
+    image_ptr_t crop_image;
+    image_ptr_t crop_mask;
+    std::vector<image_ptr_t> control_crops;
+    const int feather = mask_blur_size_ > 0 ? std::max((int) mask_blur_size_, 1) : kMIN_FEATHER;
+    bool only_masked = false;
+    if (mask_ && is_only_masked(inpaint_mode_)) {
+        ScopedTimer timer("mask crop");
+        tile_rect_t bounds;
+        if (repaint_bounds(mask_.get(), &bounds)) {
+            only_masked = true;
+            const int target_w = (width_ + 7) / 8 * 8;
+            const int target_h = (height_ + 7) / 8 * 8;
+            crop = padded_crop(bounds, mask_padding_ + feather, image_->w(), image_->h(), target_w, target_h);
+            crop_image = crop_resized(image_.get(), crop, target_w, target_h);
+            crop_mask = crop_resized(full_mask ? full_mask.get() : mask_.get(), crop, target_w, target_h);
+            params.image = crop_image.get();
+            params.width = target_w;
+            params.height = target_h;
+            full_mask = crop_mask;
+        }
+    }
+
     params.mask = full_mask.get();
+    {
+        ScopedTimer timer("content hash");
+        params.image_hash = digest_to_hex(params.image->contentHash());
+        if (full_mask) {
+            params.mask_hash = digest_to_hex(full_mask->contentHash());
+        }
+    }
     params.strength = image_strength_;
     params.restore_faces = restore_faces_;
     params.enable_codeformer = enable_codeformer_;
@@ -150,22 +300,65 @@ void GeneratorImg2Image::generate(generator_cb_t cb) {
             control
         );
     } 
+    if (only_masked) {
+        params.controlnets = crop_controlnets(params.controlnets, image_.get(), crop, params.width, params.height, &control_crops);
+    }
 
     if (!isVariation()) {
         params.var_stren = 0;
     }
     
     image_ptr_t result;
-    auto gen_cb = dexpert::py::img2_image(params, [&result, &success, &message] (bool status, const char* msg, std::shared_ptr<dexpert::py::RawImage> img) {
-        success = status;
-        message = msg;
-        result = img;
-    });
-
-    dexpert::py::get_py()->execute_callback(gen_cb);
+    std::string stitch_error;  // the message outlives the stitcher
+    const int tile_w = (width_ + 7) / 8 * 8;
+    const int tile_h = (height_ + 7) / 8 * 8;
+    if (tiled_ && !mask_ && ((int) image_->w() > tile_w || (int) image_->h() > tile_h)) {
+        // every tile is generated at the target size, python never sees the whole image
+        auto tiles = plan_tiles(image_->w(), image_->h(), tile_w, tile_h, kTILE_OVERLAP);
+        TileStitcher stitcher(image_->w(), image_->h(), 1.0, kTILE_OVERLAP, seam_cosine);
+        const auto controls = params.controlnets;
+        for (size_t i = 0; i < tiles.size(); ++i) {
+            const auto & r = tiles[i];
+            auto tile = image_->getCrop(r.x, r.y, r.w, r.h);
+            std::vector<image_ptr_t> tile_controls;
+            params.image = tile.get();
+            params.width = r.w;
+            params.height = r.h;
+            params.image_hash = digest_to_hex(tile->contentHash());
+            params.controlnets = crop_controlnets(controls, image_.get(), r, r.w, r.h, &tile_controls);
+            image_ptr_t tile_result;
+            run_img2img(params, &success, &message, &tile_result);
+            if (!success || !tile_result) {
+                success = false;
+                break;
+            }
+            params.reload_model = false;
+            stitcher.add(r, tile_result);
+        }
+        if (success) {
+            result = stitcher.finish();
+            if (!result) {
+                success = false;
+                stitch_error = stitcher.lastError();
+                message = stitch_error.c_str();
+            }
+        }
+    } else {
+        run_img2img(params, &success, &message, &result);
+    }
 
     if (result) {
-        if (mask_.get() != NULL && image_.get() != NULL) {
+        if (only_masked) {
+            ScopedTimer timer("mask composite");
+            // the original pixels go back over the generated area, the padding hides the seams
+            auto original = image_->getCrop(crop.x, crop.y, crop.w, crop.h);
+            auto keep = mask_->getCrop(crop.x, crop.y, crop.w, crop.h)->removeAlpha()->blur(feather);
+            auto generated = result->resizeImage(crop.w, crop.h);
+            generated->pasteAt(0, 0, keep.get(), original.get());
+            result = image_->duplicate();
+            result->pasteAt(crop.x, crop.y, generated.get());
+        } else if (mask_.get() != NULL && image_.get() != NULL) {
+            ScopedTimer timer("mask composite");
             if (mask_blur_size_) {
                 blur_mask = mask_->removeAlpha()->blur(mask_blur_size_)->resizeCanvas(image_->w(), image_->h());
             } 
@@ -38,7 +38,9 @@ class GeneratorImg2Image: public GeneratorBase {
             bool enable_codeformer,
             bool reload_model,
             float mask_blur_size,
-            inpaint_mode_t inpaint_mode
+            inpaint_mode_t inpaint_mode,
+            int mask_padding,
+            bool tiled
         );
 
         void generate(
@@ -46,6 +48,7 @@ class GeneratorImg2Image: public GeneratorBase {
         ) override;
 
         std::shared_ptr<GeneratorBase> duplicate(bool variation);
+        void describe(profile_record_t *record) const override;
         
     private:
         image_ptr_t image_;
@@ -65,6 +68,8 @@ class GeneratorImg2Image: public GeneratorBase {
         float image_strength_ = 0.8;
         float mask_blur_size_ = 4.0;
         inpaint_mode_t inpaint_mode_;
+        int mask_padding_ = 32;
+        bool tiled_ = false;    // img2img without mask: large images are generated in tiles of width x height
         bool restore_faces_ = false;
         bool reload_model_ = false;
         bool enable_codeformer_ = false;
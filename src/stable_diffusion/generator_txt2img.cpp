@@ -21,11 +21,13 @@ namespace dexpert
         float var_stren,
         bool restore_faces,
         bool enable_codeformer,
-        bool reload_model
+        bool reload_model,
+        const std::string& scheduler
     ) : GeneratorBase(seed_gen, variation), prompt_(prompt), negative_(negative), model_(model), controlnets_(controlnets),
         seed_(seed), width_(width), height_(height), steps_(steps), 
         cfg_(cfg), var_strength_(var_stren), 
-        restore_faces_(restore_faces), enable_codeformer_(enable_codeformer), reload_model_(reload_model)
+        restore_faces_(restore_faces), enable_codeformer_(enable_codeformer), reload_model_(reload_model),
+        scheduler_(scheduler)
         {
 
 }
@@ -48,11 +50,20 @@ std::shared_ptr<GeneratorBase> GeneratorTxt2Image::duplicate(bool variation) {
         this->var_strength_,
         this->restore_faces_,
         this->enable_codeformer_,
-        false // only the first one should reload the model
+        false, // only the first one should reload the model
+        this->scheduler_
     ));
     return d;
 }
 
+void GeneratorTxt2Image::describe(profile_record_t *record) const {
+    record->mode = controlnets_.empty() ? "txt2img" : "txt2img+controlnet";
+    record->model = model_;
+    record->width = width_;
+    record->height = height_;
+    record->steps = steps_;
+}
+
 void GeneratorTxt2Image::generate(generator_cb_t cb) {
     bool success = false;
 
@@ -74,6 +85,7 @@ void GeneratorTxt2Image::generate(generator_cb_t cb) {
     params.restore_faces = restore_faces_;
     params.enable_codeformer = enable_codeformer_;
     params.reload_model = reload_model_;
+    params.scheduler = scheduler_.c_str();
     reload_model_ = false;
 
     for (auto it = controlnets_.begin(); it != controlnets_.end(); it++) {
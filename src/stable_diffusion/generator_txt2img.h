@@ -32,7 +32,8 @@ class GeneratorTxt2Image: public GeneratorBase {
             float var_stren,
             bool restore_faces,
             bool enable_codeformer,
-            bool reload_model
+            bool reload_model,
+            const std::string& scheduler
         );
 
         void generate(
@@ -41,6 +42,7 @@ class GeneratorTxt2Image: public GeneratorBase {
 
         
         std::shared_ptr<GeneratorBase> duplicate(bool variation) override;
+        void describe(profile_record_t *record) const override;
         
     private:
         std::string prompt_;
@@ -56,6 +58,7 @@ class GeneratorTxt2Image: public GeneratorBase {
         bool restore_faces_ = false;
         bool enable_codeformer_ = false;
         bool reload_model_ = false;
+        std::string scheduler_;
 };
 
 
@@ -0,0 +1,76 @@
+#include <stdio.h>
+#include <atomic>
+#include <thread>
+#include <algorithm>
+
+#include "src/data/sha256.h"
+#include "src/data/mapped_file.h"
+#include "src/stable_diffusion/model_hasher.h"
+
+namespace dexpert {
+
+namespace {
+    const size_t kHASH_CHUNK_SIZE = 16 * 1024 * 1024;
+    const size_t kSHORT_HASH_SIZE = 10;
+    const unsigned int kMAX_HASH_WORKERS = 4;  // more threads than that just fight for the disk
+
+    // returns an empty hash when canceled, so only the finished files are kept
+    std::string hash_file(const std::filesystem::path& path, const std::atomic_bool *canceled, hash_progress_t *progress) {
+        MappedFile file(path);
+        if (!file.good()) {
+            fprintf(stderr, "Could not map the file %s\n", path.u8string().c_str());
+            return std::string();
+        }
+        Sha256 sha;
+        for (size_t offset = 0; offset < file.size(); offset += kHASH_CHUNK_SIZE) {
+            if (canceled && *canceled) {
+                return std::string();
+            }
+            size_t len = std::min(kHASH_CHUNK_SIZE, file.size() - offset);
+            sha.update(file.data() + offset, len);
+            if (progress) {
+                progress->done += len;
+            }
+        }
+        return sha.hexdigest().substr(0, kSHORT_HASH_SIZE);
+    }
+}  // unnamed namespace
+
+std::string hash_model_file(const std::filesystem::path& path) {
+    return hash_file(path, NULL, NULL);
+}
+
+bool hash_model_files(std::vector<hash_job_t> &jobs, const std::atomic_bool &canceled, hash_progress_t *progress) {
+    if (jobs.empty()) {
+        return true;
+    }
+
+    if (progress) {
+        size_t total = 0;
+        for (const auto & j : jobs) {
+            std::error_code ec;
+            total += std::filesystem::file_size(j.path, ec);
+        }
+        progress->done = 0;
+        progress->total = total;
+    }
+
+    std::atomic<size_t> next_job(0);
+    unsigned int worker_count = std::max(1u, std::min(std::thread::hardware_concurrency(), kMAX_HASH_WORKERS));
+    worker_count = std::min<size_t>(worker_count, jobs.size());
+    std::vector<std::thread> workers;
+    for (unsigned int i = 0; i < worker_count; ++i) {
+        workers.push_back(std::thread([&] {
+            for (size_t index = next_job++; index < jobs.size() && !canceled; index = next_job++) {
+                jobs[index].hash = hash_file(jobs[index].path, &canceled, progress);
+            }
+        }));
+    }
+    for (auto & w : workers) {
+        w.join();
+    }
+
+    return !canceled;
+}
+
+}  // namespace dexpert
@@ -0,0 +1,38 @@
+/*
+ * Copyright (C) 2023 by Rodrigo Antonio de Araujo
+ */
+#ifndef SRC_STABLE_DIFFUSION_MODEL_HASHER_H_
+#define SRC_STABLE_DIFFUSION_MODEL_HASHER_H_
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <filesystem>
+
+namespace dexpert {
+
+typedef struct {
+    std::filesystem::path path;
+    std::string hash;   // empty when it fails or the user cancels
+} hash_job_t;
+
+// bytes of the files, the workers update done while they read them
+typedef struct {
+    std::atomic<size_t> done{0};
+    std::atomic<size_t> total{0};
+} hash_progress_t;
+
+// first 10 characters of the file's sha256
+std::string hash_model_file(const std::filesystem::path& path);
+
+/*
+    Hashes the files in parallel (each file is hashed by one worker).
+    It blocks until the workers finish, the model index calls it from a background thread
+    and the gui reads the progress from there.
+    Returns false if canceled is set before all the files were hashed.
+*/
+bool hash_model_files(std::vector<hash_job_t> &jobs, const std::atomic_bool &canceled, hash_progress_t *progress);
+
+}  // namespace dexpert
+
+#endif  // SRC_STABLE_DIFFUSION_MODEL_HASHER_H_
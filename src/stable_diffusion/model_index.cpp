@@ -0,0 +1,341 @@
+#include <stdio.h>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#endif
+
+#include <nlohmann/json.hpp>
+
+#include "src/stable_diffusion/safetensors.h"
+#include "src/stable_diffusion/model_index.h"
+
+using json = nlohmann::json;
+
+namespace dexpert {
+
+namespace {
+    const int kWATCH_TIMEOUT_MS = 500;
+
+    bool is_model(const std::filesystem::path& path) {
+        std::string ext = path.extension().u8string();
+        std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+        return ext == ".ckpt" || ext == ".safetensors";
+    }
+
+    void read_metadata(indexed_model_t &model, const std::filesystem::path& path) {
+        auto metadata = read_model_metadata(path);
+        if (metadata.known) {
+            model.inpainting = metadata.inpainting;
+            model.arch = metadata.arch;
+            return;
+        }
+        // we do not unpickle .ckpt files, so trust the name
+        std::string name_lower = model.name;
+        std::transform(name_lower.begin(), name_lower.end(), name_lower.begin(), ::tolower);
+        model.inpainting = name_lower.find("inpaint") != std::string::npos;
+        model.arch = "unknown";
+    }
+}  // unnamed namespace
+
+ModelIndex::ModelIndex(const std::wstring& index_path) : index_path_(index_path) {
+    dirty_ = true;
+    watching_ = false;
+    terminated_ = false;
+    hashing_ = false;
+    cancel_hashing_ = false;
+    load();
+}
+
+ModelIndex::~ModelIndex() {
+    stopWatching();
+    stopHashing();
+    if (mergeHashes()) {
+        save();
+    }
+}
+
+const std::list<indexed_model_t>& ModelIndex::models() const {
+    return models_;
+}
+
+bool ModelIndex::hashing(size_t *done, size_t *total) {
+    *done = hash_progress_.done;
+    *total = hash_progress_.total;
+    return hashing_;
+}
+
+const char *ModelIndex::lastError() {
+    if (last_error_.empty()) {
+        return NULL;
+    }
+    return last_error_.c_str();
+}
+
+bool ModelIndex::refresh(const std::vector<std::filesystem::path>& directories, bool force) {
+    last_error_.clear();
+    bool changed = mergeHashes();
+    if (!force && watching_ && !dirty_ && directories == directories_) {
+        if (changed && !save()) {
+            last_error_ = "Could not save the model index";
+            return false;
+        }
+        return true;
+    }
+    if (directories != directories_ || !watching_) {
+        watch(directories);
+    }
+    // the changes made while we walk the directories are going to be catch in the next refresh
+    dirty_ = false;
+
+    std::list<indexed_model_t> models;
+    std::vector<hash_job_t> jobs;
+    for (const auto & directory : directories) {
+        std::error_code ec;
+        std::filesystem::directory_iterator it(directory, ec);
+        if (ec) {
+            fprintf(stderr, "Could not list the models at %s: %s\n", directory.u8string().c_str(), ec.message().c_str());
+            continue;
+        }
+        for (; it != std::filesystem::directory_iterator(); it.increment(ec)) {
+            if (ec) {
+                break;
+            }
+            if (!it->is_regular_file(ec) || !is_model(it->path())) {
+                continue;
+            }
+            indexed_model_t model;
+            model.path = it->path().u8string();
+            model.name = it->path().filename().u8string();
+            model.size = it->file_size(ec);
+            model.mtime = it->last_write_time(ec).time_since_epoch().count();
+            if (ec) {
+                continue;
+            }
+            auto previous = std::find_if(models_.begin(), models_.end(), [&model] (const indexed_model_t & m) {
+                return m.path == model.path;
+            });
+            bool same_file = previous != models_.end() && previous->size == model.size && previous->mtime == model.mtime;
+            if (same_file && !previous->hash.empty()) {
+                model.hash = previous->hash;
+            } else {
+                jobs.push_back(hash_job_t{it->path(), std::string()});
+                changed = true;
+            }
+            if (same_file && !previous->arch.empty()) {
+                model.inpainting = previous->inpainting;
+                model.arch = previous->arch;
+            } else {
+                read_metadata(model, it->path());
+                changed = true;
+            }
+            models.push_back(model);
+        }
+    }
+
+    if (!jobs.empty()) {
+        startHashing(jobs);
+    }
+
+    models.sort([] (const indexed_model_t & a, const indexed_model_t & b) {
+        return a.path < b.path;
+    });
+    changed = changed || models.size() != models_.size();
+    models_ = models;
+
+    if (changed && !save()) {
+        last_error_ = "Could not save the model index";
+        return false;
+    }
+    return true;
+}
+
+void ModelIndex::startHashing(const std::vector<hash_job_t>& jobs) {
+    if (hashing_) {
+        // the files left without hash are going to be hashed in a refresh after this one finishes
+        return;
+    }
+    if (hasher_) {
+        hasher_->join();
+    }
+    hashing_ = true;
+    cancel_hashing_ = false;
+    hasher_.reset(new std::thread([this, jobs] {
+        std::vector<hash_job_t> result = jobs;
+        hash_model_files(result, cancel_hashing_, &hash_progress_);
+        {
+            std::unique_lock<std::mutex> lk(hash_mtx_);
+            hashed_.insert(hashed_.end(), result.begin(), result.end());
+        }
+        hashing_ = false;
+        dirty_ = true;  // the next refresh stores the hashes and queues the files it missed
+    }));
+}
+
+void ModelIndex::stopHashing() {
+    if (!hasher_) {
+        return;
+    }
+    cancel_hashing_ = true;
+    hasher_->join();
+    hasher_.reset();
+}
+
+bool ModelIndex::mergeHashes() {
+    std::vector<hash_job_t> hashed;
+    {
+        std::unique_lock<std::mutex> lk(hash_mtx_);
+        hashed.swap(hashed_);
+    }
+    bool changed = false;
+    for (const auto & j : hashed) {
+        if (j.hash.empty()) {
+            continue;  // canceled or the file could not be read
+        }
+        std::string path = j.path.u8string();
+        for (auto & m : models_) {
+            if (m.path == path) {
+                // a file that changed while it was hashed has another mtime in the next refresh and is hashed again
+                changed = changed || m.hash != j.hash;
+                m.hash = j.hash;
+                break;
+            }
+        }
+    }
+    return changed;
+}
+
+bool ModelIndex::load() {
+    std::ifstream f{std::filesystem::path(index_path_)};
+    if (!f.good()) {
+        return false;
+    }
+    try {
+        json data = json::parse(f);
+        if (!data.contains("models")) {
+            return false;
+        }
+        for (auto & m : data["models"]) {
+            indexed_model_t model;
+            model.path = m["path"].get<std::string>();
+            model.name = m["name"].get<std::string>();
+            model.hash = m["hash"].get<std::string>();
+            model.size = m["size"].get<size_t>();
+            model.mtime = m["mtime"].get<int64_t>();
+            if (m.contains("arch")) {
+                model.arch = m["arch"].get<std::string>();
+                model.inpainting = m["inpainting"].get<bool>();
+            }
+            models_.push_back(model);
+        }
+        return true;
+    } catch (json::exception& e) {
+        fprintf(stderr, "Error loading the model index: %s\n", e.what());
+        models_.clear();
+    }
+    return false;
+}
+
+bool ModelIndex::save() {
+    try {
+        json models = json::array();
+        for (const auto & m : models_) {
+            json model;
+            model["path"] = m.path;
+            model["name"] = m.name;
+            model["hash"] = m.hash;
+            model["size"] = m.size;
+            model["mtime"] = m.mtime;
+            model["inpainting"] = m.inpainting;
+            model["arch"] = m.arch;
+            models.push_back(model);
+        }
+        json data;
+        data["models"] = models;
+        std::ofstream f{std::filesystem::path(index_path_)};
+        f << std::setw(2) << data << std::endl;
+        return f.good();
+    } catch (json::exception& e) {
+        fprintf(stderr, "Error saving the model index: %s\n", e.what());
+    }
+    return false;
+}
+
+void ModelIndex::watch(const std::vector<std::filesystem::path>& directories) {
+    stopWatching();
+    directories_ = directories;
+    terminated_ = false;
+    watching_ = true;
+    watcher_.reset(new std::thread([this, directories] {
+        run_watcher(directories);
+    }));
+}
+
+void ModelIndex::stopWatching() {
+    if (!watcher_) {
+        return;
+    }
+    terminated_ = true;
+    watcher_->join();
+    watcher_.reset();
+    watching_ = false;
+}
+
+void ModelIndex::run_watcher(std::vector<std::filesystem::path> directories) {
+#ifdef _WIN32
+    std::vector<HANDLE> handles;
+    for (const auto & d : directories) {
+        HANDLE h = FindFirstChangeNotificationW(d.wstring().c_str(), FALSE,
+            FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE);
+        if (h == INVALID_HANDLE_VALUE) {
+            fprintf(stderr, "Could not watch the directory %s\n", d.u8string().c_str());
+            continue;
+        }
+        handles.push_back(h);
+    }
+    if (handles.size() != directories.size()) {
+        watching_ = false; // a refresh is going to walk the directories every time
+    }
+    while (!terminated_ && !handles.empty()) {
+        DWORD r = WaitForMultipleObjects(handles.size(), &handles[0], FALSE, kWATCH_TIMEOUT_MS);
+        if (r >= WAIT_OBJECT_0 && r < WAIT_OBJECT_0 + handles.size()) {
+            dirty_ = true;
+            FindNextChangeNotification(handles[r - WAIT_OBJECT_0]);
+        }
+    }
+    for (auto h : handles) {
+        FindCloseChangeNotification(h);
+    }
+#else
+    int fd = inotify_init1(IN_NONBLOCK);
+    if (fd < 0) {
+        watching_ = false;
+        return;
+    }
+    for (const auto & d : directories) {
+        if (inotify_add_watch(fd, d.c_str(), IN_CREATE | IN_DELETE | IN_CLOSE_WRITE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF) < 0) {
+            fprintf(stderr, "Could not watch the directory %s\n", d.u8string().c_str());
+            watching_ = false;
+        }
+    }
+    char buffer[4096];
+    while (!terminated_) {
+        pollfd p = {fd, POLLIN, 0};
+        if (poll(&p, 1, kWATCH_TIMEOUT_MS) > 0) {
+            while (read(fd, buffer, sizeof(buffer)) > 0) {
+                // drain the events, we only need to know something changed
+            }
+            dirty_ = true;
+        }
+    }
+    close(fd);
+#endif
+}
+
+}  // namespace dexpert
@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2023 by Rodrigo Antonio de Araujo
+ */
+#ifndef SRC_STABLE_DIFFUSION_MODEL_INDEX_H_
+#define SRC_STABLE_DIFFUSION_MODEL_INDEX_H_
+
+#include <list>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <memory>
+#include <filesystem>
+
+#include "src/stable_diffusion/model_hasher.h"
+
+namespace dexpert {
+
+typedef struct {
+    std::string path;   // utf-8
+    std::string name;
+    std::string hash;   // first 10 characters of the sha256 (the same short hash used by other tools)
+    size_t size = 0;
+    int64_t mtime = 0;
+    bool inpainting = false;
+    std::string arch;   // sd1, sd2, sdxl or unknown (empty when not computed yet)
+} indexed_model_t;
+
+/*
+    Persistent index of the stable diffusion models (model_index.json at the config dir).
+    A refresh walks the model directories comparing size and modification time, only new or
+    changed files are hashed again. The hashes are computed in a background thread (the hash is empty
+    until it finishes), the next refresh after that stores them. The gui refreshes when hashing()
+    turns false (see PromptPanel::checkModelHashing).
+    The directories are watched (inotify on Linux, change notifications on Windows),
+    so refreshing an index that didn't change does not touch the disk.
+*/
+class ModelIndex {
+ public:
+    ModelIndex(const std::wstring& index_path);
+    ~ModelIndex();
+    ModelIndex (const ModelIndex &) = delete;
+    ModelIndex & operator = (const ModelIndex &) = delete;
+
+    bool refresh(const std::vector<std::filesystem::path>& directories, bool force);
+    const std::list<indexed_model_t>& models() const;
+    // true while the background thread hashes files, the progress is in bytes
+    bool hashing(size_t *done, size_t *total);
+    const char *lastError();
+
+ private:
+    bool load();
+    bool save();
+    void watch(const std::vector<std::filesystem::path>& directories);
+    void stopWatching();
+    void run_watcher(std::vector<std::filesystem::path> directories);
+    void startHashing(const std::vector<hash_job_t>& jobs);
+    void stopHashing();
+    bool mergeHashes();
+
+ private:
+    std::wstring index_path_;
+    std::string last_error_;
+    std::list<indexed_model_t> models_;
+    std::vector<std::filesystem::path> directories_;
+    std::atomic_bool dirty_;
+    std::atomic_bool watching_;
+    std::atomic_bool terminated_;
+    std::unique_ptr<std::thread> watcher_;
+    std::mutex hash_mtx_;
+    std::vector<hash_job_t> hashed_;        // finished by the hasher, not merged yet
+    std::atomic_bool hashing_;
+    std::atomic_bool cancel_hashing_;
+    hash_progress_t hash_progress_;
+    std::unique_ptr<std::thread> hasher_;
+};
+
+}  // namespace dexpert
+
+#endif  // SRC_STABLE_DIFFUSION_MODEL_INDEX_H_
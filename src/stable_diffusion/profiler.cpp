@@ -0,0 +1,224 @@
+#include <stdio.h>
+#include <time.h>
+#include <fstream>
+#include <filesystem>
+
+#include <nlohmann/json.hpp>
+
+#include "src/stable_diffusion/telemetry.h"
+#include "src/stable_diffusion/profiler.h"
+
+using json = nlohmann::json;
+
+namespace dexpert
+{
+
+namespace {
+    const size_t kMAX_RECORDS = 128;
+
+    std::mutex active_mtx;
+    GenerationProfiler *active_profiler = NULL;
+
+    std::string local_time(const char *format) {
+        char buffer[64] = {0,};
+        time_t now = time(NULL);
+        struct tm tm_now;
+#ifdef _WIN32
+        localtime_s(&tm_now, &now);
+#else
+        localtime_r(&now, &tm_now);
+#endif
+        strftime(buffer, sizeof(buffer), format, &tm_now);
+        return buffer;
+    }
+
+    std::string csv_quote(const std::string& value) {
+        std::string result = "\"";
+        for (char c : value) {
+            if (c == '"') {
+                result += '"';
+            }
+            result += c;
+        }
+        return result + "\"";
+    }
+}  // unnamed namespace
+
+GenerationProfiler::GenerationProfiler(const std::wstring& directory) {
+    std::error_code ec;
+    std::filesystem::create_directories(std::filesystem::path(directory), ec);
+    std::string session = local_time("%Y%m%d-%H%M%S");
+    std::wstring name = directory + L"/session-" + std::wstring(session.begin(), session.end());
+    csv_path_ = name + L".csv";
+    json_path_ = name + L".jsonl";
+    set_scope_time_hook(&GenerationProfiler::record);
+}
+
+GenerationProfiler::~GenerationProfiler() {
+    std::unique_lock<std::mutex> lk(active_mtx);
+    if (active_profiler == this) {
+        active_profiler = NULL;
+    }
+}
+
+void GenerationProfiler::begin(const profile_record_t& info) {
+    process_telemetry();
+    generation_timing_t timing;
+    {
+        std::unique_lock<std::mutex> lk(mtx_);
+        current_ = info;
+        current_.id = records_.empty() ? 1 : records_.back().id + 1;
+        current_.started = local_time("%Y-%m-%d %H:%M:%S");
+        current_.entries.clear();
+        telemetry_id_ = current_generation(&timing) ? timing.id : 0;
+        started_ = std::chrono::steady_clock::now();
+        active_ = true;
+    }
+    std::unique_lock<std::mutex> lk(active_mtx);
+    active_profiler = this;
+}
+
+void GenerationProfiler::end(bool success) {
+    {
+        std::unique_lock<std::mutex> lk(active_mtx);
+        if (active_profiler == this) {
+            active_profiler = NULL;
+        }
+    }
+    // python has returned, so its events are already in the queue
+    process_telemetry();
+    generation_timing_t timing;
+    bool has_timing = current_generation(&timing) && timing.id != telemetry_id_ && timing.finished;
+
+    profile_record_t record;
+    {
+        std::unique_lock<std::mutex> lk(mtx_);
+        if (!active_) {
+            return;
+        }
+        active_ = false;
+        current_.success = success;
+        current_.total_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started_).count();
+        if (has_timing) {
+            for (const auto & p : timing.phases) {
+                profile_entry_t e;
+                e.name = p.name;
+                e.source = "python";
+                e.ms = p.ms;
+                e.count = p.count;
+                current_.entries.push_back(e);
+            }
+            if (timing.step_ms_avg > 0) {
+                profile_entry_t e;
+                e.name = "step (average)";
+                e.source = "python";
+                e.ms = timing.step_ms_avg;
+                e.count = timing.steps;
+                current_.entries.push_back(e);
+            }
+            for (const auto & c : timing.caches) {
+                profile_entry_t e;
+                e.name = c.name + " cache hits";
+                e.source = "python";
+                e.ms = 0;
+                e.count = c.hits;
+                current_.entries.push_back(e);
+                e.name = c.name + " cache misses";
+                e.count = c.misses;
+                current_.entries.push_back(e);
+            }
+        }
+        records_.push_back(current_);
+        if (records_.size() > kMAX_RECORDS) {
+            records_.erase(records_.begin());
+        }
+        record = current_;
+    }
+    append(record);
+}
+
+void GenerationProfiler::record(const char *name, double ms) {
+    std::unique_lock<std::mutex> lk(active_mtx);
+    if (active_profiler) {
+        active_profiler->add(name, "cpp", ms, 1);
+    }
+}
+
+void GenerationProfiler::add(const char *name, const char *source, double ms, size_t count) {
+    std::unique_lock<std::mutex> lk(mtx_);
+    if (!active_) {
+        return;
+    }
+    for (auto & e : current_.entries) {
+        if (e.name == name) {
+            e.ms += ms;
+            e.count += count;
+            return;
+        }
+    }
+    profile_entry_t e;
+    e.name = name;
+    e.source = source;
+    e.ms = ms;
+    e.count = count;
+    current_.entries.push_back(e);
+}
+
+std::vector<profile_record_t> GenerationProfiler::records() {
+    std::unique_lock<std::mutex> lk(mtx_);
+    return records_;
+}
+
+const std::wstring& GenerationProfiler::csvPath() const {
+    return csv_path_;
+}
+
+const std::wstring& GenerationProfiler::jsonPath() const {
+    return json_path_;
+}
+
+void GenerationProfiler::append(const profile_record_t& record) {
+    // one row per entry (long format), it's easy to pivot when comparing configurations
+    std::filesystem::path csv_path(csv_path_);
+    std::error_code ec;
+    bool write_header = !std::filesystem::exists(csv_path, ec);
+    std::ofstream csv(csv_path, std::ios::app);
+    if (csv) {
+        if (write_header) {
+            csv << "id,started,mode,model,width,height,steps,success,total_ms,source,phase,ms,count\n";
+        }
+        char total_ms[32];
+        char ms[32];
+        snprintf(total_ms, sizeof(total_ms), "%0.3f", record.total_ms);
+        for (const auto & e : record.entries) {
+            snprintf(ms, sizeof(ms), "%0.3f", e.ms);
+            csv << record.id << "," << record.started << "," << csv_quote(record.mode) << "," << csv_quote(record.model) << ","
+                << record.width << "," << record.height << "," << record.steps << "," << (record.success ? 1 : 0) << ","
+                << total_ms << "," << e.source << "," << csv_quote(e.name) << "," << ms << "," << e.count << "\n";
+        }
+    }
+
+    try {
+        json data;
+        data["id"] = record.id;
+        data["started"] = record.started;
+        data["mode"] = record.mode;
+        data["model"] = record.model;
+        data["width"] = record.width;
+        data["height"] = record.height;
+        data["steps"] = record.steps;
+        data["success"] = record.success;
+        data["total_ms"] = record.total_ms;
+        json entries = json::array();
+        for (const auto & e : record.entries) {
+            entries.push_back({{"name", e.name}, {"source", e.source}, {"ms", e.ms}, {"count", e.count}});
+        }
+        data["entries"] = entries;
+        std::ofstream f(std::filesystem::path(json_path_), std::ios::app);
+        f << data.dump() << "\n";
+    } catch (json::exception& e) {
+        printf("Could not write the profile record: %s\n", e.what());
+    }
+}
+
+}  // namespace dexpert
@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2023 by Rodrigo Antonio de Araujo
+ */
+#ifndef SRC_STABLE_DIFFUSION_PROFILER_H_
+#define SRC_STABLE_DIFFUSION_PROFILER_H_
+
+#include <stddef.h>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "src/data/tracing.h"
+
+namespace dexpert
+{
+
+typedef struct {
+    std::string name;
+    std::string source;     // "cpp" or "python"
+    double ms;
+    size_t count;
+} profile_entry_t;
+
+typedef struct {
+    size_t id = 0;
+    std::string started;    // local time (YYYY-mm-dd HH:MM:SS)
+    std::string mode;
+    std::string model;
+    size_t width = 0;
+    size_t height = 0;
+    size_t steps = 0;
+    bool success = false;
+    double total_ms = 0;
+    std::vector<profile_entry_t> entries;
+} profile_record_t;
+
+/*
+    Wall time of each generation: the C++ steps around the python call (ScopedTimer)
+    plus the python phases received through the telemetry channel.
+    Each finished generation is appended to the session logs (csv and jsonl) at the profile directory.
+*/
+class GenerationProfiler {
+ public:
+    GenerationProfiler(const std::wstring& directory);
+    GenerationProfiler (const GenerationProfiler &) = delete;
+    GenerationProfiler & operator = (const GenerationProfiler &) = delete;
+    virtual ~GenerationProfiler();
+
+    void begin(const profile_record_t& info);
+    void end(bool success);
+    std::vector<profile_record_t> records();
+    const std::wstring& csvPath() const;
+    const std::wstring& jsonPath() const;
+
+ private:
+    static void record(const char *name, double ms);    // the scope time hook
+    void add(const char *name, const char *source, double ms, size_t count);
+    void append(const profile_record_t& record);
+
+ private:
+    std::mutex mtx_;
+    bool active_ = false;
+    size_t telemetry_id_ = 0;
+    std::chrono::steady_clock::time_point started_;
+    profile_record_t current_;
+    std::vector<profile_record_t> records_;
+    std::wstring csv_path_;
+    std::wstring json_path_;
+};
+
+}  // namespace dexpert
+
+#endif  // SRC_STABLE_DIFFUSION_PROFILER_H_
@@ -0,0 +1,149 @@
+#include <stdio.h>
+#include <algorithm>
+
+#include <nlohmann/json.hpp>
+
+#include "src/stable_diffusion/safetensors.h"
+
+using json = nlohmann::json;
+
+namespace dexpert {
+
+namespace {
+    const size_t kMAX_HEADER_SIZE = 100 * 1024 * 1024;
+    const char *kUNET_INPUT_KEY = "model.diffusion_model.input_blocks.0.0.weight";
+    const char *kUNET_CROSS_ATTENTION_KEY = "model.diffusion_model.input_blocks.1.1.transformer_blocks.0.attn2.to_k.weight";
+    const char *kSDXL_SECOND_ENCODER_KEY = "conditioner.embedders.1.model.ln_final.weight";
+    const int64_t kINPAINTING_CHANNELS = 9;  // 4 latent + 4 masked image latent + 1 mask
+
+    bool is_safetensors(const std::filesystem::path& path) {
+        std::string ext = path.extension().u8string();
+        std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+        return ext == ".safetensors";
+    }
+}  // unnamed namespace
+
+SafeTensors::SafeTensors(const std::filesystem::path& path) {
+    file_.reset(new MappedFile(path));
+    if (!file_->good()) {
+        last_error_ = "Could not open the safetensors file";
+        return;
+    }
+    parse();
+}
+
+bool SafeTensors::good() {
+    return last_error_.empty();
+}
+
+const char *SafeTensors::lastError() {
+    if (last_error_.empty()) {
+        return NULL;
+    }
+    return last_error_.c_str();
+}
+
+const std::vector<tensor_info_t>& SafeTensors::tensors() {
+    return tensors_;
+}
+
+const std::map<std::string, std::string>& SafeTensors::metadata() {
+    return metadata_;
+}
+
+const tensor_info_t *SafeTensors::find(const std::string& name) {
+    auto it = names_.find(name);
+    if (it == names_.end()) {
+        return NULL;
+    }
+    return &tensors_[it->second];
+}
+
+const uint8_t *SafeTensors::tensorData(const tensor_info_t& tensor) {
+    if (!good()) {
+        return NULL;
+    }
+    return file_->data() + data_offset_ + tensor.begin;
+}
+
+bool SafeTensors::parse() {
+    const uint8_t *data = file_->data();
+    size_t size = file_->size();
+    if (size < 8) {
+        last_error_ = "The safetensors file is too small";
+        return false;
+    }
+    uint64_t header_size = 0;
+    for (int i = 7; i >= 0; --i) {
+        header_size = (header_size << 8) | data[i];  // little endian
+    }
+    if (header_size > kMAX_HEADER_SIZE || header_size > size - 8) {
+        last_error_ = "Invalid safetensors header size";
+        return false;
+    }
+    data_offset_ = 8 + header_size;
+    size_t data_size = size - data_offset_;
+
+    try {
+        json header = json::parse(data + 8, data + data_offset_);
+        for (auto it = header.begin(); it != header.end(); it++) {
+            if (it.key() == "__metadata__") {
+                for (auto m = it.value().begin(); m != it.value().end(); m++) {
+                    if (m.value().is_string()) {
+                        metadata_[m.key()] = m.value().get<std::string>();
+                    }
+                }
+                continue;
+            }
+            tensor_info_t tensor;
+            tensor.name = it.key();
+            tensor.dtype = it.value()["dtype"].get<std::string>();
+            tensor.shape = it.value()["shape"].get<std::vector<int64_t> >();
+            auto offsets = it.value()["data_offsets"].get<std::vector<size_t> >();
+            if (offsets.size() != 2 || offsets[0] > offsets[1] || offsets[1] > data_size) {
+                last_error_ = "Invalid tensor offsets at the safetensors header";
+                tensors_.clear();
+                names_.clear();
+                return false;
+            }
+            tensor.begin = offsets[0];
+            tensor.end = offsets[1];
+            names_[tensor.name] = tensors_.size();
+            tensors_.push_back(tensor);
+        }
+    } catch (json::exception& e) {
+        last_error_ = std::string("Could not parse the safetensors header: ") + e.what();
+        tensors_.clear();
+        names_.clear();
+        return false;
+    }
+    return true;
+}
+
+model_metadata_t read_model_metadata(const std::filesystem::path& path) {
+    model_metadata_t result;
+    if (!is_safetensors(path)) {
+        return result;
+    }
+    SafeTensors st(path);
+    if (!st.good()) {
+        fprintf(stderr, "%s: %s\n", path.u8string().c_str(), st.lastError());
+        return result;
+    }
+    result.known = true;
+    auto input = st.find(kUNET_INPUT_KEY);
+    result.inpainting = input && input->shape.size() > 1 && input->shape[1] == kINPAINTING_CHANNELS;
+    auto cross_attention = st.find(kUNET_CROSS_ATTENTION_KEY);
+    if (st.find(kSDXL_SECOND_ENCODER_KEY)) {
+        result.arch = "sdxl";
+    } else if (cross_attention && cross_attention->shape.size() > 1 && cross_attention->shape[1] == 768) {
+        result.arch = "sd1";
+    } else if (cross_attention && cross_attention->shape.size() > 1 && cross_attention->shape[1] == 1024) {
+        result.arch = "sd2";
+    } else {
+        result.arch = "unknown";
+    }
+    return result;
+}
+
+}  // namespace dexpert
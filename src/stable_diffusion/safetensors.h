@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2023 by Rodrigo Antonio de Araujo
+ */
+#ifndef SRC_STABLE_DIFFUSION_SAFETENSORS_H_
+#define SRC_STABLE_DIFFUSION_SAFETENSORS_H_
+
+#include <map>
+#include <string>
+#include <vector>
+#include <memory>
+#include <filesystem>
+
+#include "src/data/mapped_file.h"
+
+namespace dexpert {
+
+typedef struct {
+    std::string name;
+    std::string dtype;              // F16, F32, BF16, I64 ...
+    std::vector<int64_t> shape;
+    size_t begin = 0;               // offsets relative to the beginning of the data (after the header)
+    size_t end = 0;
+} tensor_info_t;
+
+/*
+    Reads the index of a .safetensors file.
+    The file is memory mapped and only the json header is parsed, the weights are
+    not touched unless tensorData() is called.
+*/
+class SafeTensors {
+ public:
+    SafeTensors(const std::filesystem::path& path);
+    SafeTensors (const SafeTensors &) = delete;
+    SafeTensors & operator = (const SafeTensors &) = delete;
+
+    bool good();
+    const char *lastError();
+    const std::vector<tensor_info_t>& tensors();
+    const std::map<std::string, std::string>& metadata();
+    const tensor_info_t *find(const std::string& name);
+    const uint8_t *tensorData(const tensor_info_t& tensor);
+
+ private:
+    bool parse();
+
+ private:
+    std::unique_ptr<MappedFile> file_;
+    size_t data_offset_ = 0;
+    std::string last_error_;
+    std::vector<tensor_info_t> tensors_;
+    std::map<std::string, size_t> names_;
+    std::map<std::string, std::string> metadata_;
+};
+
+typedef struct {
+    bool known = false;         // false for .ckpt files or when the header can not be parsed
+    bool inpainting = false;
+    std::string arch;           // sd1, sd2, sdxl or unknown
+} model_metadata_t;
+
+// inspect the unet input channels and the cross attention size without loading the weights
+model_metadata_t read_model_metadata(const std::filesystem::path& path);
+
+}  // namespace dexpert
+
+#endif  // SRC_STABLE_DIFFUSION_SAFETENSORS_H_
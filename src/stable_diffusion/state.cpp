@@ -1,3 +1,5 @@
+#include <stdio.h>
+
 #include "src/stable_diffusion/state.h"
 #include "src/python/helpers.h"
 #include "src/python/wrapper.h"
@@ -8,9 +10,21 @@ namespace {
 
 const char *kNO_ERROR_MESSAGE = "Error with no error message";
 const int MAX_GENERATORS = 4;
+const wchar_t *kMODEL_INDEX_FILE = L"/model_index.json";
+const wchar_t *kPROFILES_DIR = L"/profiles";
 
 std::shared_ptr<StableDiffusionState> sd_state;
 
+void print_cache_stats(const char *title, const py::model_cache_stats_t& stats) {
+    const float mb = 1024.0 * 1024.0;
+    printf("%s: %0.1f MB of %0.1f MB, %zu hits, %zu misses, %zu evictions\n",
+        title, stats.used / mb, stats.budget / mb, stats.hits, stats.misses, stats.evictions);
+    for (const auto & e : stats.entries) {
+        printf("    %-10s %8.1f MB %5zu hits  %s\n", e.kind.c_str(), e.bytes / mb, e.hits, e.name.c_str());
+    }
+    fflush(stdout);
+}
+
 }  // unnamed namespace
 
 std::shared_ptr<StableDiffusionState> get_sd_state() {
@@ -21,6 +35,8 @@ std::shared_ptr<StableDiffusionState> get_sd_state() {
 }
 
 StableDiffusionState::StableDiffusionState() {
+    modelIndex_.reset(new ModelIndex(getConfig().getConfigDir() + kMODEL_INDEX_FILE));
+    profiler_.reset(new GenerationProfiler(getConfig().getConfigDir() + kPROFILES_DIR));
     generators_.resize(MAX_GENERATORS);
     reloadSdModelList();
 }
@@ -30,35 +46,31 @@ StableDiffusionState::~StableDiffusionState() {
 }
 
 bool StableDiffusionState::reloadSdModelList() {
-    bool success = false;
     last_error_ = std::string();
-    const char *msg = "Fail retriving model list";
-    std::list<model_info_t> new_list;
-    auto cb = [&success, &msg, &new_list] (bool s, const char *m, const dexpert::py::model_list_t &l) {
-        if (s) {
-            success = true;
-            for (auto it = l.cbegin(); it != l.cend(); it++) {
-                model_info_t el;
-                el.hash = it->hash;
-                el.model_size = it->size;
-                el.name = it->name;
-                el.path = it->path;
-                new_list.push_back(el);
-            }
-        } else {
-            if (m) msg = m;
-        }
-    };
+    std::vector<std::filesystem::path> directories;
+    directories.push_back(std::filesystem::path(getConfig().sdModelsDir()));
+    std::string additional = getConfig().getAdditionalModelDir();
+    if (!additional.empty()) {
+        directories.push_back(std::filesystem::u8path(additional));
+    }
 
-    dexpert::py::get_py()->execute_callback(dexpert::py::list_models(
-        getConfig().sdModelsDir().c_str(),
-        cb
-    ));
+    bool success = modelIndex_->refresh(directories, false);
 
+    std::list<model_info_t> new_list;
+    for (auto it = modelIndex_->models().cbegin(); it != modelIndex_->models().cend(); it++) {
+        model_info_t el;
+        el.hash = it->hash;
+        el.model_size = it->size;
+        el.name = it->name;
+        el.path = it->path;
+        el.inpainting = it->inpainting;
+        el.arch = it->arch;
+        new_list.push_back(el);
+    }
     sdModels_ = new_list;
 
     if (!success) {
-        last_error_ = msg;
+        last_error_ = modelIndex_->lastError() ? modelIndex_->lastError() : "Fail retriving model list";
     }
 
     return success;
@@ -68,6 +80,10 @@ const std::list<model_info_t> &StableDiffusionState::getSdModels() const {
     return sdModels_;
 }
 
+bool StableDiffusionState::hashingSdModels(size_t *done, size_t *total) {
+    return modelIndex_->hashing(done, total);
+}
+
 std::string StableDiffusionState::getSdModelPath(const std::string& name) {
     for (auto it = sdModels_.cbegin(); it != sdModels_.cend(); it++) {
         if (name == it->name) {
@@ -110,7 +126,11 @@ bool StableDiffusionState::generatorAdd(std::shared_ptr<GeneratorBase> generator
     last_error_.clear();
 
     size_t index = 0;
+    profile_record_t info;
+    generator->describe(&info);
+    profiler_->begin(info);
     generator->generate(generatorMakeCallback());
+    profiler_->end(last_error_.empty() && generator->getImage() != NULL);
 
     if (generator->getImage()) {
         generators_.push_back(generator);
@@ -139,6 +159,66 @@ bool StableDiffusionState::generateNextVariation(int index) {
 }
 
 
+bool StableDiffusionState::printModelCache() {
+    bool success = false;
+    std::string message;
+    py::model_cache_stats_t stats;
+    dexpert::py::get_py()->execute_callback(dexpert::py::model_cache_stats([&] (bool status, const char *msg, const py::model_cache_stats_t& value) {
+        success = status;
+        message = msg ? msg : kNO_ERROR_MESSAGE;
+        stats = value;
+    }));
+    if (!success) {
+        last_error_ = message;
+        return false;
+    }
+    print_cache_stats("Model cache", stats);
+    return true;
+}
+
+bool StableDiffusionState::printPreProcessCache() {
+    bool success = false;
+    std::string message;
+    py::model_cache_stats_t stats;
+    dexpert::py::get_py()->execute_callback(dexpert::py::pre_process_cache_stats([&] (bool status, const char *msg, const py::model_cache_stats_t& value) {
+        success = status;
+        message = msg ? msg : kNO_ERROR_MESSAGE;
+        stats = value;
+    }));
+    if (!success) {
+        last_error_ = message;
+        return false;
+    }
+    print_cache_stats("Pre-processor cache", stats);
+    return true;
+}
+
+bool StableDiffusionState::releasePreProcessModels(const std::string& name) {
+    bool success = false;
+    std::string message;
+    dexpert::py::get_py()->execute_callback(dexpert::py::pre_process_cache_evict(name, [&] (bool status, const char *msg) {
+        success = status;
+        message = msg ? msg : kNO_ERROR_MESSAGE;
+    }));
+    if (!success) {
+        last_error_ = message;
+    }
+    return success;
+}
+
+bool StableDiffusionState::releaseCachedModels(const std::string& name) {
+    bool success = false;
+    std::string message;
+    dexpert::py::get_py()->execute_callback(dexpert::py::model_cache_evict(name, [&] (bool status, const char *msg) {
+        success = status;
+        message = msg ? msg : kNO_ERROR_MESSAGE;
+    }));
+    if (!success) {
+        last_error_ = message;
+    }
+    return success;
+}
+
 image_ptr_t StableDiffusionState::openImage(const char *path) {
     bool success = false;
     last_error_ = std::string();
@@ -199,5 +279,9 @@ const char* StableDiffusionState::lastError() {
 size_t StableDiffusionState::getGeneratorSize() {
     return generators_.size();
 }
+
+GenerationProfiler *StableDiffusionState::profiler() {
+    return profiler_.get();
+}
     
 } // namespace dexpert
@@ -11,6 +11,8 @@
 
 #include "src/python/raw_image.h"
 #include "src/stable_diffusion/generator.h"
+#include "src/stable_diffusion/model_index.h"
+#include "src/stable_diffusion/profiler.h"
 
 namespace dexpert
 {
@@ -23,6 +25,8 @@ typedef struct {
     std::string hash;
     std::string path;
     size_t model_size;
+    bool inpainting;
+    std::string arch;
 } model_info_t;
 
 typedef std::vector<image_ptr_t> image_list_t;
@@ -42,6 +46,14 @@ class StableDiffusionState {
     bool reloadSdModelList();
     const std::list<model_info_t> &getSdModels() const;
     std::string getSdModelPath(const std::string& name);
+    // the new models are hashed in background, their hash is empty until it finishes (progress in bytes)
+    bool hashingSdModels(size_t *done, size_t *total);
+    // models and pipelines python keeps in memory (see models/model_cache.py)
+    bool printModelCache();
+    bool releaseCachedModels(const std::string& name = std::string());
+    // detectors the image pre-processors keep in memory (openpose, depth, lineart...)
+    bool printPreProcessCache();
+    bool releasePreProcessModels(const std::string& name = std::string());
 
     // generation
     bool generatorAdd(std::shared_ptr<GeneratorBase> generator);
@@ -64,12 +76,17 @@ class StableDiffusionState {
     RawImage *getResultsImage(int index);
 
     size_t getGeneratorSize();
+
+    // timing of the latest generations (also appended to the session logs)
+    GenerationProfiler *profiler();
    
 private:
     void scroll_down_generators();
     void scroll_up_generators();
 
 private:
+    std::unique_ptr<ModelIndex> modelIndex_;
+    std::unique_ptr<GenerationProfiler> profiler_;
     std::list<model_info_t> sdModels_;
     std::string last_error_;
     std::vector<std::shared_ptr<GeneratorBase> > generators_;
@@ -0,0 +1,400 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <algorithm>
+
+#include "src/data/tracing.h"
+#include "src/stable_diffusion/sweep.h"
+
+namespace dexpert
+{
+
+namespace {
+    const size_t kMAX_AXIS_VALUES = 16;
+    const int kMAX_CELL_SIZE = 512;     // larger cells are scaled down in the contact sheet
+    const int kSPACING = 4;
+    const int kFONT_HEIGHT = 24;
+    const int kLABEL_HEIGHT = kFONT_HEIGHT + 12;
+    const int kLABEL_WIDTH = 220;
+    const unsigned char kBACKGROUND = 235;
+    const unsigned char kEMPTY_CELL = 160;
+    uint8_t text_color[4] = {0, 0, 0, 255};
+
+    const char *scheduler_names[] = {
+        "PNDMScheduler",
+        "DDIMScheduler",
+        "UniPCMultistepScheduler",
+        "LMSDiscreteScheduler"
+    };
+
+    std::string trim(const std::string& text) {
+        size_t first = 0;
+        size_t last = text.size();
+        while (first < last && isspace((unsigned char) text[first])) {
+            ++first;
+        }
+        while (last > first && isspace((unsigned char) text[last - 1])) {
+            --last;
+        }
+        return text.substr(first, last - first);
+    }
+
+    bool parse_float(const std::string& text, float *value) {
+        char *end = NULL;
+        *value = strtof(text.c_str(), &end);
+        return !text.empty() && end && *end == '\0';
+    }
+
+    bool parse_int(const std::string& text, int *value) {
+        char *end = NULL;
+        long v = strtol(text.c_str(), &end, 10);
+        *value = (int) v;
+        return !text.empty() && end && *end == '\0' && v >= 0 && v <= INT32_MAX;
+    }
+
+    bool valid_value(const sweep_axis_t& axis, const std::string& value) {
+        float f = 0;
+        int i = 0;
+        switch (axis.field) {
+            case sweep_cfg:
+                return parse_float(value, &f) && f >= 1.0f && f <= 30.0f;
+            case sweep_steps:
+                return parse_int(value, &i) && i >= 1 && i <= 150;
+            case sweep_seed:
+                return parse_int(value, &i);
+            case sweep_scheduler:
+                return is_scheduler_name(value);
+            case sweep_lora:
+                return parse_float(value, &f) && f >= 0.0f && f <= 2.0f;
+            default:
+                return false;
+        }
+    }
+
+    // the higher the rank, the cheaper it is to change the value between two cells
+    int change_rank(sweep_field_t field) {
+        switch (field) {
+            case sweep_lora:
+                return 0;   // reloads the model (the lora weights are merged into the unet and the text encoder)
+            case sweep_scheduler:
+                return 1;   // replaces the scheduler of the pipeline
+            case sweep_seed:
+                return 2;   // new noise, the prompt embeddings are reused
+            case sweep_steps:
+                return 3;
+            default:
+                return 4;   // cfg and the axis without values
+        }
+    }
+
+    size_t axis_size(const sweep_axis_t& axis) {
+        return std::max<size_t>(axis.values.size(), 1);
+    }
+
+    // replaces the weight of the lora in the prompt (or adds the lora)
+    std::string prompt_with_lora(const std::string& prompt, const std::string& lora, const std::string& weight) {
+        const std::string tag = "<lora:" + lora + ":";
+        const std::string replacement = tag + weight + ">";
+        size_t start = prompt.find(tag);
+        if (start != std::string::npos) {
+            size_t end = prompt.find('>', start);
+            if (end != std::string::npos) {
+                return prompt.substr(0, start) + replacement + prompt.substr(end + 1);
+            }
+        }
+        return prompt + " " + replacement;
+    }
+
+    void apply_axis(const sweep_axis_t& axis, size_t index, sweep_base_t *params) {
+        if (index >= axis.values.size()) {
+            return;
+        }
+        const std::string& value = axis.values[index];
+        int i = 0;
+        float f = 0;
+        switch (axis.field) {
+            case sweep_cfg:
+                parse_float(value, &f);
+                params->cfg = f;
+                break;
+            case sweep_steps:
+                parse_int(value, &i);
+                params->steps = i;
+                break;
+            case sweep_seed:
+                parse_int(value, &i);
+                params->seed = i;
+                break;
+            case sweep_scheduler:
+                params->scheduler = value;
+                break;
+            case sweep_lora:
+                params->prompt = prompt_with_lora(params->prompt, axis.lora, value);
+                break;
+            default:
+                break;
+        }
+    }
+
+    std::string axis_label(const sweep_axis_t& axis, size_t index) {
+        if (index >= axis.values.size()) {
+            return std::string();
+        }
+        switch (axis.field) {
+            case sweep_cfg:
+                return "cfg " + axis.values[index];
+            case sweep_steps:
+                return "steps " + axis.values[index];
+            case sweep_seed:
+                return "seed " + axis.values[index];
+            case sweep_lora:
+                return axis.lora + " " + axis.values[index];
+            default:
+                return axis.values[index];
+        }
+    }
+
+    // the built-in font has about half of its height of width
+    std::string fit_label(const std::string& label, int width) {
+        size_t max_chars = std::max(width / (kFONT_HEIGHT / 2), 1);
+        if (label.size() <= max_chars) {
+            return label;
+        }
+        return label.substr(0, max_chars > 3 ? max_chars - 3 : max_chars) + "...";
+    }
+
+    void fill_rect(RawImage *image, int x, int y, int w, int h, unsigned char value) {
+        std::vector<unsigned char> row((size_t) w * image->channels(), value);
+        for (int i = 0; i < h; ++i) {
+            image->setPixels(x, y + i, w, 1, row.data());
+        }
+    }
+
+}  // unnamed namespace
+
+bool is_scheduler_name(const std::string& name) {
+    for (size_t i = 0; i < sizeof(scheduler_names) / sizeof(scheduler_names[0]); ++i) {
+        if (name == scheduler_names[i]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool parse_sweep_axis(const std::string& text, sweep_axis_t *axis, std::string *error) {
+    *axis = sweep_axis_t();
+    std::string value = trim(text);
+    if (value.empty()) {
+        return true;
+    }
+    size_t equal = value.find('=');
+    if (equal == std::string::npos) {
+        *error = "the axis should be field=value1,value2... : " + value;
+        return false;
+    }
+    std::string field = trim(value.substr(0, equal));
+    if (field == "cfg") {
+        axis->field = sweep_cfg;
+    } else if (field == "steps") {
+        axis->field = sweep_steps;
+    } else if (field == "seed") {
+        axis->field = sweep_seed;
+    } else if (field == "scheduler") {
+        axis->field = sweep_scheduler;
+    } else if (field.rfind("lora:", 0) == 0 && field.size() > 5) {
+        axis->field = sweep_lora;
+        axis->lora = trim(field.substr(5));
+    } else {
+        *error = "invalid sweep field (use cfg, steps, seed, scheduler or lora:name): " + field;
+        return false;
+    }
+
+    std::string values = value.substr(equal + 1);
+    size_t start = 0;
+    while (start <= values.size()) {
+        size_t comma = values.find(',', start);
+        if (comma == std::string::npos) {
+            comma = values.size();
+        }
+        std::string item = trim(values.substr(start, comma - start));
+        if (!item.empty()) {
+            if (!valid_value(*axis, item)) {
+                *error = "invalid value for " + field + ": " + item;
+                return false;
+            }
+            axis->values.push_back(item);
+        }
+        start = comma + 1;
+    }
+    if (axis->values.empty()) {
+        *error = "the axis " + field + " has no values";
+        return false;
+    }
+    if (axis->values.size() > kMAX_AXIS_VALUES) {
+        *error = "the axis " + field + " has too many values (max " + std::to_string(kMAX_AXIS_VALUES) + ")";
+        return false;
+    }
+    return true;
+}
+
+std::vector<sweep_cell_t> plan_sweep(const sweep_axis_t& x_axis, const sweep_axis_t& y_axis) {
+    std::vector<sweep_cell_t> result;
+    const size_t columns = axis_size(x_axis);
+    const size_t rows = axis_size(y_axis);
+    // the rows go first when y is as expensive or more expensive to change than x
+    const bool rows_first = change_rank(y_axis.field) <= change_rank(x_axis.field);
+    sweep_cell_t cell;
+    for (size_t outer = 0; outer < (rows_first ? rows : columns); ++outer) {
+        for (size_t inner = 0; inner < (rows_first ? columns : rows); ++inner) {
+            cell.x = rows_first ? inner : outer;
+            cell.y = rows_first ? outer : inner;
+            result.push_back(cell);
+        }
+    }
+    return result;
+}
+
+ParameterSweep::ParameterSweep(const sweep_base_t& base, const sweep_axis_t& x_axis, const sweep_axis_t& y_axis) :
+    base_(base), x_axis_(x_axis), y_axis_(y_axis) {
+    if (base_.seed < 0) {
+        // the seed does not change between the cells, only the swept parameters do
+        base_.seed = get_sd_state()->randomSeed();
+    }
+    grid_.resize(rows(), image_list_t(columns()));
+
+    cell_w_ = (int) base_.width;
+    cell_h_ = (int) base_.height;
+    if (cell_w_ > kMAX_CELL_SIZE || cell_h_ > kMAX_CELL_SIZE) {
+        float scale = (float) kMAX_CELL_SIZE / std::max(cell_w_, cell_h_);
+        cell_w_ = std::max((int) (cell_w_ * scale), 1);
+        cell_h_ = std::max((int) (cell_h_ * scale), 1);
+    }
+    label_w_ = y_axis_.values.empty() ? 0 : kLABEL_WIDTH;
+    label_h_ = x_axis_.values.empty() ? 0 : kLABEL_HEIGHT;
+
+    int w = label_w_ + (int) columns() * (cell_w_ + kSPACING) + kSPACING;
+    int h = label_h_ + (int) rows() * (cell_h_ + kSPACING) + kSPACING;
+    sheet_ = std::make_shared<RawImage>((const unsigned char *) NULL, w, h, py::img_rgb, false);
+    fill_rect(sheet_.get(), 0, 0, w, h, kBACKGROUND);
+    sweep_cell_t cell;
+    for (cell.y = 0; cell.y < rows(); ++cell.y) {
+        for (cell.x = 0; cell.x < columns(); ++cell.x) {
+            int x = 0, y = 0;
+            cellRect(cell, &x, &y);
+            fill_rect(sheet_.get(), x, y, cell_w_, cell_h_, kEMPTY_CELL);
+        }
+    }
+    drawLabels();
+}
+
+size_t ParameterSweep::columns() const {
+    return axis_size(x_axis_);
+}
+
+size_t ParameterSweep::rows() const {
+    return axis_size(y_axis_);
+}
+
+const image_grid_t& ParameterSweep::grid() const {
+    return grid_;
+}
+
+image_ptr_t ParameterSweep::contactSheet() const {
+    return sheet_;
+}
+
+const char *ParameterSweep::lastError() const {
+    return last_error_.c_str();
+}
+
+void ParameterSweep::cellRect(const sweep_cell_t& cell, int *x, int *y) const {
+    *x = label_w_ + kSPACING + (int) cell.x * (cell_w_ + kSPACING);
+    *y = label_h_ + kSPACING + (int) cell.y * (cell_h_ + kSPACING);
+}
+
+void ParameterSweep::drawLabels() {
+    sweep_cell_t cell;
+    int x = 0, y = 0;
+    for (cell.x = 0; cell.x < x_axis_.values.size(); ++cell.x) {
+        cellRect(cell, &x, &y);
+        auto label = fit_label(axis_label(x_axis_, cell.x), cell_w_);
+        sheet_->drawText(x, (label_h_ - kFONT_HEIGHT) / 2, label.c_str(), text_color, kFONT_HEIGHT);
+    }
+    cell.x = 0;
+    for (cell.y = 0; cell.y < y_axis_.values.size(); ++cell.y) {
+        cellRect(cell, &x, &y);
+        auto label = fit_label(axis_label(y_axis_, cell.y), label_w_ - kSPACING * 2);
+        sheet_->drawText(kSPACING, y + (cell_h_ - kFONT_HEIGHT) / 2, label.c_str(), text_color, kFONT_HEIGHT);
+    }
+}
+
+void ParameterSweep::drawCell(const sweep_cell_t& cell, RawImage *image) {
+    image_ptr_t converted;
+    if (image->format() != py::img_rgb) {
+        converted = image->removeAlpha();
+        image = converted.get();
+    }
+    if ((int) image->w() != cell_w_ || (int) image->h() != cell_h_) {
+        converted = image->resizeImage(cell_w_, cell_h_);
+        image = converted.get();
+    }
+    int x = 0, y = 0;
+    cellRect(cell, &x, &y);
+    sheet_->pasteAt(x, y, image);
+}
+
+std::shared_ptr<GeneratorBase> ParameterSweep::makeGenerator(const sweep_cell_t& cell, bool reload_model) {
+    sweep_base_t params = base_;
+    apply_axis(x_axis_, cell.x, &params);
+    apply_axis(y_axis_, cell.y, &params);
+    return std::make_shared<GeneratorTxt2Image>(
+        std::make_shared<SeedGenerator>(),
+        false,
+        params.prompt,
+        params.negative,
+        params.model,
+        params.controlnets,
+        params.seed,
+        params.width,
+        params.height,
+        params.steps,
+        params.cfg,
+        0,
+        params.restore_faces,
+        params.enable_codeformer,
+        reload_model,
+        params.scheduler
+    );
+}
+
+bool ParameterSweep::run(sweep_callback_t cb) {
+    TRACE_SCOPE("ParameterSweep::run");
+    last_error_.clear();
+    auto state = get_sd_state();
+    bool reload_model = base_.reload_model;
+    for (const auto & cell : plan_sweep(x_axis_, y_axis_)) {
+        auto g = makeGenerator(cell, reload_model);
+        reload_model = false;
+        image_ptr_t image;
+        if (state->generatorAdd(g) && g->getImage()) {
+            // the generator may be released by the results list, the grid keeps its own image
+            image = g->getImage()->duplicate();
+            grid_[cell.y][cell.x] = image;
+            drawCell(cell, image.get());
+        } else {
+            last_error_ = state->lastError();
+            if (last_error_.empty()) {
+                last_error_ = "the sweep cell was not generated";
+            }
+        }
+        if (cb && !cb(cell, image, sheet_.get())) {
+            return false;
+        }
+        if (!image) {
+            return false;
+        }
+    }
+    return true;
+}
+
+}  // namespace dexpert
@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2023 by Rodrigo Antonio de Araujo
+ */
+#ifndef SRC_STABLE_DIFFUSION_SWEEP_H_
+#define SRC_STABLE_DIFFUSION_SWEEP_H_
+
+#include <string>
+#include <vector>
+#include <functional>
+
+#include "src/python/raw_image.h"
+#include "src/stable_diffusion/state.h"
+#include "src/stable_diffusion/generator_txt2img.h"
+
+namespace dexpert
+{
+
+typedef enum {
+    sweep_none,
+    sweep_cfg,
+    sweep_steps,
+    sweep_seed,
+    sweep_scheduler,
+    sweep_lora
+} sweep_field_t;
+
+typedef struct {
+    sweep_field_t field = sweep_none;
+    std::string lora;                   // sweep_lora: the lora name (as written in the prompt)
+    std::vector<std::string> values;    // sweep_none has no values, it is a single cell
+} sweep_axis_t;
+
+/*
+    Parses an axis, the field followed by the values:
+        cfg=5,7.5,9
+        steps=20,30,50
+        seed=100,200
+        scheduler=PNDMScheduler,DDIMScheduler
+        lora:name=0.2,0.6,1
+    An empty text is an axis without values (sweep_none).
+*/
+bool parse_sweep_axis(const std::string& text, sweep_axis_t *axis, std::string *error);
+// the schedulers python knows (see models/loader.py)
+bool is_scheduler_name(const std::string& name);
+
+typedef struct {
+    std::string prompt;
+    std::string negative;
+    std::string model;          // the model path
+    std::string scheduler;      // empty uses the scheduler of the settings
+    controlnet_list_t controlnets;
+    int seed = -1;              // -1 picks a random seed, all the cells use it
+    size_t width = 512;
+    size_t height = 512;
+    size_t steps = 50;
+    float cfg = 7.5;
+    bool restore_faces = false;
+    bool enable_codeformer = false;
+    bool reload_model = false;
+} sweep_base_t;
+
+typedef struct {
+    size_t x = 0;
+    size_t y = 0;
+} sweep_cell_t;
+
+// the generation order of the cells: the axis that is more expensive to change (a lora weight reloads the model,
+// a scheduler changes the pipeline) varies slower, the cells that share the model run in sequence.
+std::vector<sweep_cell_t> plan_sweep(const sweep_axis_t& x_axis, const sweep_axis_t& y_axis);
+
+// called when a cell finishes (image is NULL when it failed), return false to stop the sweep
+typedef std::function<bool(const sweep_cell_t& cell, image_ptr_t image, RawImage *sheet)> sweep_callback_t;
+
+/*
+    Generates a text to image grid with the values of the axes (x varies in the columns and y in the rows).
+    The cells go through StableDiffusionState::generatorAdd (they are profiled and listed in the results).
+    The contact sheet is composed while the cells finish: the x values are written at the top,
+    the y values at the left, the missing cells stay gray.
+*/
+class ParameterSweep {
+ public:
+    ParameterSweep(const sweep_base_t& base, const sweep_axis_t& x_axis, const sweep_axis_t& y_axis);
+    ParameterSweep (const ParameterSweep &) = delete;
+    ParameterSweep & operator = (const ParameterSweep &) = delete;
+
+    // returns false when a cell fails (see lastError) or the callback stops it
+    bool run(sweep_callback_t cb);
+
+    size_t columns() const;
+    size_t rows() const;
+    const image_grid_t& grid() const;   // grid[y][x], NULL for the missing cells
+    image_ptr_t contactSheet() const;
+    const char *lastError() const;
+
+ private:
+    std::shared_ptr<GeneratorBase> makeGenerator(const sweep_cell_t& cell, bool reload_model);
+    void drawLabels();
+    void drawCell(const sweep_cell_t& cell, RawImage *image);
+    void cellRect(const sweep_cell_t& cell, int *x, int *y) const;
+
+ private:
+    sweep_base_t base_;
+    sweep_axis_t x_axis_;
+    sweep_axis_t y_axis_;
+    image_grid_t grid_;
+    image_ptr_t sheet_;
+    int cell_w_ = 0;
+    int cell_h_ = 0;
+    int label_w_ = 0;
+    int label_h_ = 0;
+    std::string last_error_;
+};
+
+}  // namespace dexpert
+
+#endif  // SRC_STABLE_DIFFUSION_SWEEP_H_
@@ -0,0 +1,226 @@
+#ifdef _WIN32
+#include <Windows.h>
+#include <psapi.h>
+#else
+#include <stdio.h>
+#include <unistd.h>
+#endif
+
+#include <string.h>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <atomic>
+
+#include "src/data/spsc_queue.h"
+#include "src/stable_diffusion/telemetry.h"
+
+namespace dexpert
+{
+
+namespace {
+    const size_t kQUEUE_SIZE = 4096;
+    const size_t kHISTORY_SIZE = 32;
+    const size_t kMAX_PHASE_DEPTH = 16;
+
+    typedef struct {
+        std::string name;
+        double started_ms;
+        double children_ms;
+    } open_phase_t;
+
+    SpscQueue<telemetry_event_t> events(kQUEUE_SIZE);
+    std::atomic<size_t> dropped_events(0);
+
+    std::mutex consumer_mtx;
+    bool has_generation = false;
+    size_t generation_count = 0;
+    double generation_started_ms = 0;
+    generation_timing_t generation;
+    std::vector<open_phase_t> open_phases;
+    size_t step_count = 0;
+    double step_ms_total = 0;
+    std::deque<generation_timing_t> history;
+
+    double steady_ms() {
+        using namespace std::chrono;
+        return duration<double, std::milli>(steady_clock::now().time_since_epoch()).count();
+    }
+
+    size_t resident_memory() {
+#ifdef _WIN32
+        PROCESS_MEMORY_COUNTERS counters;
+        if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+            return counters.WorkingSetSize;
+        }
+        return 0;
+#else
+        size_t pages = 0, resident = 0;
+        FILE *fp = fopen("/proc/self/statm", "r");
+        if (!fp) {
+            return 0;
+        }
+        if (fscanf(fp, "%zu %zu", &pages, &resident) != 2) {
+            resident = 0;
+        }
+        fclose(fp);
+        return resident * (size_t) sysconf(_SC_PAGESIZE);
+#endif
+    }
+
+    void add_phase_time(const std::string& name, double ms) {
+        for (auto & p : generation.phases) {
+            if (p.name == name) {
+                p.ms += ms;
+                p.count += 1;
+                return;
+            }
+        }
+        phase_timing_t p;
+        p.name = name;
+        p.ms = ms;
+        p.count = 1;
+        generation.phases.push_back(p);
+    }
+
+    void add_cache_lookup(const std::string& name, bool hit) {
+        for (auto & c : generation.caches) {
+            if (c.name == name) {
+                (hit ? c.hits : c.misses) += 1;
+                return;
+            }
+        }
+        cache_usage_t c;
+        c.name = name;
+        c.hits = hit ? 1 : 0;
+        c.misses = hit ? 0 : 1;
+        generation.caches.push_back(c);
+    }
+
+    void close_phase(double now_ms) {
+        open_phase_t p = open_phases.back();
+        open_phases.pop_back();
+        double total = now_ms - p.started_ms;
+        add_phase_time(p.name, total - p.children_ms);
+        if (!open_phases.empty()) {
+            open_phases.back().children_ms += total;
+        }
+    }
+
+    void finish_generation(double now_ms, bool success) {
+        while (!open_phases.empty()) {
+            close_phase(now_ms);
+        }
+        generation.finished = true;
+        generation.success = success;
+        generation.total_ms = now_ms - generation_started_ms;
+        history.push_back(generation);
+        if (history.size() > kHISTORY_SIZE) {
+            history.pop_front();
+        }
+    }
+
+    void handle_event(const telemetry_event_t& e) {
+        if (e.kind == telemetry_generation_begin) {
+            if (has_generation && !generation.finished) {
+                finish_generation(e.timestamp_ms, false);  // the end event was lost
+            }
+            generation = generation_timing_t();
+            generation.id = ++generation_count;
+            generation.mode = e.name;
+            generation_started_ms = e.timestamp_ms;
+            open_phases.clear();
+            step_count = 0;
+            step_ms_total = 0;
+            has_generation = true;
+        }
+        if (!has_generation || generation.finished) {
+            return;
+        }
+        if (e.vram > generation.peak_vram) {
+            generation.peak_vram = e.vram;
+        }
+        if (e.ram > generation.peak_ram) {
+            generation.peak_ram = e.ram;
+        }
+        if (e.vram) {
+            generation.vram = e.vram;
+        }
+        switch (e.kind) {
+            case telemetry_phase_begin:
+                if (open_phases.size() < kMAX_PHASE_DEPTH) {
+                    open_phases.push_back({e.name, e.timestamp_ms, 0});
+                }
+            break;
+            case telemetry_phase_end:
+                if (!open_phases.empty()) {
+                    close_phase(e.timestamp_ms);
+                }
+            break;
+            case telemetry_step:
+                generation.step = e.step;
+                generation.steps = e.steps;
+                generation.step_ms_last = e.elapsed_ms;
+                if (e.elapsed_ms > generation.step_ms_max) {
+                    generation.step_ms_max = e.elapsed_ms;
+                }
+                step_count += 1;
+                step_ms_total += e.elapsed_ms;
+                generation.step_ms_avg = step_ms_total / step_count;
+            break;
+            case telemetry_cache:
+                add_cache_lookup(e.name, e.success);
+            break;
+            case telemetry_generation_end:
+                finish_generation(e.timestamp_ms, e.success);
+            break;
+            default:
+            break;
+        }
+    }
+}  // unnamed namespace
+
+bool push_telemetry(telemetry_event_t event) {
+    event.name[sizeof(event.name) - 1] = '\0';
+    event.timestamp_ms = steady_ms();
+    event.ram = resident_memory();
+    if (events.push(event)) {
+        return true;
+    }
+    dropped_events += 1;
+    return false;
+}
+
+void process_telemetry() {
+    std::unique_lock<std::mutex> lk(consumer_mtx);
+    telemetry_event_t buffer[64];
+    size_t count = 0;
+    while ((count = events.pop(buffer, sizeof(buffer) / sizeof(buffer[0]))) > 0) {
+        for (size_t i = 0; i < count; ++i) {
+            handle_event(buffer[i]);
+        }
+    }
+}
+
+bool current_generation(generation_timing_t *timing) {
+    std::unique_lock<std::mutex> lk(consumer_mtx);
+    if (!has_generation) {
+        return false;
+    }
+    *timing = generation;
+    if (!generation.finished) {
+        timing->total_ms = steady_ms() - generation_started_ms;
+    }
+    return true;
+}
+
+std::vector<generation_timing_t> generation_history() {
+    std::unique_lock<std::mutex> lk(consumer_mtx);
+    return std::vector<generation_timing_t>(history.begin(), history.end());
+}
+
+size_t dropped_telemetry_events() {
+    return dropped_events;
+}
+
+}  // namespace dexpert
@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2023 by Rodrigo Antonio de Araujo
+ */
+#ifndef SRC_STABLE_DIFFUSION_TELEMETRY_H_
+#define SRC_STABLE_DIFFUSION_TELEMETRY_H_
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+namespace dexpert
+{
+
+typedef enum {
+    telemetry_generation_begin,
+    telemetry_generation_end,
+    telemetry_phase_begin,
+    telemetry_phase_end,
+    telemetry_step,
+    telemetry_cache
+} telemetry_kind_t;
+
+typedef struct {
+    telemetry_kind_t kind;
+    char name[48];          // generation mode, phase name or cache name
+    bool success;           // generation end, or a cache hit
+    size_t step;
+    size_t steps;
+    double timestep;
+    double elapsed_ms;      // time spent in the step (measured by python)
+    size_t vram;            // bytes allocated by torch
+    size_t ram;             // process resident memory (bytes)
+    double timestamp_ms;    // steady clock, taken when the event was pushed
+} telemetry_event_t;
+
+typedef struct {
+    std::string name;
+    double ms;              // self time (nested phases are not included)
+    size_t count;
+} phase_timing_t;
+
+typedef struct {
+    std::string name;
+    size_t hits;
+    size_t misses;
+} cache_usage_t;
+
+typedef struct {
+    size_t id = 0;          // sequential, starts at 1
+    std::string mode;
+    bool finished = false;
+    bool success = false;
+    double total_ms = 0;
+    size_t step = 0;        // the latest step
+    size_t steps = 0;
+    double step_ms_avg = 0;
+    double step_ms_max = 0;
+    double step_ms_last = 0;
+    size_t vram = 0;        // the latest reported usage
+    size_t peak_vram = 0;
+    size_t peak_ram = 0;
+    std::vector<phase_timing_t> phases;
+    std::vector<cache_usage_t> caches;    // lookups in the python caches (prompt embeddings...)
+} generation_timing_t;
+
+/*
+    Python pushes typed events (dexpert.telemetry) through a lock-free queue.
+    The gui drains the queue and aggregates the events into a timing record per generation,
+    so we know where the time goes without parsing the console text.
+*/
+// producer side: called from the python thread only
+bool push_telemetry(telemetry_event_t event);
+// consumer side: any thread, the consumers are serialized
+void process_telemetry();
+bool current_generation(generation_timing_t *timing);   // false if there is no generation yet
+std::vector<generation_timing_t> generation_history();  // the latest finished generations (oldest first)
+size_t dropped_telemetry_events();
+
+}  // namespace dexpert
+
+#endif  // SRC_STABLE_DIFFUSION_TELEMETRY_H_
@@ -71,6 +71,13 @@ void DiffusionTool::refreshBrowser() {
     page_browser_->select(pages_->visibleIndex() + 1);
 }
 
+void DiffusionTool::parameterSweep() {
+    // the contact sheet grows in the results page while the cells finish
+    pages_->goPage(page_results);
+    refreshBrowser();
+    pages_->parameterSweep();
+}
+
 void DiffusionTool::initToolbar() {
     toolsPanel_ = new Fl_Group(0, 20, this->w(), 20);
     cancelBtn_.reset(new Button(xpm::image(xpm::button_cancel_16x16), [this] {
@@ -88,12 +95,16 @@ void DiffusionTool::initToolbar() {
     consoleBtn_.reset(new Button(xpm::image(xpm::lupe_16x16), [this] {
        showConsoles("Console windows", true);
     }));
+    sweepBtn_.reset(new Button(xpm::image(xpm::tune_16x16), [this] {
+       parameterSweep();
+    }));
 
     toolsPanel_->end();
     toolsPanel_->box(FL_BORDER_BOX);
     cancelBtn_->tooltip("Discart all changes and close the window");
     confirmBtn_->tooltip("Confirm");
     consoleBtn_->tooltip("Show the console window");
+    sweepBtn_->tooltip("Parameter sweep: generates a grid of images varying cfg, steps, seed, scheduler or a lora weight [shortcut key: F10]");
 }
 
 void DiffusionTool::initPagesPanel() {
@@ -126,11 +137,13 @@ void DiffusionTool::alignComponents() {
     cancelBtn_->size(200, 40);
     confirmBtn_->size(200, 40);
     consoleBtn_->size(30, 30);
+    sweepBtn_->size(30, 30);
     
     confirmBtn_->position(toolsPanel_->x() + toolsPanel_->w() - confirmBtn_->w() * 2 - 7, toolsPanel_->y() + 5);
     cancelBtn_->position(toolsPanel_->x() + toolsPanel_->w() - confirmBtn_->w() - 5, toolsPanel_->y() + 5);
 
     consoleBtn_->position(5, toolsPanel_->y() + toolsPanel_->h() / 2 - consoleBtn_->h() / 2);
+    sweepBtn_->position(consoleBtn_->x() + consoleBtn_->w() + 5, consoleBtn_->y());
 
     generateBtn_->position(page_browser_->x() + page_browser_->w() / 2 - 25, page_browser_->y() - 55);
     generateBtn_->size(50, 50);
@@ -152,6 +165,10 @@ int DiffusionTool::handle(int event) {
                 pages_->textToImage();
                 return 1;
             }
+            if (Fl::event_key() == FL_F + 10) {
+                parameterSweep();
+                return 1;
+            }
         }
         break;
         case FL_KEYDOWN: {
@@ -41,6 +41,7 @@ class DiffusionTool : public Fl_Window {
   void alignComponents();
   void gotoSelectedPage();
   void refreshBrowser();
+  void parameterSweep();
   static void pageChangeCallback(Fl_Widget* widget, void *cbdata);
   static void gotoPromptPage(void *cbdata);
 
@@ -56,6 +57,7 @@ class DiffusionTool : public Fl_Window {
     std::unique_ptr<Button> cancelBtn_;
     std::unique_ptr<Button> confirmBtn_;
     std::unique_ptr<Button> consoleBtn_;
+    std::unique_ptr<Button> sweepBtn_;
 };
 
 image_ptr_t get_stable_diffusion_image(RawImage *image, painting_mode_t mode);
@@ -5,8 +5,10 @@
 #include "src/dialogs/size_dialog.h"
 #include "src/dialogs/model_downloader.h"
 #include "src/python/helpers.h"
+#include "src/stable_diffusion/state.h"
 #include "src/config/config.h"
 #include "src/data/xpm.h"
+#include "src/opengl_utils/frame_scheduler.h"
 
 #include "src/windows/main_window.h"
 
@@ -31,6 +33,7 @@ MainWindow::MainWindow():  Fl_Menu_Window(
     image_editor_ = new ImagePanel(0, 0, 1, 1, [this] {
         updateStatusbar();
     });
+    image_editor_->enableHistory();
 
     initMenubar();
 
@@ -41,6 +44,7 @@ MainWindow::MainWindow():  Fl_Menu_Window(
     label_select_ = new Fl_Box(0, 0, 1, 1);
     label_scroll_ = new Fl_Box(0, 0, 1, 1);
     label_size_ = new Fl_Box(0, 0, 1, 1);
+    label_frames_ = new Fl_Box(0, 0, 1, 1);
 
     bottomPanel_->end();
 
@@ -79,9 +83,12 @@ void MainWindow::initMenu() {
     menu_->addItem([this] { saveImage(); }, "", "File/Save", "^s", 0, xpm::save_16x16);
     menu_->addItem([this] { closeImage(); }, "", "File/Close");
     menu_->addItem([this] { Fl::delete_widget(this); }, "", "File/Exit", "", 0, xpm::exit_16x16);
+    menu_->addItem([this] { image_editor_->undo(); }, "", "Edit/Undo", "^z");
+    menu_->addItem([this] { image_editor_->redo(); }, "", "Edit/Redo", "^y");
     menu_->addItem([this] { image_editor_->selectAll(); }, "", "Edit/Select All", "^a");
     menu_->addItem([this] { image_editor_->noSelection(); }, "", "Edit/Select None");
     menu_->addItem([this] { editConfig(); }, "", "Edit/Settings", "", 0, xpm::edit_16x16);
+    menu_->addItem([this] { releaseCachedModels(); }, "", "Edit/Release cached models");
     menu_->addItem([this] { editSelection(painting_img2img); }, "", "Selection/Image to image", "#i");
     menu_->addItem([this] { editSelection(painting_inpaint_masked); }, "", "Selection/Inpaint", "^i");
     menu_->addItem([this] { image_editor_->clearPasteImage(); }, "", "Selection/Discart changes");
@@ -122,12 +129,22 @@ void MainWindow::alignComponents() {
     label_zoom_->resize(label_size_->x() + label_size_->w() + 2, label_size_->y(), 200, stabusbar_h - 4);
     label_select_->resize(label_zoom_->x() + label_zoom_->w() + 2, label_size_->y(), 200, stabusbar_h - 4);
     label_scroll_->resize(label_select_->x() + label_select_->w() + 2, label_size_->y(), 200, stabusbar_h - 4);
+    label_frames_->resize(label_scroll_->x() + label_scroll_->w() + 2, label_size_->y(), 200, stabusbar_h - 4);
 }
 
 void MainWindow::editConfig() {
     show_configuration(); 
 }
 
+void MainWindow::releaseCachedModels() {
+    auto state = get_sd_state();
+    state->printModelCache();
+    state->printPreProcessCache();
+    if (!state->releaseCachedModels() || !state->releasePreProcessModels()) {
+        show_error(state->lastError());
+    }
+}
+
 void MainWindow::newImage(bool fromStableDiffusion) {
     if (fromStableDiffusion) {
         auto img = get_stable_diffusion_image();
@@ -297,6 +314,10 @@ void MainWindow::updateStatusbar() {
     image_editor_->getMouseXY(&sx1, &sy1);
     sprintf(buffer, "Mouse: %d x %d ", sx1, sy1);
     label_scroll_->copy_label(buffer);
+    // the status bar is updated from a frame, so we do not need a timer to keep it fresh
+    frame_stats_t stats = get_frame_stats();
+    sprintf(buffer, "Frames: %0.1f/s %0.2f ms", stats.wakeups_per_second, stats.frame_time_ms);
+    label_frames_->copy_label(buffer);
 }
 
 }  // namespace dexpert
@@ -39,6 +39,7 @@ class MainWindow : Fl_Menu_Window {
   void initMenu();
   void alignComponents();
   void editConfig();
+  void releaseCachedModels();
   void updateStatusbar();
   void newImage(bool fromStableDiffusion);
   void openImage();
@@ -62,6 +63,7 @@ class MainWindow : Fl_Menu_Window {
     Fl_Box * label_select_ = NULL;
     Fl_Box * label_scroll_ = NULL;
     Fl_Box * label_size_ = NULL;
+    Fl_Box * label_frames_ = NULL;
     MainMenu *menu_ = NULL;
     ImagePanel *image_editor_;
 };
@@ -2,9 +2,13 @@
 #include <mutex>
 #include <string>
 #include <atomic>
+#include <thread>
+#include <chrono>
 #include "src/data/xpm.h"
+#include "src/data/tracing.h"
 #include "src/python/raw_image.h"
 #include "src/config/config.h"
+#include "src/stable_diffusion/telemetry.h"
 #include "src/windows/progress_window.h"
 
 
@@ -14,6 +18,7 @@ namespace {
     bool progress_enabled = false;
     bool progress_canceled = false;
     bool preview_enabled = false;
+    bool headless_mode = false;
     std::unique_ptr<ProgressWindow> prog_win;
     std::string progress_label;
 
@@ -75,6 +80,15 @@ void ProgressWindow::update(void *cbdata) {
 }
 
 void ProgressWindow::update() {
+    process_telemetry();
+    generation_timing_t timing;
+    if (current_generation(&timing) && !timing.finished && timing.steps > 0) {
+        char buffer[256] = {0,};
+        snprintf(buffer, sizeof(buffer), "Step %zu/%zu - %0.0f ms/step - VRAM %0.2f GB - RAM %0.2f GB",
+            timing.step + 1, timing.steps, timing.step_ms_avg,
+            timing.vram / (1024.0 * 1024.0 * 1024.0), timing.peak_ram / (1024.0 * 1024.0 * 1024.0));
+        window_->copy_label(buffer);
+    }
     std::unique_lock<std::mutex> lk(mtx_progress);
     progress_->maximum(max_progress);
     progress_->value(current_progress);
@@ -119,7 +133,7 @@ void enable_progress_window(bool preview_images) {
  }
 
 void show_progress_window() {
-    if (prog_win) 
+    if (prog_win || headless_mode) 
         return;
     if (!progress_enabled)
         return;
@@ -130,12 +144,54 @@ void show_progress_window() {
     progress_enabled = false;
 }
 
+namespace {
+// the profiler appends the timings to the session logs, the console copy is for the --trace sessions
+void print_generation_timing() {
+    static size_t printed_id = 0;
+    process_telemetry();
+    if (!tracing_enabled()) {
+        return;
+    }
+    auto history = generation_history();
+    if (history.empty() || history.back().id == printed_id) {
+        return;
+    }
+    const auto & timing = history.back();
+    printed_id = timing.id;
+    printf("[%s] %s in %0.2f s (%zu steps, %0.1f ms/step, peak VRAM %0.2f GB)\n",
+        timing.mode.c_str(), timing.success ? "finished" : "failed", timing.total_ms / 1000.0, timing.steps,
+        timing.step_ms_avg, timing.peak_vram / (1024.0 * 1024.0 * 1024.0));
+    for (const auto & p : timing.phases) {
+        printf("    %s: %0.2f s\n", p.name.c_str(), p.ms / 1000.0);
+    }
+    for (const auto & c : timing.caches) {
+        printf("    %s cache: %zu hits, %zu misses\n", c.name.c_str(), c.hits, c.misses);
+    }
+}
+}  // unnamed namespace
+
 void hide_progress_window() {
+    print_generation_timing();
     if (prog_win) {
         prog_win->hide();
         prog_win.reset();
     }
 }
 
+void set_progress_headless(bool headless) {
+    headless_mode = headless;
+}
+
+bool progress_headless() {
+    return headless_mode;
+}
+
+void progress_wait(double seconds) {
+    if (headless_mode) {
+        std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+    } else {
+        Fl::wait(seconds);
+    }
+}
 
 } // namespace dexpert
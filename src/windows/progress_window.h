@@ -45,6 +45,11 @@ bool should_cancel_progress();
 void enable_progress_window(bool preview_images=true);
 void show_progress_window();
 void hide_progress_window();
+// headless mode: no progress window and no fltk event loop (render nodes without a display)
+void set_progress_headless(bool headless);
+bool progress_headless();
+// waits for the background work, it processes the fltk events when there is a gui
+void progress_wait(double seconds);
 
 } // namespace dexpert
 
@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2023 by Rodrigo Antonio de Araujo
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <chrono>
+#include <memory>
+#include <string>
+
+#include "src/data/content_hash.h"
+#include "src/python/raw_image.h"
+
+namespace {
+
+typedef std::chrono::steady_clock clock_type_t;
+
+double elapsed(clock_type_t::time_point start) {
+    return std::chrono::duration<double>(clock_type_t::now() - start).count();
+}
+
+}  // namespace
+
+int main() {
+    // RawImage::contentHash on a 4K rgba image: full hash, memoized, and after a small change
+    const uint32_t w = 3840, h = 2160;
+    auto image = std::make_shared<dexpert::py::RawImage>((const unsigned char *) NULL, w, h, dexpert::py::img_rgba, false);
+    std::string noise((size_t) w * 4, '\0');
+    for (uint32_t y = 0; y < h; ++y) {
+        for (size_t i = 0; i < noise.size(); ++i) {
+            noise[i] = (char) ((y * 2654435761u) ^ (i * 40503u));
+        }
+        image->setPixels(0, y, w, 1, (const unsigned char *) noise.c_str());
+    }
+    const double bytes = (double) w * h * 4;
+    const int rounds = 20;
+    double raw = 0, full = 0, memo = 0, dirty = 0;
+    for (int i = 0; i < rounds; ++i) {
+        auto start = clock_type_t::now();
+        dexpert::content_hash128(image->buffer(), (size_t) bytes);
+        raw += elapsed(start);
+        image->incVersion();
+        start = clock_type_t::now();
+        image->contentHash();
+        full += elapsed(start);
+        start = clock_type_t::now();
+        image->contentHash();
+        memo += elapsed(start);
+        image->setPixels(i * 64, i * 64, 64, 1, (const unsigned char *) noise.c_str());
+        start = clock_type_t::now();
+        image->contentHash();
+        dirty += elapsed(start);
+    }
+    printf("4K rgba (%0.1f MB) digest %s\n", bytes / (1024 * 1024), dexpert::digest_to_hex(image->contentHash()).c_str());
+    printf("    content_hash128: %8.3f ms  %6.2f GB/s\n", raw * 1000 / rounds, bytes * rounds / raw / 1e9);
+    printf("    full hash:       %8.3f ms  %6.2f GB/s\n", full * 1000 / rounds, bytes * rounds / full / 1e9);
+    printf("    memoized:        %8.3f ms\n", memo * 1000 / rounds);
+    printf("    64x1 edit:       %8.3f ms\n", dirty * 1000 / rounds);
+    return 0;
+}
@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2023 by Rodrigo Antonio de Araujo
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "src/data/content_hash.h"
+
+/*
+    The digests are fixed: they are cache keys on the disk, a change here invalidates the caches.
+    The same test is built with CONTENT_HASH_SCALAR (content_hash_scalar_test), so the sse2 and
+    the portable paths are checked against the same vectors.
+*/
+
+namespace {
+
+const uint64_t kSEED = 1234567;
+int failures = 0;
+
+void check(bool condition, const char *what) {
+    if (!condition) {
+        printf("FAILED: %s\n", what);
+        ++failures;
+    }
+}
+
+typedef struct {
+    size_t size;
+    uint64_t hash64;
+    uint64_t hash64_seed;
+    const char *hash128;
+    const char *hash128_seed;
+} hash_vector_t;
+
+// the sizes cover the short inputs, the stripes (64 bytes) and the blocks (1024 bytes) edges
+const hash_vector_t kVECTORS[] = {
+    {0, 0xef46db3751d8e999ULL, 0x782a14fcf8f34b6aULL, "5882066aec0ee186f89dca7cbfbc740b", "5689c7b58ab493d35377d16dd661dee2"},
+    {1, 0xa96c7f0ce858bbb7ULL, 0x7f0fd28c81ed630eULL, "90c5263435f01f8a36e16f0ed5171f2c", "0b3d7412f4092143eb5e2c379f2c2e94"},
+    {3, 0x56e6957632a487f9ULL, 0x112f96c70443ad3eULL, "2171e179e7b4effd4ebedd2cb1995299", "cef16ec72b8af80f8fd1940842b9cf67"},
+    {8, 0x3da5c7aa269683e0ULL, 0xa89fc5f15c44428bULL, "1ac8ca8c16459f1af7fc57cc394d5092", "6b96df00565169b84e1ab2ee6ab08f9e"},
+    {31, 0x4a74f3a1a39ad4a1ULL, 0xe27b181c731588cdULL, "468c8f16c2066c11cafb1c64bc8f5cfd", "c1e211fb425c8a5b07adbc40fb0075c1"},
+    {32, 0x8d57d6a4671cc43dULL, 0x14c2c26a671350dcULL, "69b3d33857ec40da10daa06a899112a0", "2ffc2370e9bfdac33ec149178241a247"},
+    {63, 0x5c320a0d2707057fULL, 0xddcb3d0022019720ULL, "e9029abf289c789056e27fe21e7f070b", "8cd48a6561b6ad087c3eb1f219e2984b"},
+    {64, 0x7bbabbc45729d17eULL, 0xe05aeb92436aa9d5ULL, "08ca747552a1e9ef6a641995c67a07c9", "eb96e2b15d856620810f3856e965c94b"},
+    {65, 0xf3980c34bae65dc1ULL, 0x53000e548fa824d4ULL, "d012f73d35693ce404b85c022d0045a6", "4cf8f22395f04282203d22501d8dbdc2"},
+    {240, 0xd430520ae3ed2fc6ULL, 0x4925f636b882cda2ULL, "1892147c62c305fb2794ee1834c81b8c", "c6f4b899944a7a833637f998ab5395da"},
+    {1024, 0x149aa44972cdae00ULL, 0xf1d6e563739163a5ULL, "8117304fd122b106c7372995ab600602", "58c97e130f9fa2d436de9ca239de0cb1"},
+    {1025, 0x2c9d0b038b4a4b35ULL, 0x07279848fd16268dULL, "3e455d678fc36e6d1d8ccb7583bfa31e", "e821f7cb70f8a467cbec02e623750a24"},
+    {5137, 0x09802ba870cbde1dULL, 0xa2a2a1342816acbfULL, "f91d3a16ce7f66e8decffd6e2b98f99b", "bc650e6e21883aed73874dc682894fe7"},
+    {100000, 0x3ac9cbc5a9b7f843ULL, 0x4318199d7327c889ULL, "cd7273381f7f5629a9a6c7603fa58f1c", "db1e04db3e4ea9138e6db5ff5dee4199"},
+};
+
+std::vector<unsigned char> pattern(size_t size) {
+    std::vector<unsigned char> result(size);
+    for (size_t i = 0; i < size; ++i) {
+        result[i] = (unsigned char) (i * 31 + 7);
+    }
+    return result;
+}
+
+void test_xxh64() {
+    // the published XXH64 values
+    check(dexpert::content_hash64("", 0) == 0xef46db3751d8e999ULL, "xxh64 of an empty input");
+    check(dexpert::content_hash64("a", 1) == 0xd24ec4f1a98c6e5bULL, "xxh64 of a");
+    check(dexpert::content_hash64("abc", 3) == 0x44bc2cf5ad770999ULL, "xxh64 of abc");
+}
+
+void test_vectors() {
+    auto data = pattern(100000);
+    for (const auto & v : kVECTORS) {
+        std::string name = std::to_string(v.size) + " bytes";
+        check(dexpert::content_hash64(data.data(), v.size) == v.hash64, ("content_hash64 of " + name).c_str());
+        check(dexpert::content_hash64(data.data(), v.size, kSEED) == v.hash64_seed, ("seeded content_hash64 of " + name).c_str());
+        check(dexpert::digest_to_hex(dexpert::content_hash128(data.data(), v.size)) == v.hash128,
+            ("content_hash128 of " + name).c_str());
+        check(dexpert::digest_to_hex(dexpert::content_hash128(data.data(), v.size, kSEED)) == v.hash128_seed,
+            ("seeded content_hash128 of " + name).c_str());
+    }
+}
+
+void test_unaligned() {
+    auto data = pattern(5137 + 3);
+    auto copy = pattern(5137);
+    for (size_t offset = 1; offset < 4; ++offset) {
+        memmove(data.data() + offset, copy.data(), copy.size());
+        check(dexpert::content_hash128(data.data() + offset, copy.size()) == dexpert::content_hash128(copy.data(), copy.size()),
+            "the alignment does not change the digest");
+    }
+}
+
+void test_hex() {
+    check(dexpert::hash_to_hex(0x0123456789abcdefULL) == "0123456789abcdef", "hash_to_hex keeps the leading zeros");
+    dexpert::digest128_t digest;
+    digest.low = 1;
+    digest.high = 0xff;
+    check(dexpert::digest_to_hex(digest) == "00000000000000ff0000000000000001", "digest_to_hex puts the high part first");
+}
+
+}  // namespace
+
+int main() {
+    test_xxh64();
+    test_vectors();
+    test_unaligned();
+    test_hex();
+    if (failures) {
+        printf("%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("all checks passed\n");
+    return 0;
+}
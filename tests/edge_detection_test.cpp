@@ -0,0 +1,154 @@
+/*
+ * Copyright (C) 2023 by Rodrigo Antonio de Araujo
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "src/images/edge_detection.h"
+
+namespace {
+
+int failures = 0;
+
+void check(bool condition, const char *what) {
+    if (!condition) {
+        printf("FAILED: %s\n", what);
+        ++failures;
+    }
+}
+
+// '#' where the control image has a line (opaque), '.' elsewhere
+std::vector<std::string> lines_of(dexpert::image_ptr_t image) {
+    std::vector<std::string> result;
+    const unsigned char *buffer = image->buffer();
+    for (uint32_t y = 0; y < image->h(); ++y) {
+        std::string row;
+        for (uint32_t x = 0; x < image->w(); ++x) {
+            row += buffer[((size_t) y * image->w() + x) * 4 + 3] ? '#' : '.';
+        }
+        result.push_back(row);
+    }
+    return result;
+}
+
+size_t count_lines(dexpert::image_ptr_t image) {
+    size_t count = 0;
+    for (const auto & row : lines_of(image)) {
+        for (char c : row) {
+            count += c == '#';
+        }
+    }
+    return count;
+}
+
+// an rgb image of the color, with the rectangle painted with the other color
+dexpert::image_ptr_t rectangle_image(int w, int h, int x1, int y1, int x2, int y2, unsigned char color, unsigned char other) {
+    std::vector<unsigned char> pixels((size_t) w * h * 3, color);
+    for (int y = y1; y < y2; ++y) {
+        for (int x = x1; x < x2; ++x) {
+            for (int c = 0; c < 3; ++c) {
+                pixels[((size_t) y * w + x) * 3 + c] = other;
+            }
+        }
+    }
+    return std::make_shared<dexpert::RawImage>(pixels.data(), w, h, dexpert::py::img_rgb);
+}
+
+void test_hwc3() {
+    const unsigned char gray[2] = {0, 200};
+    dexpert::RawImage gray_image(gray, 2, 1, dexpert::py::img_gray_8bit);
+    auto rgb = dexpert::hwc3(&gray_image);
+    const unsigned char *p = rgb->buffer();
+    check(rgb->format() == dexpert::py::img_rgb && p[3] == 200 && p[4] == 200 && p[5] == 200, "gray becomes rgb");
+
+    const unsigned char rgba[8] = {0, 0, 0, 255, 0, 0, 0, 0};
+    dexpert::RawImage rgba_image(rgba, 2, 1, dexpert::py::img_rgba);
+    rgb = dexpert::hwc3(&rgba_image);
+    p = rgb->buffer();
+    check(p[0] == 0 && p[3] == 255, "the alpha is composed over white");
+}
+
+void test_canny_square() {
+    // thresholds 100 and 200 over a white square, the suppression keeps one side of the ties
+    const char *expected[] = {
+        "................",
+        "................",
+        "................",
+        ".....######.....",
+        "....#......#....",
+        "...#.......#....",
+        "...#.......#....",
+        "...#.......#....",
+        "...#.......#....",
+        "...#.......#....",
+        "...#.......#....",
+        "....########....",
+        "................",
+        "................",
+        "................",
+        "................",
+    };
+    auto image = rectangle_image(16, 16, 4, 4, 12, 12, 0, 255);
+    auto map = dexpert::canny_map(image.get());
+    auto lines = lines_of(dexpert::canny_threshold(map, 100, 200));
+    bool same = lines.size() == 16;
+    for (size_t y = 0; same && y < lines.size(); ++y) {
+        same = lines[y] == expected[y];
+    }
+    check(same, "the canny lines of a square");
+    check(lines_of(dexpert::canny_threshold(map, 200, 100)) == lines, "the thresholds are swapped when low > high");
+    check(count_lines(dexpert::canny_threshold(map, 2000, 4000)) == 0, "no line above the strongest edge");
+
+    auto flat = rectangle_image(16, 16, 0, 0, 0, 0, 90, 90);
+    check(count_lines(dexpert::canny_threshold(dexpert::canny_map(flat.get()), 1, 2)) == 0, "a flat image has no lines");
+}
+
+void test_canny_hysteresis() {
+    // a strong edge continues through the weak ones it touches, a weak edge alone is dropped
+    dexpert::edge_map_t map;
+    map.w = 8;
+    map.h = 1;
+    map.strength = {250, 150, 150, 0, 150, 0, 50, 250};
+    auto lines = lines_of(dexpert::canny_threshold(map, 100, 200));
+    check(lines.size() == 1 && lines[0] == "###....#", "the weak edges follow the strong ones");
+}
+
+void test_scribble_line() {
+    // the xdog sigmas are meant for 512 pixels, a black line 4 pixels wide over white
+    auto image = rectangle_image(512, 512, 254, 128, 258, 384, 255, 0);
+    auto map = dexpert::scribble_map(image.get());
+    auto lines = lines_of(dexpert::scribble_threshold(map, 32));
+    bool inside = true;
+    size_t count = 0;
+    for (int y = 0; y < 512; ++y) {
+        for (int x = 0; x < 512; ++x) {
+            if (lines[y][x] == '#') {
+                inside = inside && x >= 254 && x < 258 && y >= 128 && y < 384;
+                ++count;
+            }
+        }
+    }
+    check(inside, "the scribble lines stay over the dark line");
+    check(count == 4 * 256, "the whole dark line is a scribble line");
+    check(count_lines(dexpert::scribble_threshold(map, 510)) == 0, "no line above the strongest response");
+
+    auto white = rectangle_image(512, 512, 0, 0, 0, 0, 255, 255);
+    check(count_lines(dexpert::scribble_threshold(dexpert::scribble_map(white.get()), 1)) == 0, "a flat image has no scribble");
+}
+
+}  // namespace
+
+int main() {
+    test_hwc3();
+    test_canny_square();
+    test_canny_hysteresis();
+    test_scribble_line();
+    if (failures) {
+        printf("%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2023 by Rodrigo Antonio de Araujo
+ */
+#include <stdio.h>
+#include <string>
+#include <fstream>
+#include <filesystem>
+
+#include "src/batch/http_server.h"
+#include "src/batch/job_paths.h"
+
+namespace {
+
+int failures = 0;
+
+void check(bool condition, const char *what) {
+    if (!condition) {
+        printf("FAILED: %s\n", what);
+        ++failures;
+    }
+}
+
+dexpert::http_request_t parse(const std::string& head) {
+    dexpert::http_request_t request;
+    check(dexpert::parse_http_head(head, &request), head.c_str());
+    return request;
+}
+
+dexpert::http_request_t with_headers(const std::string& host, const std::string& origin = std::string()) {
+    dexpert::http_request_t request;
+    if (!host.empty()) {
+        request.headers["host"] = host;
+    }
+    if (!origin.empty()) {
+        request.headers["origin"] = origin;
+    }
+    return request;
+}
+
+void test_parse_head() {
+    auto request = parse("POST /jobs?wait=1 HTTP/1.1\r\nHost: localhost:8000\r\nContent-Type:  application/json \r\nX-Empty:");
+    check(request.method == "POST", "the method is read");
+    check(request.path == "/jobs" && request.query == "wait=1", "the query is split from the path");
+    check(request.headers["host"] == "localhost:8000", "the header names are lower case");
+    check(request.headers["content-type"] == "application/json", "the header values are trimmed");
+    check(request.headers.count("x-empty") == 1 && request.headers["x-empty"].empty(), "an empty header is kept");
+
+    request = parse("GET /health HTTP/1.1");
+    check(request.path == "/health" && request.query.empty() && request.headers.empty(), "a request without headers");
+
+    dexpert::http_request_t invalid;
+    check(!dexpert::parse_http_head("GET", &invalid), "a request line without a target is invalid");
+    check(!dexpert::parse_http_head("GET /health", &invalid), "a request line without a version is invalid");
+}
+
+void test_local_request() {
+    check(dexpert::is_local_request(with_headers("localhost")), "localhost");
+    check(dexpert::is_local_request(with_headers("127.0.0.1:8000")), "127.0.0.1 with a port");
+    check(dexpert::is_local_request(with_headers("[::1]:8000")), "the ipv6 loopback");
+    check(dexpert::is_local_request(with_headers("LocalHost:8000", "http://localhost:3000")), "a local page");
+    check(!dexpert::is_local_request(with_headers("")), "the host is required");
+    check(!dexpert::is_local_request(with_headers("evil.example:8000")), "a dns name that points to the loopback");
+    check(!dexpert::is_local_request(with_headers("localhost.evil.example")), "a name that starts with localhost");
+    check(!dexpert::is_local_request(with_headers("localhost:80x")), "an invalid port");
+    check(!dexpert::is_local_request(with_headers("localhost:8000", "https://evil.example")), "another origin");
+    check(!dexpert::is_local_request(with_headers("localhost:8000", "null")), "an opaque origin");
+    check(!dexpert::is_local_request(with_headers("localhost:8000", "http://localhost.evil.example")),
+        "an origin that starts with localhost");
+}
+
+void test_resolve_inside() {
+    std::error_code ec;
+    auto root = std::filesystem::temp_directory_path(ec) / "dexpert-http-server-test";
+    auto output = root / "output";
+    std::filesystem::remove_all(root, ec);
+    std::filesystem::create_directories(output / "inputs", ec);
+    std::ofstream(root / "secret.png") << "secret";
+    const std::string dir = output.u8string();
+
+    std::string resolved;
+    check(dexpert::resolve_inside(dir, "image.png", &resolved) &&
+        resolved == (std::filesystem::weakly_canonical(output, ec) / "image.png").u8string(),
+        "a relative path is resolved inside the directory");
+    check(dexpert::resolve_inside(dir, "new/sub/image.png", &resolved), "a directory that does not exist yet");
+    check(dexpert::resolve_inside(dir, "inputs/../image.png", &resolved), "a .. that stays inside");
+    check(dexpert::resolve_inside(dir, (output / "inputs" / "1-image.png").u8string(), &resolved),
+        "an absolute path inside the directory");
+    check(!dexpert::resolve_inside(dir, "../secret.png", &resolved), "a .. that goes outside");
+    check(!dexpert::resolve_inside(dir, (root / "secret.png").u8string(), &resolved), "an absolute path outside");
+    check(!dexpert::resolve_inside(dir, (root / "output-other" / "a.png").u8string(), &resolved),
+        "a sibling directory with the same prefix");
+    check(!dexpert::resolve_inside(dir, ".", &resolved), "the directory itself");
+    check(!dexpert::resolve_inside(dir, "", &resolved), "an empty path");
+
+    std::filesystem::create_directory_symlink(root, output / "link", ec);
+    if (!ec) {  // creating links requires a privilege on windows
+        check(!dexpert::resolve_inside(dir, "link/secret.png", &resolved), "a link that points outside");
+    }
+    std::filesystem::remove_all(root, ec);
+}
+
+void test_content_type() {
+    check(std::string(dexpert::image_content_type("a/b.png")) == "image/png", "png");
+    check(std::string(dexpert::image_content_type("b.JPG")) == "image/jpeg", "the extension case does not matter");
+    check(std::string(dexpert::image_content_type("b.webp")) == "image/webp", "webp");
+    check(std::string(dexpert::image_content_type("b")) == "application/octet-stream", "no extension");
+}
+
+}  // namespace
+
+int main() {
+    test_parse_head();
+    test_local_request();
+    test_resolve_inside();
+    test_content_type();
+    if (failures) {
+        printf("%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("all checks passed\n");
+    return 0;
+}
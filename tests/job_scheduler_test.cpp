@@ -0,0 +1,153 @@
+/*
+ * Copyright (C) 2023 by Rodrigo Antonio de Araujo
+ */
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "src/batch/job_scheduler.h"
+
+namespace {
+
+int failures = 0;
+
+void check(bool condition, const char *what) {
+    if (!condition) {
+        printf("FAILED: %s\n", what);
+        ++failures;
+    }
+}
+
+dexpert::batch_job_t make_job(const std::string& model, const std::string& prompt, const std::string& mode = "txt2img") {
+    dexpert::batch_job_t job;
+    job.model = model;
+    job.prompt = prompt;
+    job.mode = mode;
+    return job;
+}
+
+std::string resolve(const std::string& model) {
+    if (model == "model.safetensors" || model == "/models/model.safetensors") {
+        return "/models/model.safetensors";
+    }
+    return std::string();
+}
+
+void test_affinity() {
+    auto by_name = dexpert::job_affinity(make_job("model.safetensors", "a cat"), resolve);
+    auto by_path = dexpert::job_affinity(make_job("/models/model.safetensors", "a dog"), resolve);
+    check(by_name.pipeline == by_path.pipeline, "a model given by name and by path has the same affinity");
+    check(dexpert::job_affinity(make_job("missing", "a cat"), resolve).weights == "missing",
+        "an unknown model keeps its name");
+
+    auto lora1 = dexpert::job_affinity(make_job("m", "<lora:a:1> <lora:b:0.5> cat"));
+    auto lora2 = dexpert::job_affinity(make_job("m", "dog <lora:b:.5> <lora:a:1.0>"));
+    check(lora1.weights == lora2.weights, "the lora order and the weight format do not matter");
+    auto lora3 = dexpert::job_affinity(make_job("m", "<lora:a:0.8> <lora:b:0.5>"));
+    check(lora1.weights != lora3.weights, "another lora weight loads other weights");
+
+    auto txt2img = dexpert::job_affinity(make_job("m", "cat"));
+    auto img2img = dexpert::job_affinity(make_job("m", "cat", "img2img"));
+    check(txt2img.weights == img2img.weights && txt2img.pipeline != img2img.pipeline,
+        "the pipeline mode changes only the pipeline");
+
+    auto control1 = make_job("m", "cat");
+    control1.controlnets.push_back({"canny", "a.png", 1.0});
+    control1.controlnets.push_back({"pose", "b.png", 1.0});
+    auto control2 = make_job("m", "cat");
+    control2.controlnets.push_back({"pose", "c.png", 0.5});
+    control2.controlnets.push_back({"canny", "d.png", 0.5});
+    check(dexpert::job_affinity(control1).pipeline == dexpert::job_affinity(control2).pipeline,
+        "the controlnet order and images do not matter");
+    check(dexpert::job_affinity(control1).pipeline != txt2img.pipeline, "the controlnets change the pipeline");
+}
+
+std::vector<dexpert::scheduled_job_t> make_pending(const std::vector<std::string>& models, dexpert::job_time_t submitted) {
+    std::vector<dexpert::scheduled_job_t> result;
+    for (const auto & m : models) {
+        result.push_back({dexpert::job_affinity(make_job(m, "cat")), submitted});
+    }
+    return result;
+}
+
+// picks every job, returns the models in the order they ran
+std::vector<std::string> run_all(dexpert::JobScheduler *scheduler, std::vector<std::string> models, dexpert::job_time_t submitted, dexpert::job_time_t now) {
+    std::vector<std::string> order;
+    while (!models.empty()) {
+        size_t index = scheduler->pick(make_pending(models, submitted), now);
+        order.push_back(models[index]);
+        models.erase(models.begin() + index);
+    }
+    return order;
+}
+
+void test_groups_by_pipeline() {
+    auto now = std::chrono::steady_clock::now();
+    dexpert::JobScheduler scheduler;
+    auto order = run_all(&scheduler, {"a", "b", "a", "b", "a"}, now, now);
+    check(order == std::vector<std::string>({"a", "a", "a", "b", "b"}), "the jobs of the loaded model run first");
+    check(scheduler.stats().weight_reloads == 2, "one model load per model");
+}
+
+void test_largest_group_first() {
+    auto now = std::chrono::steady_clock::now();
+    dexpert::JobScheduler scheduler;
+    auto order = run_all(&scheduler, {"a", "b", "b", "b", "a"}, now, now);
+    check(order[0] == "b", "without a loaded model the pipeline with more jobs runs first");
+}
+
+void test_same_weights_before_others() {
+    auto now = std::chrono::steady_clock::now();
+    dexpert::JobScheduler scheduler;
+    std::vector<dexpert::scheduled_job_t> pending;
+    pending.push_back({dexpert::job_affinity(make_job("a", "cat")), now});
+    scheduler.pick(pending, now);
+    pending.clear();
+    pending.push_back({dexpert::job_affinity(make_job("b", "cat")), now});
+    pending.push_back({dexpert::job_affinity(make_job("b", "cat")), now});
+    pending.push_back({dexpert::job_affinity(make_job("a", "cat", "img2img")), now});
+    check(scheduler.pick(pending, now) == 2, "a job of the loaded weights only rebuilds the pipeline");
+    check(scheduler.stats().pipeline_rebuilds == 1, "the pipeline rebuild is counted");
+}
+
+void test_max_batch() {
+    auto now = std::chrono::steady_clock::now();
+    dexpert::scheduler_config_t config;
+    config.max_batch = 2;
+    dexpert::JobScheduler scheduler(config);
+    auto order = run_all(&scheduler, {"a", "a", "a", "a", "b"}, now, now);
+    check(order == std::vector<std::string>({"a", "a", "b", "a", "a"}), "a batch gives the turn to the other jobs");
+}
+
+void test_starvation() {
+    auto now = std::chrono::steady_clock::now();
+    dexpert::scheduler_config_t config;
+    config.max_wait_seconds = 60;
+    dexpert::JobScheduler scheduler(config);
+    std::vector<dexpert::scheduled_job_t> pending;
+    pending.push_back({dexpert::job_affinity(make_job("a", "cat")), now});
+    scheduler.pick(pending, now);
+
+    pending.clear();
+    pending.push_back({dexpert::job_affinity(make_job("b", "cat")), now - std::chrono::seconds(120)});
+    pending.push_back({dexpert::job_affinity(make_job("a", "cat")), now});
+    check(scheduler.pick(pending, now) == 0, "a job waiting too long runs next");
+    check(scheduler.stats().starved == 1, "the starved job is counted");
+}
+
+}  // namespace
+
+int main() {
+    test_affinity();
+    test_groups_by_pipeline();
+    test_largest_group_first();
+    test_same_weights_before_others();
+    test_max_batch();
+    test_starvation();
+    if (failures) {
+        printf("%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2023 by Rodrigo Antonio de Araujo
+ */
+#include <stdio.h>
+#include <string>
+
+#include "src/console/scrollback.h"
+
+namespace {
+
+const size_t kLINES = 20000;  // about 600 KB, several compressed chunks
+int failures = 0;
+
+void check(bool condition, const char *what) {
+    if (!condition) {
+        printf("FAILED: %s\n", what);
+        ++failures;
+    }
+}
+
+std::string line_text(size_t index) {
+    return "line " + std::to_string(index) + (index % 7 == 0 ? " step done" : " progress");
+}
+
+void fill(dexpert::ScrollbackStore *store) {
+    for (size_t i = 0; i < kLINES; ++i) {
+        std::string text = line_text(i);
+        store->append(text.c_str(), text.size());
+    }
+}
+
+void test_line() {
+    dexpert::ScrollbackStore store(64 * 1024 * 1024);
+    fill(&store);
+    check(store.firstLine() == 0 && store.endLine() == kLINES, "all the lines are kept");
+
+    bool same = true;
+    std::string text;
+    // backwards, so the chunk cache is replaced often
+    for (size_t i = kLINES; i > 0; --i) {
+        same = same && store.line(i - 1, text) && text == line_text(i - 1);
+    }
+    check(same, "each line is read back from its chunk");
+    check(!store.line(kLINES, text) && text.empty(), "a line after the end");
+}
+
+void test_find() {
+    dexpert::ScrollbackStore store(64 * 1024 * 1024);
+    fill(&store);
+    check(store.find("line 12345 ", 0) == 12345, "a line in a compressed chunk");
+    check(store.find(line_text(kLINES - 1), 0) == (int64_t) kLINES - 1, "the line in the open chunk");
+    check(store.find("step done", 8) == 14, "the search starts at from_line");
+    check(store.find("step done", 14) == 14, "from_line itself is searched");
+    check(store.find("line 3 ", 4) == -1, "the lines before from_line are skipped");
+    check(store.find("not there", 0) == -1, "a text that is not there");
+    check(store.find("", 0) == -1, "an empty text");
+
+    int64_t found = 0;
+    size_t count = 0;
+    while ((found = store.find("step done", found)) >= 0) {
+        ++count;
+        ++found;
+    }
+    check(count == (kLINES + 6) / 7, "the search walks the whole log");
+}
+
+void test_memory_limit() {
+    dexpert::ScrollbackStore store(64 * 1024);
+    fill(&store);
+    std::string text;
+    size_t first = store.firstLine();
+    check(first > 0 && store.endLine() == kLINES, "the oldest chunks are discarded");
+    check(store.memoryUsage() <= 64 * 1024 + 64 * 1024, "the memory stays near the limit");
+    check(!store.line(first - 1, text), "a discarded line");
+    check(store.line(first, text) && text == line_text(first), "the oldest line kept");
+    check(store.find("line 0 ", 0) == -1, "the discarded lines are not searched");
+    check(store.find(line_text(first), 0) == (int64_t) first, "the search starts at the oldest line kept");
+}
+
+}  // namespace
+
+int main() {
+    test_line();
+    test_find();
+    test_memory_limit();
+    if (failures) {
+        printf("%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2023 by Rodrigo Antonio de Araujo
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <chrono>
+#include <thread>
+
+#include "src/data/spsc_queue.h"
+
+namespace {
+
+const uint64_t kSTRESS_ITEMS = 20000000;
+const size_t kBATCH_SIZE = 64;
+int failures = 0;
+
+void check(bool condition, const char *what) {
+    if (!condition) {
+        printf("FAILED: %s\n", what);
+        ++failures;
+    }
+}
+
+void test_capacity() {
+    dexpert::SpscQueue<int> q1(1);
+    dexpert::SpscQueue<int> q5(5);
+    dexpert::SpscQueue<int> q64(64);
+    check(q1.capacity() == 2, "capacity 1 rounds up to 2");
+    check(q5.capacity() == 8, "capacity 5 rounds up to 8");
+    check(q64.capacity() == 64, "capacity 64 is kept");
+}
+
+void test_full_and_empty() {
+    dexpert::SpscQueue<int> q(4);
+    int items[6] = {1, 2, 3, 4, 5, 6};
+    int out[6] = {};
+    check(q.empty(), "a new queue is empty");
+    check(q.push(items, 6) == 4, "push stops when the queue is full");
+    check(!q.push(7), "push fails on a full queue");
+    check(q.pop(out, 2) == 2 && out[0] == 1 && out[1] == 2, "pop returns the oldest items");
+    check(q.push(items + 4, 2) == 2, "push wraps around the ring");
+    check(q.pop(out, 6) == 4, "pop returns what is available");
+    check(out[0] == 3 && out[1] == 4 && out[2] == 5 && out[3] == 6, "the wrapped items keep the order");
+    check(q.empty(), "the queue is empty after the items were popped");
+    check(!q.pop(out[0]), "pop fails on an empty queue");
+}
+
+// one producer and one consumer threads, the consumer checks the sequence and the sum
+void test_stress(size_t capacity) {
+    dexpert::SpscQueue<uint64_t> q(capacity);
+    uint64_t received = 0;
+    uint64_t sum = 0;
+    bool ordered = true;
+
+    auto started = std::chrono::steady_clock::now();
+
+    std::thread producer([&q] {
+        uint64_t batch[kBATCH_SIZE];
+        uint64_t next = 0;
+        while (next < kSTRESS_ITEMS) {
+            size_t count = 0;
+            while (count < kBATCH_SIZE && next + count < kSTRESS_ITEMS) {
+                batch[count] = next + count;
+                ++count;
+            }
+            size_t sent = q.push(batch, count);
+            while (sent < count) {
+                std::this_thread::yield();
+                sent += q.push(batch + sent, count - sent);
+            }
+            next += count;
+        }
+    });
+
+    uint64_t batch[kBATCH_SIZE];
+    while (received < kSTRESS_ITEMS) {
+        size_t count = q.pop(batch, kBATCH_SIZE);
+        if (count == 0) {
+            std::this_thread::yield();
+            continue;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            if (batch[i] != received) {
+                ordered = false;
+            }
+            sum += batch[i];
+            ++received;
+        }
+    }
+    producer.join();
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+    check(ordered, "the consumer receives the items in the order they were pushed");
+    check(sum == kSTRESS_ITEMS * (kSTRESS_ITEMS - 1) / 2, "no item is lost or duplicated");
+    check(q.empty(), "the queue is empty after the stress");
+
+    printf("capacity %zu: %llu items in %.3f s (%.1f M items/s)\n",
+        q.capacity(), (unsigned long long) kSTRESS_ITEMS, seconds,
+        seconds > 0 ? kSTRESS_ITEMS / seconds / 1000000.0 : 0.0);
+}
+
+}  // namespace
+
+int main() {
+    test_capacity();
+    test_full_and_empty();
+    test_stress(16);        // the producer waits often
+    test_stress(1024 * 1024);  // the size of the terminal ring
+    if (failures) {
+        printf("%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,220 @@
+/*
+ * Copyright (C) 2023 by Rodrigo Antonio de Araujo
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#define MAKE_PIPE(X) _pipe((X), 4096, O_BINARY)
+#define READ _read
+#define WRITE _write
+#define CLOSE _close
+#else
+#include <unistd.h>
+#define MAKE_PIPE(X) pipe(X)
+#define READ read
+#define WRITE write
+#define CLOSE close
+#endif
+
+#include "src/data/spsc_queue.h"
+
+/*
+    Python side write throughput with the console open.
+    A writer thread plays the python worker: it writes what the worker prints during a generation
+    (the tqdm bars of the diffusers callbacks, the image open/save lines and a tensor dump like the
+    one of manga_line.py) to a pipe. A draw thread plays the console window, every frame it takes
+    kDRAW_MS to draw. The "locked" mode is the terminal before the ring: the pipe reader parses under
+    the mutex the draw holds. The "ring" mode is EmulatedTerminal now: the reader only pushes the
+    bytes to the SpscQueue, a parser thread drains it and the draw reads a snapshot.
+*/
+
+namespace {
+
+typedef std::chrono::steady_clock clock_type_t;
+
+const size_t kPAYLOAD_BYTES = 64 * 1024 * 1024;
+const size_t kRING_SIZE = 1024 * 1024;     // RING_SIZE of emulated_terminal.cpp
+const size_t kREAD_SIZE = 1024;            // LINE_SIZE of emulated_terminal.cpp
+const int kFRAME_MS = 16;
+const int kDRAW_MS = 12;
+
+std::string tqdm_bar(int step, int steps) {
+    char text[160] = "";
+    int filled = step * 20 / steps;
+    std::string bar(filled * 3, '\0');
+    for (int i = 0; i < filled; ++i) {
+        memcpy(&bar[i * 3], "\xe2\x96\x88", 3);   // the full block of tqdm
+    }
+    snprintf(text, sizeof(text), "\r%3d%%|%s%*s| %d/%d [00:%02d<00:%02d,  2.61it/s]",
+        step * 100 / steps, bar.c_str(), 20 - filled, "", step, steps, step / 3, (steps - step) / 3);
+    return text;
+}
+
+std::string tensor_dump() {
+    std::string result = "tensor([[[";
+    uint32_t seed = 1;
+    for (int row = 0; row < 64; ++row) {
+        for (int col = 0; col < 8; ++col) {
+            seed = seed * 1664525u + 1013904223u;
+            char value[32] = "";
+            snprintf(value, sizeof(value), "%s%.4f, ", (seed >> 31) ? "-" : " ", (seed >> 8) / 16777216.0);
+            result += value;
+        }
+        result += "\n         ";
+    }
+    return result + "]]], device='cuda:0')\n";
+}
+
+// one generation: open the image, 50 steps, save it, and a debug tensor
+std::string generation_output() {
+    std::string result = "Open image: /home/user/diffusion-expert/inputs/source.png\n";
+    for (int step = 0; step <= 50; ++step) {
+        result += tqdm_bar(step, 50);
+    }
+    result += "\nSave image: /home/user/diffusion-expert/outputs/0001.png\n";
+    return result + tensor_dump();
+}
+
+// the work the vt100 parser does per byte, enough to keep the bytes from being ignored
+uint64_t parse(const char *data, size_t len, uint64_t state) {
+    for (size_t i = 0; i < len; ++i) {
+        state = (state ^ (unsigned char) data[i]) * 1099511628211ull;
+    }
+    return state;
+}
+
+typedef struct {
+    double write_seconds = 0;
+    double longest_write_ms = 0;
+    size_t received = 0;
+} bench_result_t;
+
+bench_result_t run(bool ring_mode) {
+    bench_result_t result;
+    int fds[2] = {0, 0};
+    if (MAKE_PIPE(fds) != 0) {
+        printf("could not create the pipe\n");
+        return result;
+    }
+
+    std::mutex mtx;     // the parser state
+    std::atomic_bool writing(true);
+    std::atomic_bool reading(true);
+    std::atomic<size_t> received(0);
+    dexpert::SpscQueue<char> ring(kRING_SIZE);
+    uint64_t state = 14695981039346656037ull;
+
+    std::thread draw([&] {
+        while (reading) {
+            auto frame = clock_type_t::now();
+            if (ring_mode) {
+                // draws the published snapshot, the parser keeps running
+                std::this_thread::sleep_for(std::chrono::milliseconds(kDRAW_MS));
+            } else {
+                std::unique_lock<std::mutex> lk(mtx);
+                std::this_thread::sleep_for(std::chrono::milliseconds(kDRAW_MS));
+            }
+            std::this_thread::sleep_until(frame + std::chrono::milliseconds(kFRAME_MS));
+        }
+    });
+
+    std::thread parser([&] {
+        std::vector<char> temp(64 * 1024);
+        while (ring_mode && (reading || !ring.empty())) {
+            size_t count = ring.pop(&temp[0], temp.size());
+            if (count == 0) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                continue;
+            }
+            std::unique_lock<std::mutex> lk(mtx);
+            state = parse(&temp[0], count, state);
+            received += count;
+        }
+    });
+
+    std::thread reader([&] {
+        char temp[kREAD_SIZE];
+        while (true) {
+            int readed = READ(fds[0], temp, sizeof(temp));
+            if (readed <= 0) {
+                break;
+            }
+            if (ring_mode) {
+                size_t sent = ring.push(temp, (size_t) readed);
+                while (sent < (size_t) readed) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                    sent += ring.push(temp + sent, readed - sent);
+                }
+            } else {
+                std::unique_lock<std::mutex> lk(mtx);
+                state = parse(temp, readed, state);
+                received += readed;
+            }
+        }
+        reading = false;
+    });
+
+    const std::string payload = generation_output();
+    size_t written = 0;
+    auto started = clock_type_t::now();
+    while (written < kPAYLOAD_BYTES) {
+        auto before = clock_type_t::now();
+        // python flushes stdout line by line when it is not a tty
+        size_t start = 0;
+        while (start < payload.size()) {
+            size_t end = payload.find_first_of("\r\n", start + 1);
+            end = end == std::string::npos ? payload.size() : end;
+            if (WRITE(fds[1], payload.c_str() + start, (unsigned int) (end - start)) <= 0) {
+                break;
+            }
+            start = end;
+        }
+        double ms = std::chrono::duration<double, std::milli>(clock_type_t::now() - before).count();
+        result.longest_write_ms = std::max(result.longest_write_ms, ms);
+        written += payload.size();
+    }
+    result.write_seconds = std::chrono::duration<double>(clock_type_t::now() - started).count();
+    CLOSE(fds[1]);
+
+    reader.join();
+    parser.join();
+    draw.join();
+    CLOSE(fds[0]);
+    result.received = received;
+    if (state == 0) {
+        printf("\n");   // keeps the parse from being optimized out
+    }
+    return result;
+}
+
+}  // namespace
+
+int main() {
+    size_t payload_size = generation_output().size();
+    size_t expected = (kPAYLOAD_BYTES + payload_size - 1) / payload_size * payload_size;
+    int failures = 0;
+    const char *modes[] = {"locked", "ring"};
+    for (int mode = 0; mode < 2; ++mode) {
+        auto result = run(mode == 1);
+        if (result.received != expected) {
+            printf("FAILED: %s: %zu bytes received, %zu written\n", modes[mode], result.received, expected);
+            ++failures;
+        }
+        printf("%s: %.1f MB in %.3f s (%.1f MB/s), the slowest generation output took %.1f ms\n",
+            modes[mode], expected / 1048576.0, result.write_seconds,
+            result.write_seconds > 0 ? expected / 1048576.0 / result.write_seconds : 0.0,
+            result.longest_write_ms);
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,238 @@
+/*
+ * Copyright (C) 2023 by Rodrigo Antonio de Araujo
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <filesystem>
+
+#include "src/controls/undo_history.h"
+
+namespace {
+
+const int kIMAGE_SIZE = 256;
+int failures = 0;
+
+void check(bool condition, const char *what) {
+    if (!condition) {
+        printf("FAILED: %s\n", what);
+        ++failures;
+    }
+}
+
+uint32_t next_random(uint32_t *state) {
+    *state = *state * 1664525u + 1013904223u;
+    return *state >> 8;
+}
+
+dexpert::image_ptr_t make_image(int w, int h, uint32_t seed) {
+    std::vector<unsigned char> pixels((size_t) w * h * 3);
+    for (auto & p : pixels) {
+        p = (unsigned char) next_random(&seed);
+    }
+    return std::make_shared<dexpert::RawImage>(pixels.data(), w, h, dexpert::py::img_rgb, false);
+}
+
+std::string pixels_of(dexpert::image_ptr_t image) {
+    return std::string((const char *) image->buffer(), (size_t) image->w() * image->h() * image->channels());
+}
+
+// noise over the rectangle (it does not compress, so the budgets are easy to reach)
+void paint(dexpert::UndoHistory *history, dexpert::image_ptr_t image, int x, int y, int w, int h, uint32_t seed) {
+    history->touch(0, image, x, y, w, h);
+    std::vector<unsigned char> pixels((size_t) w * h * image->channels());
+    for (auto & p : pixels) {
+        p = (unsigned char) next_random(&seed);
+    }
+    image->setPixels(x, y, w, h, pixels.data());
+    history->commit();
+}
+
+void test_undo_redo_tiles() {
+    dexpert::UndoHistory history(64 * 1024 * 1024, 64 * 1024 * 1024);
+    dexpert::image_ptr_t layers[2] = {make_image(kIMAGE_SIZE, kIMAGE_SIZE, 1), dexpert::image_ptr_t()};
+    std::string original = pixels_of(layers[0]);
+    paint(&history, layers[0], 10, 20, 100, 30, 2);
+    std::string first = pixels_of(layers[0]);
+    paint(&history, layers[0], 60, 0, 70, 200, 3);
+    std::string second = pixels_of(layers[0]);
+
+    check(history.stats().undo_steps == 2, "one step per commit");
+    check(history.undo(layers) && pixels_of(layers[0]) == first, "undo restores the tiles of the last step");
+    check(history.undo(layers) && pixels_of(layers[0]) == original, "undo restores the tiles of the first step");
+    check(!history.undo(layers), "there is nothing else to undo");
+    check(history.redo(layers) && pixels_of(layers[0]) == first, "redo applies the same xor again");
+    check(history.redo(layers) && pixels_of(layers[0]) == second, "redo applies the last step");
+    check(!history.canRedo(), "there is nothing else to redo");
+
+    history.touch(0, layers[0], 0, 0, 64, 64);
+    history.commit();
+    check(history.stats().undo_steps == 2, "a step that changed nothing is not recorded");
+}
+
+void test_replace() {
+    dexpert::UndoHistory history(64 * 1024 * 1024, 64 * 1024 * 1024);
+    dexpert::image_ptr_t layers[2] = {make_image(kIMAGE_SIZE, kIMAGE_SIZE, 4), dexpert::image_ptr_t()};
+    std::string original = pixels_of(layers[0]);
+    history.replace(0, layers[0]);
+    layers[0] = make_image(100, 50, 5);
+    std::string resized = pixels_of(layers[0]);
+    history.commit();
+
+    check(history.undo(layers) && layers[0]->w() == kIMAGE_SIZE && pixels_of(layers[0]) == original,
+        "undo brings the replaced image back");
+    check(history.redo(layers) && layers[0]->w() == 100 && pixels_of(layers[0]) == resized,
+        "redo brings the new image back");
+
+    history.replace(1, layers[1]);
+    layers[1] = make_image(32, 32, 6);
+    history.commit();
+    check(history.undo(layers) && !layers[1], "undo removes a layer that did not exist");
+}
+
+void test_memory_budget() {
+    // every step is about 90 KB (the noise does not compress), only one fits in the memory
+    dexpert::UndoHistory history(100 * 1024, 64 * 1024 * 1024);
+    dexpert::image_ptr_t layers[2] = {make_image(kIMAGE_SIZE, kIMAGE_SIZE, 7), dexpert::image_ptr_t()};
+    std::vector<std::string> states;
+    states.push_back(pixels_of(layers[0]));
+    for (uint32_t i = 0; i < 6; ++i) {
+        paint(&history, layers[0], 0, i * 20, kIMAGE_SIZE, 120, 10 + i);
+        states.push_back(pixels_of(layers[0]));
+    }
+    auto stats = history.stats();
+    check(stats.undo_steps == 6, "the spilled steps are kept");
+    check(stats.disk_bytes > 0, "the oldest steps go to the spill file");
+    check(stats.memory_bytes <= 100 * 1024, "the memory stays in the budget");
+
+    bool restored = true;
+    for (size_t i = states.size() - 1; i > 0; --i) {
+        restored = restored && history.undo(layers) && pixels_of(layers[0]) == states[i - 1];
+    }
+    check(restored, "the spilled steps restore the pixels");
+    check(history.stats().memory_bytes <= 100 * 1024, "the redo steps also go to the spill file");
+    restored = true;
+    for (size_t i = 1; i < states.size(); ++i) {
+        restored = restored && history.redo(layers) && pixels_of(layers[0]) == states[i];
+    }
+    check(restored, "the spilled steps are redone");
+}
+
+void test_disk_budget() {
+    dexpert::UndoHistory history(100 * 1024, 200 * 1024);
+    dexpert::image_ptr_t layers[2] = {make_image(kIMAGE_SIZE, kIMAGE_SIZE, 20), dexpert::image_ptr_t()};
+    for (uint32_t i = 0; i < 10; ++i) {
+        paint(&history, layers[0], 0, 0, kIMAGE_SIZE, 120, 30 + i);
+    }
+    auto stats = history.stats();
+    check(stats.disk_bytes <= 200 * 1024, "the disk stays in the budget");
+    check(stats.undo_steps < 10 && stats.undo_steps > 1, "the oldest steps are dropped");
+}
+
+// the spill file is named after the history address (see UndoHistory::spill)
+std::filesystem::path spill_file_of(dexpert::UndoHistory *history) {
+    std::error_code ec;
+    char prefix[64] = "";
+    snprintf(prefix, sizeof(prefix), "dexpert-undo-%p-", (void *) history);
+    for (const auto & entry : std::filesystem::directory_iterator(std::filesystem::temp_directory_path(ec), ec)) {
+        if (entry.path().filename().u8string().rfind(prefix, 0) == 0) {
+            return entry.path();
+        }
+    }
+    return std::filesystem::path();
+}
+
+void test_spill_file_reuse() {
+    dexpert::UndoHistory history(100 * 1024, 64 * 1024 * 1024);
+    dexpert::image_ptr_t layers[2] = {make_image(kIMAGE_SIZE, kIMAGE_SIZE, 60), dexpert::image_ptr_t()};
+    for (uint32_t i = 0; i < 4; ++i) {
+        paint(&history, layers[0], 0, 0, kIMAGE_SIZE, 120, 70 + i);
+    }
+    std::string last = pixels_of(layers[0]);
+    size_t peak = 0;
+    // every cycle reads the steps back and spills them again
+    for (int cycle = 0; cycle < 20; ++cycle) {
+        while (history.undo(layers)) {
+            peak = std::max(peak, history.stats().disk_bytes);
+        }
+        while (history.redo(layers)) {
+            peak = std::max(peak, history.stats().disk_bytes);
+        }
+    }
+    check(pixels_of(layers[0]) == last, "the cycles end at the last step");
+    std::error_code ec;
+    auto path = spill_file_of(&history);
+    check(!path.empty(), "the spill file was found");
+    size_t size = (size_t) std::filesystem::file_size(path, ec);
+    check(!ec && peak > 0 && size <= 2 * peak, "the freed ranges of the spill file are reused");
+}
+
+void test_disk_budget_redo() {
+    // undoing a replace keeps the newer image, bigger here, so the redo steps hold more bytes
+    dexpert::UndoHistory history(100 * 1024, 128 * 1024);
+    dexpert::image_ptr_t layers[2] = {make_image(8, 8, 80), dexpert::image_ptr_t()};
+    const int sizes[] = {64, 96, 128, 160, 192};
+    for (uint32_t i = 0; i < 5; ++i) {
+        history.replace(0, layers[0]);
+        layers[0] = make_image(sizes[i], sizes[i], 90 + i);
+        history.commit();
+    }
+    while (history.undo(layers)) {
+    }
+    auto stats = history.stats();
+    check(layers[0]->w() == 8, "every step is undone");
+    check(stats.disk_bytes <= 128 * 1024, "the disk stays in the budget when the redo steps hold it");
+    check(stats.redo_steps < 5 && stats.redo_steps > 1, "the farthest redo steps are dropped");
+    bool redone = true;
+    for (size_t i = 0; i < stats.redo_steps; ++i) {
+        redone = redone && history.redo(layers) && (int) layers[0]->w() == sizes[i];
+    }
+    check(redone && !history.canRedo(), "the steps kept are redone");
+}
+
+void test_truncated_spill_file() {
+    dexpert::UndoHistory history(100 * 1024, 64 * 1024 * 1024);
+    dexpert::image_ptr_t layers[2] = {make_image(kIMAGE_SIZE, kIMAGE_SIZE, 40), dexpert::image_ptr_t()};
+    for (uint32_t i = 0; i < 4; ++i) {
+        paint(&history, layers[0], 0, 0, kIMAGE_SIZE, 120, 50 + i);
+    }
+    check(history.stats().disk_bytes > 0, "the oldest steps go to the spill file");
+
+    bool truncated = false;
+    std::error_code ec;
+    auto path = spill_file_of(&history);
+    if (!path.empty()) {
+        std::filesystem::resize_file(path, 0, ec);
+        truncated = !ec;
+    }
+    check(truncated, "the spill file was found");
+
+    check(history.undo(layers), "the step in the memory is undone");
+    std::string before = pixels_of(layers[0]);
+    check(!history.undo(layers), "a step that can not be read is not undone");
+    check(pixels_of(layers[0]) == before, "the failed step does not change the pixels");
+    auto stats = history.stats();
+    check(stats.undo_steps == 0 && stats.disk_bytes == 0, "the failed step and the older ones are dropped");
+    check(stats.redo_steps == 1, "the redo steps are kept");
+}
+
+}  // namespace
+
+int main() {
+    test_undo_redo_tiles();
+    test_replace();
+    test_memory_budget();
+    test_disk_budget();
+    test_spill_file_reuse();
+    test_disk_budget_redo();
+    test_truncated_spill_file();
+    if (failures) {
+        printf("%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("all checks passed\n");
+    return 0;
+}